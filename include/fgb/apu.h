@@ -2,6 +2,7 @@
 #define FGB_APU_H
 
 #include "audio/channel.h"
+#include "scheduler.h"
 
 #include <stdint.h>
 
@@ -72,6 +73,8 @@ fgb_apu* fgb_apu_create(uint32_t sample_rate, fgb_apu_sample_callback sample_cal
 void fgb_apu_destroy(fgb_apu* apu);
 void fgb_apu_reset(fgb_apu* apu);
 void fgb_apu_tick(fgb_apu* apu);
+void fgb_apu_advance(fgb_apu* apu, uint32_t cycles); // Equivalent to calling fgb_apu_tick `cycles` times
+uint32_t fgb_apu_next_event(const fgb_apu* apu); // Cycles until the next sample chunk is complete
 
 uint8_t fgb_apu_read(const fgb_apu* apu, uint16_t addr);
 void fgb_apu_write(fgb_apu* apu, uint16_t addr, uint8_t value);
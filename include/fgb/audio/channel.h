@@ -168,6 +168,12 @@ void fgb_audio_channel_2_tick(fgb_audio_channel_2* ch);
 void fgb_audio_channel_3_tick(fgb_audio_channel_3* ch);
 void fgb_audio_channel_4_tick(fgb_audio_channel_4* ch);
 
+// Equivalent to calling the tick function `cycles` times without register changes in between
+void fgb_audio_channel_1_advance(fgb_audio_channel_1* ch, uint32_t cycles);
+void fgb_audio_channel_2_advance(fgb_audio_channel_2* ch, uint32_t cycles);
+void fgb_audio_channel_3_advance(fgb_audio_channel_3* ch, uint32_t cycles);
+void fgb_audio_channel_4_advance(fgb_audio_channel_4* ch, uint32_t cycles);
+
 // Frame sequencer tick functions
 void fgb_audio_channel_1_fs_tick(fgb_audio_channel_1* ch, uint8_t step);
 void fgb_audio_channel_2_fs_tick(fgb_audio_channel_2* ch, uint8_t step);
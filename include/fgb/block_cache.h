@@ -0,0 +1,70 @@
+#ifndef FGB_BLOCK_CACHE_H
+#define FGB_BLOCK_CACHE_H
+
+#include "code_table.h"
+#include "instruction.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FGB_BLOCK_CACHE_ARENA_SIZE          (2 * 1024 * 1024) // 2 MiB of decoded blocks
+#define FGB_BLOCK_CACHE_MAX_BLOCK_LENGTH    32 // Guest instructions per block
+
+struct fgb_cpu;
+
+typedef struct fgb_cached_instruction {
+    fgb_instruction_handler handler;
+    const fgb_instruction* instruction;
+    uint16_t operand; // Operand bytes, little endian
+    uint8_t operand_size;
+} fgb_cached_instruction;
+
+typedef struct fgb_cached_block {
+    uint16_t start;
+    uint16_t end; // One past the last byte of the block
+    uint8_t length;
+    fgb_cached_instruction instructions[];
+} fgb_cached_block;
+
+typedef struct fgb_block_cache_stats {
+    uint64_t hits;
+    uint64_t misses; // Blocks that had to be decoded
+    uint64_t invalidations; // Blocks dropped because their memory was written
+    uint64_t flushes; // Times the whole cache was dropped
+} fgb_block_cache_stats;
+
+// Cached interpreter: runs of guest instructions are decoded once into their
+// handler, instruction info and operand, and replayed from there afterwards.
+//
+// Blocks are kept in a code table (see code_table.h). Writes to WRAM/HRAM
+// invalidate the blocks that cover the written byte.
+typedef struct fgb_block_cache {
+    struct fgb_cpu* cpu;
+
+    uint8_t* arena;
+    size_t arena_used;
+
+    fgb_code_table blocks; // Slots hold fgb_cached_block pointers
+
+    // Set by writes that may change the code being executed (bank switches,
+    // self-modifying code). The running block stops after the current instruction.
+    bool exit_block;
+
+    fgb_block_cache_stats stats;
+} fgb_block_cache;
+
+
+fgb_block_cache* fgb_block_cache_create(struct fgb_cpu* cpu);
+void fgb_block_cache_destroy(fgb_block_cache* cache);
+void fgb_block_cache_flush(fgb_block_cache* cache); // Drops all blocks
+
+// Returns the block starting at addr, decoding it first if necessary.
+// Returns NULL if code at addr is not cached (e.g. VRAM or OAM) or its first
+// instruction straddles the end of a bank, and must be interpreted.
+const fgb_cached_block* fgb_block_cache_get(fgb_block_cache* cache, uint16_t addr);
+
+// Must be called for every CPU write
+void fgb_block_cache_notify_write(fgb_block_cache* cache, uint16_t addr);
+
+#endif // FGB_BLOCK_CACHE_H
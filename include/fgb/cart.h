@@ -1,13 +1,16 @@
 #ifndef FGB_CART_H
 #define FGB_CART_H
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #define FGB_CART_MAX_ROM_BANKS 512
 #define FGB_CART_MAX_RAM_BANKS 16
 #define FGB_CART_ROM_BANK_SIZE 0x4000
 #define FGB_CART_RAM_BANK_SIZE 0x2000
+#define FGB_CART_RTC_STATE_SIZE 48 // RTC state appended to the save file, in the format most emulators use
 
 enum fgb_cart_type {
     CART_TYPE_ROM_ONLY                       = 0x00,
@@ -85,6 +88,13 @@ enum fgb_cart_rtc_register {
     RTC_REG_START = 8,
 };
 
+// Where the data of a ROM image lives, decides how it is released
+enum fgb_cart_rom_storage {
+    CART_ROM_OWNED,     // Heap copy made by fgb_rom_image_create
+    CART_ROM_BORROWED,  // Caller-owned buffer, must outlive the cart
+    CART_ROM_MAPPED,    // Read-only private mapping of the ROM file
+};
+
 typedef struct fgb_cart_header {
     /* 0x100 */ uint8_t entry_point[4];     // Usually NOP, JP 0x150
     /* 0x104 */ uint8_t logo[48];           // Nintendo logo
@@ -101,24 +111,39 @@ typedef struct fgb_cart_header {
     /* 0x14E */ uint8_t global_checksum[2]; // Global checksum (2 bytes)
 } fgb_cart_header;
 
+// Validated ROM contents, shared by every cart running the same game.
+// Carts only keep their MBC state, RAM and RTC, so creating more of them is cheap.
+typedef struct fgb_rom_image {
+    fgb_cart_header header;
+    const uint8_t* data;
+    size_t size;
+    enum fgb_cart_rom_storage storage;
+    size_t bank_count;
+    const uint8_t* banks[FGB_CART_MAX_ROM_BANKS];
+    atomic_int refcount;
+} fgb_rom_image;
+
 typedef struct fgb_cart {
     fgb_cart_header header;
-    uint8_t* rom;
+    struct fgb_save* save; // Keeps the save file up to date, NULL if the cart isn't saved
+    struct fgb_rom_image* image;
+    const uint8_t* rom; // image->data
     uint8_t* ram;
-    size_t rom_size;
+    size_t rom_size; // image->size
     uint8_t rom_bank;
     uint8_t rom_bank_high;
     uint8_t ram_bank;
-    uint8_t* rom_banks[FGB_CART_MAX_ROM_BANKS];
+    const uint8_t* const* rom_banks; // image->banks
     uint8_t* ram_banks[FGB_CART_MAX_RAM_BANKS];
     struct {
         uint8_t latch[RTC_REG_COUNT];
-        uint8_t regs[RTC_REG_COUNT];
+        uint8_t regs[RTC_REG_COUNT]; // Time at the last update, only brought up to date on latch and write
         uint8_t last_latch;
-        uint32_t cycles;
+        uint64_t cycles; // Unhalted cycles since the last update
     } rtc;
     bool ram_enabled;
     bool has_ram_battery;
+    bool has_rtc;
     bool has_rumble;
     bool rumble_enabled;
     uint32_t ram_size_bytes;
@@ -126,18 +151,40 @@ typedef struct fgb_cart {
     enum fgb_cart_mode mode;
     uint8_t(*read)(const struct fgb_cart* cart, uint16_t addr);
     void(*write)(struct fgb_cart* cart, uint16_t addr, uint8_t value);
-    void(*tick)(struct fgb_cart* cart);
+    void(*tick)(struct fgb_cart* cart, uint32_t cycles);
 } fgb_cart;
 
-fgb_cart* fgb_cart_load(const uint8_t* data, size_t size);
+// Images start with a reference count of 1, owned by the caller
+fgb_rom_image* fgb_rom_image_create(const uint8_t* data, size_t size); // Copies the ROM
+fgb_rom_image* fgb_rom_image_create_borrowed(const uint8_t* data, size_t size); // Uses data directly, it must outlive the image
+fgb_rom_image* fgb_rom_image_create_mapped(const char* path); // Maps the ROM file read-only
+fgb_rom_image* fgb_rom_image_retain(fgb_rom_image* image);
+void fgb_rom_image_release(fgb_rom_image* image); // Frees the image once the last reference is gone
+
+fgb_cart* fgb_cart_load_image(fgb_rom_image* image); // Shares image, the cart holds its own reference
+fgb_cart* fgb_cart_load(const uint8_t* data, size_t size); // Copies the ROM
+fgb_cart* fgb_cart_load_borrowed(const uint8_t* data, size_t size); // Uses data directly, it must outlive the cart
+fgb_cart* fgb_cart_load_mapped(const char* path); // Maps the ROM file read-only, instances share its pages
 void fgb_cart_destroy(fgb_cart* cart);
 
 const uint8_t* fgb_cart_get_battery_buffered_ram(const fgb_cart* cart);
 bool fgb_cart_load_battery_buffered_ram(const fgb_cart* cart, const uint8_t* data, size_t size);
 size_t fgb_cart_get_ram_size(const fgb_cart* cart);
+bool fgb_cart_has_battery(const fgb_cart* cart); // Whether there is battery backed RAM or an RTC to save
+
+// Current and latched registers plus a UNIX timestamp, all little endian.
+// Loading advances the clock by the real time that passed since it was saved.
+void fgb_cart_save_rtc(fgb_cart* cart, uint8_t* dest);
+void fgb_cart_load_rtc(fgb_cart* cart, const uint8_t* src);
 
 uint8_t fgb_cart_read(const fgb_cart* cart, uint16_t addr);
 void fgb_cart_write(fgb_cart* cart, uint16_t addr, uint8_t value);
-void fgb_cart_tick(fgb_cart* cart);
+void fgb_cart_tick(fgb_cart* cart, uint32_t cycles);
+uint16_t fgb_cart_get_rom_bank(const fgb_cart* cart, uint16_t addr); // ROM bank currently mapped at addr (< 0x8000)
+
+// Host memory currently mapped by the MBC, used for the MMU's page tables.
+// Returns NULL if the region has to go through fgb_cart_read/fgb_cart_write.
+const uint8_t* fgb_cart_map_rom(const fgb_cart* cart, uint16_t addr); // 16 KiB bank mapped at addr (< 0x8000)
+uint8_t* fgb_cart_map_ram(const fgb_cart* cart); // 8 KiB bank mapped at A000
 
 #endif // FGB_CART_H
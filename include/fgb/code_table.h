@@ -0,0 +1,51 @@
+#ifndef FGB_CODE_TABLE_H
+#define FGB_CODE_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FGB_CODE_TABLE_MAX_ROM_BANKS    512
+#define FGB_CODE_TABLE_BANK_SIZE        0x4000
+#define FGB_CODE_TABLE_BOOTROM_SIZE     0x100
+#define FGB_CODE_TABLE_WRAM_SIZE        0x2000
+#define FGB_CODE_TABLE_HRAM_SIZE        0x7F
+
+struct fgb_cpu;
+
+// What a CPU write means for the code in a table, see fgb_code_table_classify_write
+enum fgb_code_write {
+    CODE_WRITE_NONE,
+    CODE_WRITE_BANK, // MBC register, the bank mapped under the running block may have changed
+    CODE_WRITE_CODE, // RAM that blocks were read from
+};
+
+// Slots of the blocks shared by the block cache and the JIT, with whatever
+// each of them stores per guest address.
+//
+// Slots are keyed by (ROM bank, PC) for code in ROM, and by PC for code in WRAM
+// and HRAM. Switchable WRAM on CGB and everything else has no slots.
+typedef struct fgb_code_table {
+    void** rom_slots[FGB_CODE_TABLE_MAX_ROM_BANKS]; // Allocated on first use
+    void* bootrom_slots[FGB_CODE_TABLE_BOOTROM_SIZE];
+    void* wram_slots[FGB_CODE_TABLE_WRAM_SIZE];
+    void* hram_slots[FGB_CODE_TABLE_HRAM_SIZE];
+    uint8_t ram_code[0x10000 / 8]; // Bitmap of RAM addresses that blocks were read from
+} fgb_code_table;
+
+
+void fgb_code_table_destroy(fgb_code_table* table); // Frees the ROM bank tables
+void fgb_code_table_clear(fgb_code_table* table);
+void fgb_code_table_clear_ram(fgb_code_table* table); // Only drops the WRAM and HRAM slots
+
+// Returns the slot of the block starting at pc in the currently mapped bank, or NULL if
+// code at pc is not cached. region_end is set to the end of the bank or RAM region, a block
+// can't read past it since whatever is mapped there may change independently.
+void** fgb_code_table_lookup(fgb_code_table* table, const struct fgb_cpu* cpu, uint16_t pc, uint16_t* region_end);
+
+// Records that a block was read from [start, end), only RAM is tracked
+void fgb_code_table_mark(fgb_code_table* table, uint16_t start, uint32_t end);
+
+// Echo RAM writes are mapped onto WRAM in addr
+enum fgb_code_write fgb_code_table_classify_write(const fgb_code_table* table, uint16_t* addr);
+
+#endif // FGB_CODE_TABLE_H
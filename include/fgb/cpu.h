@@ -2,11 +2,15 @@
 #define FGB_CPU_H
 
 #include "apu.h"
+#include "block_cache.h"
 #include "mmu.h"
 #include "timer.h"
+#include "trace.h"
 #include "io.h"
+#include "jit.h"
 #include "instruction.h"
 #include "ppu.h"
+#include "scheduler.h"
 #include "types.h"
 
 #include <stdbool.h>
@@ -16,7 +20,7 @@
 #define FGB_CPU_CLOCK_SPEED     4194304 // 4.194304 MHz
 #define FGB_SCREEN_REFRESH_RATE 59.7275 // ~59.7 Hz
 #define FGB_CYCLES_PER_FRAME    ((int)(FGB_CPU_CLOCK_SPEED / FGB_SCREEN_REFRESH_RATE)) // 70224 T-cycles
-#define FGB_CPU_MAX_BREAKPOINTS 16
+#define FGB_CPU_BP_ANY_BANK 0xFFFF
 
 
 enum fgb_cpu_interrupt {
@@ -37,6 +41,20 @@ enum fgb_cpu_mode {
     CPU_MODE_EI,
 };
 
+enum fgb_cpu_backend {
+    CPU_BACKEND_INTERPRETER,
+    CPU_BACKEND_CACHED, // Predecoded blocks, see block_cache.h
+    CPU_BACKEND_JIT, // x86-64 only, see jit.h
+};
+
+// Variants of the frame loop, each compiled with its features fixed
+enum fgb_cpu_core {
+    CPU_CORE_PRODUCTION, // No breakpoints, stepping or tracing
+    CPU_CORE_DEBUG, // Breakpoints, stepping and tracing
+    CPU_CORE_TEST, // Debug core that also honours test_mode, used with custom MMU ops
+    CPU_CORE_COUNT
+};
+
 enum fgb_cpu_flag {
     CPU_FLAG_C = 1 << 4,
     CPU_FLAG_H = 1 << 5,
@@ -49,6 +67,22 @@ enum fgb_cpu_flag {
     CPU_FLAG_z = CPU_FLAG_Z,
 };
 
+// ALU operation whose flags have not been written to F yet
+enum fgb_cpu_lazy_op {
+    LAZY_OP_NONE, // F is up to date
+    LAZY_OP_ADD,  // x + y + carry
+    LAZY_OP_SUB,  // x - y - carry
+    LAZY_OP_INC,  // x + 1, C preserved in carry
+    LAZY_OP_DEC,  // x - 1, C preserved in carry
+    LAZY_OP_AND,  // Result in x
+    LAZY_OP_OR,   // Result in x, also used for XOR
+};
+
+typedef struct fgb_cpu_breakpoint {
+    uint16_t addr;
+    uint16_t bank; // ROM bank that must be mapped at addr, or FGB_CPU_BP_ANY_BANK
+} fgb_cpu_breakpoint;
+
 typedef void (*fgb_cpu_bp_callback)(struct fgb_cpu* cpu, size_t bp, uint16_t addr);
 typedef void (*fgb_cpu_step_callback)(struct fgb_cpu* cpu);
 typedef void (*fgb_cpu_trace_callback)(struct fgb_cpu* cpu, uint16_t addr, uint32_t depth, const char* disasm);
@@ -99,8 +133,42 @@ typedef struct fgb_cpu_trace_step {
     const fgb_instruction* instruction;
 } fgb_cpu_trace_step;
 
+typedef struct fgb_cpu_idle_loop_stats {
+    uint64_t loops_detected; // Times a polling loop was recognized
+    uint64_t skips; // Times iterations were skipped
+    uint64_t iterations_skipped;
+    uint64_t cycles_skipped;
+} fgb_cpu_idle_loop_stats;
+
+// Short loops that do nothing but poll a PPU, timer or joypad register, e.g.
+// `LDH A,(0x44); CP 0x90; JR NZ`. Every iteration behaves the same until the
+// register changes, so iterations up to the next point where it (or anything
+// else observable) may change are skipped by advancing the clock.
+typedef struct fgb_cpu_idle_loop {
+    bool enabled; // Set by fgb_cpu_run_frame while instructions run back to back
+    bool armed;
+    uint16_t start; // Address of the first instruction
+    uint16_t end; // Address following the backward branch
+    uint16_t addr; // Polled register
+    uint32_t cycles; // Cycles per iteration
+    uint64_t armed_at; // Cycle at which the current iteration started
+    uint64_t bound; // Reads before this cycle return the same value
+
+    fgb_cpu_idle_loop_stats stats;
+} fgb_cpu_idle_loop;
+
 typedef struct fgb_cpu {
     fgb_cpu_regs regs;
+
+    // Most flag results are overwritten before anything reads F, so ALU
+    // instructions only record their operands here. Use fgb_cpu_get_f and
+    // fgb_cpu_set_f instead of accessing regs.f directly.
+    struct {
+        uint8_t op; // See fgb_cpu_lazy_op
+        uint8_t x;
+        uint8_t y;
+        uint8_t carry;
+    } lazy_flags;
     fgb_mmu mmu;
     fgb_timer timer;
     fgb_io io;
@@ -110,7 +178,8 @@ typedef struct fgb_cpu {
     fgb_model model; // DMG or CGB
 
     bool test_mode;
-    
+    enum fgb_cpu_core core; // Chosen at creation, debugger setters switch to CPU_CORE_DEBUG
+
     bool ime;
     enum fgb_cpu_mode mode;
 
@@ -120,21 +189,42 @@ typedef struct fgb_cpu {
 
     uint32_t cycles_this_frame;
     uint64_t total_cycles;
+    fgb_scheduler scheduler;
 
     struct {
         uint8_t enable;
         uint8_t flags;
     } interrupt;
 
-    uint16_t breakpoints[FGB_CPU_MAX_BREAKPOINTS];
-    bool debugging;
+    // The bitmap has a bit set for every address with at least one breakpoint,
+    // so checking the PC is a single bit test. Bank qualified breakpoints are
+    // only looked up in the list once the bit matched.
+    uint8_t bp_bitmap[0x10000 / 8];
+    fgb_cpu_breakpoint* breakpoints;
+    size_t bp_count;
+    size_t bp_capacity;
+    bool debugging; // Set through fgb_cpu_set_debugging, only checked by the debug cores
     bool do_step;
     fgb_cpu_bp_callback bp_callback;
     fgb_cpu_step_callback step_callback;
     fgb_cpu_trace_callback trace_callback;
+    fgb_trace* trace; // Takes precedence over trace_callback
     bool force_disable_interrupts;
 
     fgb_cpu_trace_step last_ins;
+
+    bool skip_idle_loops;
+    fgb_cpu_idle_loop idle_loop;
+
+    fgb_block_cache* block_cache; // NULL unless using CPU_BACKEND_CACHED
+    fgb_jit* jit; // NULL unless using CPU_BACKEND_JIT
+
+    // Operand bytes of the current instruction supplied by the block cache,
+    // consumed by the next fetches instead of reading memory
+    struct {
+        uint16_t value;
+        uint8_t count;
+    } operand;
 } fgb_cpu;
 
 
@@ -143,9 +233,15 @@ fgb_cpu* fgb_cpu_create_with(fgb_cart* cart, fgb_ppu* ppu, fgb_apu* apu, const f
 // Extended create that allows choosing model and custom MMU ops
 fgb_cpu* fgb_cpu_create_ex(fgb_cart* cart, fgb_ppu* ppu, fgb_apu* apu, fgb_model model, const fgb_mmu_ops* mmu_ops);
 void fgb_cpu_destroy(fgb_cpu* cpu);
+// Returns false if the backend is not available on this platform
+bool fgb_cpu_set_backend(fgb_cpu* cpu, enum fgb_cpu_backend backend);
+void fgb_cpu_set_core(fgb_cpu* cpu, enum fgb_cpu_core core);
+void fgb_cpu_flush_blocks(fgb_cpu* cpu); // Drops cached and translated code after memory was modified externally
 
 void fgb_cpu_tick(fgb_cpu* cpu); // Tick 1 T-cycle
 void fgb_cpu_m_tick(fgb_cpu* cpu); // Tick 1 M-cycle (4 T-cycles)
+void fgb_cpu_sync(fgb_cpu* cpu); // Runs all peripherals up to the current cycle
+void fgb_cpu_sync_due(fgb_cpu* cpu); // Runs the peripherals whose next event is due
 void fgb_cpu_reset(fgb_cpu* cpu);
 void fgb_cpu_run_frame(fgb_cpu* cpu); // Executes FGB_CYCLES_PER_FRAME cycles
 uint32_t fgb_cpu_step(fgb_cpu* cpu); // Executes a single instruction and returns its cycles
@@ -155,7 +251,40 @@ bool fgb_cpu_has_pending_interrupts(const fgb_cpu* cpu);
 void fgb_cpu_write(fgb_cpu* cpu, uint16_t addr, uint8_t value);
 uint8_t fgb_cpu_read(const fgb_cpu* cpu, uint16_t addr);
 
+uint8_t fgb_cpu_compute_flags(const fgb_cpu* cpu); // Evaluates the pending lazy flags
+
+// Called by translated code (see jit.h), which charges the cycles before a memory
+// access itself and only leaves the access to these on the slow path
+uint8_t fgb_cpu_finish_read(fgb_cpu* cpu, uint16_t addr); // After the first 3 T-cycles of the M-cycle
+void fgb_cpu_finish_write(fgb_cpu* cpu, uint16_t addr, uint8_t value);
+void fgb_cpu_check_idle_loop(fgb_cpu* cpu, uint16_t start, uint16_t end); // After a taken backward jump
+
+static inline uint8_t fgb_cpu_get_f(const fgb_cpu* cpu) {
+    return cpu->lazy_flags.op == LAZY_OP_NONE ? cpu->regs.f : fgb_cpu_compute_flags(cpu);
+}
+
+static inline void fgb_cpu_set_f(fgb_cpu* cpu, uint8_t value) {
+    cpu->regs.f = value;
+    cpu->lazy_flags.op = LAZY_OP_NONE;
+}
+
+// Writes pending lazy flags to F
+static inline void fgb_cpu_resolve_flags(fgb_cpu* cpu) {
+    if (cpu->lazy_flags.op != LAZY_OP_NONE) {
+        fgb_cpu_set_f(cpu, fgb_cpu_compute_flags(cpu));
+    }
+}
+
+static inline void fgb_cpu_set_lazy_flags(fgb_cpu* cpu, enum fgb_cpu_lazy_op op, uint8_t x, uint8_t y, uint8_t carry) {
+    cpu->lazy_flags.op = (uint8_t)op;
+    cpu->lazy_flags.x = x;
+    cpu->lazy_flags.y = y;
+    cpu->lazy_flags.carry = carry;
+}
+
 static inline void fgb_cpu_set_flag(fgb_cpu* cpu, enum fgb_cpu_flag flag, bool value) {
+    fgb_cpu_resolve_flags(cpu);
+
     if (value) {
         cpu->regs.f |= flag;
     }
@@ -165,14 +294,16 @@ static inline void fgb_cpu_set_flag(fgb_cpu* cpu, enum fgb_cpu_flag flag, bool v
 }
 
 static inline void fgb_cpu_clear_flag(fgb_cpu* cpu, enum fgb_cpu_flag flag) {
+    fgb_cpu_resolve_flags(cpu);
     cpu->regs.f &= ~flag;
 }
 
 static inline bool fgb_cpu_get_flag(const fgb_cpu* cpu, enum fgb_cpu_flag flag) {
-    return (cpu->regs.f & flag) != 0;
+    return (fgb_cpu_get_f(cpu) & flag) != 0;
 }
 
 static inline void fgb_cpu_toggle_flag(fgb_cpu* cpu, enum fgb_cpu_flag flag) {
+    fgb_cpu_resolve_flags(cpu);
     cpu->regs.f ^= flag;
 }
 
@@ -182,10 +313,16 @@ void fgb_cpu_disassemble(const fgb_cpu* cpu, uint16_t addr, int count);
 void fgb_cpu_disassemble_to(const fgb_cpu* cpu, uint16_t addr, int count, char** dest);
 uint16_t fgb_cpu_disassemble_one(const fgb_cpu* cpu, uint16_t addr, char* dest, size_t dest_size);
 void fgb_cpu_set_bp(fgb_cpu* cpu, uint16_t addr);
-void fgb_cpu_clear_bp(fgb_cpu* cpu, uint16_t addr);
-int fgb_cpu_get_bp_at(const fgb_cpu* cpu, uint16_t addr);
+void fgb_cpu_set_bp_banked(fgb_cpu* cpu, uint16_t addr, uint16_t bank); // Only hit while bank is mapped at addr (< 0x8000)
+void fgb_cpu_clear_bp(fgb_cpu* cpu, uint16_t addr); // Clears all breakpoints at addr, banked or not
+void fgb_cpu_clear_bp_banked(fgb_cpu* cpu, uint16_t addr, uint16_t bank);
+void fgb_cpu_clear_all_bps(fgb_cpu* cpu);
+int fgb_cpu_get_bp_at(const fgb_cpu* cpu, uint16_t addr); // Index of the first breakpoint at addr, or -1
 void fgb_cpu_set_bp_callback(fgb_cpu* cpu, fgb_cpu_bp_callback callback);
 void fgb_cpu_set_step_callback(fgb_cpu* cpu, fgb_cpu_step_callback callback);
 void fgb_cpu_set_trace_callback(fgb_cpu* cpu, fgb_cpu_trace_callback callback);
+void fgb_cpu_set_trace(fgb_cpu* cpu, fgb_trace* trace); // Records traced instructions in binary form instead
+void fgb_cpu_set_debugging(fgb_cpu* cpu, bool debugging); // Pauses or resumes execution
+void fgb_cpu_request_step(fgb_cpu* cpu); // Runs one instruction on the next frame while paused
 
 #endif // FGB_CPU_H
@@ -8,6 +8,9 @@
 #include "ppu.h"
 #include "types.h"
 
+#define FGB_FRAMESKIP_AUTO  (-1) // Skip frames only while the host can't keep up with real time
+#define FGB_FRAMESKIP_MAX   9 // Most frames skipped in a row in FGB_FRAMESKIP_AUTO mode
+
 
 typedef struct fgb_emu {
     fgb_cpu* cpu;
@@ -16,6 +19,12 @@ typedef struct fgb_emu {
     fgb_apu* apu;
     fgb_cart* cart;
     fgb_model model;
+
+    // Frame skipping, see fgb_emu_set_frameskip
+    int frameskip;
+    int frames_until_drawn;
+    int auto_frameskip; // Frames currently skipped in FGB_FRAMESKIP_AUTO mode
+    double frame_deadline; // Host time by which the next frame should be done in FGB_FRAMESKIP_AUTO mode
 } fgb_emu;
 
 
@@ -27,11 +36,34 @@ fgb_emu* fgb_emu_create_ex(const uint8_t* cart_data, size_t cart_size,
                            fgb_apu_sample_callback sample_cb,
                            void* userdata,
                            const fgb_mmu_ops* mmu_ops);
+// Same as fgb_emu_create_ex, but the ROM is not copied. cart_data must outlive the emulator.
+fgb_emu* fgb_emu_create_borrowed(const uint8_t* cart_data, size_t cart_size,
+                                 fgb_model model,
+                                 uint32_t apu_sample_rate,
+                                 fgb_apu_sample_callback sample_cb,
+                                 void* userdata);
+// Maps the ROM file read-only instead of reading it, so instances running the same ROM share its pages.
+fgb_emu* fgb_emu_create_from_file(const char* rom_path,
+                                  fgb_model model,
+                                  uint32_t apu_sample_rate,
+                                  fgb_apu_sample_callback sample_cb,
+                                  void* userdata);
+// Shares an already loaded ROM image, see fgb_rom_image. The emulator holds its own reference.
+fgb_emu* fgb_emu_create_from_image(fgb_rom_image* image,
+                                   fgb_model model,
+                                   uint32_t apu_sample_rate,
+                                   fgb_apu_sample_callback sample_cb,
+                                   void* userdata);
 void fgb_emu_destroy(fgb_emu* emu);
 void fgb_emu_reset(fgb_emu* emu);
 
 void fgb_emu_set_log_level(fgb_emu* emu, int level);
 
+// Draws only every (frameskip + 1)th frame in fgb_emu_run_frame, or adapts to the host with FGB_FRAMESKIP_AUTO.
+// Skipped frames keep exact timing and interrupts, see fgb_ppu_set_frame_skip.
+void fgb_emu_set_frameskip(fgb_emu* emu, int frameskip);
+void fgb_emu_run_frame(fgb_emu* emu); // fgb_cpu_run_frame with frame skipping
+
 void fgb_emu_press_button(fgb_emu* emu, enum fgb_button button);
 void fgb_emu_release_button(fgb_emu* emu, enum fgb_button button);
 
@@ -1,6 +1,7 @@
 #ifndef FGB_INSTRUCTION_H
 #define FGB_INSTRUCTION_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #define FGB_INSTRUCTION_COUNT 256
@@ -9,26 +10,20 @@
 struct fgb_cpu;
 struct fgb_instruction;
 
-typedef void (*fgb_instruction_exec_0)(struct fgb_cpu* cpu, const struct fgb_instruction* ins);
-typedef void (*fgb_instruction_exec_1)(struct fgb_cpu* cpu, const struct fgb_instruction* ins);
-typedef void (*fgb_instruction_exec_2)(struct fgb_cpu* cpu, const struct fgb_instruction* ins);
+typedef void (*fgb_instruction_handler)(struct fgb_cpu* cpu, const struct fgb_instruction* ins);
 
 typedef char* (*fgb_instruction_fmt_0)(const struct fgb_instruction* ins);
 typedef char* (*fgb_instruction_fmt_1)(const struct fgb_instruction* ins, uint8_t operand);
 typedef char* (*fgb_instruction_fmt_2)(const struct fgb_instruction* ins, uint16_t operand);
 
+// Disassembly metadata. Execution only goes through fgb_instruction_handlers
+// (or the CPU's dispatcher), so this table stays out of the hot path.
 typedef struct fgb_instruction {
     const char* disassembly;
     uint8_t opcode;
     uint8_t operand_size; // 0, 1, or 2 bytes
     uint8_t cycles; // Number of cycles the instruction takes to execute
     uint8_t alt_cycles; // Number of cycles for alternate paths (e.g., taken branches)
-    union {
-        void* exec;
-        fgb_instruction_exec_0 exec_0;
-        fgb_instruction_exec_1 exec_1;
-        fgb_instruction_exec_2 exec_2;
-    };
     union {
         void* fmt;
         fgb_instruction_fmt_0 fmt_0;
@@ -38,12 +33,21 @@ typedef struct fgb_instruction {
 } fgb_instruction;
 
 extern const fgb_instruction fgb_instruction_table[FGB_INSTRUCTION_COUNT];
+extern const fgb_instruction_handler fgb_instruction_handlers[FGB_INSTRUCTION_COUNT];
 extern const uint8_t fgb_cb_instruction_cycles[FGB_INSTRUCTION_COUNT];
 
 static inline const fgb_instruction* fgb_instruction_get(uint8_t opcode) {
     return fgb_instruction_table + opcode;
 }
 
+static inline fgb_instruction_handler fgb_instruction_get_handler(uint8_t opcode) {
+    return fgb_instruction_handlers[opcode];
+}
+
+// Whether the instruction may change control flow or CPU mode, i.e. has to be
+// the last one of a predecoded or translated block
+bool fgb_instruction_ends_block(uint8_t opcode);
+
 static inline uint8_t fgb_instruction_get_cb_cycles(uint8_t opcode) {
     return fgb_cb_instruction_cycles[opcode] * 4; // Convert to clock cycles
 }
@@ -371,4 +375,266 @@ void fgb_rst_7(struct fgb_cpu* cpu, const fgb_instruction* ins);
 // CB Prefix
 void fgb_cb(struct fgb_cpu* cpu, const fgb_instruction* ins);
 
+// Illegal opcodes
+void fgb_unimplemented(struct fgb_cpu* cpu, const fgb_instruction* ins);
+
+// Opcode to handler mapping, expanded into the handler table and the CPU's dispatcher
+#define FGB_OPCODE_LIST(OP) \
+    OP(0x00, fgb_nop) \
+    OP(0x01, fgb_ld_bc_imm) \
+    OP(0x02, fgb_ld_p_bc_a) \
+    OP(0x03, fgb_inc_bc) \
+    OP(0x04, fgb_inc_b) \
+    OP(0x05, fgb_dec_b) \
+    OP(0x06, fgb_ld_b_imm) \
+    OP(0x07, fgb_rlca) \
+    OP(0x08, fgb_ld_p_imm_sp) \
+    OP(0x09, fgb_add_hl_bc) \
+    OP(0x0A, fgb_ld_a_p_bc) \
+    OP(0x0B, fgb_dec_bc) \
+    OP(0x0C, fgb_inc_c) \
+    OP(0x0D, fgb_dec_c) \
+    OP(0x0E, fgb_ld_c_imm) \
+    OP(0x0F, fgb_rrca) \
+    OP(0x10, fgb_stop) \
+    OP(0x11, fgb_ld_de_imm) \
+    OP(0x12, fgb_ld_p_de_a) \
+    OP(0x13, fgb_inc_de) \
+    OP(0x14, fgb_inc_d) \
+    OP(0x15, fgb_dec_d) \
+    OP(0x16, fgb_ld_d_imm) \
+    OP(0x17, fgb_rla) \
+    OP(0x18, fgb_jr) \
+    OP(0x19, fgb_add_hl_de) \
+    OP(0x1A, fgb_ld_a_p_de) \
+    OP(0x1B, fgb_dec_de) \
+    OP(0x1C, fgb_inc_e) \
+    OP(0x1D, fgb_dec_e) \
+    OP(0x1E, fgb_ld_e_imm) \
+    OP(0x1F, fgb_rra) \
+    OP(0x20, fgb_jr_nz) \
+    OP(0x21, fgb_ld_hl_imm) \
+    OP(0x22, fgb_ld_p_hli_a) \
+    OP(0x23, fgb_inc_hl) \
+    OP(0x24, fgb_inc_h) \
+    OP(0x25, fgb_dec_h) \
+    OP(0x26, fgb_ld_h_imm) \
+    OP(0x27, fgb_daa) \
+    OP(0x28, fgb_jr_z) \
+    OP(0x29, fgb_add_hl_hl) \
+    OP(0x2A, fgb_ld_a_p_hli) \
+    OP(0x2B, fgb_dec_hl) \
+    OP(0x2C, fgb_inc_l) \
+    OP(0x2D, fgb_dec_l) \
+    OP(0x2E, fgb_ld_l_imm) \
+    OP(0x2F, fgb_cpl) \
+    OP(0x30, fgb_jr_nc) \
+    OP(0x31, fgb_ld_sp_imm) \
+    OP(0x32, fgb_ld_p_hld_a) \
+    OP(0x33, fgb_inc_sp) \
+    OP(0x34, fgb_inc_p_hl) \
+    OP(0x35, fgb_dec_p_hl) \
+    OP(0x36, fgb_ld_p_hl_imm) \
+    OP(0x37, fgb_scf) \
+    OP(0x38, fgb_jr_c) \
+    OP(0x39, fgb_add_hl_sp) \
+    OP(0x3A, fgb_ld_a_p_hld) \
+    OP(0x3B, fgb_dec_sp) \
+    OP(0x3C, fgb_inc_a) \
+    OP(0x3D, fgb_dec_a) \
+    OP(0x3E, fgb_ld_a_imm) \
+    OP(0x3F, fgb_ccf) \
+    OP(0x40, fgb_ld_b_b) \
+    OP(0x41, fgb_ld_b_c) \
+    OP(0x42, fgb_ld_b_d) \
+    OP(0x43, fgb_ld_b_e) \
+    OP(0x44, fgb_ld_b_h) \
+    OP(0x45, fgb_ld_b_l) \
+    OP(0x46, fgb_ld_b_p_hl) \
+    OP(0x47, fgb_ld_b_a) \
+    OP(0x48, fgb_ld_c_b) \
+    OP(0x49, fgb_ld_c_c) \
+    OP(0x4A, fgb_ld_c_d) \
+    OP(0x4B, fgb_ld_c_e) \
+    OP(0x4C, fgb_ld_c_h) \
+    OP(0x4D, fgb_ld_c_l) \
+    OP(0x4E, fgb_ld_c_p_hl) \
+    OP(0x4F, fgb_ld_c_a) \
+    OP(0x50, fgb_ld_d_b) \
+    OP(0x51, fgb_ld_d_c) \
+    OP(0x52, fgb_ld_d_d) \
+    OP(0x53, fgb_ld_d_e) \
+    OP(0x54, fgb_ld_d_h) \
+    OP(0x55, fgb_ld_d_l) \
+    OP(0x56, fgb_ld_d_p_hl) \
+    OP(0x57, fgb_ld_d_a) \
+    OP(0x58, fgb_ld_e_b) \
+    OP(0x59, fgb_ld_e_c) \
+    OP(0x5A, fgb_ld_e_d) \
+    OP(0x5B, fgb_ld_e_e) \
+    OP(0x5C, fgb_ld_e_h) \
+    OP(0x5D, fgb_ld_e_l) \
+    OP(0x5E, fgb_ld_e_p_hl) \
+    OP(0x5F, fgb_ld_e_a) \
+    OP(0x60, fgb_ld_h_b) \
+    OP(0x61, fgb_ld_h_c) \
+    OP(0x62, fgb_ld_h_d) \
+    OP(0x63, fgb_ld_h_e) \
+    OP(0x64, fgb_ld_h_h) \
+    OP(0x65, fgb_ld_h_l) \
+    OP(0x66, fgb_ld_h_p_hl) \
+    OP(0x67, fgb_ld_h_a) \
+    OP(0x68, fgb_ld_l_b) \
+    OP(0x69, fgb_ld_l_c) \
+    OP(0x6A, fgb_ld_l_d) \
+    OP(0x6B, fgb_ld_l_e) \
+    OP(0x6C, fgb_ld_l_h) \
+    OP(0x6D, fgb_ld_l_l) \
+    OP(0x6E, fgb_ld_l_p_hl) \
+    OP(0x6F, fgb_ld_l_a) \
+    OP(0x70, fgb_ld_p_hl_b) \
+    OP(0x71, fgb_ld_p_hl_c) \
+    OP(0x72, fgb_ld_p_hl_d) \
+    OP(0x73, fgb_ld_p_hl_e) \
+    OP(0x74, fgb_ld_p_hl_h) \
+    OP(0x75, fgb_ld_p_hl_l) \
+    OP(0x76, fgb_halt) \
+    OP(0x77, fgb_ld_p_hl_a) \
+    OP(0x78, fgb_ld_a_b) \
+    OP(0x79, fgb_ld_a_c) \
+    OP(0x7A, fgb_ld_a_d) \
+    OP(0x7B, fgb_ld_a_e) \
+    OP(0x7C, fgb_ld_a_h) \
+    OP(0x7D, fgb_ld_a_l) \
+    OP(0x7E, fgb_ld_a_p_hl) \
+    OP(0x7F, fgb_ld_a_a) \
+    OP(0x80, fgb_add_a_b) \
+    OP(0x81, fgb_add_a_c) \
+    OP(0x82, fgb_add_a_d) \
+    OP(0x83, fgb_add_a_e) \
+    OP(0x84, fgb_add_a_h) \
+    OP(0x85, fgb_add_a_l) \
+    OP(0x86, fgb_add_a_p_hl) \
+    OP(0x87, fgb_add_a_a) \
+    OP(0x88, fgb_adc_a_b) \
+    OP(0x89, fgb_adc_a_c) \
+    OP(0x8A, fgb_adc_a_d) \
+    OP(0x8B, fgb_adc_a_e) \
+    OP(0x8C, fgb_adc_a_h) \
+    OP(0x8D, fgb_adc_a_l) \
+    OP(0x8E, fgb_adc_a_p_hl) \
+    OP(0x8F, fgb_adc_a_a) \
+    OP(0x90, fgb_sub_a_b) \
+    OP(0x91, fgb_sub_a_c) \
+    OP(0x92, fgb_sub_a_d) \
+    OP(0x93, fgb_sub_a_e) \
+    OP(0x94, fgb_sub_a_h) \
+    OP(0x95, fgb_sub_a_l) \
+    OP(0x96, fgb_sub_a_p_hl) \
+    OP(0x97, fgb_sub_a_a) \
+    OP(0x98, fgb_sbc_a_b) \
+    OP(0x99, fgb_sbc_a_c) \
+    OP(0x9A, fgb_sbc_a_d) \
+    OP(0x9B, fgb_sbc_a_e) \
+    OP(0x9C, fgb_sbc_a_h) \
+    OP(0x9D, fgb_sbc_a_l) \
+    OP(0x9E, fgb_sbc_a_p_hl) \
+    OP(0x9F, fgb_sbc_a_a) \
+    OP(0xA0, fgb_and_a_b) \
+    OP(0xA1, fgb_and_a_c) \
+    OP(0xA2, fgb_and_a_d) \
+    OP(0xA3, fgb_and_a_e) \
+    OP(0xA4, fgb_and_a_h) \
+    OP(0xA5, fgb_and_a_l) \
+    OP(0xA6, fgb_and_a_p_hl) \
+    OP(0xA7, fgb_and_a_a) \
+    OP(0xA8, fgb_xor_a_b) \
+    OP(0xA9, fgb_xor_a_c) \
+    OP(0xAA, fgb_xor_a_d) \
+    OP(0xAB, fgb_xor_a_e) \
+    OP(0xAC, fgb_xor_a_h) \
+    OP(0xAD, fgb_xor_a_l) \
+    OP(0xAE, fgb_xor_a_p_hl) \
+    OP(0xAF, fgb_xor_a_a) \
+    OP(0xB0, fgb_or_a_b) \
+    OP(0xB1, fgb_or_a_c) \
+    OP(0xB2, fgb_or_a_d) \
+    OP(0xB3, fgb_or_a_e) \
+    OP(0xB4, fgb_or_a_h) \
+    OP(0xB5, fgb_or_a_l) \
+    OP(0xB6, fgb_or_a_p_hl) \
+    OP(0xB7, fgb_or_a_a) \
+    OP(0xB8, fgb_cp_a_b) \
+    OP(0xB9, fgb_cp_a_c) \
+    OP(0xBA, fgb_cp_a_d) \
+    OP(0xBB, fgb_cp_a_e) \
+    OP(0xBC, fgb_cp_a_h) \
+    OP(0xBD, fgb_cp_a_l) \
+    OP(0xBE, fgb_cp_a_p_hl) \
+    OP(0xBF, fgb_cp_a_a) \
+    OP(0xC0, fgb_ret_nz) \
+    OP(0xC1, fgb_pop_bc) \
+    OP(0xC2, fgb_jp_nz_imm16) \
+    OP(0xC3, fgb_jp_imm16) \
+    OP(0xC4, fgb_call_nz_imm16) \
+    OP(0xC5, fgb_push_bc) \
+    OP(0xC6, fgb_add_a_imm) \
+    OP(0xC7, fgb_rst_0) \
+    OP(0xC8, fgb_ret_z) \
+    OP(0xC9, fgb_ret) \
+    OP(0xCA, fgb_jp_z_imm16) \
+    OP(0xCB, fgb_cb) \
+    OP(0xCC, fgb_call_z_imm16) \
+    OP(0xCD, fgb_call_imm16) \
+    OP(0xCE, fgb_adc_a_imm) \
+    OP(0xCF, fgb_rst_1) \
+    OP(0xD0, fgb_ret_nc) \
+    OP(0xD1, fgb_pop_de) \
+    OP(0xD2, fgb_jp_nc_imm16) \
+    OP(0xD3, fgb_unimplemented) \
+    OP(0xD4, fgb_call_nc_imm16) \
+    OP(0xD5, fgb_push_de) \
+    OP(0xD6, fgb_sub_a_imm) \
+    OP(0xD7, fgb_rst_2) \
+    OP(0xD8, fgb_ret_c) \
+    OP(0xD9, fgb_reti) \
+    OP(0xDA, fgb_jp_c_imm16) \
+    OP(0xDB, fgb_unimplemented) \
+    OP(0xDC, fgb_call_c_imm16) \
+    OP(0xDD, fgb_unimplemented) \
+    OP(0xDE, fgb_sbc_a_imm) \
+    OP(0xDF, fgb_rst_3) \
+    OP(0xE0, fgb_ld_p_imm_a) \
+    OP(0xE1, fgb_pop_hl) \
+    OP(0xE2, fgb_ld_p_c_a) \
+    OP(0xE3, fgb_unimplemented) \
+    OP(0xE4, fgb_unimplemented) \
+    OP(0xE5, fgb_push_hl) \
+    OP(0xE6, fgb_and_a_imm) \
+    OP(0xE7, fgb_rst_4) \
+    OP(0xE8, fgb_add_sp_imm) \
+    OP(0xE9, fgb_jp_hl) \
+    OP(0xEA, fgb_ld_p_imm16_a) \
+    OP(0xEB, fgb_unimplemented) \
+    OP(0xEC, fgb_unimplemented) \
+    OP(0xED, fgb_unimplemented) \
+    OP(0xEE, fgb_xor_a_imm) \
+    OP(0xEF, fgb_rst_5) \
+    OP(0xF0, fgb_ld_a_p_imm) \
+    OP(0xF1, fgb_pop_af) \
+    OP(0xF2, fgb_ld_a_p_c) \
+    OP(0xF3, fgb_di) \
+    OP(0xF4, fgb_unimplemented) \
+    OP(0xF5, fgb_push_af) \
+    OP(0xF6, fgb_or_a_imm) \
+    OP(0xF7, fgb_rst_6) \
+    OP(0xF8, fgb_ld_hl_sp_imm) \
+    OP(0xF9, fgb_ld_sp_hl) \
+    OP(0xFA, fgb_ld_a_p_imm16) \
+    OP(0xFB, fgb_ei) \
+    OP(0xFC, fgb_unimplemented) \
+    OP(0xFD, fgb_unimplemented) \
+    OP(0xFE, fgb_cp_a_imm) \
+    OP(0xFF, fgb_rst_7)
+
 #endif // FGB_INSTRUCTION_H
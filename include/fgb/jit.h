@@ -0,0 +1,57 @@
+#ifndef FGB_JIT_H
+#define FGB_JIT_H
+
+#include "code_table.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FGB_JIT_CODE_SIZE           (4 * 1024 * 1024) // 4 MiB of host code
+#define FGB_JIT_MAX_BLOCK_LENGTH    32 // Guest instructions per block
+
+struct fgb_cpu;
+
+// Translated block, called with the CPU as its only argument
+typedef void (*fgb_jit_block)(struct fgb_cpu* cpu);
+
+// Translates guest basic blocks into x86-64 code. Loads, stores, ALU operations,
+// INC/DEC, jumps, calls and returns are compiled natively, anything else calls the
+// instruction handler. Cycles are charged in bulk up to the next memory access that
+// may be observed, and native instructions access ROM, WRAM and HRAM through the MMU
+// page tables, leaving other addresses to the same code paths as the interpreter, so
+// timing stays identical to it. Blocks leave at the next instruction boundary once the
+// scheduler deadline or the end of the frame is reached.
+//
+// The code buffer is only writable while a block is being translated.
+//
+// Blocks are kept in a code table (see code_table.h). RAM blocks are dropped whenever
+// memory they were translated from is written.
+typedef struct fgb_jit {
+    struct fgb_cpu* cpu;
+
+    uint8_t* code;
+    size_t code_used;
+
+    fgb_code_table blocks; // Slots hold the host code of each block, see fgb_jit_block
+
+    // Set by writes that may change the code being executed (bank switches,
+    // self-modifying code). Checked by blocks after every instruction.
+    bool exit_block;
+} fgb_jit;
+
+
+bool fgb_jit_is_supported(void);
+fgb_jit* fgb_jit_create(struct fgb_cpu* cpu);
+void fgb_jit_destroy(fgb_jit* jit);
+void fgb_jit_flush(fgb_jit* jit); // Drops all translated blocks
+
+// Runs the block starting at the current PC, translating it first if necessary.
+// With single_step only the first instruction is executed.
+// Returns false if the code at PC can't be translated and must be interpreted.
+bool fgb_jit_run(fgb_jit* jit, bool single_step);
+
+// Must be called for every CPU write
+void fgb_jit_notify_write(fgb_jit* jit, uint16_t addr);
+
+#endif // FGB_JIT_H
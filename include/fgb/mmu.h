@@ -14,7 +14,26 @@
 #define FGB_WRAM_BANK_SIZE 0x1000
 #define FGB_WRAM_BANKS     8 // Only first 2 accessible in DMG mode
 #define FGB_HRAM_SIZE      0x7F
+#define FGB_MMU_PAGE_SIZE  0x100
+#define FGB_MMU_PAGE_COUNT 0x100
+#define FGB_IO_REGISTER_COUNT 0x80 // FF00 - FF7F
 
+struct fgb_mmu;
+
+typedef uint8_t (*fgb_mmu_read_handler)(const struct fgb_mmu* mmu, uint16_t addr);
+typedef void (*fgb_mmu_write_handler)(struct fgb_mmu* mmu, uint16_t addr, uint8_t value);
+
+typedef uint8_t (*fgb_io_read_handler)(const void* ctx, uint16_t addr);
+typedef void (*fgb_io_write_handler)(void* ctx, uint16_t addr, uint8_t value);
+
+// A single I/O register, dispatched to by address without any range checks
+typedef struct fgb_io_register {
+    fgb_io_read_handler read;
+    fgb_io_write_handler write;
+    void* ctx; // Component owning the register
+    uint8_t sync; // Scheduler events (1 << event) to catch up on before an access
+    uint8_t reschedule; // Scheduler events whose deadline may move after a write
+} fgb_io_register;
 
 typedef struct fgb_mmu {
     union {
@@ -43,6 +62,19 @@ typedef struct fgb_mmu {
     bool bootrom_mapped;
     uint8_t wbk; // WRAM Bank (CGB only)
 
+    // Page tables, one entry per 256 byte page. An entry points at the host memory
+    // currently mapped there (ROM/RAM banks, WRAM), or is NULL if accesses go through
+    // the page's handler (I/O, VRAM, OAM, MBC registers). Pointers are updated whenever
+    // the mapping changes. Always empty when custom ops are used.
+    const uint8_t* read_pages[FGB_MMU_PAGE_COUNT];
+    uint8_t* write_pages[FGB_MMU_PAGE_COUNT];
+    fgb_mmu_read_handler read_handlers[FGB_MMU_PAGE_COUNT];
+    fgb_mmu_write_handler write_handlers[FGB_MMU_PAGE_COUNT];
+
+    // Filled per model, also when custom ops are used since the CPU's catch-up relies on it
+    fgb_io_register io_registers[FGB_IO_REGISTER_COUNT];
+    bool paged;
+
     fgb_model model; // DMG or CGB
 } fgb_mmu;
 
@@ -56,5 +88,23 @@ typedef struct fgb_mmu_ops {
 } fgb_mmu_ops;
 
 void fgb_mmu_init(fgb_mmu* mmu, fgb_cart* cart, struct fgb_cpu* cpu, const fgb_mmu_ops* ops); // ops may be NULL
+void fgb_mmu_remap(fgb_mmu* mmu); // Rebuilds the page tables, e.g. after changing bootrom_mapped
+
+// Sends writes to every page mapped at memory through the page handlers until the next remap
+void fgb_mmu_protect(fgb_mmu* mmu, const uint8_t* memory);
+
+static inline uint8_t fgb_mmu_read_fast(const fgb_mmu* mmu, uint16_t addr) {
+    const uint8_t* page = mmu->read_pages[addr >> 8];
+    return page ? page[addr & 0xFF] : mmu->read_u8(mmu, addr);
+}
+
+static inline void fgb_mmu_write_fast(fgb_mmu* mmu, uint16_t addr, uint8_t value) {
+    uint8_t* page = mmu->write_pages[addr >> 8];
+    if (page) {
+        page[addr & 0xFF] = value;
+    } else {
+        mmu->write_u8(mmu, addr, value);
+    }
+}
 
 #endif // FGB_MEMORY_H
@@ -1,10 +1,13 @@
 #ifndef PPU_H
 #define PPU_H
 
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
-#include <threads.h>
 
+#include "scheduler.h"
+#include "simd.h"
 #include "types.h"
 
 #define PPU_VRAM_SIZE 0x2000
@@ -22,8 +25,10 @@
 #define TILE_BLOCK_COUNT    3 // Number of tile blocks
 #define TILES_PER_SCANLINE  (SCREEN_WIDTH / TILE_WIDTH)
 #define TILE_BLOCK_SIZE     (TILES_PER_BLOCK * TILE_SIZE_BYTES) // 128 tiles per block
+#define TILE_COUNT          (TILE_BLOCK_COUNT * TILES_PER_BLOCK) // Number of tiles in a VRAM bank
 
-#define PPU_FRAMEBUFFER_COUNT   2 // Double buffering
+#define PPU_FRAMEBUFFER_COUNT   3 // Triple buffering, see fgb_ppu_acquire_latest_frame
+#define PPU_FRAME_READY         0x4 // Flag in fgb_ppu::ready_buffer
 #define PPU_SCANLINE_SPRITES    10 // Maximum number of sprites per scanline
 #define PPU_SPRITE_SIZE_BYTES   4
 #define PPU_OAM_SPRITES         (PPU_OAM_SIZE / PPU_SPRITE_SIZE_BYTES) // Number of sprites in OAM
@@ -57,6 +62,21 @@ enum fgb_color_mode {
     PPU_COLOR_MODE_TINTED,
 };
 
+// Pixel format of the framebuffers. The index formats store where each pixel's color comes from
+// in the frame palette (see fgb_ppu_get_frame_palette), and only become colors in fgb_ppu_convert_frame.
+enum fgb_frame_format {
+    PPU_FRAME_FORMAT_RGBA8888, // 4 bytes per pixel, the colors the LCD shows
+    PPU_FRAME_FORMAT_RGB565, // 2 bytes per pixel
+    PPU_FRAME_FORMAT_INDEX8, // 1 byte per pixel, a frame palette index
+    PPU_FRAME_FORMAT_INDEX2, // 4 pixels per byte, the shade (0-3) of each starting in the top bits
+};
+
+// Frame palette indices
+#define PPU_FRAME_INDEX_BG          0 // + shade (0-3)
+#define PPU_FRAME_INDEX_OBJ         4 // + shade (0-3)
+#define PPU_FRAME_INDEX_WINDOW      8 // Debug window color
+#define PPU_FRAME_PALETTE_SIZE      16
+
 typedef struct fgb_palette {
     uint32_t colors[4];
 } fgb_palette;
@@ -65,6 +85,12 @@ typedef struct fgb_tile {
     uint8_t data[16]; // 8x8 tile data, 2 bytes per row
 } fgb_tile;
 
+// A tile with one byte (color index) per pixel, as is and mirrored horizontally
+typedef struct fgb_decoded_tile {
+    uint8_t rows[TILE_HEIGHT][TILE_WIDTH];
+    uint8_t flipped_rows[TILE_HEIGHT][TILE_WIDTH];
+} fgb_decoded_tile;
+
 typedef struct fgb_sprite {
     uint8_t y;
     uint8_t x;
@@ -90,18 +116,29 @@ typedef struct fgb_pixel {
     uint8_t is_wnd : 1; // Debug: is this pixel from the window?
 } fgb_pixel;
 
-typedef struct fgb_queue {
-    fgb_pixel pixels[PPU_PIXEL_FIFO_SIZE];
-    int push_index;
-    int pop_index;
+// A pixel FIFO as a set of shift registers with one bit per pixel in each plane, like the hardware.
+// Bit 7 is the pixel at the front, and the bits past count are always 0.
+typedef struct fgb_pixel_fifo {
+    uint8_t lo; // Bit 0 of the color index
+    uint8_t hi; // Bit 1 of the color index
+    uint8_t palette; // See fgb_pixel::palette
+    uint8_t bg_prio; // See fgb_pixel::bg_prio
+    uint8_t is_wnd; // See fgb_pixel::is_wnd
     int count;
-} fgb_queue;
+} fgb_pixel_fifo;
 
 typedef struct fgb_ppu {
     uint8_t vram0[PPU_VRAM_SIZE];
     uint8_t vram1[PPU_VRAM_SIZE]; // CGB only
     uint8_t oam[PPU_OAM_SIZE];
-    uint32_t framebuffers[PPU_FRAMEBUFFER_COUNT][SCREEN_WIDTH * SCREEN_HEIGHT];
+
+    // Decoded copies of the tiles in both VRAM banks, see fgb_ppu_get_tile_row
+    fgb_decoded_tile tile_cache[2][TILE_COUNT];
+    uint8_t tile_cache_dirty[2][TILE_COUNT]; // One bit per row that changed since it was decoded
+    uint8_t* framebuffers[PPU_FRAMEBUFFER_COUNT]; // frame_pitch bytes per line, all in one allocation
+    enum fgb_frame_format frame_format;
+    size_t frame_pitch;
+    uint8_t line_indices[SCREEN_WIDTH]; // Line drawn by the FIFO as frame palette indices, stored once it is complete
     int framebuffer_x; // Current X position in the framebuffer (actual number of pixels drawn)
     int processed_pixels; // Number of pixels pushed OR discarded from the FIFO
 
@@ -109,8 +146,8 @@ typedef struct fgb_ppu {
     uint8_t line_sprites[SCREEN_HEIGHT][PPU_SCANLINE_SPRITES];
 
     // Pixel FIFO
-    fgb_queue bg_wnd_fifo;
-    fgb_queue sprite_fifo;
+    fgb_pixel_fifo bg_wnd_fifo;
+    fgb_pixel_fifo sprite_fifo;
     enum fgb_fetch_step bg_wnd_fetch_step;
     enum fgb_fetch_step sprite_fetch_step;
     int fetch_x;
@@ -131,8 +168,19 @@ typedef struct fgb_ppu {
     int sprite_index; // Index of the next sprite to evaluate during pixel fetching
     const fgb_sprite* current_sprite; // Current sprite being fetched
 
+    // Scanline renderer (see fgb_ppu_render_line)
+    bool fast_line; // Mode 3 of the current line was drawn in one go and only has to be waited out
+    uint32_t fast_line_cycles; // How long the FIFO would have taken for the line
+    bool fast_line_window; // The line reached the window
+    fgb_pixel_fifo fast_line_sprites; // Sprite FIFO left over at the end of the line
+    const fgb_simd_kernels* simd; // Line kernels for the host CPU
+
+    // Each framebuffer is owned by exactly one side at a time. The PPU draws into back_buffer, the
+    // consumer reads front_buffer, and the third one is handed over through ready_buffer.
     int back_buffer;
-    mtx_t buffer_mutex;
+    int front_buffer;
+    atomic_int ready_buffer; // Index of the third buffer, PPU_FRAME_READY if it holds a frame the consumer hasn't seen
+    bool frame_acquired; // The consumer is reading front_buffer
 
     uint32_t mode_cycles; // Cycles for the current mode
     uint32_t frame_cycles; // Cycles for the current frame
@@ -145,6 +193,11 @@ typedef struct fgb_ppu {
     int sprite_count;
     bool oam_scan_done;
 
+    // Sprite index for the OAM scan, updated whenever a sprite's Y or X or the sprite size changes
+    uint64_t sprite_lines[SCREEN_HEIGHT]; // Bit i is set if OAM sprite i covers the scanline
+    uint8_t sprite_x_order[PPU_OAM_SPRITES]; // OAM offsets of all sprites, sorted by X (and OAM index for ties)
+    int sprite_lines_height; // Sprite height sprite_lines was built with
+
     bool last_stat;
     bool reset;
 
@@ -152,6 +205,8 @@ typedef struct fgb_ppu {
     fgb_palette obj_palette;
 
     int frames_rendered;
+    bool skip_next_frame; // See fgb_ppu_set_frame_skip
+    bool frame_skipped; // The current frame is only timed, not drawn
 
     union {
         uint8_t value;
@@ -229,6 +284,7 @@ typedef struct fgb_ppu {
     bool oam_blocked; // OAM is blocked by DMA
     uint8_t dma; // DMA register value
     uint16_t dma_addr; // Address for DMA transfer
+    const uint8_t* dma_source; // Host memory behind dma_addr, NULL if the source has to be read through the MMU
     int dma_bytes; // Number of bytes transferred in the current DMA operation
     int dma_cycles;
 
@@ -245,23 +301,41 @@ void fgb_ppu_set_cpu(fgb_ppu* ppu, struct fgb_cpu* cpu);
 void fgb_ppu_set_model(fgb_ppu* ppu, fgb_model model);
 void fgb_ppu_reset(fgb_ppu* ppu);
 
-const uint32_t* fgb_ppu_get_front_buffer(const fgb_ppu* ppu);
-const uint32_t* fgb_ppu_get_back_buffer(const fgb_ppu* ppu);
-void fgb_ppu_lock_buffer(fgb_ppu* ppu);
-void fgb_ppu_unlock_buffer(fgb_ppu* ppu);
-void fgb_ppu_swap_buffers(fgb_ppu* ppu);
+const void* fgb_ppu_get_front_buffer(const fgb_ppu* ppu); // Newest complete frame, from the emulation thread only
+const void* fgb_ppu_get_back_buffer(const fgb_ppu* ppu); // Frame being drawn
+void fgb_ppu_swap_buffers(fgb_ppu* ppu); // Publishes the back buffer as the newest frame
+
+// Returns the newest complete frame without ever waiting on the PPU. Can be called from any thread, but
+// only one at a time. The frame stays untouched until it is released and the next one is acquired.
+const void* fgb_ppu_acquire_latest_frame(fgb_ppu* ppu);
+void fgb_ppu_release_frame(fgb_ppu* ppu, const void* frame);
+
+// Replaces the framebuffers with blank ones in the new format. Not while a frame is acquired.
+bool fgb_ppu_set_frame_format(fgb_ppu* ppu, enum fgb_frame_format format);
+size_t fgb_ppu_get_frame_pitch(const fgb_ppu* ppu); // Bytes per line of a frame
+void fgb_ppu_get_frame_palette(const fgb_ppu* ppu, uint32_t* colors); // PPU_FRAME_PALETTE_SIZE colors, RGBA8888
+void fgb_ppu_convert_frame(const fgb_ppu* ppu, const void* frame, uint32_t* colors); // To RGBA8888, from any format
 void fgb_ppu_set_color_mode(fgb_ppu* ppu, enum fgb_color_mode mode);
 
+// Whether the next frame is drawn or only timed, takes effect when the frame starts. A skipped frame has
+// the same mode timing and interrupts, but nothing is drawn and the newest frame stays the last drawn one.
+void fgb_ppu_set_frame_skip(fgb_ppu* ppu, bool skip);
+
 int fgb_ppu_get_tile_id_old(const fgb_ppu* ppu, int tile_map, int x, int y);
 const fgb_tile* fgb_ppu_get_tile_data(const fgb_ppu* ppu, int tile_id, bool is_sprite);
 uint8_t fgb_tile_get_pixel(const fgb_tile* tile, uint8_t x, uint8_t y);
+int fgb_ppu_get_tile_index(const fgb_ppu* ppu, int tile_id, bool is_sprite); // Index of a tile ID's data in VRAM (0-383)
+const uint8_t* fgb_ppu_get_tile_row(fgb_ppu* ppu, int bank, int tile_index, int y, bool flip); // 8 color indices
 uint32_t fgb_ppu_get_bg_color(const fgb_ppu* ppu, fgb_pixel pixel);
 uint32_t fgb_ppu_get_obj_color(const fgb_ppu* ppu, uint8_t pixel_index, int palette);
 
 bool fgb_ppu_tick(fgb_ppu* ppu);
+void fgb_ppu_advance(fgb_ppu* ppu, uint32_t cycles); // Equivalent to calling fgb_ppu_tick `cycles` times
+uint32_t fgb_ppu_next_event(const fgb_ppu* ppu); // Cycles until the PPU may request an interrupt
 
 void fgb_ppu_write(fgb_ppu* ppu, uint16_t addr, uint8_t value);
 uint8_t fgb_ppu_read(const fgb_ppu* ppu, uint16_t addr);
+void fgb_ppu_leave_fast_dma(fgb_ppu* ppu); // Reads the rest of an OAM DMA through the MMU, before its source memory changes
 
 void fgb_ppu_write_vram(fgb_ppu* ppu, uint16_t addr, uint8_t value);
 uint8_t fgb_ppu_read_vram(const fgb_ppu* ppu, uint16_t addr);
@@ -0,0 +1,48 @@
+#ifndef FGB_SAVE_H
+#define FGB_SAVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <threads.h>
+
+#define FGB_SAVE_PAGE_SIZE  256 // Granularity of the dirty tracking
+#define FGB_SAVE_MAX_PAGES  (0x20000 / FGB_SAVE_PAGE_SIZE) // 128 KiB, the largest cart RAM
+
+struct fgb_cart;
+
+// Keeps the .sav file of a battery backed cart up to date while the game runs.
+// Whenever the game disables cart RAM (which it does once it is done saving) the
+// RAM and RTC state are compared against the last captured copy, and the 256 byte
+// pages that changed are handed to a writer thread. The emulation thread never touches the file.
+typedef struct fgb_save {
+    struct fgb_cart* cart;
+    FILE* file;
+    size_t size; // Size of the file, cart RAM followed by the RTC state if there is an RTC
+    size_t ram_size;
+
+    uint8_t* shadow; // File contents as of the last capture
+    uint8_t* staging; // Pages being written by the flusher
+    uint8_t dirty[FGB_SAVE_MAX_PAGES / 8]; // Pages of shadow not written yet
+
+    mtx_t lock; // Guards shadow, dirty and running
+    cnd_t wake;
+    thrd_t flusher;
+    bool running;
+
+    uint64_t captures;
+    uint64_t pages_written;
+} fgb_save;
+
+
+// Loads the save file into the cart's RAM if there is one and attaches the saver to the cart.
+// A file that doesn't match the cart is moved to <path>.bak first.
+// Returns NULL if the cart has nothing to save, or the file can't be opened or backed up.
+fgb_save* fgb_save_create(struct fgb_cart* cart, const char* path);
+void fgb_save_destroy(fgb_save* save); // Captures the RAM one last time and writes all pending pages
+
+// Marks the pages that changed since the last capture for writing. Called by the cart when RAM gets disabled.
+void fgb_save_capture(fgb_save* save);
+
+#endif // FGB_SAVE_H
@@ -0,0 +1,34 @@
+#ifndef FGB_SCHEDULER_H
+#define FGB_SCHEDULER_H
+
+#include <stdint.h>
+
+
+#define FGB_SCHEDULER_NEVER         UINT64_MAX // Absolute deadline for components with nothing pending
+#define FGB_SCHEDULER_NO_EVENT      UINT32_MAX // Relative deadline returned by the *_next_event functions
+
+// Peripherals are not ticked alongside the CPU. Instead each one is run forward
+// ("synced") in bulk once its next event is due, or right before the CPU touches
+// one of its registers. Only events that the CPU can observe without accessing
+// the peripheral need a deadline, i.e. interrupts and audio sample delivery.
+enum fgb_sched_event {
+    SCHED_EVENT_TIMER,  // TIMA overflow
+    SCHED_EVENT_PPU,    // Mode transitions, STAT line changes and OAM DMA
+    SCHED_EVENT_APU,    // Completion of a sample chunk
+    SCHED_EVENT_CART,   // MBC3 RTC, only synced on access
+
+    SCHED_EVENT_COUNT
+};
+
+typedef struct fgb_scheduler {
+    uint64_t deadline[SCHED_EVENT_COUNT]; // Cycle at which the component has to be synced
+    uint64_t synced[SCHED_EVENT_COUNT]; // Cycle up to which the component has been run
+    uint64_t next; // Earliest deadline of all components
+} fgb_scheduler;
+
+
+// Marks every component as synced at `now` and due immediately
+void fgb_scheduler_reset(fgb_scheduler* sched, uint64_t now);
+void fgb_scheduler_set(fgb_scheduler* sched, enum fgb_sched_event event, uint64_t deadline);
+
+#endif // FGB_SCHEDULER_H
@@ -0,0 +1,41 @@
+#ifndef FGB_SIMD_H
+#define FGB_SIMD_H
+
+#include <stdint.h>
+
+// Palette slots used by the line kernels. A line is first reduced to one slot per pixel,
+// which is then looked up in a table of FGB_SIMD_SLOT_COUNT colors.
+#define FGB_SIMD_SLOT_BG        0 // + BG color index (0-3)
+#define FGB_SIMD_SLOT_OBP0      4 // + sprite color index (1-3)
+#define FGB_SIMD_SLOT_OBP1      8 // + sprite color index (1-3)
+#define FGB_SIMD_SLOT_WINDOW    12 // Debug window color
+#define FGB_SIMD_SLOT_COUNT     16
+
+// Set on a sprite pixel's slot if it is behind BG colors 1-3. A sprite pixel of 0 is transparent.
+#define FGB_SIMD_SPRITE_BEHIND_BG   0x10
+
+enum fgb_simd_level {
+    FGB_SIMD_SCALAR,
+    FGB_SIMD_SSSE3,
+    FGB_SIMD_AVX2,
+};
+
+typedef struct fgb_simd_kernels {
+    enum fgb_simd_level level;
+    const char* name;
+
+    // Decodes a 2bpp tile row into 8 color indices, and the same mirrored horizontally
+    void (*decode_row)(uint8_t lsb, uint8_t msb, uint8_t* pixels, uint8_t* flipped);
+
+    // Picks the slot of each pixel from the BG color index and the sprite pixel on top of it
+    void (*compose)(const uint8_t* bg, const uint8_t* sprites, uint8_t* slots, int count);
+
+    // Looks up the color of each slot in a table of FGB_SIMD_SLOT_COUNT colors
+    void (*map_colors)(const uint8_t* slots, const uint32_t* table, uint32_t* colors, int count);
+} fgb_simd_kernels;
+
+
+enum fgb_simd_level fgb_simd_detect(void); // Best level the host CPU supports
+const fgb_simd_kernels* fgb_simd_get_kernels(enum fgb_simd_level level); // Kernels for level, or the next lower one that is compiled in
+
+#endif // FGB_SIMD_H
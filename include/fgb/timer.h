@@ -1,6 +1,8 @@
 #ifndef FGB_TIMER_H
 #define FGB_TIMER_H
 
+#include "scheduler.h"
+
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -37,6 +39,9 @@ typedef struct fgb_timer {
 
 void fgb_timer_init(fgb_timer* timer, struct fgb_cpu* cpu);
 void fgb_timer_tick(fgb_timer* timer);
+void fgb_timer_advance(fgb_timer* timer, uint32_t cycles); // Equivalent to calling fgb_timer_tick `cycles` times
+uint32_t fgb_timer_next_event(const fgb_timer* timer); // Cycles until the timer may request an interrupt
+uint32_t fgb_timer_stable_cycles(const fgb_timer* timer, uint16_t addr); // Ticks during which reading addr returns the same value
 void fgb_timer_reset(fgb_timer* timer);
 
 void fgb_timer_write(fgb_timer* timer, uint16_t addr, uint8_t value);
@@ -0,0 +1,68 @@
+#ifndef FGB_TRACE_H
+#define FGB_TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <threads.h>
+
+#define FGB_TRACE_MAGIC             "FGBT"
+#define FGB_TRACE_VERSION           1
+#define FGB_TRACE_DEFAULT_CAPACITY  (1 << 16) // Records, must be a power of 2
+
+struct fgb_cpu;
+
+// Written once at the start of a trace file, followed by fgb_trace_record entries
+typedef struct fgb_trace_header {
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size; // sizeof(fgb_trace_record) of the writer
+} fgb_trace_header;
+
+// One executed instruction. Registers hold the state before it ran.
+typedef struct fgb_trace_record {
+    uint64_t cycle; // Total cycles at the opcode fetch
+    uint16_t pc;
+    uint16_t bank; // ROM bank mapped at pc, 0 for anything outside of ROM
+    uint16_t af;
+    uint16_t bc;
+    uint16_t de;
+    uint16_t hl;
+    uint16_t sp;
+    uint8_t opcode;
+    uint8_t operands[2]; // Only the first operand_size bytes are valid
+    uint8_t depth; // Call depth, saturated at 255
+    uint8_t reserved[4];
+} fgb_trace_record;
+
+// Binary instruction trace. The CPU pushes records into a single producer,
+// single consumer ring buffer which a writer thread drains into a file, so
+// tracing costs a few stores per instruction instead of formatting text.
+// If the writer falls behind, the CPU waits for it rather than dropping records.
+typedef struct fgb_trace {
+    fgb_trace_record* records;
+    size_t capacity;
+    atomic_size_t head; // Next record written by the CPU
+    atomic_size_t tail; // Next record written to the file
+
+    FILE* file;
+    thrd_t writer;
+    atomic_bool running;
+
+    uint64_t records_written;
+    uint64_t stalls; // Times the CPU had to wait for the writer
+} fgb_trace;
+
+
+// Creates the trace file and starts the writer thread. capacity is rounded up to a power of 2.
+fgb_trace* fgb_trace_create(const char* path, size_t capacity);
+void fgb_trace_destroy(fgb_trace* trace); // Writes all pending records and closes the file
+
+void fgb_trace_push(fgb_trace* trace, const fgb_trace_record* record);
+
+// Reads and validates the header of a trace file
+bool fgb_trace_read_header(FILE* file, fgb_trace_header* header);
+
+#endif // FGB_TRACE_H
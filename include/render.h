@@ -10,9 +10,9 @@ uint32_t fgb_create_screen_texture(void);
 void fgb_upload_screen_texture(uint32_t texture_id, fgb_ppu* ppu);
 void fgb_upload_back_buffer_texture(uint32_t texture_id, fgb_ppu* ppu);
 uint32_t fgb_create_tile_block_texture(int tiles_per_row);
-void fgb_upload_tile_block_texture(uint32_t texture_id, int tiles_per_row, const fgb_ppu* ppu, int tile_block, const fgb_palette* pal);
+void fgb_upload_tile_block_texture(uint32_t texture_id, int tiles_per_row, fgb_ppu* ppu, int tile_block, const fgb_palette* pal);
 void fgb_create_oam_textures(uint32_t* textures, int count);
-void fgb_upload_oam_textures(const uint32_t* textures, int count, const fgb_ppu* ppu);
+void fgb_upload_oam_textures(const uint32_t* textures, int count, fgb_ppu* ppu);
 
 void fgb_create_quad(uint32_t* vertex_array, uint32_t* vertex_buffer, uint32_t* index_buffer);
 
@@ -82,59 +82,109 @@ void fgb_apu_reset(fgb_apu* apu) {
 }
 
 void fgb_apu_tick(fgb_apu* apu) {
-    if (!apu->nr52.apu_en) {
-        return;
-    }
-
-    if (apu->cycle_counter++ >= FRAME_SEQUENCER_CYCLES) {
-        // Tick at 512 Hz
-        fgb_audio_channel_1_fs_tick(&apu->channel1, apu->sequencer_step);
-        fgb_audio_channel_2_fs_tick(&apu->channel2, apu->sequencer_step);
-        fgb_audio_channel_3_fs_tick(&apu->channel3, apu->sequencer_step);
-        fgb_audio_channel_4_fs_tick(&apu->channel4, apu->sequencer_step);
+    fgb_apu_advance(apu, 1);
+}
 
-        apu->cycle_counter = 0;
-        apu->sequencer_step = (apu->sequencer_step + 1) % FRAME_SEQUENCER_STEPS;
-    }
+static void fgb_apu_step_frame_sequencer(fgb_apu* apu) {
+    // Tick at 512 Hz
+    fgb_audio_channel_1_fs_tick(&apu->channel1, apu->sequencer_step);
+    fgb_audio_channel_2_fs_tick(&apu->channel2, apu->sequencer_step);
+    fgb_audio_channel_3_fs_tick(&apu->channel3, apu->sequencer_step);
+    fgb_audio_channel_4_fs_tick(&apu->channel4, apu->sequencer_step);
 
-    fgb_audio_channel_1_tick(&apu->channel1);
-    fgb_audio_channel_2_tick(&apu->channel2);
-    fgb_audio_channel_3_tick(&apu->channel3);
-    fgb_audio_channel_4_tick(&apu->channel4);
+    apu->cycle_counter = 0;
+    apu->sequencer_step = (apu->sequencer_step + 1) % FRAME_SEQUENCER_STEPS;
+}
 
-    apu->accumulator += apu->sample_rate;
-    if (apu->accumulator >= FGB_CPU_CLOCK_SPEED) {
-        apu->accumulator -= FGB_CPU_CLOCK_SPEED;
+static void fgb_apu_emit_sample(fgb_apu* apu) {
+    // Mix samples
+    float left_sample = 0.0f;
+    float right_sample = 0.0f;
+
+    ACCUMULATE_SAMPLES(1);
+    ACCUMULATE_SAMPLES(2);
+    ACCUMULATE_SAMPLES(3);
+    ACCUMULATE_SAMPLES(4);
+
+    // Simple soft clip to [-1, 1]
+    if (left_sample > 1.0f) left_sample = 1.0f;
+    if (left_sample < -1.0f) left_sample = -1.0f;
+    if (right_sample > 1.0f) right_sample = 1.0f;
+    if (right_sample < -1.0f) right_sample = -1.0f;
+
+    apu->sample_buffer[apu->sample_count * 2 + 0] = left_sample;
+    apu->sample_buffer[apu->sample_count * 2 + 1] = right_sample;
+    apu->sample_count++;
+
+    if (apu->sample_count >= apu->sample_chunk) {
+        if (apu->sample_callback) {
+            apu->sample_callback(apu->sample_buffer, apu->sample_count, apu->userdata);
+        }
 
-        // Mix samples
-        float left_sample = 0.0f;
-        float right_sample = 0.0f;
+        apu->sample_count = 0;
+    }
+}
 
-        ACCUMULATE_SAMPLES(1);
-        ACCUMULATE_SAMPLES(2);
-        ACCUMULATE_SAMPLES(3);
-        ACCUMULATE_SAMPLES(4);
+void fgb_apu_advance(fgb_apu* apu, uint32_t cycles) {
+    if (!apu->nr52.apu_en) {
+        return;
+    }
 
-        // Simple soft clip to [-1, 1]
-        if (left_sample > 1.0f) left_sample = 1.0f;
-        if (left_sample < -1.0f) left_sample = -1.0f;
-        if (right_sample > 1.0f) right_sample = 1.0f;
-        if (right_sample < -1.0f) right_sample = -1.0f;
+    // Each T-cycle steps the frame sequencer, then the channel timers, then takes a sample.
+    // The channels only depend on each other through the frame sequencer and the mixer,
+    // so they run in closed form up to whichever of the two comes next.
+    while (cycles > 0) {
+        uint32_t stretch;
+        bool stepped = false;
+
+        if (apu->cycle_counter >= FRAME_SEQUENCER_CYCLES) {
+            fgb_apu_step_frame_sequencer(apu);
+            stepped = true;
+            stretch = FRAME_SEQUENCER_CYCLES + 1; // The counter restarts from 0 on this cycle
+        } else {
+            stretch = FRAME_SEQUENCER_CYCLES - apu->cycle_counter;
+        }
 
-        apu->sample_buffer[apu->sample_count * 2 + 0] = left_sample;
-        apu->sample_buffer[apu->sample_count * 2 + 1] = right_sample;
-        apu->sample_count++;
+        if (stretch > cycles) {
+            stretch = cycles;
+        }
 
-        if (apu->sample_count >= apu->sample_chunk) {
-            if (apu->sample_callback) {
-                apu->sample_callback(apu->sample_buffer, apu->sample_count, apu->userdata);
+        if (apu->sample_rate != 0) {
+            const uint64_t to_sample = apu->accumulator >= FGB_CPU_CLOCK_SPEED
+                ? 1 : (FGB_CPU_CLOCK_SPEED - apu->accumulator + apu->sample_rate - 1) / apu->sample_rate;
+            if (to_sample < stretch) {
+                stretch = (uint32_t)to_sample;
             }
+        }
+
+        fgb_audio_channel_1_advance(&apu->channel1, stretch);
+        fgb_audio_channel_2_advance(&apu->channel2, stretch);
+        fgb_audio_channel_3_advance(&apu->channel3, stretch);
+        fgb_audio_channel_4_advance(&apu->channel4, stretch);
+
+        apu->cycle_counter += (uint16_t)(stepped ? stretch - 1 : stretch);
+        apu->accumulator += (uint64_t)stretch * apu->sample_rate;
+        cycles -= stretch;
 
-            apu->sample_count = 0;
+        if (apu->accumulator >= FGB_CPU_CLOCK_SPEED) {
+            apu->accumulator -= FGB_CPU_CLOCK_SPEED;
+            fgb_apu_emit_sample(apu);
         }
     }
 }
 
+uint32_t fgb_apu_next_event(const fgb_apu* apu) {
+    if (!apu->nr52.apu_en || !apu->sample_callback || apu->sample_rate == 0) {
+        return FGB_SCHEDULER_NO_EVENT;
+    }
+
+    // Sync when the current chunk is complete so samples reach the callback as early as before
+    const uint64_t samples = apu->sample_chunk > apu->sample_count ? apu->sample_chunk - apu->sample_count : 1;
+    const uint64_t cycles = (samples * FGB_CPU_CLOCK_SPEED - apu->accumulator + apu->sample_rate - 1) / apu->sample_rate;
+
+    return (uint32_t)cycles;
+}
+
 uint8_t fgb_apu_read(const fgb_apu* apu, uint16_t addr) {
     if (addr < 0xFF10) {
         return 0xFF;
@@ -70,55 +70,95 @@ void fgb_audio_channel_4_reset(fgb_audio_channel_4* ch) {
     ch->nr44.value = 0xBF;
 }
 
+// Runs a frequency timer for the given T-cycles and returns how often it expired. Matches
+// `if (timer-- <= 0) timer = reload;` once per cycle, with reload fixed for the whole stretch.
+static uint32_t fgb_audio_timer_advance(int* timer, int reload, uint32_t cycles) {
+    const uint32_t first = *timer <= 0 ? 1 : (uint32_t)*timer + 1;
+    if (cycles < first) {
+        *timer -= (int)cycles;
+        return 0;
+    }
+
+    cycles -= first;
+    const uint32_t period = (uint32_t)reload + 1;
+    *timer = reload - (int)(cycles % period);
+
+    return 1 + cycles / period;
+}
+
 void fgb_audio_channel_1_tick(fgb_audio_channel_1* ch) {
-    if (ch->timer-- <= 0) {
-        ch->timer = fgb_period_to_timer(MAKE_PERIOD(ch->nr13, ch->nr14), 2);
+    fgb_audio_channel_1_advance(ch, 1);
+}
+
+void fgb_audio_channel_2_tick(fgb_audio_channel_2* ch) {
+    fgb_audio_channel_2_advance(ch, 1);
+}
 
-        ch->waveform_index = (ch->waveform_index + 1) % WAVEFORM_LENGTH;
+void fgb_audio_channel_3_tick(fgb_audio_channel_3* ch) {
+    fgb_audio_channel_3_advance(ch, 1);
+}
 
-        if (ch->enabled) {
-            const uint8_t bit = s_waveforms[ch->nr11.wave_duty][ch->waveform_index];
-            ch->sample = bit ? ch->envelope.volume : -ch->envelope.volume;
-        } else {
-            ch->sample = 0;
-        }
+void fgb_audio_channel_4_tick(fgb_audio_channel_4* ch) {
+    fgb_audio_channel_4_advance(ch, 1);
+}
+
+// Only the last waveform step of a stretch is audible, the sample is taken after it
+void fgb_audio_channel_1_advance(fgb_audio_channel_1* ch, uint32_t cycles) {
+    const uint32_t steps = fgb_audio_timer_advance(&ch->timer, fgb_period_to_timer(MAKE_PERIOD(ch->nr13, ch->nr14), 2), cycles);
+    if (steps == 0) {
+        return;
+    }
+
+    ch->waveform_index = (uint8_t)((ch->waveform_index + steps) % WAVEFORM_LENGTH);
+
+    if (ch->enabled) {
+        const uint8_t bit = s_waveforms[ch->nr11.wave_duty][ch->waveform_index];
+        ch->sample = bit ? ch->envelope.volume : -ch->envelope.volume;
+    } else {
+        ch->sample = 0;
     }
 }
 
-void fgb_audio_channel_2_tick(fgb_audio_channel_2* ch) {
-    if (ch->timer-- <= 0) {
-        ch->timer = fgb_period_to_timer(MAKE_PERIOD(ch->nr23, ch->nr24), 2);
+void fgb_audio_channel_2_advance(fgb_audio_channel_2* ch, uint32_t cycles) {
+    const uint32_t steps = fgb_audio_timer_advance(&ch->timer, fgb_period_to_timer(MAKE_PERIOD(ch->nr23, ch->nr24), 2), cycles);
+    if (steps == 0) {
+        return;
+    }
 
-        ch->waveform_index = (ch->waveform_index + 1) % WAVEFORM_LENGTH;
+    ch->waveform_index = (uint8_t)((ch->waveform_index + steps) % WAVEFORM_LENGTH);
 
-        if (ch->enabled) {
-            const uint8_t bit = s_waveforms[ch->nr21.wave_duty][ch->waveform_index];
-            ch->sample = bit ? ch->envelope.volume : -ch->envelope.volume;
-        } else {
-            ch->sample = 0;
-        }
+    if (ch->enabled) {
+        const uint8_t bit = s_waveforms[ch->nr21.wave_duty][ch->waveform_index];
+        ch->sample = bit ? ch->envelope.volume : -ch->envelope.volume;
+    } else {
+        ch->sample = 0;
     }
 }
 
-void fgb_audio_channel_3_tick(fgb_audio_channel_3* ch) {
-    if (ch->timer-- <= 0) {
-        ch->timer = fgb_period_to_timer(MAKE_PERIOD(ch->nr33, ch->nr34), 1);
+void fgb_audio_channel_3_advance(fgb_audio_channel_3* ch, uint32_t cycles) {
+    const uint32_t steps = fgb_audio_timer_advance(&ch->timer, fgb_period_to_timer(MAKE_PERIOD(ch->nr33, ch->nr34), 1), cycles);
+    if (steps == 0) {
+        return;
+    }
 
-        ch->waveform_index = (ch->waveform_index + 1) % 32;
+    ch->waveform_index = (uint8_t)((ch->waveform_index + steps) % 32);
 
-        if (ch->enabled && ch->nr30.dac_en) {
-            const int8_t centered = (int8_t)WAVEFORM_SAMPLE(ch->wave_ram, ch->waveform_index) - 8;
-            ch->sample = centered >> s_ch3_output_level_shift[ch->nr32.output_level];
-        } else {
-            ch->sample = 0;
-        }
+    if (ch->enabled && ch->nr30.dac_en) {
+        const int8_t centered = (int8_t)WAVEFORM_SAMPLE(ch->wave_ram, ch->waveform_index) - 8;
+        ch->sample = centered >> s_ch3_output_level_shift[ch->nr32.output_level];
+    } else {
+        ch->sample = 0;
     }
 }
 
-void fgb_audio_channel_4_tick(fgb_audio_channel_4* ch) {
-    if (ch->timer-- <= 0) {
-        ch->timer = s_ch4_divisors[ch->nr43.clk_div] << ch->nr43.clk_shift;
+void fgb_audio_channel_4_advance(fgb_audio_channel_4* ch, uint32_t cycles) {
+    uint32_t steps = fgb_audio_timer_advance(&ch->timer, s_ch4_divisors[ch->nr43.clk_div] << ch->nr43.clk_shift, cycles);
+    if (steps == 0) {
+        return;
+    }
 
+    // Every step feeds back into the LFSR, so these can't be skipped
+    while (steps-- > 0) {
         const uint8_t bit = ~((ch->lfsr & 1) ^ ((ch->lfsr >> 1) & 1));
         ch->lfsr = SETBIT(ch->lfsr, 15, bit);
 
@@ -128,10 +168,10 @@ void fgb_audio_channel_4_tick(fgb_audio_channel_4* ch) {
         }
 
         ch->lfsr >>= 1;
-
-        // Lowest bit INVERTED
-        ch->sample = (ch->lfsr & 1) ? -ch->envelope.volume : ch->envelope.volume;
     }
+
+    // Lowest bit INVERTED
+    ch->sample = (ch->lfsr & 1) ? -ch->envelope.volume : ch->envelope.volume;
 }
 
 void fgb_audio_channel_1_fs_tick(fgb_audio_channel_1* ch, uint8_t step) {
@@ -0,0 +1,161 @@
+#include "block_cache.h"
+#include "cpu.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <ulog.h>
+
+
+// Upper bound of the bytes covered by a block, used to find blocks overlapping a write
+#define FGB_BLOCK_CACHE_MAX_BLOCK_BYTES     (FGB_BLOCK_CACHE_MAX_BLOCK_LENGTH * 3)
+#define FGB_BLOCK_CACHE_MAX_BLOCK_SIZE      (sizeof(fgb_cached_block) + FGB_BLOCK_CACHE_MAX_BLOCK_LENGTH * sizeof(fgb_cached_instruction))
+
+static fgb_cached_block* fgb_block_cache_decode(fgb_block_cache* cache, uint16_t addr, uint16_t region_end);
+static void fgb_block_cache_invalidate(fgb_block_cache* cache, void** blocks, uint16_t base, uint16_t addr);
+
+
+fgb_block_cache* fgb_block_cache_create(struct fgb_cpu* cpu) {
+    fgb_block_cache* cache = malloc(sizeof(fgb_block_cache));
+    if (!cache) {
+        log_error("Failed to allocate block cache");
+        return NULL;
+    }
+
+    memset(cache, 0, sizeof(fgb_block_cache));
+    cache->cpu = cpu;
+
+    cache->arena = malloc(FGB_BLOCK_CACHE_ARENA_SIZE);
+    if (!cache->arena) {
+        log_error("Failed to allocate block cache arena");
+        free(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+void fgb_block_cache_destroy(fgb_block_cache* cache) {
+    if (!cache) {
+        return;
+    }
+
+    log_info("Block cache: %llu hits, %llu misses, %llu invalidations, %llu flushes",
+        (unsigned long long)cache->stats.hits, (unsigned long long)cache->stats.misses,
+        (unsigned long long)cache->stats.invalidations, (unsigned long long)cache->stats.flushes);
+
+    fgb_code_table_destroy(&cache->blocks);
+    free(cache->arena);
+    free(cache);
+}
+
+void fgb_block_cache_flush(fgb_block_cache* cache) {
+    fgb_code_table_clear(&cache->blocks);
+
+    cache->arena_used = 0;
+    cache->exit_block = true;
+    cache->stats.flushes++;
+}
+
+const fgb_cached_block* fgb_block_cache_get(fgb_block_cache* cache, uint16_t addr) {
+    uint16_t region_end;
+    void** slot = fgb_code_table_lookup(&cache->blocks, cache->cpu, addr, &region_end);
+    if (!slot) {
+        return NULL;
+    }
+
+    if (*slot) {
+        cache->stats.hits++;
+        return *slot;
+    }
+
+    if (FGB_BLOCK_CACHE_ARENA_SIZE - cache->arena_used < FGB_BLOCK_CACHE_MAX_BLOCK_SIZE) {
+        // Slots stay valid, flushing only clears the tables
+        fgb_block_cache_flush(cache);
+    }
+
+    cache->stats.misses++;
+    *slot = fgb_block_cache_decode(cache, addr, region_end);
+
+    return *slot;
+}
+
+void fgb_block_cache_notify_write(fgb_block_cache* cache, uint16_t addr) {
+    switch (fgb_code_table_classify_write(&cache->blocks, &addr)) {
+    case CODE_WRITE_BANK:
+        cache->exit_block = true;
+        break;
+    case CODE_WRITE_CODE:
+        if (addr >= 0xC000 && addr < 0xE000) {
+            fgb_block_cache_invalidate(cache, cache->blocks.wram_slots, 0xC000, addr);
+        }
+        else if (addr >= 0xFF80 && addr < 0xFFFF) {
+            fgb_block_cache_invalidate(cache, cache->blocks.hram_slots, 0xFF80, addr);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+fgb_cached_block* fgb_block_cache_decode(fgb_block_cache* cache, uint16_t addr, uint16_t region_end) {
+    const fgb_mmu* mmu = &cache->cpu->mmu;
+
+    fgb_cached_block* block = (fgb_cached_block*)(cache->arena + cache->arena_used);
+    block->start = addr;
+    block->length = 0;
+
+    // Reads are side effect free in ROM and RAM, so the MMU can be queried directly
+    uint32_t pc = addr;
+    while (block->length < FGB_BLOCK_CACHE_MAX_BLOCK_LENGTH) {
+        const uint8_t opcode = mmu->read_u8(mmu, (uint16_t)pc);
+        const fgb_instruction* instruction = fgb_instruction_get(opcode);
+
+        // Operands past the end of the region (e.g. in the next ROM bank) may change
+        // independently of the block, so the interpreter has to fetch them
+        if (pc + 1 + instruction->operand_size > region_end) {
+            break;
+        }
+
+        fgb_cached_instruction* cached = &block->instructions[block->length++];
+        cached->handler = fgb_instruction_get_handler(opcode);
+        cached->instruction = instruction;
+        cached->operand_size = instruction->operand_size;
+        cached->operand = 0;
+
+        for (uint8_t i = 0; i < instruction->operand_size; i++) {
+            cached->operand |= mmu->read_u8(mmu, (uint16_t)(pc + 1 + i)) << (i * 8);
+        }
+
+        fgb_code_table_mark(&cache->blocks, (uint16_t)pc, pc + 1 + instruction->operand_size);
+        pc += 1 + instruction->operand_size;
+        if (fgb_instruction_ends_block(opcode) || pc >= region_end) {
+            break;
+        }
+    }
+
+    if (block->length == 0) {
+        return NULL; // Left to the interpreter, see above
+    }
+
+    block->end = (uint16_t)pc; // Blocks end before 0xFFFF at the latest
+
+    // Keep blocks pointer aligned
+    const size_t size = sizeof(fgb_cached_block) + block->length * sizeof(fgb_cached_instruction);
+    cache->arena_used += (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+
+    return block;
+}
+
+void fgb_block_cache_invalidate(fgb_block_cache* cache, void** blocks, uint16_t base, uint16_t addr) {
+    const uint16_t first = addr - base < FGB_BLOCK_CACHE_MAX_BLOCK_BYTES ? base : addr - FGB_BLOCK_CACHE_MAX_BLOCK_BYTES + 1;
+
+    for (uint16_t start = first; start <= addr; start++) {
+        const fgb_cached_block* block = blocks[start - base];
+        if (block && block->end > addr) {
+            blocks[start - base] = NULL;
+            cache->stats.invalidations++;
+            cache->exit_block = true;
+        }
+    }
+}
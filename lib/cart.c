@@ -1,23 +1,46 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L // open, fstat, mmap
+#endif
+
 #include "cart.h"
 #include "cpu.h"
+#include "save.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <ulog.h>
 
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #define MAKE_RTC_DAYS(HIGH, LOW) ((((((uint16_t)HIGH) & 0x01) << 8) | (uint16_t)(LOW)))
 
 static uint8_t fgb_compute_header_checksum(const uint8_t* data);
 static uint32_t fgb_get_ram_size_bytes(const fgb_cart_header* header);
-static bool fgb_cart_map_banks(fgb_cart* cart);
+static bool fgb_cart_map_ram_banks(fgb_cart* cart);
+static fgb_rom_image* fgb_rom_image_init(const uint8_t* data, size_t size, enum fgb_cart_rom_storage storage);
+static fgb_cart* fgb_cart_load_image_owned(fgb_rom_image* image);
+static const uint8_t* fgb_cart_map_file(const char* path, size_t* size);
+static void fgb_cart_unmap_file(const uint8_t* data, size_t size);
 
 static uint8_t fgb_cart_read_rom_only(const fgb_cart* cart, uint16_t addr);
 static void fgb_cart_write_rom_only(fgb_cart* cart, uint16_t addr, uint8_t value);
 
 static uint8_t fgb_cart_read_mbc3(const fgb_cart* cart, uint16_t addr);
 static void fgb_cart_write_mbc3(fgb_cart* cart, uint16_t addr, uint8_t value);
-static void fgb_cart_tick_mbc3(fgb_cart* cart);
+static void fgb_cart_tick_mbc3(fgb_cart* cart, uint32_t cycles);
+static void fgb_cart_rtc_update(fgb_cart* cart);
+static void fgb_cart_rtc_advance(fgb_cart* cart, uint64_t elapsed);
+static uint64_t fgb_cart_rtc_count(uint8_t* reg, uint64_t increments, uint8_t limit, uint8_t mask);
 
 static uint8_t fgb_cart_read_mbc1(const fgb_cart* cart, uint16_t addr);
 static void fgb_cart_write_mbc1(fgb_cart* cart, uint16_t addr, uint8_t value);
@@ -38,47 +61,159 @@ static const uint8_t fgb_nintendo_logo[] = {
 };
 
 
-fgb_cart* fgb_cart_load(const uint8_t* data, size_t size) {
-    fgb_cart* cart = malloc(sizeof(fgb_cart));
-    if (!cart) {
-        log_error("Failed to allocate Cart");
+fgb_rom_image* fgb_rom_image_create(const uint8_t* data, size_t size) {
+    uint8_t* rom = malloc(size);
+    if (!rom) {
+        log_error("Failed to allocate ROM");
         return NULL;
     }
 
-    memset(cart, 0, sizeof(fgb_cart));
+    memcpy(rom, data, size);
+
+    return fgb_rom_image_init(rom, size, CART_ROM_OWNED);
+}
+
+fgb_rom_image* fgb_rom_image_create_borrowed(const uint8_t* data, size_t size) {
+    return fgb_rom_image_init(data, size, CART_ROM_BORROWED);
+}
+
+fgb_rom_image* fgb_rom_image_create_mapped(const char* path) {
+    size_t size;
+    const uint8_t* rom = fgb_cart_map_file(path, &size);
+    if (!rom) {
+        return NULL;
+    }
+
+    return fgb_rom_image_init(rom, size, CART_ROM_MAPPED);
+}
+
+fgb_rom_image* fgb_rom_image_retain(fgb_rom_image* image) {
+    atomic_fetch_add_explicit(&image->refcount, 1, memory_order_relaxed);
+    return image;
+}
+
+void fgb_rom_image_release(fgb_rom_image* image) {
+    if (!image || atomic_fetch_sub_explicit(&image->refcount, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
 
-    cart->header = *(fgb_cart_header*)(data + 0x100);
+    switch (image->storage) {
+    case CART_ROM_OWNED:
+        free((void*)image->data);
+        break;
+    case CART_ROM_MAPPED:
+        fgb_cart_unmap_file(image->data, image->size);
+        break;
+    case CART_ROM_BORROWED:
+        break;
+    }
+
+    free(image);
+}
+
+// Takes ownership of data according to storage, it is released again if validation fails
+fgb_rom_image* fgb_rom_image_init(const uint8_t* data, size_t size, enum fgb_cart_rom_storage storage) {
+    fgb_rom_image* image = malloc(sizeof(fgb_rom_image));
+    if (!image) {
+        log_error("Failed to allocate ROM image");
+        if (storage == CART_ROM_OWNED) {
+            free((void*)data);
+        }
+        else if (storage == CART_ROM_MAPPED) {
+            fgb_cart_unmap_file(data, size);
+        }
+        return NULL;
+    }
 
-    if (memcmp(fgb_nintendo_logo, cart->header.logo, sizeof(fgb_nintendo_logo)) != 0) {
+    memset(image, 0, sizeof(fgb_rom_image));
+
+    image->data = data;
+    image->size = size;
+    image->storage = storage;
+    atomic_init(&image->refcount, 1);
+
+    if (size < 0x100 + sizeof(fgb_cart_header)) {
+        log_error("ROM size (%zu bytes) is too small to hold a cart header, aborting cart load", size);
+        fgb_rom_image_release(image);
+        return NULL;
+    }
+
+    image->header = *(const fgb_cart_header*)(data + 0x100);
+
+    if (memcmp(fgb_nintendo_logo, image->header.logo, sizeof(fgb_nintendo_logo)) != 0) {
         log_error("Nintendo Logo mismatch, aborting cart load");
-        fgb_cart_destroy(cart);
+        fgb_rom_image_release(image);
         return NULL;
     }
 
-    if (cart->header.header_checksum != fgb_compute_header_checksum(data)) {
+    if (image->header.header_checksum != fgb_compute_header_checksum(data)) {
         log_error("Header Checksum mismatch, aborting cart load");
-        fgb_cart_destroy(cart);
+        fgb_rom_image_release(image);
         return NULL;
     }
 
-    cart->rom = malloc(size);
-    if (!cart->rom) {
-        log_error("Failed to allocate ROM");
-        fgb_cart_destroy(cart);
+    image->bank_count = fgb_cart_get_rom_banks((enum fgb_cart_rom_size)image->header.rom_size);
+    if (image->bank_count == 0 || image->bank_count > FGB_CART_MAX_ROM_BANKS) {
+        log_error("Unsupported ROM size code 0x%02X, aborting cart load", image->header.rom_size);
+        fgb_rom_image_release(image);
         return NULL;
     }
 
-    const size_t rom_banks = fgb_cart_get_rom_banks((enum fgb_cart_rom_size)cart->header.rom_size);
-    cart->ram_size_bytes = fgb_get_ram_size_bytes(&cart->header);
-    cart->rom_bank_mask = (uint8_t)(rom_banks - 1ull);
+    if (size < image->bank_count * FGB_CART_ROM_BANK_SIZE) {
+        log_error("ROM size (%zu bytes) is smaller than expected (%zu bytes), aborting cart load", size, image->bank_count * FGB_CART_ROM_BANK_SIZE);
+        fgb_rom_image_release(image);
+        return NULL;
+    }
 
-    if (!fgb_cart_map_banks(cart)) {
-        fgb_cart_destroy(cart);
+    for (size_t i = 0; i < image->bank_count; i++) {
+        image->banks[i] = &data[i * FGB_CART_ROM_BANK_SIZE];
+    }
+
+    return image;
+}
+
+fgb_cart* fgb_cart_load(const uint8_t* data, size_t size) {
+    return fgb_cart_load_image_owned(fgb_rom_image_create(data, size));
+}
+
+fgb_cart* fgb_cart_load_borrowed(const uint8_t* data, size_t size) {
+    return fgb_cart_load_image_owned(fgb_rom_image_create_borrowed(data, size));
+}
+
+fgb_cart* fgb_cart_load_mapped(const char* path) {
+    return fgb_cart_load_image_owned(fgb_rom_image_create_mapped(path));
+}
+
+// Loads a cart from an image nobody else holds a reference to yet
+fgb_cart* fgb_cart_load_image_owned(fgb_rom_image* image) {
+    if (!image) {
         return NULL;
     }
 
-    if (size < rom_banks * FGB_CART_ROM_BANK_SIZE) {
-        log_error("ROM size (%zu bytes) is smaller than expected (%zu bytes), aborting cart load", size, rom_banks * FGB_CART_ROM_BANK_SIZE);
+    fgb_cart* cart = fgb_cart_load_image(image);
+    fgb_rom_image_release(image);
+
+    return cart;
+}
+
+fgb_cart* fgb_cart_load_image(fgb_rom_image* image) {
+    fgb_cart* cart = malloc(sizeof(fgb_cart));
+    if (!cart) {
+        log_error("Failed to allocate Cart");
+        return NULL;
+    }
+
+    memset(cart, 0, sizeof(fgb_cart));
+
+    cart->image = fgb_rom_image_retain(image);
+    cart->header = image->header;
+    cart->rom = image->data;
+    cart->rom_size = image->size;
+    cart->rom_banks = image->banks;
+    cart->ram_size_bytes = fgb_get_ram_size_bytes(&cart->header);
+    cart->rom_bank_mask = (uint8_t)(image->bank_count - 1ull);
+
+    if (!fgb_cart_map_ram_banks(cart)) {
         fgb_cart_destroy(cart);
         return NULL;
     }
@@ -109,16 +244,22 @@ fgb_cart* fgb_cart_load(const uint8_t* data, size_t size) {
             return NULL;
         }
         break;
-    case CART_TYPE_MBC3_RAM_BATTERY:
     case CART_TYPE_MBC3_TIMER_RAM_BATTERY:
         cart->has_ram_battery = true;
     case CART_TYPE_MBC3_TIMER_BATTERY:
+        cart->has_rtc = true;
+        cart->read = fgb_cart_read_mbc3;
+        cart->write = fgb_cart_write_mbc3;
+        cart->tick = fgb_cart_tick_mbc3; // Only carts with a timer have to count cycles
+        cart->rom_bank = 1; // MBC3 starts with bank 1 selected
+        break;
+    case CART_TYPE_MBC3_RAM_BATTERY:
+        cart->has_ram_battery = true;
     case CART_TYPE_MBC3:
     case CART_TYPE_MBC3_RAM:
         cart->read = fgb_cart_read_mbc3;
         cart->write = fgb_cart_write_mbc3;
-        cart->tick = fgb_cart_tick_mbc3;
-        cart->rom_bank = 1; // MBC3 starts with bank 1 selected
+        cart->rom_bank = 1;
         break;
     case CART_TYPE_MBC5_RAM_BATTERY:
     case CART_TYPE_MBC5_RUMBLE_RAM_BATTERY:
@@ -140,14 +281,12 @@ fgb_cart* fgb_cart_load(const uint8_t* data, size_t size) {
         break;
     }
 
-    memcpy(cart->rom, data, size);
-    cart->rom_size = size;
-
     return cart;
 }
 
 void fgb_cart_destroy(fgb_cart* cart) {
-    free(cart->rom);
+    fgb_save_destroy(cart->save);
+    fgb_rom_image_release(cart->image);
     free(cart->ram);
     free(cart);
 }
@@ -180,15 +319,78 @@ uint8_t fgb_cart_read(const fgb_cart* cart, uint16_t addr) {
 }
 
 void fgb_cart_write(fgb_cart* cart, uint16_t addr, uint8_t value) {
+    const bool ram_enabled = cart->ram_enabled;
     cart->write(cart, addr, value);
+
+    // Games disable RAM once they're done writing to it, which makes it a good time to save
+    if (ram_enabled && !cart->ram_enabled && cart->save) {
+        fgb_save_capture(cart->save);
+    }
 }
 
-void fgb_cart_tick(fgb_cart *cart) {
+void fgb_cart_tick(fgb_cart *cart, uint32_t cycles) {
     if (cart->tick) {
-        cart->tick(cart);
+        cart->tick(cart, cycles);
     }
 }
 
+uint16_t fgb_cart_get_rom_bank(const fgb_cart* cart, uint16_t addr) {
+    if (cart->read == fgb_cart_read_mbc1) {
+        if (addr < 0x4000) {
+            return cart->mode == CART_MODE_SIMPLE ? 0 : cart->ram_bank;
+        }
+
+        return (cart->ram_bank << 5) | cart->rom_bank;
+    }
+
+    if (addr < 0x4000) {
+        return 0;
+    }
+
+    if (cart->read == fgb_cart_read_mbc5) {
+        return cart->rom_bank_high << 8 | cart->rom_bank;
+    }
+
+    if (cart->read == fgb_cart_read_rom_only) {
+        return 1;
+    }
+
+    return cart->rom_bank;
+}
+
+const uint8_t* fgb_cart_map_rom(const fgb_cart* cart, uint16_t addr) {
+    if (!cart->read) {
+        return NULL;
+    }
+
+    const uint16_t bank = fgb_cart_get_rom_bank(cart, addr);
+    return bank < FGB_CART_MAX_ROM_BANKS ? cart->rom_banks[bank] : NULL;
+}
+
+uint8_t* fgb_cart_map_ram(const fgb_cart* cart) {
+    // Smaller RAM is mirrored and MBC2 RAM is only 4 bits wide, both need the read/write handlers
+    if (!cart->ram_enabled || cart->ram_size_bytes < FGB_CART_RAM_BANK_SIZE) {
+        return NULL;
+    }
+
+    uint8_t bank;
+    if (cart->read == fgb_cart_read_mbc1) {
+        bank = cart->mode == CART_MODE_SIMPLE ? 0 : cart->ram_bank;
+    } else if (cart->read == fgb_cart_read_mbc3) {
+        if (cart->ram_bank >= 4) {
+            return NULL; // RTC register
+        }
+
+        bank = cart->ram_bank;
+    } else if (cart->read == fgb_cart_read_mbc5) {
+        bank = cart->ram_bank;
+    } else {
+        return NULL;
+    }
+
+    return bank < FGB_CART_MAX_RAM_BANKS ? cart->ram_banks[bank] : NULL;
+}
+
 uint8_t fgb_compute_header_checksum(const uint8_t* data) {
     uint8_t checksum = 0;
     for (uint16_t addr = 0x134; addr <= 0x14C; addr++) {
@@ -216,19 +418,13 @@ uint32_t fgb_get_ram_size_bytes(const fgb_cart_header* header) {
     }
 }
 
-bool fgb_cart_map_banks(fgb_cart* cart) {
-    const size_t rom_banks = 2ull << cart->header.rom_size;
+bool fgb_cart_map_ram_banks(fgb_cart* cart) {
     const size_t ram_banks = cart->ram_size_bytes / FGB_CART_RAM_BANK_SIZE;
 
-    for (size_t i = 0; i < rom_banks; i++) {
-        cart->rom_banks[i] = &cart->rom[i * FGB_CART_ROM_BANK_SIZE];
-    }
-
     if (cart->ram_size_bytes > 0) {
         cart->ram = malloc(cart->ram_size_bytes);
         if (!cart->ram) {
             log_error("Failed to allocate RAM");
-            fgb_cart_destroy(cart);
             return false;
         }
 
@@ -329,6 +525,7 @@ void fgb_cart_write_mbc3(fgb_cart* cart, uint16_t addr, uint8_t value) {
     if (addr < 0x8000) {
         if (value == 1 && cart->rtc.last_latch == 0) {
             // Latch RTC data
+            fgb_cart_rtc_update(cart);
             cart->rtc.latch[RTC_S] = cart->rtc.seconds;
             cart->rtc.latch[RTC_M] = cart->rtc.minutes;
             cart->rtc.latch[RTC_H] = cart->rtc.hours;
@@ -349,7 +546,9 @@ void fgb_cart_write_mbc3(fgb_cart* cart, uint16_t addr, uint8_t value) {
             return;
         }
 
-        // RTC register
+        // RTC register, the time up to now still counts with the old values
+        fgb_cart_rtc_update(cart);
+
         switch (cart->ram_bank) {
         case RTC_REG_START + RTC_S:
             cart->rtc.seconds = cart->rtc.latch[RTC_S] = value & 0x3F;
@@ -377,48 +576,85 @@ void fgb_cart_write_mbc3(fgb_cart* cart, uint16_t addr, uint8_t value) {
     log_warn("Attempt to write to unmapped MBC3 memory at address 0x%04X", addr);
 }
 
-void fgb_cart_tick_mbc3(fgb_cart *cart) {
-    if (halt(cart->rtc.days_high)) {
-        return;
+void fgb_cart_tick_mbc3(fgb_cart *cart, uint32_t cycles) {
+    if (!halt(cart->rtc.days_high)) {
+        cart->rtc.cycles += cycles;
     }
+}
 
-    cart->rtc.cycles++;
-    if (cart->rtc.cycles >= FGB_CPU_CLOCK_SPEED) {
-        cart->rtc.cycles = 0;
+void fgb_cart_rtc_update(fgb_cart* cart) {
+    fgb_cart_rtc_advance(cart, cart->rtc.cycles / FGB_CPU_CLOCK_SPEED);
+    cart->rtc.cycles %= FGB_CPU_CLOCK_SPEED;
+}
 
-        // Note: The following code intentionally doesn't use '<' or '>=' to match the MBC3 behavior.
-        // When writing 61 to RTC_S, the register continues incrementing to 62, 63, 0, 1, ...
-        // However, when it overflows from 63 to 0, the minutes are not incremented until it actually reaches 60.
-        // The same applies to minutes and hours.
+void fgb_cart_rtc_advance(fgb_cart* cart, uint64_t elapsed) {
+    const uint64_t minute_carries = fgb_cart_rtc_count(&cart->rtc.seconds, elapsed, 60, 0x3F);
+    const uint64_t hour_carries = fgb_cart_rtc_count(&cart->rtc.minutes, minute_carries, 60, 0x3F);
+    const uint64_t day_carries = fgb_cart_rtc_count(&cart->rtc.hours, hour_carries, 24, 0x1F);
 
-        cart->rtc.seconds = (cart->rtc.seconds + 1) & 0x3F;
-        if (cart->rtc.seconds != 60) {
-            return;
-        }
+    uint64_t days = MAKE_RTC_DAYS(cart->rtc.days_high, cart->rtc.days_low) + day_carries;
+    if (days >= 512) {
+        days %= 512;
+        cart->rtc.days_high |= 0x80; // Set day carry bit
+    }
 
-        cart->rtc.seconds = 0;
-        cart->rtc.minutes = (cart->rtc.minutes + 1) & 0x3F;
-        if (cart->rtc.minutes != 60) {
-            return;
-        }
+    cart->rtc.days_low = (uint8_t)(days & 0xFF);
+    cart->rtc.days_high = (cart->rtc.days_high & 0xFE) | ((days >> 8) & 0x01);
+}
 
-        cart->rtc.minutes = 0;
-        cart->rtc.hours = (cart->rtc.hours + 1) & 0x1F;
-        if (cart->rtc.hours != 24) {
-            return;
-        }
+// Adds increments to an RTC counter and returns how often it carried into the next one.
+// Counters wrap around at their register width (mask) but only carry when they reach limit exactly,
+// so writing 61 to RTC_S makes it continue with 62, 63, 0, 1, ... and carry 63 seconds later.
+uint64_t fgb_cart_rtc_count(uint8_t* reg, uint64_t increments, uint8_t limit, uint8_t mask) {
+    const uint64_t until_carry = *reg < limit ? (uint64_t)(limit - *reg) : (uint64_t)((mask + 1u) - *reg + limit);
+    if (increments < until_carry) {
+        *reg = (uint8_t)((*reg + increments) & mask);
+        return 0;
+    }
 
-        cart->rtc.hours = 0;
-        uint16_t days = MAKE_RTC_DAYS(cart->rtc.days_high, cart->rtc.days_low);
-        days++;
-        if (days == 512) {
-            days = 0;
-            cart->rtc.days_high |= 0x80; // Set day carry bit
-        }
+    increments -= until_carry;
+    *reg = (uint8_t)(increments % limit);
+
+    return 1 + increments / limit;
+}
+
+bool fgb_cart_has_battery(const fgb_cart* cart) {
+    return (cart->has_ram_battery && cart->ram) || cart->has_rtc;
+}
+
+void fgb_cart_save_rtc(fgb_cart* cart, uint8_t* dest) {
+    fgb_cart_rtc_update(cart);
+
+    memset(dest, 0, FGB_CART_RTC_STATE_SIZE);
+    for (int i = 0; i < RTC_REG_COUNT; i++) {
+        dest[i * 4] = cart->rtc.regs[i];
+        dest[(RTC_REG_COUNT + i) * 4] = cart->rtc.latch[i];
+    }
+
+    const uint64_t timestamp = (uint64_t)time(NULL);
+    for (int i = 0; i < 8; i++) {
+        dest[RTC_REG_COUNT * 8 + i] = (uint8_t)(timestamp >> (i * 8));
+    }
+}
 
-        cart->rtc.days_low = (uint8_t)(days & 0xFF);
-        cart->rtc.days_high = (cart->rtc.days_high & 0xFE) | ((days >> 8) & 0x01);
+void fgb_cart_load_rtc(fgb_cart* cart, const uint8_t* src) {
+    for (int i = 0; i < RTC_REG_COUNT; i++) {
+        cart->rtc.regs[i] = src[i * 4];
+        cart->rtc.latch[i] = src[(RTC_REG_COUNT + i) * 4];
     }
+
+    uint64_t timestamp = 0;
+    for (int i = 0; i < 8; i++) {
+        timestamp |= (uint64_t)src[RTC_REG_COUNT * 8 + i] << (i * 8);
+    }
+
+    // The clock kept running while the emulator was closed
+    const uint64_t now = (uint64_t)time(NULL);
+    if (!halt(cart->rtc.days_high) && now > timestamp) {
+        fgb_cart_rtc_advance(cart, now - timestamp);
+    }
+
+    cart->rtc.cycles = 0;
 }
 
 #undef seconds
@@ -603,3 +839,72 @@ size_t fgb_cart_get_rom_banks(enum fgb_cart_rom_size size) {
     return 2;
 }
 
+#if defined(_WIN32)
+const uint8_t* fgb_cart_map_file(const char* path, size_t* size) {
+    const HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        log_error("Failed to open ROM %s", path);
+        return NULL;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        log_error("Failed to get the size of ROM %s", path);
+        CloseHandle(file);
+        return NULL;
+    }
+
+    const HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) {
+        log_error("Failed to map ROM %s", path);
+        return NULL;
+    }
+
+    // The view keeps the mapping alive
+    const uint8_t* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data) {
+        log_error("Failed to map ROM %s", path);
+        return NULL;
+    }
+
+    *size = (size_t)file_size.QuadPart;
+    return data;
+}
+
+void fgb_cart_unmap_file(const uint8_t* data, size_t size) {
+    (void)size;
+    UnmapViewOfFile(data);
+}
+#else
+const uint8_t* fgb_cart_map_file(const char* path, size_t* size) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        log_error("Failed to open ROM %s", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        log_error("Failed to get the size of ROM %s", path);
+        close(fd);
+        return NULL;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        log_error("Failed to map ROM %s", path);
+        return NULL;
+    }
+
+    *size = (size_t)st.st_size;
+    return data;
+}
+
+void fgb_cart_unmap_file(const uint8_t* data, size_t size) {
+    munmap((void*)data, size);
+}
+#endif
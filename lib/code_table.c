@@ -0,0 +1,95 @@
+#include "code_table.h"
+#include "cpu.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <ulog.h>
+
+
+void fgb_code_table_destroy(fgb_code_table* table) {
+    for (int i = 0; i < FGB_CODE_TABLE_MAX_ROM_BANKS; i++) {
+        free(table->rom_slots[i]);
+        table->rom_slots[i] = NULL;
+    }
+}
+
+void fgb_code_table_clear(fgb_code_table* table) {
+    for (int i = 0; i < FGB_CODE_TABLE_MAX_ROM_BANKS; i++) {
+        if (table->rom_slots[i]) {
+            memset(table->rom_slots[i], 0, FGB_CODE_TABLE_BANK_SIZE * sizeof(void*));
+        }
+    }
+
+    memset(table->bootrom_slots, 0, sizeof(table->bootrom_slots));
+    fgb_code_table_clear_ram(table);
+}
+
+void fgb_code_table_clear_ram(fgb_code_table* table) {
+    memset(table->wram_slots, 0, sizeof(table->wram_slots));
+    memset(table->hram_slots, 0, sizeof(table->hram_slots));
+    memset(table->ram_code, 0, sizeof(table->ram_code));
+}
+
+void** fgb_code_table_lookup(fgb_code_table* table, const fgb_cpu* cpu, uint16_t pc, uint16_t* region_end) {
+    if (pc < 0x8000) {
+        if (cpu->mmu.bootrom_mapped && pc < FGB_CODE_TABLE_BOOTROM_SIZE) {
+            *region_end = FGB_CODE_TABLE_BOOTROM_SIZE;
+            return &table->bootrom_slots[pc];
+        }
+
+        const uint16_t bank = cpu->mmu.cart ? fgb_cart_get_rom_bank(cpu->mmu.cart, pc) : pc / FGB_CODE_TABLE_BANK_SIZE;
+        if (bank >= FGB_CODE_TABLE_MAX_ROM_BANKS) {
+            return NULL;
+        }
+
+        if (!table->rom_slots[bank]) {
+            table->rom_slots[bank] = calloc(FGB_CODE_TABLE_BANK_SIZE, sizeof(void*));
+            if (!table->rom_slots[bank]) {
+                log_error("Failed to allocate block table for bank %u", bank);
+                return NULL;
+            }
+        }
+
+        *region_end = (pc & 0xC000) + FGB_CODE_TABLE_BANK_SIZE;
+        return &table->rom_slots[bank][pc & (FGB_CODE_TABLE_BANK_SIZE - 1)];
+    }
+
+    if (pc >= 0xC000 && pc < 0xE000) {
+        if (pc >= 0xD000 && cpu->model == FGB_MODEL_CGB) {
+            return NULL; // Switchable WRAM bank
+        }
+
+        *region_end = pc < 0xD000 ? 0xD000 : 0xE000;
+        return &table->wram_slots[pc - 0xC000];
+    }
+
+    if (pc >= 0xFF80 && pc < 0xFFFF) {
+        *region_end = 0xFFFF;
+        return &table->hram_slots[pc - 0xFF80];
+    }
+
+    return NULL;
+}
+
+void fgb_code_table_mark(fgb_code_table* table, uint16_t start, uint32_t end) {
+    if (start < 0x8000) {
+        return;
+    }
+
+    for (uint32_t a = start; a < end && a < 0x10000; a++) {
+        table->ram_code[a >> 3] |= 1 << (a & 7);
+    }
+}
+
+enum fgb_code_write fgb_code_table_classify_write(const fgb_code_table* table, uint16_t* addr) {
+    if (*addr < 0x8000) {
+        return CODE_WRITE_BANK;
+    }
+
+    if (*addr >= 0xE000 && *addr < 0xFE00) {
+        *addr -= 0x2000; // Echo RAM, the write lands in WRAM
+    }
+
+    return table->ram_code[*addr >> 3] & (1 << (*addr & 7)) ? CODE_WRITE_CODE : CODE_WRITE_NONE;
+}
@@ -2,6 +2,7 @@
 #include "instruction.h"
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -9,21 +10,37 @@
 
 
 // These functions automatically tick components
-static const fgb_instruction* fgb_cpu_fetch_instruction(fgb_cpu* cpu);
 static uint8_t fgb_cpu_fetch(fgb_cpu* cpu);
 static uint16_t fgb_cpu_fetch_u16(fgb_cpu* cpu);
 static uint8_t fgb_cpu_read_u8(fgb_cpu* cpu, uint16_t addr);
-static uint16_t fgb_cpu_read_u16(fgb_cpu* cpu, uint16_t addr);
 static void fgb_cpu_write_u8(fgb_cpu* cpu, uint16_t addr, uint8_t value);
 static void fgb_cpu_write_u16(fgb_cpu* cpu, uint16_t addr, uint16_t value);
-static void fgb_cpu_run_instruction(fgb_cpu* cpu, const fgb_instruction* instr);
+static void fgb_cpu_run_instruction(fgb_cpu* cpu, uint8_t opcode);
+static void fgb_cpu_run_threaded(fgb_cpu* cpu);
+static void fgb_cpu_use_debug_core(fgb_cpu* cpu);
+static void fgb_cpu_run_blocks(fgb_cpu* cpu);
+static bool fgb_cpu_run_block(fgb_cpu* cpu, bool single_step);
+static bool fgb_cpu_run_cached_block(fgb_cpu* cpu, bool single_step);
+static void fgb_cpu_trace_instruction(fgb_cpu* cpu, uint16_t addr, uint32_t depth, uint8_t opcode);
+static void fgb_cpu_record_instruction(fgb_cpu* cpu, uint8_t opcode);
+static int fgb_cpu_find_bp(const fgb_cpu* cpu, uint16_t addr, bool match_bank);
+static void fgb_cpu_remove_bp(fgb_cpu* cpu, size_t index);
+static void fgb_cpu_halt(fgb_cpu* cpu);
+static bool fgb_cpu_analyze_idle_loop(fgb_cpu* cpu, uint16_t start, uint16_t end);
+
+static inline void fgb_cpu_advance(fgb_cpu* cpu, uint32_t cycles);
+static void fgb_cpu_sync_event(fgb_cpu* cpu, enum fgb_sched_event event);
+static inline void fgb_cpu_sync_events(fgb_cpu* cpu, uint8_t events);
+static void fgb_cpu_sync_for_access(fgb_cpu* cpu, uint16_t addr, bool write);
+static void fgb_cpu_reschedule_after_write(fgb_cpu* cpu, uint16_t addr);
 
 static void fgb_cpu_handle_interrupts(fgb_cpu* cpu);
-#define fgb_mmu_write(cpu, addr, value) (cpu)->mmu.write_u8(&(cpu)->mmu, addr, value)
-#define fgb_mmu_read_u8(cpu, addr) (cpu)->mmu.read_u8(&(cpu)->mmu, addr)
+#define fgb_mmu_write(cpu, addr, value) fgb_mmu_write_fast(&(cpu)->mmu, addr, value)
+#define fgb_mmu_read_u8(cpu, addr) fgb_mmu_read_fast(&(cpu)->mmu, addr)
 #define fgb_mmu_read_u16(cpu, addr) (cpu)->mmu.read_u16(&(cpu)->mmu, addr)
 
-#define FGB_BP_ADDR_NONE 0xFFFF
+#define fgb_cpu_is_tracing(cpu) (((cpu)->trace_callback || (cpu)->trace) && (cpu)->trace_count != 0)
+#define fgb_cpu_bp_bit(cpu, addr) ((cpu)->bp_bitmap[(addr) >> 3] & (1 << ((addr) & 7)))
 
 #define set_flag(flag, value) fgb_cpu_set_flag(cpu, CPU_FLAG_##flag, value)
 #define toggle_flag(flag) fgb_cpu_toggle_flag(cpu, CPU_FLAG_##flag)
@@ -51,6 +68,8 @@ fgb_cpu* fgb_cpu_create_ex(fgb_cart* cart, fgb_ppu* ppu, fgb_apu* apu, fgb_model
     ulog_set_quiet(true);
 
     memset(cpu, 0, sizeof(fgb_cpu));
+    cpu->skip_idle_loops = true;
+    cpu->core = mmu_ops ? CPU_CORE_TEST : CPU_CORE_PRODUCTION;
 
     cpu->apu = apu;
     cpu->ppu = ppu;
@@ -77,33 +96,174 @@ fgb_cpu* fgb_cpu_create_with(fgb_cart* cart, fgb_ppu* ppu, fgb_apu* apu, const f
 }
 
 void fgb_cpu_destroy(fgb_cpu* cpu) {
+    log_info("Idle loops: %llu detected, %llu iterations (%llu cycles) skipped",
+        (unsigned long long)cpu->idle_loop.stats.loops_detected,
+        (unsigned long long)cpu->idle_loop.stats.iterations_skipped,
+        (unsigned long long)cpu->idle_loop.stats.cycles_skipped);
+
+    fgb_block_cache_destroy(cpu->block_cache);
+    fgb_jit_destroy(cpu->jit);
+    free(cpu->breakpoints);
     free(cpu);
 }
 
+bool fgb_cpu_set_backend(fgb_cpu* cpu, enum fgb_cpu_backend backend) {
+    if (backend != CPU_BACKEND_CACHED) {
+        fgb_block_cache_destroy(cpu->block_cache);
+        cpu->block_cache = NULL;
+    }
+
+    if (backend != CPU_BACKEND_JIT) {
+        fgb_jit_destroy(cpu->jit);
+        cpu->jit = NULL;
+    }
+
+    switch (backend) {
+    case CPU_BACKEND_INTERPRETER:
+        return true;
+
+    case CPU_BACKEND_CACHED:
+        if (!cpu->block_cache) {
+            cpu->block_cache = fgb_block_cache_create(cpu);
+        }
+        return cpu->block_cache != NULL;
+
+    case CPU_BACKEND_JIT:
+        if (!cpu->jit) {
+            cpu->jit = fgb_jit_create(cpu);
+        }
+        return cpu->jit != NULL;
+    }
+
+    return false;
+}
+
+void fgb_cpu_flush_blocks(fgb_cpu* cpu) {
+    if (cpu->block_cache) {
+        fgb_block_cache_flush(cpu->block_cache);
+    }
+
+    if (cpu->jit) {
+        fgb_jit_flush(cpu->jit);
+    }
+}
+
 void fgb_cpu_tick(fgb_cpu *cpu) {
-    cpu->cycles_this_frame++;
-    cpu->total_cycles++;
+    fgb_cpu_advance(cpu, 1);
+}
+
+void fgb_cpu_m_tick(fgb_cpu *cpu) {
+    fgb_cpu_advance(cpu, 4);
+}
 
+void fgb_cpu_advance(fgb_cpu* cpu, uint32_t cycles) {
+    cpu->cycles_this_frame += cycles;
+    cpu->total_cycles += cycles;
+
+    // Peripherals are only run once something observable is about to happen
+    if (cpu->total_cycles >= cpu->scheduler.next) {
+        fgb_cpu_sync_due(cpu);
+    }
+}
+
+void fgb_cpu_sync(fgb_cpu* cpu) {
+    if (cpu->test_mode) {
+        return;
+    }
+
+    for (int i = 0; i < SCHED_EVENT_COUNT; i++) {
+        fgb_cpu_sync_event(cpu, (enum fgb_sched_event)i);
+    }
+}
+
+void fgb_cpu_sync_due(fgb_cpu* cpu) {
     if (cpu->test_mode) {
         // Don't tick peripherals in test mode
         return;
     }
 
-    fgb_timer_tick(&cpu->timer);
-    fgb_ppu_tick(cpu->ppu);
-    fgb_apu_tick(cpu->apu);
-    fgb_cart_tick(cpu->mmu.cart);
+    for (int i = 0; i < SCHED_EVENT_COUNT; i++) {
+        if (cpu->scheduler.deadline[i] <= cpu->total_cycles) {
+            fgb_cpu_sync_event(cpu, (enum fgb_sched_event)i);
+        }
+    }
+}
+
+void fgb_cpu_sync_event(fgb_cpu* cpu, enum fgb_sched_event event) {
+    fgb_scheduler* sched = &cpu->scheduler;
+    const uint64_t now = cpu->total_cycles;
+    const uint32_t cycles = (uint32_t)(now - sched->synced[event]);
+    uint32_t next_event = FGB_SCHEDULER_NO_EVENT;
+
+    sched->synced[event] = now;
+
+    switch (event) {
+    case SCHED_EVENT_TIMER:
+        fgb_timer_advance(&cpu->timer, cycles);
+        next_event = fgb_timer_next_event(&cpu->timer);
+        break;
+
+    case SCHED_EVENT_PPU:
+        fgb_ppu_advance(cpu->ppu, cycles);
+        next_event = fgb_ppu_next_event(cpu->ppu);
+        break;
 
-    // TODO:
-    // - Maybe extract DMA handling from PPU tick?
-    // - Maybe tick serial?
+    case SCHED_EVENT_APU:
+        fgb_apu_advance(cpu->apu, cycles);
+        next_event = fgb_apu_next_event(cpu->apu);
+        break;
+
+    case SCHED_EVENT_CART:
+        fgb_cart_tick(cpu->mmu.cart, cycles);
+        break;
+
+    default:
+        break;
+    }
+
+    fgb_scheduler_set(sched, event, next_event == FGB_SCHEDULER_NO_EVENT ? FGB_SCHEDULER_NEVER : now + next_event);
 }
 
-void fgb_cpu_m_tick(fgb_cpu *cpu) {
-    fgb_cpu_tick(cpu);
-    fgb_cpu_tick(cpu);
-    fgb_cpu_tick(cpu);
-    fgb_cpu_tick(cpu);
+// Syncs every event in a mask of (1 << event) bits, in event order
+void fgb_cpu_sync_events(fgb_cpu* cpu, uint8_t events) {
+    for (int event = 0; events != 0; event++, events >>= 1) {
+        if (events & 1) {
+            fgb_cpu_sync_event(cpu, (enum fgb_sched_event)event);
+        }
+    }
+}
+
+// Brings the peripheral behind the given address up to date before the CPU accesses it
+void fgb_cpu_sync_for_access(fgb_cpu* cpu, uint16_t addr, bool write) {
+    if ((addr >= 0xC000 && addr < 0xFE00) || addr >= 0xFF80 || (addr < 0x8000 && !write)) {
+        return; // WRAM, HRAM and ROM reads
+    }
+
+    // The handlers are shared by every core, so this is a runtime check. It comes
+    // after the address checks to keep it off the common accesses.
+    if (cpu->test_mode) {
+        return;
+    }
+
+    if (addr < 0x8000 || (addr >= 0xA000 && addr < 0xC000)) {
+        // Bank switching and RTC latching, only carts with a timer have anything to catch up on
+        if (cpu->mmu.cart->tick) {
+            fgb_cpu_sync_event(cpu, SCHED_EVENT_CART);
+        }
+    } else if (addr < 0xA000) {
+        fgb_cpu_sync_event(cpu, SCHED_EVENT_PPU);
+    } else if (addr < 0xFF00) {
+        fgb_cpu_sync_event(cpu, SCHED_EVENT_PPU);
+    } else {
+        fgb_cpu_sync_events(cpu, cpu->mmu.io_registers[addr - 0xFF00].sync);
+    }
+}
+
+// A register write may have moved the peripheral's next event, so compute it again
+void fgb_cpu_reschedule_after_write(fgb_cpu* cpu, uint16_t addr) {
+    if (addr >= 0xFF00 && addr < 0xFF80 && !cpu->test_mode) {
+        fgb_cpu_sync_events(cpu, cpu->mmu.io_registers[addr - 0xFF00].reschedule);
+    }
 }
 
 void fgb_cpu_reset(fgb_cpu* cpu) {
@@ -111,11 +271,15 @@ void fgb_cpu_reset(fgb_cpu* cpu) {
     cpu->mode = CPU_MODE_NORMAL;
     cpu->total_cycles = 0;
     cpu->cycles_this_frame = 0;
+    fgb_scheduler_reset(&cpu->scheduler, 0);
+
+    fgb_cpu_flush_blocks(cpu);
 
     cpu->regs.pc = 0x0000; // Starting at $0000 to run Bootrom
     cpu->regs.sp = 0xFFFE;
 
     cpu->regs.af = 0x01B0;
+    cpu->lazy_flags.op = LAZY_OP_NONE;
     cpu->regs.bc = 0x0013;
     cpu->regs.de = 0x00D8;
     cpu->regs.hl = 0x014D;
@@ -124,36 +288,69 @@ void fgb_cpu_reset(fgb_cpu* cpu) {
     cpu->interrupt.enable = 0x00;
 
     cpu->mmu.bootrom_mapped = true;
-    
+    fgb_mmu_remap(&cpu->mmu);
+
     for (size_t i = 0; i < sizeof(fgb_init_table) / sizeof(fgb_init_table[0]); i++) {
         fgb_mmu_write(cpu, fgb_init_table[i].addr, fgb_init_table[i].value);
     }
 
-    for (int i = 0; i < FGB_CPU_MAX_BREAKPOINTS; i++) {
-        cpu->breakpoints[i] = FGB_BP_ADDR_NONE;
-    }
-
     fgb_timer_reset(&cpu->timer);
 }
 
-void fgb_cpu_run_frame(fgb_cpu* cpu) {
-    if (cpu->debugging && !cpu->do_step) {
+#if defined(__GNUC__) || defined(__clang__)
+#define FGB_CPU_FORCE_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define FGB_CPU_FORCE_INLINE __forceinline
+#else
+#define FGB_CPU_FORCE_INLINE inline
+#endif
+
+// Frame loop template, debug and test are compile time constants in every instantiation
+static FGB_CPU_FORCE_INLINE void fgb_cpu_run_frame_core(fgb_cpu* cpu, const bool debug, const bool test) {
+    if (debug && cpu->debugging && !cpu->do_step) {
         return;
     }
 
     cpu->cycles_this_frame = 0;
 
+    // Without breakpoints, tracing or single stepping, instructions can run back to back
+    const bool threaded = !debug || (!cpu->debugging && cpu->bp_count == 0 && !fgb_cpu_is_tracing(cpu));
+
+    // Input may have changed since the last frame
+    cpu->idle_loop.armed = false;
+    cpu->idle_loop.enabled = threaded && cpu->skip_idle_loops && !(test && cpu->test_mode);
+
     while (cpu->cycles_this_frame < FGB_CYCLES_PER_FRAME) {
+        if (threaded && cpu->mode == CPU_MODE_NORMAL) {
+            if (cpu->jit || cpu->block_cache) {
+                fgb_cpu_run_blocks(cpu);
+            }
+            else {
+                fgb_cpu_run_threaded(cpu);
+            }
+
+            if (fgb_cpu_has_pending_interrupts(cpu)) {
+                fgb_cpu_handle_interrupts(cpu);
+            }
+
+            continue;
+        }
+
         fgb_cpu_step(cpu);
 
-        for (size_t i = 0; i < FGB_CPU_MAX_BREAKPOINTS; i++) {
-            if (cpu->breakpoints[i] != FGB_BP_ADDR_NONE && cpu->regs.pc == cpu->breakpoints[i]) {
+        if (!debug) {
+            continue;
+        }
+
+        if (cpu->bp_count != 0 && fgb_cpu_bp_bit(cpu, cpu->regs.pc)) {
+            const int bp = fgb_cpu_find_bp(cpu, cpu->regs.pc, true);
+            if (bp != -1) {
                 log_info("Breakpoint hit at 0x%04X", cpu->regs.pc);
                 cpu->debugging = true;
                 cpu->do_step = false;
 
                 if (cpu->bp_callback) {
-                    cpu->bp_callback(cpu, i, cpu->regs.pc);
+                    cpu->bp_callback(cpu, (size_t)bp, cpu->regs.pc);
                 }
             }
         }
@@ -169,6 +366,13 @@ void fgb_cpu_run_frame(fgb_cpu* cpu) {
         }
     }
 
+    cpu->idle_loop.enabled = false;
+
+    // Leave every peripheral in a consistent state for the frontend
+    if (!(test && cpu->test_mode)) {
+        fgb_cpu_sync_events(cpu, (1 << SCHED_EVENT_COUNT) - 1);
+    }
+
     if (cpu->cycles_this_frame >= FGB_CYCLES_PER_FRAME) {
         cpu->frames++;
 
@@ -178,31 +382,75 @@ void fgb_cpu_run_frame(fgb_cpu* cpu) {
     }
 }
 
+#define FGB_CPU_CORE_LIST(CORE) \
+    CORE(CPU_CORE_PRODUCTION, production, false, false) \
+    CORE(CPU_CORE_DEBUG, debug, true, false) \
+    CORE(CPU_CORE_TEST, test, true, true)
+
+#define FGB_CPU_CORE_DEFINE(CORE, NAME, DEBUG, TEST) \
+    static void fgb_cpu_run_frame_##NAME(fgb_cpu* cpu) { \
+        fgb_cpu_run_frame_core(cpu, DEBUG, TEST); \
+    }
+#define FGB_CPU_CORE_ENTRY(CORE, NAME, DEBUG, TEST) [CORE] = fgb_cpu_run_frame_##NAME,
+
+FGB_CPU_CORE_LIST(FGB_CPU_CORE_DEFINE)
+
+static void (*const fgb_cpu_cores[CPU_CORE_COUNT])(fgb_cpu* cpu) = {
+    FGB_CPU_CORE_LIST(FGB_CPU_CORE_ENTRY)
+};
+
+#undef FGB_CPU_CORE_DEFINE
+#undef FGB_CPU_CORE_ENTRY
+
+void fgb_cpu_run_frame(fgb_cpu* cpu) {
+    fgb_cpu_cores[cpu->core](cpu);
+}
+
+void fgb_cpu_set_core(fgb_cpu* cpu, enum fgb_cpu_core core) {
+    if ((unsigned)core >= CPU_CORE_COUNT) {
+        log_error("Invalid CPU core: %d", (int)core);
+        return;
+    }
+
+    cpu->core = core;
+}
+
+// Debugger features only work on cores compiled with them
+void fgb_cpu_use_debug_core(fgb_cpu* cpu) {
+    if (cpu->core == CPU_CORE_PRODUCTION) {
+        log_info("Switching to the debug core");
+        cpu->core = CPU_CORE_DEBUG;
+    }
+}
+
 uint32_t fgb_cpu_step(fgb_cpu* cpu) {
     const uint32_t start_cycles = cpu->cycles_this_frame;
 
     switch (cpu->mode) {
     case CPU_MODE_NORMAL:
-        fgb_cpu_run_instruction(cpu, fgb_cpu_fetch_instruction(cpu));
+        // Traced instructions go through the interpreter, which reports them
+        if (fgb_cpu_is_tracing(cpu) || !fgb_cpu_run_block(cpu, true)) {
+            fgb_cpu_run_instruction(cpu, fgb_cpu_fetch(cpu));
+        }
         break;
 
     case CPU_MODE_STOP:
     case CPU_MODE_HALT:
-        fgb_cpu_m_tick(cpu);
+        fgb_cpu_halt(cpu);
         break;
 
     case CPU_MODE_HALT_BUG: {
-        const fgb_instruction* instr = fgb_cpu_fetch_instruction(cpu);
+        const uint8_t opcode = fgb_cpu_fetch(cpu);
 
         // Revert PC increment
         cpu->regs.pc--;
 
-        fgb_cpu_run_instruction(cpu, instr);
+        fgb_cpu_run_instruction(cpu, opcode);
         cpu->mode = CPU_MODE_NORMAL;
     } break;
 
     case CPU_MODE_HALT_DI:
-        fgb_cpu_m_tick(cpu);
+        fgb_cpu_halt(cpu);
         if (fgb_cpu_has_pending_interrupts(cpu)) {
             cpu->mode = CPU_MODE_NORMAL;
         }
@@ -213,7 +461,7 @@ uint32_t fgb_cpu_step(fgb_cpu* cpu) {
         cpu->ime = true;
         cpu->mode = CPU_MODE_NORMAL;
 
-        fgb_cpu_run_instruction(cpu, fgb_cpu_fetch_instruction(cpu));
+        fgb_cpu_run_instruction(cpu, fgb_cpu_fetch(cpu));
         break;
     }
 
@@ -224,32 +472,338 @@ uint32_t fgb_cpu_step(fgb_cpu* cpu) {
     return cpu->cycles_this_frame - start_cycles;
 }
 
-void fgb_cpu_run_instruction(fgb_cpu *cpu, const fgb_instruction* instr) {
-    const uint16_t addr = cpu->regs.pc - 1; // Address of the fetched opcode
-    const uint32_t depth = cpu->call_depth;
+void fgb_cpu_halt(fgb_cpu* cpu) {
+    // The tester observes every M-cycle and has no peripherals to wake the CPU
+    if (cpu->test_mode) {
+        fgb_cpu_m_tick(cpu);
+        return;
+    }
 
-    instr->exec_0(cpu, instr);
+    // Interrupts are only raised when a peripheral is synced, which can't happen
+    // before the next scheduler deadline. Skip straight to the M-cycle that reaches it
+    // (or the end of the frame) instead of ticking one M-cycle per step.
+    do {
+        const uint64_t frame_end = cpu->total_cycles + FGB_CYCLES_PER_FRAME - cpu->cycles_this_frame;
+        const uint64_t target = cpu->scheduler.next < frame_end ? cpu->scheduler.next : frame_end;
+        uint32_t m_cycles = 1;
 
-    if (cpu->trace_callback && (cpu->trace_count > 0 || cpu->trace_count < 0)) {
-        if (cpu->trace_count > 0) {
-            cpu->trace_count--;
+        if (target > cpu->total_cycles) {
+            m_cycles = (uint32_t)((target - cpu->total_cycles + 3) / 4);
         }
 
-        switch (instr->operand_size) {
-        case 0:
-            cpu->trace_callback(cpu, addr, depth, instr->fmt_0(instr));
+        fgb_cpu_advance(cpu, m_cycles * 4);
+    } while (!fgb_cpu_has_pending_interrupts(cpu) && cpu->cycles_this_frame < FGB_CYCLES_PER_FRAME);
+}
+
+// Called on every taken backward jump while idle loop skipping is enabled
+void fgb_cpu_check_idle_loop(fgb_cpu* cpu, uint16_t start, uint16_t end) {
+    fgb_cpu_idle_loop* loop = &cpu->idle_loop;
+    const uint64_t now = cpu->total_cycles;
+
+    if (loop->armed && loop->start == start && loop->end == end) {
+        // One full iteration ran inside the window in which the polled register was
+        // stable, so it read the same value as every further iteration in that window.
+        // A different iteration length means the CPU left the loop in between.
+        if (now - loop->armed_at == loop->cycles && now <= loop->bound
+            && cpu->cycles_this_frame < FGB_CYCLES_PER_FRAME) {
+            uint64_t iterations = (loop->bound - now) / loop->cycles;
+            const uint64_t frame_iterations = (FGB_CYCLES_PER_FRAME - cpu->cycles_this_frame) / loop->cycles;
+            if (frame_iterations < iterations) {
+                iterations = frame_iterations;
+            }
+
+            if (iterations > 0) {
+                fgb_cpu_advance(cpu, (uint32_t)(iterations * loop->cycles));
+
+                loop->stats.skips++;
+                loop->stats.iterations_skipped += iterations;
+                loop->stats.cycles_skipped += iterations * loop->cycles;
+            }
+        }
+    }
+    else {
+        loop->armed = fgb_cpu_analyze_idle_loop(cpu, start, end);
+        if (!loop->armed) {
+            return;
+        }
+
+        loop->start = start;
+        loop->end = end;
+        loop->stats.loops_detected++;
+    }
+
+    // Nothing observable can change before the next scheduler deadline,
+    // the polled register itself may change earlier
+    uint64_t bound = cpu->scheduler.next;
+
+    if (loop->addr == 0xFF04 || loop->addr == 0xFF05) {
+        fgb_cpu_sync_event(cpu, SCHED_EVENT_TIMER);
+        bound = cpu->scheduler.next;
+
+        const uint32_t stable = fgb_timer_stable_cycles(&cpu->timer, loop->addr);
+        if (stable != FGB_SCHEDULER_NO_EVENT && cpu->total_cycles + stable + 1 < bound) {
+            bound = cpu->total_cycles + stable + 1;
+        }
+    }
+
+    loop->armed_at = cpu->total_cycles;
+    loop->bound = bound;
+}
+
+// Checks whether [start, end) reads one PPU, timer or joypad register and then
+// only tests A before jumping back, so that every iteration with the same value
+// read leaves the CPU in the same state.
+bool fgb_cpu_analyze_idle_loop(fgb_cpu* cpu, uint16_t start, uint16_t end) {
+    if (end > 0x8000 || end - start > 16) {
+        return false; // Only short loops in ROM
+    }
+
+    uint8_t opcode = fgb_mmu_read_u8(cpu, start);
+    uint16_t addr;
+
+    switch (opcode) {
+    case 0xF0: addr = 0xFF00 | fgb_mmu_read_u8(cpu, start + 1); break; // LDH A,(a8)
+    case 0xFA: addr = fgb_mmu_read_u16(cpu, start + 1); break; // LD A,(a16)
+    default: return false;
+    }
+
+    switch (addr) {
+    case 0xFF00: // JOYP
+    case 0xFF04: // DIV
+    case 0xFF05: // TIMA
+    case 0xFF41: // STAT
+    case 0xFF44: // LY
+        break;
+    default:
+        return false;
+    }
+
+    uint32_t cycles = fgb_instruction_get(opcode)->cycles;
+    uint16_t pc = start + 1 + fgb_instruction_get(opcode)->operand_size;
+    bool branch = false;
+
+    while (pc < end && !branch) {
+        opcode = fgb_mmu_read_u8(cpu, pc);
+        const fgb_instruction* ins = fgb_instruction_get(opcode);
+        const uint16_t next = pc + 1 + ins->operand_size;
+
+        switch (opcode) {
+        case 0xA7: case 0xB7: // AND A, OR A
+        case 0xE6: case 0xEE: case 0xF6: case 0xFE: // AND/XOR/OR/CP n8
+            cycles += ins->cycles;
             break;
-        case 1:
-            cpu->trace_callback(cpu, addr, depth, instr->fmt_1(instr, fgb_mmu_read_u8(cpu, addr + 1)));
+
+        case 0xCB: {
+            const uint8_t cb = fgb_mmu_read_u8(cpu, pc + 1);
+            if (cb < 0x40 || cb >= 0x80 || (cb & 7) != 7) {
+                return false; // Only BIT b,A
+            }
+            cycles += fgb_instruction_get_cb_cycles(cb);
+        } break;
+
+        case 0x20: case 0x28: case 0x30: case 0x38: // JR cc
+            if (next != end || (uint16_t)(next + (int8_t)fgb_mmu_read_u8(cpu, pc + 1)) != start) {
+                return false;
+            }
+            cycles += ins->alt_cycles;
+            branch = true;
             break;
-        case 2:
-            cpu->trace_callback(cpu, addr, depth, instr->fmt_2(instr, fgb_mmu_read_u16(cpu, addr + 1)));
+
+        case 0xC2: case 0xCA: case 0xD2: case 0xDA: // JP cc
+            if (next != end || fgb_mmu_read_u16(cpu, pc + 1) != start) {
+                return false;
+            }
+            cycles += ins->alt_cycles;
+            branch = true;
             break;
+
         default:
-            cpu->trace_callback(cpu, addr, depth, "UNKNOWN");
+            return false;
+        }
+
+        pc = next;
+    }
+
+    if (!branch) {
+        return false;
+    }
+
+    cpu->idle_loop.addr = addr;
+    cpu->idle_loop.cycles = cycles;
+
+    return true;
+}
+
+void fgb_cpu_run_instruction(fgb_cpu *cpu, uint8_t opcode) {
+    if (!fgb_cpu_is_tracing(cpu)) {
+        fgb_instruction_get_handler(opcode)(cpu, fgb_instruction_get(opcode));
+        return;
+    }
+
+    if (cpu->trace) {
+        fgb_cpu_record_instruction(cpu, opcode);
+        fgb_instruction_get_handler(opcode)(cpu, fgb_instruction_get(opcode));
+        return;
+    }
+
+    const uint16_t addr = cpu->regs.pc - 1; // Address of the fetched opcode
+    const uint32_t depth = cpu->call_depth;
+
+    fgb_instruction_get_handler(opcode)(cpu, fgb_instruction_get(opcode));
+    fgb_cpu_trace_instruction(cpu, addr, depth, opcode);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FGB_CPU_COMPUTED_GOTO
+#endif
+
+// Whether the threaded loop may run another instruction or has to hand back to fgb_cpu_run_frame
+#define fgb_cpu_can_continue(cpu) \
+    ((cpu)->mode == CPU_MODE_NORMAL \
+    && (cpu)->cycles_this_frame < FGB_CYCLES_PER_FRAME \
+    && !((cpu)->ime && fgb_cpu_has_pending_interrupts(cpu)))
+
+void fgb_cpu_run_threaded(fgb_cpu* cpu) {
+#ifdef FGB_CPU_COMPUTED_GOTO
+    // Every handler is followed by its own copy of the dispatch so the
+    // host branch predictor can learn common opcode sequences
+#define FGB_DISPATCH_LABEL(OPCODE, HANDLER) [OPCODE] = &&op_##OPCODE,
+#define FGB_DISPATCH_BODY(OPCODE, HANDLER) \
+    op_##OPCODE: \
+        HANDLER(cpu, &fgb_instruction_table[OPCODE]); \
+        if (!fgb_cpu_can_continue(cpu)) { \
+            return; \
+        } \
+        goto *dispatch_table[fgb_cpu_fetch(cpu)];
+
+    static const void* const dispatch_table[FGB_INSTRUCTION_COUNT] = {
+        FGB_OPCODE_LIST(FGB_DISPATCH_LABEL)
+    };
+
+    goto *dispatch_table[fgb_cpu_fetch(cpu)];
+    FGB_OPCODE_LIST(FGB_DISPATCH_BODY)
+
+#undef FGB_DISPATCH_LABEL
+#undef FGB_DISPATCH_BODY
+#else
+#define FGB_DISPATCH_CASE(OPCODE, HANDLER) case OPCODE: HANDLER(cpu, &fgb_instruction_table[OPCODE]); break;
+
+    do {
+        switch (fgb_cpu_fetch(cpu)) {
+        FGB_OPCODE_LIST(FGB_DISPATCH_CASE)
+        }
+    } while (fgb_cpu_can_continue(cpu));
+
+#undef FGB_DISPATCH_CASE
+#endif
+}
+
+void fgb_cpu_run_blocks(fgb_cpu* cpu) {
+    // Code outside of ROM and RAM (e.g. VRAM or OAM) is interpreted one instruction at a time
+    do {
+        if (!fgb_cpu_run_block(cpu, false)) {
+            fgb_cpu_run_instruction(cpu, fgb_cpu_fetch(cpu));
+        }
+    } while (fgb_cpu_can_continue(cpu));
+}
+
+// Runs the block at PC through the active backend.
+// Returns false if there is none or the code at PC must be interpreted.
+bool fgb_cpu_run_block(fgb_cpu* cpu, bool single_step) {
+    if (cpu->jit) {
+        return fgb_jit_run(cpu->jit, single_step);
+    }
+
+    if (cpu->block_cache) {
+        return fgb_cpu_run_cached_block(cpu, single_step);
+    }
+
+    return false;
+}
+
+bool fgb_cpu_run_cached_block(fgb_cpu* cpu, bool single_step) {
+    fgb_block_cache* cache = cpu->block_cache;
+
+    const fgb_cached_block* block = fgb_block_cache_get(cache, cpu->regs.pc);
+    if (!block) {
+        return false;
+    }
+
+    cache->exit_block = single_step;
+
+    for (uint8_t i = 0; i < block->length; i++) {
+        const fgb_cached_instruction* ins = &block->instructions[i];
+
+        // The opcode fetch reads ROM or RAM, which needs no peripheral sync
+        fgb_cpu_advance(cpu, 4);
+        cpu->regs.pc++;
+
+        cpu->operand.value = ins->operand;
+        cpu->operand.count = ins->operand_size;
+        ins->handler(cpu, ins->instruction);
+
+        if (cache->exit_block || !fgb_cpu_can_continue(cpu)) {
             break;
         }
     }
+
+    return true;
+}
+
+void fgb_cpu_record_instruction(fgb_cpu* cpu, uint8_t opcode) {
+    const uint16_t addr = cpu->regs.pc - 1; // Address of the fetched opcode
+    const fgb_instruction* instr = fgb_instruction_get(opcode);
+
+    if (cpu->trace_count > 0) {
+        cpu->trace_count--;
+    }
+
+    fgb_trace_record record = {
+        .cycle = cpu->total_cycles - 4, // The fetch has already been charged
+        .pc = addr,
+        .bank = 0,
+        .af = (uint16_t)(cpu->regs.a << 8 | fgb_cpu_get_f(cpu)),
+        .bc = cpu->regs.bc,
+        .de = cpu->regs.de,
+        .hl = cpu->regs.hl,
+        .sp = cpu->regs.sp,
+        .opcode = opcode,
+        .depth = cpu->call_depth > UINT8_MAX ? UINT8_MAX : (uint8_t)cpu->call_depth,
+    };
+
+    if (addr < 0x8000 && cpu->mmu.cart && !(cpu->mmu.bootrom_mapped && addr < 0x100)) {
+        record.bank = fgb_cart_get_rom_bank(cpu->mmu.cart, addr);
+    }
+
+    // Operands are read before the instruction runs, so self-modifying code is recorded as executed
+    for (uint8_t i = 0; i < instr->operand_size; i++) {
+        record.operands[i] = fgb_mmu_read_u8(cpu, addr + 1 + i);
+    }
+
+    fgb_trace_push(cpu->trace, &record);
+}
+
+void fgb_cpu_trace_instruction(fgb_cpu* cpu, uint16_t addr, uint32_t depth, uint8_t opcode) {
+    const fgb_instruction* instr = fgb_instruction_get(opcode);
+
+    if (cpu->trace_count > 0) {
+        cpu->trace_count--;
+    }
+
+    switch (instr->operand_size) {
+    case 0:
+        cpu->trace_callback(cpu, addr, depth, instr->fmt_0(instr));
+        break;
+    case 1:
+        cpu->trace_callback(cpu, addr, depth, instr->fmt_1(instr, fgb_mmu_read_u8(cpu, addr + 1)));
+        break;
+    case 2:
+        cpu->trace_callback(cpu, addr, depth, instr->fmt_2(instr, fgb_mmu_read_u16(cpu, addr + 1)));
+        break;
+    default:
+        cpu->trace_callback(cpu, addr, depth, "UNKNOWN");
+        break;
+    }
 }
 
 void fgb_cpu_request_interrupt(fgb_cpu* cpu, enum fgb_cpu_interrupt interrupt) {
@@ -293,7 +847,7 @@ uint8_t fgb_cpu_read(const fgb_cpu* cpu, uint16_t addr) {
 void fgb_cpu_dump_state(const fgb_cpu* cpu) {
     log_info("CPU State -----------------------");
     log_info("Registers:");
-    log_info("  AF: 0x%04X", cpu->regs.af);
+    log_info("  AF: 0x%04X", cpu->regs.a << 8 | fgb_cpu_get_f(cpu));
     log_info("  BC: 0x%04X", cpu->regs.bc);
     log_info("  DE: 0x%04X", cpu->regs.de);
     log_info("  HL: 0x%04X", cpu->regs.hl);
@@ -310,9 +864,12 @@ void fgb_cpu_dump_state(const fgb_cpu* cpu) {
     log_info("  Enable: 0x%02X", cpu->interrupt.enable);
     log_info("  Flags: 0x%02X", cpu->interrupt.flags);
     log_info("Breakpoints:");
-    for (size_t i = 0; i < FGB_CPU_MAX_BREAKPOINTS; i++) {
-        if (cpu->breakpoints[i] != FGB_BP_ADDR_NONE) {
-            log_info("  Breakpoint %zu: 0x%04X", i, cpu->breakpoints[i]);
+    for (size_t i = 0; i < cpu->bp_count; i++) {
+        if (cpu->breakpoints[i].bank == FGB_CPU_BP_ANY_BANK) {
+            log_info("  Breakpoint %zu: 0x%04X", i, cpu->breakpoints[i].addr);
+        }
+        else {
+            log_info("  Breakpoint %zu: %02X:0x%04X", i, cpu->breakpoints[i].bank, cpu->breakpoints[i].addr);
         }
     }
     log_info("Debugging: %d", cpu->debugging);
@@ -412,36 +969,88 @@ uint16_t fgb_cpu_disassemble_one(const fgb_cpu* cpu, uint16_t addr, char* dest,
 }
 
 void fgb_cpu_set_bp(fgb_cpu* cpu, uint16_t addr) {
-    for (size_t i = 0; i < FGB_CPU_MAX_BREAKPOINTS; i++) {
-        if (cpu->breakpoints[i] == addr) {
+    fgb_cpu_set_bp_banked(cpu, addr, FGB_CPU_BP_ANY_BANK);
+}
+
+void fgb_cpu_set_bp_banked(fgb_cpu* cpu, uint16_t addr, uint16_t bank) {
+    fgb_cpu_use_debug_core(cpu);
+
+    if (addr >= 0x8000) {
+        bank = FGB_CPU_BP_ANY_BANK; // Only ROM is banked for breakpoints
+    }
+
+    for (size_t i = 0; i < cpu->bp_count; i++) {
+        if (cpu->breakpoints[i].addr == addr && cpu->breakpoints[i].bank == bank) {
             return;
         }
     }
 
-    for (size_t i = 0; i < FGB_CPU_MAX_BREAKPOINTS; i++) {
-        if (cpu->breakpoints[i] == FGB_BP_ADDR_NONE) {
-            cpu->breakpoints[i] = addr;
+    if (cpu->bp_count == cpu->bp_capacity) {
+        const size_t capacity = cpu->bp_capacity ? cpu->bp_capacity * 2 : 16;
+        fgb_cpu_breakpoint* breakpoints = realloc(cpu->breakpoints, capacity * sizeof(fgb_cpu_breakpoint));
+        if (!breakpoints) {
+            log_error("Failed to allocate breakpoints");
             return;
         }
+
+        cpu->breakpoints = breakpoints;
+        cpu->bp_capacity = capacity;
     }
 
-    log_error("No free breakpoint slots available");
+    cpu->breakpoints[cpu->bp_count++] = (fgb_cpu_breakpoint){ .addr = addr, .bank = bank };
+    cpu->bp_bitmap[addr >> 3] |= 1 << (addr & 7);
 }
 
 void fgb_cpu_clear_bp(fgb_cpu* cpu, uint16_t addr) {
-    for (size_t i = 0; i < FGB_CPU_MAX_BREAKPOINTS; i++) {
-        if (cpu->breakpoints[i] == addr) {
-            cpu->breakpoints[i] = FGB_BP_ADDR_NONE;
+    if (!fgb_cpu_bp_bit(cpu, addr)) {
+        log_warn("Breakpoint not found: 0x%04X", addr);
+        return;
+    }
+
+    for (size_t i = cpu->bp_count; i-- > 0;) {
+        if (cpu->breakpoints[i].addr == addr) {
+            fgb_cpu_remove_bp(cpu, i);
+        }
+    }
+}
+
+void fgb_cpu_clear_bp_banked(fgb_cpu* cpu, uint16_t addr, uint16_t bank) {
+    if (addr >= 0x8000) {
+        bank = FGB_CPU_BP_ANY_BANK;
+    }
+
+    for (size_t i = 0; i < cpu->bp_count; i++) {
+        if (cpu->breakpoints[i].addr == addr && cpu->breakpoints[i].bank == bank) {
+            fgb_cpu_remove_bp(cpu, i);
             return;
         }
     }
 
-    log_warn("Breakpoint not found: 0x%04X", addr);
+    log_warn("Breakpoint not found: %02X:0x%04X", bank, addr);
+}
+
+void fgb_cpu_clear_all_bps(fgb_cpu* cpu) {
+    memset(cpu->bp_bitmap, 0, sizeof(cpu->bp_bitmap));
+    cpu->bp_count = 0;
 }
 
 int fgb_cpu_get_bp_at(const fgb_cpu* cpu, uint16_t addr) {
-    for (size_t i = 0; i < FGB_CPU_MAX_BREAKPOINTS; i++) {
-        if (cpu->breakpoints[i] == addr) {
+    if (cpu->bp_count == 0 || !fgb_cpu_bp_bit(cpu, addr)) {
+        return -1;
+    }
+
+    return fgb_cpu_find_bp(cpu, addr, false);
+}
+
+int fgb_cpu_find_bp(const fgb_cpu* cpu, uint16_t addr, bool match_bank) {
+    uint16_t bank = FGB_CPU_BP_ANY_BANK;
+    if (match_bank && addr < 0x8000) {
+        bank = cpu->mmu.cart ? fgb_cart_get_rom_bank(cpu->mmu.cart, addr) : addr / 0x4000;
+    }
+
+    for (size_t i = 0; i < cpu->bp_count; i++) {
+        const fgb_cpu_breakpoint* bp = &cpu->breakpoints[i];
+        if (bp->addr == addr && (!match_bank || bp->bank == FGB_CPU_BP_ANY_BANK || bp->bank == bank)) {
             return (int)i;
         }
     }
@@ -449,59 +1058,125 @@ int fgb_cpu_get_bp_at(const fgb_cpu* cpu, uint16_t addr) {
     return -1;
 }
 
+void fgb_cpu_remove_bp(fgb_cpu* cpu, size_t index) {
+    const uint16_t addr = cpu->breakpoints[index].addr;
+    memmove(&cpu->breakpoints[index], &cpu->breakpoints[index + 1], (cpu->bp_count - index - 1) * sizeof(fgb_cpu_breakpoint));
+    cpu->bp_count--;
+
+    for (size_t i = 0; i < cpu->bp_count; i++) {
+        if (cpu->breakpoints[i].addr == addr) {
+            return; // Other breakpoints remain at this address
+        }
+    }
+
+    cpu->bp_bitmap[addr >> 3] &= ~(1 << (addr & 7));
+}
+
 void fgb_cpu_set_bp_callback(fgb_cpu* cpu, fgb_cpu_bp_callback callback) {
+    if (callback) {
+        fgb_cpu_use_debug_core(cpu);
+    }
+
     cpu->bp_callback = callback;
 }
 
 void fgb_cpu_set_step_callback(fgb_cpu* cpu, fgb_cpu_step_callback callback) {
+    if (callback) {
+        fgb_cpu_use_debug_core(cpu);
+    }
+
     cpu->step_callback = callback;
 }
 
 void fgb_cpu_set_trace_callback(fgb_cpu *cpu, fgb_cpu_trace_callback callback) {
+    if (callback) {
+        fgb_cpu_use_debug_core(cpu);
+    }
+
     cpu->trace_callback = callback;
 }
 
-const fgb_instruction* fgb_cpu_fetch_instruction(fgb_cpu *cpu) {
-    const uint8_t opcode = fgb_cpu_fetch(cpu);
-    const fgb_instruction* ins = fgb_instruction_get(opcode);
-    assert(ins->opcode == opcode);
+void fgb_cpu_set_trace(fgb_cpu* cpu, fgb_trace* trace) {
+    if (trace) {
+        fgb_cpu_use_debug_core(cpu);
+    }
+
+    cpu->trace = trace;
+}
+
+void fgb_cpu_set_debugging(fgb_cpu* cpu, bool debugging) {
+    if (debugging) {
+        fgb_cpu_use_debug_core(cpu);
+    }
 
-    return ins;
+    cpu->debugging = debugging;
+    cpu->do_step = false;
+}
+
+void fgb_cpu_request_step(fgb_cpu* cpu) {
+    if (cpu->debugging) {
+        cpu->do_step = true;
+    }
 }
 
 uint8_t fgb_cpu_fetch(fgb_cpu *cpu) {
+    if (cpu->operand.count != 0) {
+        // Already decoded by the block cache, only the bus timing remains
+        const uint8_t value = cpu->operand.value & 0xFF;
+        cpu->operand.value >>= 8;
+        cpu->operand.count--;
+        cpu->regs.pc++;
+        fgb_cpu_advance(cpu, 4);
+
+        return value;
+    }
+
     return fgb_cpu_read_u8(cpu, cpu->regs.pc++);
 }
 
 uint16_t fgb_cpu_fetch_u16(fgb_cpu* cpu) {
-    const uint16_t value = fgb_cpu_read_u16(cpu, cpu->regs.pc);
-    cpu->regs.pc += 2;
-    return value;
+    const uint16_t low = fgb_cpu_fetch(cpu);
+    const uint16_t high = fgb_cpu_fetch(cpu);
+
+    return (high << 8 | low) & 0xFFFF;
 }
 
 uint8_t fgb_cpu_read_u8(fgb_cpu *cpu, uint16_t addr) {
-    fgb_cpu_tick(cpu);
-    fgb_cpu_tick(cpu);
-    fgb_cpu_tick(cpu);
+    fgb_cpu_advance(cpu, 3);
+    fgb_cpu_sync_for_access(cpu, addr, false);
     const uint8_t val = fgb_mmu_read_u8(cpu, addr);
-    fgb_cpu_tick(cpu);
+    fgb_cpu_advance(cpu, 1);
 
     return val;
 }
 
-uint16_t fgb_cpu_read_u16(fgb_cpu *cpu, uint16_t addr) {
-    const uint16_t low = fgb_cpu_read_u8(cpu, addr);
-    const uint16_t high = fgb_cpu_read_u8(cpu, addr + 1);
+void fgb_cpu_write_u8(fgb_cpu *cpu, uint16_t addr, uint8_t value) {
+    fgb_cpu_advance(cpu, 3);
+    fgb_cpu_finish_write(cpu, addr, value);
+}
+
+// The bus access happens on the last T-cycle of the M-cycle
+uint8_t fgb_cpu_finish_read(fgb_cpu* cpu, uint16_t addr) {
+    fgb_cpu_sync_for_access(cpu, addr, false);
+    const uint8_t val = fgb_mmu_read_u8(cpu, addr);
+    fgb_cpu_advance(cpu, 1);
 
-    return (high << 8 | low) & 0xFFFF;
+    return val;
 }
 
-void fgb_cpu_write_u8(fgb_cpu *cpu, uint16_t addr, uint8_t value) {
-    fgb_cpu_tick(cpu);
-    fgb_cpu_tick(cpu);
-    fgb_cpu_tick(cpu);
+void fgb_cpu_finish_write(fgb_cpu* cpu, uint16_t addr, uint8_t value) {
+    fgb_cpu_sync_for_access(cpu, addr, true);
     fgb_mmu_write(cpu, addr, value);
-    fgb_cpu_tick(cpu);
+
+    if (cpu->block_cache) {
+        fgb_block_cache_notify_write(cpu->block_cache, addr);
+    }
+    else if (cpu->jit) {
+        fgb_jit_notify_write(cpu->jit, addr);
+    }
+
+    fgb_cpu_reschedule_after_write(cpu, addr);
+    fgb_cpu_advance(cpu, 1);
 }
 
 void fgb_cpu_write_u16(fgb_cpu *cpu, uint16_t addr, uint16_t value) {
@@ -541,6 +1216,7 @@ void fgb_cpu_handle_interrupts(fgb_cpu* cpu) {
     cpu->interrupt.flags = iflags;
     cpu->ime = false;
     cpu->mode = CPU_MODE_NORMAL;
+    cpu->idle_loop.armed = false;
 
     fgb_cpu_write_u8(cpu, --cpu->regs.sp, (cpu->regs.pc >> 0) & 0xFF);
 
@@ -556,30 +1232,70 @@ void fgb_cpu_handle_interrupts(fgb_cpu* cpu) {
 // Instruction execution functions
 // --------------------------------------------------------------
 
-static inline uint8_t fgb_inc_u8(fgb_cpu* cpu, uint8_t value) {
-    set_flag(h, (value & 0xF) == 0xF);
-    value++;
-    set_flag(z, value == 0);
-    set_flag(n, 0);
+uint8_t fgb_cpu_compute_flags(const fgb_cpu* cpu) {
+    const uint8_t x = cpu->lazy_flags.x;
+    const uint8_t y = cpu->lazy_flags.y;
+    const uint8_t carry = cpu->lazy_flags.carry;
+
+    switch (cpu->lazy_flags.op) {
+    case LAZY_OP_ADD: {
+        const uint16_t result = x + y + carry;
+        return ((result & 0xFF) == 0 ? CPU_FLAG_Z : 0)
+            | ((x & 0xF) + (y & 0xF) + carry > 0xF ? CPU_FLAG_H : 0)
+            | (result > 0xFF ? CPU_FLAG_C : 0);
+    }
+    case LAZY_OP_SUB:
+        return (((x - y - carry) & 0xFF) == 0 ? CPU_FLAG_Z : 0)
+            | CPU_FLAG_N
+            | ((y & 0xF) + carry > (x & 0xF) ? CPU_FLAG_H : 0)
+            | (y + carry > x ? CPU_FLAG_C : 0);
+    case LAZY_OP_INC:
+        return (x == 0xFF ? CPU_FLAG_Z : 0)
+            | ((x & 0xF) == 0xF ? CPU_FLAG_H : 0)
+            | (carry ? CPU_FLAG_C : 0);
+    case LAZY_OP_DEC:
+        return (x == 0x01 ? CPU_FLAG_Z : 0)
+            | CPU_FLAG_N
+            | ((x & 0xF) == 0 ? CPU_FLAG_H : 0)
+            | (carry ? CPU_FLAG_C : 0);
+    case LAZY_OP_AND:
+        return (x == 0 ? CPU_FLAG_Z : 0) | CPU_FLAG_H;
+    case LAZY_OP_OR:
+        return x == 0 ? CPU_FLAG_Z : 0;
+    default:
+        return cpu->regs.f;
+    }
+}
 
-    return value;
+// Cheaper than fgb_cpu_compute_flags for instructions that only consume C
+static inline uint8_t fgb_cpu_carry(const fgb_cpu* cpu) {
+    const uint8_t x = cpu->lazy_flags.x;
+    const uint8_t y = cpu->lazy_flags.y;
+    const uint8_t carry = cpu->lazy_flags.carry;
+
+    switch (cpu->lazy_flags.op) {
+    case LAZY_OP_NONE: return (cpu->regs.f & CPU_FLAG_C) != 0;
+    case LAZY_OP_ADD:  return x + y + carry > 0xFF;
+    case LAZY_OP_SUB:  return y + carry > x;
+    case LAZY_OP_INC:
+    case LAZY_OP_DEC:  return carry;
+    default:           return 0;
+    }
+}
+
+static inline uint8_t fgb_inc_u8(fgb_cpu* cpu, uint8_t value) {
+    fgb_cpu_set_lazy_flags(cpu, LAZY_OP_INC, value, 0, fgb_cpu_carry(cpu));
+    return value + 1;
 }
 
 static inline uint8_t fgb_dec_u8(fgb_cpu* cpu, uint8_t value) {
-    set_flag(h, (value & 0xF) == 0);
-    value--;
-    set_flag(z, value == 0);
-    set_flag(n, 1);
-    return value;
+    fgb_cpu_set_lazy_flags(cpu, LAZY_OP_DEC, value, 0, fgb_cpu_carry(cpu));
+    return value - 1;
 }
 
 static inline uint8_t fgb_add_u8(fgb_cpu* cpu, uint8_t a, uint8_t b) {
-    const uint16_t result = a + b;
-    set_flag(z, (result & 0xFF) == 0);
-    set_flag(n, 0);
-    set_flag(h, (a & 0xF) + (b & 0xF) > 0xF);
-    set_flag(c, result > 0xFF);
-    return result & 0xFF;
+    fgb_cpu_set_lazy_flags(cpu, LAZY_OP_ADD, a, b, 0);
+    return (a + b) & 0xFF;
 }
 
 static inline uint16_t fgb_add_u16(fgb_cpu* cpu, uint16_t a, uint16_t b) {
@@ -591,57 +1307,37 @@ static inline uint16_t fgb_add_u16(fgb_cpu* cpu, uint16_t a, uint16_t b) {
 }
 
 static inline uint8_t fgb_adc_u8(fgb_cpu* cpu, uint8_t a, uint8_t b) {
-    const uint16_t result = a + b + get_flag(c);
-    set_flag(z, (result & 0xFF) == 0);
-    set_flag(n, 0);
-    set_flag(h, (a & 0xF) + (b & 0xF) + get_flag(c) > 0xF);
-    set_flag(c, result > 0xFF);
-    return result & 0xFF;
+    const uint8_t carry = fgb_cpu_carry(cpu);
+    fgb_cpu_set_lazy_flags(cpu, LAZY_OP_ADD, a, b, carry);
+    return (a + b + carry) & 0xFF;
 }
 
 static inline uint8_t fgb_sub_u8(fgb_cpu* cpu, uint8_t a, uint8_t b) {
-    set_flag(c, b > a);
-    set_flag(h, (b & 0xF) > (a & 0xF));
-    set_flag(n, 1);
-    a -= b;
-    set_flag(z, a == 0);
-    return a;
+    fgb_cpu_set_lazy_flags(cpu, LAZY_OP_SUB, a, b, 0);
+    return (a - b) & 0xFF;
 }
 
 static inline uint8_t fgb_sbc_u8(fgb_cpu* cpu, uint8_t a, uint8_t b) {
-    set_flag(h, (b & 0xF) + get_flag(c) > (a & 0xF));
-    const uint8_t new_c = b + get_flag(c) > a;
-    set_flag(n, 1);
-    a -= b + get_flag(c);
-    set_flag(c, new_c);
-    set_flag(z, a == 0);
-    return a;
+    const uint8_t carry = fgb_cpu_carry(cpu);
+    fgb_cpu_set_lazy_flags(cpu, LAZY_OP_SUB, a, b, carry);
+    return (a - b - carry) & 0xFF;
 }
 
 static inline uint8_t fgb_and_u8(fgb_cpu* cpu, uint8_t a, uint8_t b) {
     a &= b;
-    set_flag(z, a == 0);
-    set_flag(n, 0);
-    set_flag(h, 1);
-    set_flag(c, 0);
+    fgb_cpu_set_lazy_flags(cpu, LAZY_OP_AND, a, 0, 0);
     return a;
 }
 
 static inline uint8_t fgb_xor_u8(fgb_cpu* cpu, uint8_t a, uint8_t b) {
     a ^= b;
-    set_flag(z, a == 0);
-    set_flag(n, 0);
-    set_flag(h, 0);
-    set_flag(c, 0);
+    fgb_cpu_set_lazy_flags(cpu, LAZY_OP_OR, a, 0, 0);
     return a;
 }
 
 static inline uint8_t fgb_or_u8(fgb_cpu* cpu, uint8_t a, uint8_t b) {
     a |= b;
-    set_flag(z, a == 0);
-    set_flag(n, 0);
-    set_flag(h, 0);
-    set_flag(c, 0);
+    fgb_cpu_set_lazy_flags(cpu, LAZY_OP_OR, a, 0, 0);
     return a;
 }
 
@@ -968,8 +1664,13 @@ void fgb_ld_p_imm_sp(fgb_cpu* cpu, const fgb_instruction* ins) {
 }
 
 static void fgb_jr_(fgb_cpu* cpu, int8_t offset) {
+    const uint16_t end = cpu->regs.pc;
     cpu->regs.pc += offset;
     fgb_cpu_m_tick(cpu); // Extra cycle for the jump
+
+    if (offset < 0 && cpu->idle_loop.enabled) {
+        fgb_cpu_check_idle_loop(cpu, cpu->regs.pc, end);
+    }
 }
 
 void fgb_jr(fgb_cpu* cpu, const fgb_instruction* ins) {
@@ -1599,7 +2300,7 @@ void fgb_push_hl(fgb_cpu* cpu, const fgb_instruction* ins) {
 void fgb_push_af(fgb_cpu* cpu, const fgb_instruction* ins) {
     fgb_cpu_m_tick(cpu);
     fgb_cpu_write_u8(cpu, --cpu->regs.sp, cpu->regs.a);
-    fgb_cpu_write_u8(cpu, --cpu->regs.sp, cpu->regs.f);
+    fgb_cpu_write_u8(cpu, --cpu->regs.sp, fgb_cpu_get_f(cpu));
 }
 
 void fgb_pop_bc(fgb_cpu* cpu, const fgb_instruction* ins) {
@@ -1618,7 +2319,7 @@ void fgb_pop_hl(fgb_cpu* cpu, const fgb_instruction* ins) {
 }
 
 void fgb_pop_af(fgb_cpu* cpu, const fgb_instruction* ins) {
-    cpu->regs.f = fgb_cpu_read_u8(cpu, cpu->regs.sp++) & 0xF0;
+    fgb_cpu_set_f(cpu, fgb_cpu_read_u8(cpu, cpu->regs.sp++) & 0xF0);
     cpu->regs.a = fgb_cpu_read_u8(cpu, cpu->regs.sp++);
 }
 
@@ -1664,8 +2365,13 @@ void fgb_ld_sp_hl(fgb_cpu* cpu, const fgb_instruction* ins) {
 }
 
 static void fgb_jp_(fgb_cpu* cpu, uint16_t address) {
+    const uint16_t end = cpu->regs.pc;
     cpu->regs.pc = address;
     fgb_cpu_m_tick(cpu);
+
+    if (address < end && cpu->idle_loop.enabled) {
+        fgb_cpu_check_idle_loop(cpu, address, end);
+    }
 }
 
 void fgb_jp_imm16(fgb_cpu* cpu, const fgb_instruction* ins) {
@@ -1814,8 +2520,6 @@ void fgb_rst_7(fgb_cpu* cpu, const fgb_instruction* ins) {
     fgb_call(cpu, 0x0038);
 }
 
-#define fgb_cb_bit_index(opcode) (((opcode) >> 3) & 7)
-
 static inline uint8_t fgb_cb_rlc(fgb_cpu* cpu, uint8_t value) {
     set_flag(c, value >> 7);
     value <<= 1;
@@ -1903,130 +2607,94 @@ static inline void fgb_cb_bit(fgb_cpu* cpu, uint8_t bit, uint8_t value) {
 #define fgb_cb_res(val, bit) ((val) & ~(1 << (bit)))
 #define fgb_cb_set(val, bit) ((val) | (1 << (bit)))
 
-#define fgb_cb_cases(start) \
-    case start + 0x00: \
-    case start + 0x08: \
-    case start + 0x10: \
-    case start + 0x18: \
-    case start + 0x20: \
-    case start + 0x28: \
-    case start + 0x30: \
-    case start + 0x38
+enum fgb_cb_op {
+    CB_OP_RLC,
+    CB_OP_RRC,
+    CB_OP_RL,
+    CB_OP_RR,
+    CB_OP_SLA,
+    CB_OP_SRA,
+    CB_OP_SWAP,
+    CB_OP_SRL,
+    CB_OP_BIT,
+    CB_OP_RES,
+    CB_OP_SET,
+};
+
+typedef struct fgb_cb_decoded {
+    uint8_t op; // See fgb_cb_op
+    uint8_t reg; // B, C, D, E, H, L, (HL), A
+    uint8_t bit;
+} fgb_cb_decoded;
+
+#define CB_REG_P_HL 6
+
+// Bits 0-2 of a CB opcode select the register, bits 3-7 the operation (and bit index)
+#define CB_ROW(OP, BIT) \
+    { OP, 0, BIT }, { OP, 1, BIT }, { OP, 2, BIT }, { OP, 3, BIT }, \
+    { OP, 4, BIT }, { OP, 5, BIT }, { OP, 6, BIT }, { OP, 7, BIT }
+
+#define CB_ROWS_BIT(OP) \
+    CB_ROW(OP, 0), CB_ROW(OP, 1), CB_ROW(OP, 2), CB_ROW(OP, 3), \
+    CB_ROW(OP, 4), CB_ROW(OP, 5), CB_ROW(OP, 6), CB_ROW(OP, 7)
+
+static const fgb_cb_decoded fgb_cb_table[FGB_INSTRUCTION_COUNT] = {
+    CB_ROW(CB_OP_RLC, 0),
+    CB_ROW(CB_OP_RRC, 0),
+    CB_ROW(CB_OP_RL, 0),
+    CB_ROW(CB_OP_RR, 0),
+    CB_ROW(CB_OP_SLA, 0),
+    CB_ROW(CB_OP_SRA, 0),
+    CB_ROW(CB_OP_SWAP, 0),
+    CB_ROW(CB_OP_SRL, 0),
+    CB_ROWS_BIT(CB_OP_BIT),
+    CB_ROWS_BIT(CB_OP_RES),
+    CB_ROWS_BIT(CB_OP_SET),
+};
+
+#undef CB_ROW
+#undef CB_ROWS_BIT
+
+static const size_t fgb_cb_reg_offsets[] = {
+    offsetof(fgb_cpu_regs, b),
+    offsetof(fgb_cpu_regs, c),
+    offsetof(fgb_cpu_regs, d),
+    offsetof(fgb_cpu_regs, e),
+    offsetof(fgb_cpu_regs, h),
+    offsetof(fgb_cpu_regs, l),
+    0, // (HL) goes through memory
+    offsetof(fgb_cpu_regs, a),
+};
 
 void fgb_cb(fgb_cpu* cpu, const fgb_instruction* ins) {
-    const uint8_t opcode = fgb_cpu_fetch(cpu);
-    switch (opcode) {
-        // RLC reg8
-    case 0x00: cpu->regs.b = fgb_cb_rlc(cpu, cpu->regs.b); break;
-    case 0x01: cpu->regs.c = fgb_cb_rlc(cpu, cpu->regs.c); break;
-    case 0x02: cpu->regs.d = fgb_cb_rlc(cpu, cpu->regs.d); break;
-    case 0x03: cpu->regs.e = fgb_cb_rlc(cpu, cpu->regs.e); break;
-    case 0x04: cpu->regs.h = fgb_cb_rlc(cpu, cpu->regs.h); break;
-    case 0x05: cpu->regs.l = fgb_cb_rlc(cpu, cpu->regs.l); break;
-    case 0x06: fgb_cpu_write_u8(cpu, cpu->regs.hl, fgb_cb_rlc(cpu, fgb_cpu_read_u8(cpu, cpu->regs.hl))); break;
-    case 0x07: cpu->regs.a = fgb_cb_rlc(cpu, cpu->regs.a); break;
-
-        // RRC reg8
-    case 0x08: cpu->regs.b = fgb_cb_rrc(cpu, cpu->regs.b); break;
-    case 0x09: cpu->regs.c = fgb_cb_rrc(cpu, cpu->regs.c); break;
-    case 0x0A: cpu->regs.d = fgb_cb_rrc(cpu, cpu->regs.d); break;
-    case 0x0B: cpu->regs.e = fgb_cb_rrc(cpu, cpu->regs.e); break;
-    case 0x0C: cpu->regs.h = fgb_cb_rrc(cpu, cpu->regs.h); break;
-    case 0x0D: cpu->regs.l = fgb_cb_rrc(cpu, cpu->regs.l); break;
-    case 0x0E: fgb_cpu_write_u8(cpu, cpu->regs.hl, fgb_cb_rrc(cpu, fgb_cpu_read_u8(cpu, cpu->regs.hl))); break;
-    case 0x0F: cpu->regs.a = fgb_cb_rrc(cpu, cpu->regs.a); break;
-
-        // RL reg8
-    case 0x10: cpu->regs.b = fgb_cb_rl(cpu, cpu->regs.b); break;
-    case 0x11: cpu->regs.c = fgb_cb_rl(cpu, cpu->regs.c); break;
-    case 0x12: cpu->regs.d = fgb_cb_rl(cpu, cpu->regs.d); break;
-    case 0x13: cpu->regs.e = fgb_cb_rl(cpu, cpu->regs.e); break;
-    case 0x14: cpu->regs.h = fgb_cb_rl(cpu, cpu->regs.h); break;
-    case 0x15: cpu->regs.l = fgb_cb_rl(cpu, cpu->regs.l); break;
-    case 0x16: fgb_cpu_write_u8(cpu, cpu->regs.hl, fgb_cb_rl(cpu, fgb_cpu_read_u8(cpu, cpu->regs.hl))); break;
-    case 0x17: cpu->regs.a = fgb_cb_rl(cpu, cpu->regs.a); break;
-
-        // RR reg8
-    case 0x18: cpu->regs.b = fgb_cb_rr(cpu, cpu->regs.b); break;
-    case 0x19: cpu->regs.c = fgb_cb_rr(cpu, cpu->regs.c); break;
-    case 0x1A: cpu->regs.d = fgb_cb_rr(cpu, cpu->regs.d); break;
-    case 0x1B: cpu->regs.e = fgb_cb_rr(cpu, cpu->regs.e); break;
-    case 0x1C: cpu->regs.h = fgb_cb_rr(cpu, cpu->regs.h); break;
-    case 0x1D: cpu->regs.l = fgb_cb_rr(cpu, cpu->regs.l); break;
-    case 0x1E: fgb_cpu_write_u8(cpu, cpu->regs.hl, fgb_cb_rr(cpu, fgb_cpu_read_u8(cpu, cpu->regs.hl))); break;
-    case 0x1F: cpu->regs.a = fgb_cb_rr(cpu, cpu->regs.a); break;
-
-        // SLA reg8
-    case 0x20: cpu->regs.b = fgb_cb_sla(cpu, cpu->regs.b); break;
-    case 0x21: cpu->regs.c = fgb_cb_sla(cpu, cpu->regs.c); break;
-    case 0x22: cpu->regs.d = fgb_cb_sla(cpu, cpu->regs.d); break;
-    case 0x23: cpu->regs.e = fgb_cb_sla(cpu, cpu->regs.e); break;
-    case 0x24: cpu->regs.h = fgb_cb_sla(cpu, cpu->regs.h); break;
-    case 0x25: cpu->regs.l = fgb_cb_sla(cpu, cpu->regs.l); break;
-    case 0x26: fgb_cpu_write_u8(cpu, cpu->regs.hl, fgb_cb_sla(cpu, fgb_cpu_read_u8(cpu, cpu->regs.hl))); break;
-    case 0x27: cpu->regs.a = fgb_cb_sla(cpu, cpu->regs.a); break;
-
-        // SRA reg8
-    case 0x28: cpu->regs.b = fgb_cb_sra(cpu, cpu->regs.b); break;
-    case 0x29: cpu->regs.c = fgb_cb_sra(cpu, cpu->regs.c); break;
-    case 0x2A: cpu->regs.d = fgb_cb_sra(cpu, cpu->regs.d); break;
-    case 0x2B: cpu->regs.e = fgb_cb_sra(cpu, cpu->regs.e); break;
-    case 0x2C: cpu->regs.h = fgb_cb_sra(cpu, cpu->regs.h); break;
-    case 0x2D: cpu->regs.l = fgb_cb_sra(cpu, cpu->regs.l); break;
-    case 0x2E: fgb_cpu_write_u8(cpu, cpu->regs.hl, fgb_cb_sra(cpu, fgb_cpu_read_u8(cpu, cpu->regs.hl))); break;
-    case 0x2F: cpu->regs.a = fgb_cb_sra(cpu, cpu->regs.a); break;
-
-        // SWAP reg8
-    case 0x30: cpu->regs.b = fgb_cb_swap(cpu, cpu->regs.b); break;
-    case 0x31: cpu->regs.c = fgb_cb_swap(cpu, cpu->regs.c); break;
-    case 0x32: cpu->regs.d = fgb_cb_swap(cpu, cpu->regs.d); break;
-    case 0x33: cpu->regs.e = fgb_cb_swap(cpu, cpu->regs.e); break;
-    case 0x34: cpu->regs.h = fgb_cb_swap(cpu, cpu->regs.h); break;
-    case 0x35: cpu->regs.l = fgb_cb_swap(cpu, cpu->regs.l); break;
-    case 0x36: fgb_cpu_write_u8(cpu, cpu->regs.hl, fgb_cb_swap(cpu, fgb_cpu_read_u8(cpu, cpu->regs.hl))); break;
-    case 0x37: cpu->regs.a = fgb_cb_swap(cpu, cpu->regs.a); break;
-
-        // SRL reg8
-    case 0x38: cpu->regs.b = fgb_cb_srl(cpu, cpu->regs.b); break;
-    case 0x39: cpu->regs.c = fgb_cb_srl(cpu, cpu->regs.c); break;
-    case 0x3A: cpu->regs.d = fgb_cb_srl(cpu, cpu->regs.d); break;
-    case 0x3B: cpu->regs.e = fgb_cb_srl(cpu, cpu->regs.e); break;
-    case 0x3C: cpu->regs.h = fgb_cb_srl(cpu, cpu->regs.h); break;
-    case 0x3D: cpu->regs.l = fgb_cb_srl(cpu, cpu->regs.l); break;
-    case 0x3E: fgb_cpu_write_u8(cpu, cpu->regs.hl, fgb_cb_srl(cpu, fgb_cpu_read_u8(cpu, cpu->regs.hl))); break;
-    case 0x3F: cpu->regs.a = fgb_cb_srl(cpu, cpu->regs.a); break;
-
-        // BIT n, reg8
-    fgb_cb_cases(0x40): fgb_cb_bit(cpu, fgb_cb_bit_index(opcode), cpu->regs.b); break;
-    fgb_cb_cases(0x41): fgb_cb_bit(cpu, fgb_cb_bit_index(opcode), cpu->regs.c); break;
-    fgb_cb_cases(0x42): fgb_cb_bit(cpu, fgb_cb_bit_index(opcode), cpu->regs.d); break;
-    fgb_cb_cases(0x43): fgb_cb_bit(cpu, fgb_cb_bit_index(opcode), cpu->regs.e); break;
-    fgb_cb_cases(0x44): fgb_cb_bit(cpu, fgb_cb_bit_index(opcode), cpu->regs.h); break;
-    fgb_cb_cases(0x45): fgb_cb_bit(cpu, fgb_cb_bit_index(opcode), cpu->regs.l); break;
-    fgb_cb_cases(0x46): fgb_cb_bit(cpu, fgb_cb_bit_index(opcode), fgb_cpu_read_u8(cpu, cpu->regs.hl)); break;
-    fgb_cb_cases(0x47): fgb_cb_bit(cpu, fgb_cb_bit_index(opcode), cpu->regs.a); break;
-
-        // RES n, reg8
-    fgb_cb_cases(0x80): cpu->regs.b = fgb_cb_res(cpu->regs.b, fgb_cb_bit_index(opcode)); break;
-    fgb_cb_cases(0x81): cpu->regs.c = fgb_cb_res(cpu->regs.c, fgb_cb_bit_index(opcode)); break;
-    fgb_cb_cases(0x82): cpu->regs.d = fgb_cb_res(cpu->regs.d, fgb_cb_bit_index(opcode)); break;
-    fgb_cb_cases(0x83): cpu->regs.e = fgb_cb_res(cpu->regs.e, fgb_cb_bit_index(opcode)); break;
-    fgb_cb_cases(0x84): cpu->regs.h = fgb_cb_res(cpu->regs.h, fgb_cb_bit_index(opcode)); break;
-    fgb_cb_cases(0x85): cpu->regs.l = fgb_cb_res(cpu->regs.l, fgb_cb_bit_index(opcode)); break;
-    fgb_cb_cases(0x86): fgb_cpu_write_u8(cpu, cpu->regs.hl, fgb_cb_res(fgb_cpu_read_u8(cpu, cpu->regs.hl), fgb_cb_bit_index(opcode))); break;
-    fgb_cb_cases(0x87): cpu->regs.a = fgb_cb_res(cpu->regs.a, fgb_cb_bit_index(opcode)); break;
-
-        // SET n, reg8
-    fgb_cb_cases(0xC0): cpu->regs.b = fgb_cb_set(cpu->regs.b, fgb_cb_bit_index(opcode)); break;
-    fgb_cb_cases(0xC1): cpu->regs.c = fgb_cb_set(cpu->regs.c, fgb_cb_bit_index(opcode)); break;
-    fgb_cb_cases(0xC2): cpu->regs.d = fgb_cb_set(cpu->regs.d, fgb_cb_bit_index(opcode)); break;
-    fgb_cb_cases(0xC3): cpu->regs.e = fgb_cb_set(cpu->regs.e, fgb_cb_bit_index(opcode)); break;
-    fgb_cb_cases(0xC4): cpu->regs.h = fgb_cb_set(cpu->regs.h, fgb_cb_bit_index(opcode)); break;
-    fgb_cb_cases(0xC5): cpu->regs.l = fgb_cb_set(cpu->regs.l, fgb_cb_bit_index(opcode)); break;
-    fgb_cb_cases(0xC6): fgb_cpu_write_u8(cpu, cpu->regs.hl, fgb_cb_set(fgb_cpu_read_u8(cpu, cpu->regs.hl), fgb_cb_bit_index(opcode))); break;
-    fgb_cb_cases(0xC7): cpu->regs.a = fgb_cb_set(cpu->regs.a, fgb_cb_bit_index(opcode)); break;
+    const fgb_cb_decoded cb = fgb_cb_table[fgb_cpu_fetch(cpu)];
+    uint8_t* reg = cb.reg == CB_REG_P_HL ? NULL : (uint8_t*)&cpu->regs + fgb_cb_reg_offsets[cb.reg];
+    const uint8_t value = reg ? *reg : fgb_cpu_read_u8(cpu, cpu->regs.hl);
+    uint8_t result;
+
+    switch (cb.op) {
+    case CB_OP_RLC:  result = fgb_cb_rlc(cpu, value); break;
+    case CB_OP_RRC:  result = fgb_cb_rrc(cpu, value); break;
+    case CB_OP_RL:   result = fgb_cb_rl(cpu, value); break;
+    case CB_OP_RR:   result = fgb_cb_rr(cpu, value); break;
+    case CB_OP_SLA:  result = fgb_cb_sla(cpu, value); break;
+    case CB_OP_SRA:  result = fgb_cb_sra(cpu, value); break;
+    case CB_OP_SWAP: result = fgb_cb_swap(cpu, value); break;
+    case CB_OP_SRL:  result = fgb_cb_srl(cpu, value); break;
+    case CB_OP_RES:  result = fgb_cb_res(value, cb.bit); break;
+    case CB_OP_SET:  result = fgb_cb_set(value, cb.bit); break;
+
+    case CB_OP_BIT:
+        fgb_cb_bit(cpu, cb.bit, value);
+        return; // BIT doesn't write back
 
         // Shouldn't ever happen but whatever
-    default: log_warn("Unknown instruction: CB %02X", opcode); break;
+    default: log_warn("Unknown CB operation: %d", cb.op); return;
+    }
+
+    if (reg) {
+        *reg = result;
+    } else {
+        fgb_cpu_write_u8(cpu, cpu->regs.hl, result);
     }
 }
@@ -1,9 +1,27 @@
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+#endif
+
 #include "emu.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include <ulog.h>
 
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+static fgb_emu* fgb_emu_create_with_cart(fgb_cart* cart, fgb_model model, uint32_t apu_sample_rate,
+                                         fgb_apu_sample_callback sample_cb, void* userdata, const fgb_mmu_ops* mmu_ops);
+static int fgb_emu_adapt_frameskip(fgb_emu* emu);
+static double fgb_emu_host_time(void);
+
+#define FGB_FRAMESKIP_MAX_LAG   0.25 // Seconds behind real time after which the auto frameskip stops trying to catch up
+
 
 fgb_emu* fgb_emu_create_ex(const uint8_t* cart_data, size_t cart_size,
                            fgb_model model,
@@ -11,19 +29,50 @@ fgb_emu* fgb_emu_create_ex(const uint8_t* cart_data, size_t cart_size,
                            fgb_apu_sample_callback sample_cb,
                            void* userdata,
                            const fgb_mmu_ops* mmu_ops) {
+    return fgb_emu_create_with_cart(fgb_cart_load(cart_data, cart_size), model, apu_sample_rate, sample_cb, userdata, mmu_ops);
+}
+
+fgb_emu* fgb_emu_create_borrowed(const uint8_t* cart_data, size_t cart_size,
+                                 fgb_model model,
+                                 uint32_t apu_sample_rate,
+                                 fgb_apu_sample_callback sample_cb,
+                                 void* userdata) {
+    return fgb_emu_create_with_cart(fgb_cart_load_borrowed(cart_data, cart_size), model, apu_sample_rate, sample_cb, userdata, NULL);
+}
+
+fgb_emu* fgb_emu_create_from_file(const char* rom_path,
+                                  fgb_model model,
+                                  uint32_t apu_sample_rate,
+                                  fgb_apu_sample_callback sample_cb,
+                                  void* userdata) {
+    return fgb_emu_create_with_cart(fgb_cart_load_mapped(rom_path), model, apu_sample_rate, sample_cb, userdata, NULL);
+}
+
+fgb_emu* fgb_emu_create_from_image(fgb_rom_image* image,
+                                   fgb_model model,
+                                   uint32_t apu_sample_rate,
+                                   fgb_apu_sample_callback sample_cb,
+                                   void* userdata) {
+    return fgb_emu_create_with_cart(fgb_cart_load_image(image), model, apu_sample_rate, sample_cb, userdata, NULL);
+}
+
+// Takes ownership of cart, which may be NULL if loading it failed
+fgb_emu* fgb_emu_create_with_cart(fgb_cart* cart, fgb_model model, uint32_t apu_sample_rate,
+                                  fgb_apu_sample_callback sample_cb, void* userdata, const fgb_mmu_ops* mmu_ops) {
+    if (!cart) {
+        return NULL;
+    }
+
     fgb_emu* emu = malloc(sizeof(fgb_emu));
     if (!emu) {
         log_error("Failed to allocate emulator");
+        fgb_cart_destroy(cart);
         return NULL;
     }
 
+    memset(emu, 0, sizeof(fgb_emu));
     emu->model = model;
-
-    emu->cart = fgb_cart_load(cart_data, cart_size);
-    if (!emu->cart) {
-        fgb_emu_destroy(emu);
-        return NULL;
-    }
+    emu->cart = cart;
 
     emu->ppu = (model == FGB_MODEL_DMG) ? fgb_ppu_create() : fgb_ppu_create_with_model(model);
     if (!emu->ppu) {
@@ -84,6 +133,11 @@ void fgb_emu_reset(fgb_emu* emu) {
     fgb_cpu_reset(emu->cpu);
     fgb_ppu_reset(emu->ppu);
     fgb_apu_reset(emu->apu);
+
+    // Frame 0 is drawn, like on a new emulator
+    emu->frames_until_drawn = 0;
+    emu->auto_frameskip = 0;
+    emu->frame_deadline = 0.0;
 }
 
 void fgb_emu_set_log_level(fgb_emu* emu, int level) {
@@ -95,6 +149,65 @@ void fgb_emu_set_log_level(fgb_emu* emu, int level) {
     ulog_set_level(level);
 }
 
+void fgb_emu_set_frameskip(fgb_emu* emu, int frameskip) {
+    emu->frameskip = frameskip == FGB_FRAMESKIP_AUTO ? frameskip : max(frameskip, 0);
+    emu->frames_until_drawn = 0;
+    emu->auto_frameskip = 0;
+    emu->frame_deadline = 0.0;
+}
+
+void fgb_emu_run_frame(fgb_emu* emu) {
+    const int skip = emu->frameskip == FGB_FRAMESKIP_AUTO ? fgb_emu_adapt_frameskip(emu) : emu->frameskip;
+
+    emu->frames_until_drawn = min(emu->frames_until_drawn, skip);
+    fgb_ppu_set_frame_skip(emu->ppu, emu->frames_until_drawn > 0);
+    emu->frames_until_drawn = emu->frames_until_drawn > 0 ? emu->frames_until_drawn - 1 : skip;
+
+    fgb_cpu_run_frame(emu->cpu);
+}
+
+// Skips one more frame whenever the emulator falls more than a frame behind real time,
+// and one less once it has caught up again
+int fgb_emu_adapt_frameskip(fgb_emu* emu) {
+    const double frame_time = 1.0 / FGB_SCREEN_REFRESH_RATE;
+    const double now = fgb_emu_host_time();
+    const double lag = now - emu->frame_deadline;
+
+    if (emu->frame_deadline == 0.0 || lag > FGB_FRAMESKIP_MAX_LAG || lag < -frame_time) {
+        // First frame, too far behind to ever catch up, or ahead because the caller waits between frames
+        emu->frame_deadline = now;
+    } else if (lag > frame_time) {
+        emu->auto_frameskip = min(emu->auto_frameskip + 1, FGB_FRAMESKIP_MAX);
+    } else if (lag <= 0.0) {
+        emu->auto_frameskip = max(emu->auto_frameskip - 1, 0);
+    }
+
+    emu->frame_deadline += frame_time;
+    return emu->auto_frameskip;
+}
+
+// Monotonic, so wall clock adjustments don't show up as lag
+#if defined(_WIN32)
+double fgb_emu_host_time(void) {
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (!QueryPerformanceFrequency(&frequency) || !QueryPerformanceCounter(&counter)) {
+        return 0.0;
+    }
+
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+#else
+double fgb_emu_host_time(void) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return 0.0;
+    }
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+#endif
+
 void fgb_emu_press_button(fgb_emu* emu, enum fgb_button button) {
     fgb_io_press_button(&emu->cpu->io, button);
 }
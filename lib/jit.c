@@ -0,0 +1,1257 @@
+#if defined(__linux__)
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS
+#endif
+
+#include "jit.h"
+#include "cpu.h"
+#include "instruction.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ulog.h>
+
+#if defined(__linux__) && defined(__x86_64__)
+#define FGB_JIT_X86_64
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+#define FGB_JIT_MAX_HOST_INSTRUCTION    1024 // Upper bound of host code emitted per guest instruction
+#define FGB_JIT_MAX_HOST_BLOCK          (32 * 1024) // Including the out of line stubs
+
+static uint16_t fgb_jit_instruction_length(uint8_t opcode);
+
+#ifdef FGB_JIT_X86_64
+static void* fgb_jit_translate(fgb_jit* jit, uint16_t pc, uint16_t region_end);
+#endif
+
+
+bool fgb_jit_is_supported(void) {
+#ifdef FGB_JIT_X86_64
+    return true;
+#else
+    return false;
+#endif
+}
+
+fgb_jit* fgb_jit_create(struct fgb_cpu* cpu) {
+#ifdef FGB_JIT_X86_64
+    fgb_jit* jit = malloc(sizeof(fgb_jit));
+    if (!jit) {
+        log_error("Failed to allocate JIT");
+        return NULL;
+    }
+
+    memset(jit, 0, sizeof(fgb_jit));
+    jit->cpu = cpu;
+
+    // Pages are only made executable once a block has been written to them, see fgb_jit_translate
+    void* code = mmap(NULL, FGB_JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        log_error("Failed to allocate JIT code buffer");
+        free(jit);
+        return NULL;
+    }
+
+    jit->code = code;
+
+    return jit;
+#else
+    (void)cpu;
+    log_warn("JIT is not supported on this platform");
+    return NULL;
+#endif
+}
+
+void fgb_jit_destroy(fgb_jit* jit) {
+    if (!jit) {
+        return;
+    }
+
+#ifdef FGB_JIT_X86_64
+    munmap(jit->code, FGB_JIT_CODE_SIZE);
+#endif
+
+    fgb_code_table_destroy(&jit->blocks);
+    free(jit);
+}
+
+void fgb_jit_flush(fgb_jit* jit) {
+    fgb_code_table_clear(&jit->blocks);
+
+    jit->code_used = 0;
+    jit->exit_block = true;
+}
+
+bool fgb_jit_run(fgb_jit* jit, bool single_step) {
+#ifdef FGB_JIT_X86_64
+    const uint16_t pc = jit->cpu->regs.pc;
+
+    uint16_t region_end;
+    void** slot = fgb_code_table_lookup(&jit->blocks, jit->cpu, pc, &region_end);
+    if (!slot) {
+        return false;
+    }
+
+    if (!*slot) {
+        if (FGB_JIT_CODE_SIZE - jit->code_used < FGB_JIT_MAX_HOST_BLOCK) {
+            // Slots stay valid, flushing only clears the tables
+            fgb_jit_flush(jit);
+        }
+
+        *slot = fgb_jit_translate(jit, pc, region_end);
+        if (!*slot) {
+            return false;
+        }
+    }
+
+    jit->exit_block = single_step;
+    ((fgb_jit_block)*slot)(jit->cpu);
+
+    return true;
+#else
+    (void)jit;
+    (void)single_step;
+    return false;
+#endif
+}
+
+void fgb_jit_notify_write(fgb_jit* jit, uint16_t addr) {
+    switch (fgb_code_table_classify_write(&jit->blocks, &addr)) {
+    case CODE_WRITE_BANK:
+        jit->exit_block = true;
+        break;
+    case CODE_WRITE_CODE:
+        // Self-modifying code or code copied to RAM being replaced
+        fgb_code_table_clear_ram(&jit->blocks);
+        jit->exit_block = true;
+        break;
+    default:
+        break;
+    }
+}
+
+uint16_t fgb_jit_instruction_length(uint8_t opcode) {
+    return 1 + fgb_instruction_get(opcode)->operand_size;
+}
+
+#ifdef FGB_JIT_X86_64
+
+// All guest state is accessed relative to rbx, which holds the fgb_cpu pointer.
+// r12 holds the cycles left until the next scheduler deadline or the end of the frame,
+// r13 the address (and value) of the memory access in progress.
+#define CPU_OFFSET(MEMBER)      ((int32_t)offsetof(fgb_cpu, MEMBER))
+
+#define FGB_JIT_MAX_STUBS               256
+#define FGB_JIT_MAX_STUB_SIZE           256 // Upper bound of host code per out of line stub
+#define FGB_JIT_CHAIN_ENTRY             78 // Size of the block prologue, skipped by chained blocks
+#define FGB_JIT_MAX_INSTRUCTION_STUBS   16 // Upper bound of stubs per guest instruction
+#define FGB_JIT_LAZY_UNKNOWN    -1
+
+_Static_assert(sizeof(enum fgb_cpu_mode) == 4, "CPU mode is compared as a dword");
+_Static_assert(sizeof(((fgb_cpu*)0)->lazy_flags) == 4, "Lazy flags are written as a dword");
+
+// 8-bit registers in the order of the opcode's register fields, (HL) goes through memory
+static const int32_t reg_offsets[8] = {
+    CPU_OFFSET(regs.b), CPU_OFFSET(regs.c), CPU_OFFSET(regs.d), CPU_OFFSET(regs.e),
+    CPU_OFFSET(regs.h), CPU_OFFSET(regs.l), -1, CPU_OFFSET(regs.a),
+};
+
+// BC, DE, HL, SP as selected by bits 4-5 of the opcode
+static const int32_t pair_offsets[4] = {
+    CPU_OFFSET(regs.bc), CPU_OFFSET(regs.de), CPU_OFFSET(regs.hl), CPU_OFFSET(regs.sp),
+};
+
+typedef enum fgb_jit_stub_kind {
+    STUB_EXIT, // Writes back the pending cycles, then leaves the block
+    STUB_BRANCH, // Same as STUB_EXIT, but continues in the block at the PC if possible
+    STUB_SYNC, // Runs the peripherals that are due, then resumes
+    STUB_NOTIFY, // Reports a write to memory that blocks were translated from, then resumes
+} fgb_jit_stub_kind;
+
+// Rarely taken paths, emitted after the block so the common path runs straight through
+typedef struct fgb_jit_stub {
+    fgb_jit_stub_kind kind;
+    uint8_t* site; // rel32 of the jump to the stub
+    uint8_t* resume;
+    int32_t pc; // PC to leave the block with, or -1 if it is already stored
+    uint32_t pending;
+} fgb_jit_stub;
+
+typedef struct fgb_jit_emitter {
+    uint8_t* ptr;
+    fgb_jit* jit;
+    bool paged; // Memory can be accessed through the MMU page tables
+    uint16_t next_pc; // PC after the current instruction
+    bool popping_pc; // regs.pc already holds part of the return address
+    uint32_t pending; // Cycles not yet added to total_cycles and cycles_this_frame
+    int lazy_op; // Operation in lazy_flags at this point, or FGB_JIT_LAZY_UNKNOWN
+    bool called; // The current instruction called back into the emulator
+    fgb_jit_stub stubs[FGB_JIT_MAX_STUBS];
+    int stub_count;
+} fgb_jit_emitter;
+
+static void emit8(fgb_jit_emitter* e, uint8_t value) {
+    *e->ptr++ = value;
+}
+
+static void emit16(fgb_jit_emitter* e, uint16_t value) {
+    memcpy(e->ptr, &value, sizeof(value));
+    e->ptr += sizeof(value);
+}
+
+static void emit32(fgb_jit_emitter* e, uint32_t value) {
+    memcpy(e->ptr, &value, sizeof(value));
+    e->ptr += sizeof(value);
+}
+
+static void emit64(fgb_jit_emitter* e, uint64_t value) {
+    memcpy(e->ptr, &value, sizeof(value));
+    e->ptr += sizeof(value);
+}
+
+// <opcode> [rbx + disp32] with the given ModRM reg field
+static void emit_rbx_mem(fgb_jit_emitter* e, uint8_t opcode, uint8_t reg, int32_t disp) {
+    emit8(e, opcode);
+    emit8(e, 0x83 | (reg << 3)); // mod=10, rm=rbx
+    emit32(e, (uint32_t)disp);
+}
+
+// Emits a short jump and returns the location of its displacement
+static uint8_t* emit_jcc8(fgb_jit_emitter* e, uint8_t opcode) {
+    emit8(e, opcode);
+    emit8(e, 0);
+    return e->ptr - 1;
+}
+
+static void patch_jcc8(const fgb_jit_emitter* e, uint8_t* disp) {
+    *disp = (uint8_t)(e->ptr - (disp + 1));
+}
+
+// Near form of the short jump opcode (0x7X, or 0xEB for jmp)
+static uint8_t* emit_jcc32(fgb_jit_emitter* e, uint8_t opcode) {
+    if (opcode == 0xEB) {
+        emit8(e, 0xE9);
+    }
+    else {
+        emit8(e, 0x0F);
+        emit8(e, opcode + 0x10);
+    }
+
+    emit32(e, 0);
+    return e->ptr - 4;
+}
+
+static void patch_rel32(uint8_t* disp, const uint8_t* target) {
+    const int32_t rel = (int32_t)(target - (disp + 4));
+    memcpy(disp, &rel, sizeof(rel));
+}
+
+static void emit_call(fgb_jit_emitter* e, const void* function) {
+    emit8(e, 0x48); emit8(e, 0x89); emit8(e, 0xDF); // mov rdi, rbx
+    emit8(e, 0x48); emit8(e, 0xB8); emit64(e, (uint64_t)(uintptr_t)function); // mov rax, imm64
+    emit8(e, 0xFF); emit8(e, 0xD0); // call rax
+}
+
+static void emit_stub(fgb_jit_emitter* e, uint8_t opcode, fgb_jit_stub_kind kind, int32_t pc) {
+    assert(e->stub_count < FGB_JIT_MAX_STUBS);
+    fgb_jit_stub* stub = &e->stubs[e->stub_count++];
+    stub->kind = kind;
+    stub->site = emit_jcc32(e, opcode);
+    stub->resume = e->ptr;
+    stub->pc = pc;
+    stub->pending = e->pending;
+}
+
+static void emit_epilogue(fgb_jit_emitter* e) {
+    emit8(e, 0x41); emit8(e, 0x5D); // pop r13
+    emit8(e, 0x41); emit8(e, 0x5C); // pop r12
+    emit8(e, 0x5B); // pop rbx
+    emit8(e, 0xC3); // ret
+}
+
+// r12 = cycles until min(scheduler.next, end of frame), 0 if already reached
+static void emit_reload_budget(fgb_jit_emitter* e) {
+    emit_rbx_mem(e, 0x8B, 0, CPU_OFFSET(cycles_this_frame)); // mov eax, [cycles_this_frame]
+    emit8(e, 0x48); emit_rbx_mem(e, 0x8B, 1, CPU_OFFSET(total_cycles)); // mov rcx, [total_cycles]
+    emit8(e, 0x48); emit8(e, 0x89); emit8(e, 0xCA); // mov rdx, rcx
+    emit8(e, 0x48); emit8(e, 0x29); emit8(e, 0xC2); // sub rdx, rax
+    emit8(e, 0x48); emit8(e, 0x81); emit8(e, 0xC2); emit32(e, FGB_CYCLES_PER_FRAME); // add rdx, imm32
+    emit8(e, 0x48); emit_rbx_mem(e, 0x8B, 0, CPU_OFFSET(scheduler.next)); // mov rax, [scheduler.next]
+    emit8(e, 0x48); emit8(e, 0x39); emit8(e, 0xD0); // cmp rax, rdx
+    emit8(e, 0x48); emit8(e, 0x0F); emit8(e, 0x47); emit8(e, 0xC2); // cmova rax, rdx
+    emit8(e, 0x31); emit8(e, 0xD2); // xor edx, edx
+    emit8(e, 0x48); emit8(e, 0x29); emit8(e, 0xC8); // sub rax, rcx
+    emit8(e, 0x48); emit8(e, 0x0F); emit8(e, 0x42); emit8(e, 0xC2); // cmovb rax, rdx
+    emit8(e, 0x49); emit8(e, 0x89); emit8(e, 0xC4); // mov r12, rax
+}
+
+// Adds the pending cycles to the counters
+static void emit_write_back(fgb_jit_emitter* e, uint32_t cycles) {
+    emit8(e, 0x48); emit_rbx_mem(e, 0x81, 0, CPU_OFFSET(total_cycles)); emit32(e, cycles); // add qword [total_cycles], imm32
+    emit_rbx_mem(e, 0x81, 0, CPU_OFFSET(cycles_this_frame)); emit32(e, cycles); // add dword [cycles_this_frame], imm32
+}
+
+// Same as fgb_cpu_advance with the pending cycles, required before anything that depends on the time
+static void emit_flush(fgb_jit_emitter* e) {
+    if (e->pending == 0) {
+        return;
+    }
+
+    emit_write_back(e, e->pending);
+    emit8(e, 0x49); emit8(e, 0x81); emit8(e, 0xEC); emit32(e, e->pending); // sub r12, imm32
+    e->pending = 0;
+    emit_stub(e, 0x76, STUB_SYNC, -1); // jbe
+}
+
+// Leaves the block, the pending cycles may have reached the next deadline
+static void emit_exit(fgb_jit_emitter* e, int32_t pc, uint32_t pending) {
+    if (pending != 0) {
+        emit_write_back(e, pending);
+        emit8(e, 0x49); emit8(e, 0x81); emit8(e, 0xFC); emit32(e, pending); // cmp r12, imm32
+        uint8_t* skip = emit_jcc8(e, 0x77); // ja
+        emit_call(e, (const void*)fgb_cpu_sync_due);
+        patch_jcc8(e, skip);
+    }
+
+    if (pc >= 0) {
+        emit8(e, 0x66); emit_rbx_mem(e, 0xC7, 0, CPU_OFFSET(regs.pc)); emit16(e, (uint16_t)pc); // mov word [pc], imm16
+    }
+
+    emit_epilogue(e);
+}
+
+// Block at the given PC which the current block may jump to directly, or NULL.
+// Its ROM bank or WRAM page must still be mapped when the jump is taken.
+static void** chain_slot(const fgb_jit_emitter* e, uint16_t pc, const uint8_t** page) {
+    const fgb_cpu* cpu = e->jit->cpu;
+
+    if (!e->paged) {
+        return NULL;
+    }
+
+    *page = cpu->mmu.read_pages[pc >> 8];
+    if (!*page) {
+        return NULL;
+    }
+
+    uint16_t region_end;
+    return fgb_code_table_lookup(&e->jit->blocks, cpu, pc, &region_end);
+}
+
+// Jumps straight into the block at pc if it is translated and the CPU would keep
+// running instructions back to back, otherwise leaves like emit_exit
+static void emit_continue(fgb_jit_emitter* e, uint16_t pc, uint32_t pending) {
+    const uint8_t* page;
+    void** slot = chain_slot(e, pc, &page);
+
+    if (slot) {
+        uint8_t* exits[6];
+
+        emit8(e, 0x49); emit8(e, 0x81); emit8(e, 0xFC); emit32(e, pending); // cmp r12, imm32
+        exits[0] = emit_jcc32(e, 0x76); // jbe
+
+        emit8(e, 0x48); emit8(e, 0xB8); emit64(e, (uint64_t)(uintptr_t)&e->jit->exit_block); // mov rax, &exit_block
+        emit8(e, 0x80); emit8(e, 0x38); emit8(e, 0x00); // cmp byte [rax], 0
+        exits[1] = emit_jcc32(e, 0x75); // jne
+
+        emit_rbx_mem(e, 0x83, 7, CPU_OFFSET(mode)); emit8(e, CPU_MODE_NORMAL); // cmp dword [mode], CPU_MODE_NORMAL
+        exits[2] = emit_jcc32(e, 0x75); // jne
+
+        emit_rbx_mem(e, 0x80, 7, CPU_OFFSET(ime)); emit8(e, 0); // cmp byte [ime], 0
+        uint8_t* no_irq = emit_jcc8(e, 0x74); // je
+        emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 0, CPU_OFFSET(interrupt.enable)); // movzx eax, byte [interrupt.enable]
+        emit_rbx_mem(e, 0x22, 0, CPU_OFFSET(interrupt.flags)); // and al, [interrupt.flags]
+        emit8(e, 0xA8); emit8(e, IRQ_MASK); // test al, IRQ_MASK
+        exits[3] = emit_jcc32(e, 0x75); // jnz
+        patch_jcc8(e, no_irq);
+
+        // The page table entry only matches while the same bank is mapped
+        emit8(e, 0x48); emit8(e, 0xB8); emit64(e, (uint64_t)(uintptr_t)page); // mov rax, imm64
+        emit8(e, 0x48); emit_rbx_mem(e, 0x39, 0, CPU_OFFSET(mmu.read_pages) + (pc >> 8) * 8); // cmp [read_pages + page], rax
+        exits[4] = emit_jcc32(e, 0x75); // jne
+
+        emit8(e, 0x48); emit8(e, 0xB8); emit64(e, (uint64_t)(uintptr_t)slot); // mov rax, slot
+        emit8(e, 0x48); emit8(e, 0x8B); emit8(e, 0x00); // mov rax, [rax]
+        emit8(e, 0x48); emit8(e, 0x85); emit8(e, 0xC0); // test rax, rax
+        exits[5] = emit_jcc32(e, 0x74); // jz
+
+        if (pending != 0) {
+            emit_write_back(e, pending);
+            emit8(e, 0x49); emit8(e, 0x81); emit8(e, 0xEC); emit32(e, pending); // sub r12, imm32
+        }
+        emit8(e, 0x48); emit8(e, 0x83); emit8(e, 0xC0); emit8(e, FGB_JIT_CHAIN_ENTRY); // add rax, FGB_JIT_CHAIN_ENTRY
+        emit8(e, 0xFF); emit8(e, 0xE0); // jmp rax
+
+        for (int i = 0; i < 6; i++) {
+            patch_rel32(exits[i], e->ptr);
+        }
+    }
+
+    emit_exit(e, pc, pending);
+}
+
+// Calls back into the emulator, which expects the counters to be up to date and may move the deadlines
+static void emit_callback(fgb_jit_emitter* e, const void* function) {
+    emit_call(e, function);
+    emit_reload_budget(e);
+    e->called = true;
+}
+
+// Leaves the block whenever fgb_cpu_run_frame would stop running instructions back to back.
+// Only callbacks can change the CPU mode, interrupts or exit_block.
+static void emit_boundary(fgb_jit_emitter* e, int32_t next_pc) {
+    if (e->called) {
+        emit_rbx_mem(e, 0x83, 7, CPU_OFFSET(mode)); emit8(e, CPU_MODE_NORMAL); // cmp dword [mode], CPU_MODE_NORMAL
+        emit_stub(e, 0x75, STUB_EXIT, next_pc); // jne
+
+        emit8(e, 0x48); emit8(e, 0xB8); emit64(e, (uint64_t)(uintptr_t)&e->jit->exit_block); // mov rax, &exit_block
+        emit8(e, 0x80); emit8(e, 0x38); emit8(e, 0x00); // cmp byte [rax], 0
+        emit_stub(e, 0x75, STUB_EXIT, next_pc); // jne
+
+        emit_rbx_mem(e, 0x80, 7, CPU_OFFSET(ime)); emit8(e, 0); // cmp byte [ime], 0
+        uint8_t* no_irq = emit_jcc8(e, 0x74); // je
+        emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 0, CPU_OFFSET(interrupt.enable)); // movzx eax, byte [interrupt.enable]
+        emit_rbx_mem(e, 0x22, 0, CPU_OFFSET(interrupt.flags)); // and al, [interrupt.flags]
+        emit8(e, 0xA8); emit8(e, IRQ_MASK); // test al, IRQ_MASK
+        emit_stub(e, 0x75, STUB_EXIT, next_pc); // jnz
+        patch_jcc8(e, no_irq);
+    }
+
+    // Also catches the end of the frame
+    emit8(e, 0x49); emit8(e, 0x81); emit8(e, 0xFC); emit32(e, e->pending); // cmp r12, imm32
+    emit_stub(e, 0x76, STUB_EXIT, next_pc); // jbe
+}
+
+static void emit_stubs(fgb_jit_emitter* e) {
+    for (int i = 0; i < e->stub_count; i++) {
+        const fgb_jit_stub* stub = &e->stubs[i];
+        patch_rel32(stub->site, e->ptr);
+
+        switch (stub->kind) {
+        case STUB_EXIT:
+            emit_exit(e, stub->pc, stub->pending);
+            break;
+
+        case STUB_BRANCH:
+            emit_continue(e, (uint16_t)stub->pc, stub->pending);
+            break;
+
+        case STUB_SYNC: {
+            emit_call(e, (const void*)fgb_cpu_sync_due);
+            emit_reload_budget(e);
+
+            // Peripherals may have requested an interrupt, leave at the next instruction boundary
+            emit_rbx_mem(e, 0x80, 7, CPU_OFFSET(ime)); emit8(e, 0); // cmp byte [ime], 0
+            patch_rel32(emit_jcc32(e, 0x74), stub->resume); // je
+            emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 0, CPU_OFFSET(interrupt.enable)); // movzx eax, byte [interrupt.enable]
+            emit_rbx_mem(e, 0x22, 0, CPU_OFFSET(interrupt.flags)); // and al, [interrupt.flags]
+            emit8(e, 0xA8); emit8(e, IRQ_MASK); // test al, IRQ_MASK
+            patch_rel32(emit_jcc32(e, 0x74), stub->resume); // jz
+            emit8(e, 0x45); emit8(e, 0x31); emit8(e, 0xE4); // xor r12d, r12d
+            patch_rel32(emit_jcc32(e, 0xEB), stub->resume);
+        } break;
+
+        case STUB_NOTIFY:
+            emit8(e, 0x48); emit8(e, 0xBF); emit64(e, (uint64_t)(uintptr_t)e->jit); // mov rdi, jit
+            emit8(e, 0x41); emit8(e, 0x0F); emit8(e, 0xB7); emit8(e, 0xF5); // movzx esi, r13w
+            emit8(e, 0x48); emit8(e, 0xB8); emit64(e, (uint64_t)(uintptr_t)fgb_jit_notify_write); // mov rax, imm64
+            emit8(e, 0xFF); emit8(e, 0xD0); // call rax
+            patch_rel32(emit_jcc32(e, 0xEB), stub->resume);
+            break;
+        }
+    }
+}
+
+// Handlers of I/O registers and MBCs see the PC the interpreter would have at this point
+static void emit_store_pc(fgb_jit_emitter* e) {
+    if (e->popping_pc) {
+        return;
+    }
+
+    emit8(e, 0x66); emit_rbx_mem(e, 0xC7, 0, CPU_OFFSET(regs.pc)); emit16(e, e->next_pc); // mov word [pc], imm16
+}
+
+// r13d = 16-bit register pair
+static void emit_load_address(fgb_jit_emitter* e, int32_t pair) {
+    emit8(e, 0x44); emit8(e, 0x0F); emit_rbx_mem(e, 0xB7, 5, pair); // movzx r13d, word [pair]
+}
+
+static void emit_load_address_imm(fgb_jit_emitter* e, uint32_t addr) {
+    emit8(e, 0x41); emit8(e, 0xBD); emit32(e, addr); // mov r13d, imm32
+}
+
+// Puts the 8-bit register in bits 16-23 of r13d, next to the address
+static void emit_load_value(fgb_jit_emitter* e, int32_t reg) {
+    emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 0, reg); // movzx eax, byte [reg]
+    emit8(e, 0xC1); emit8(e, 0xE0); emit8(e, 0x10); // shl eax, 16
+    emit8(e, 0x41); emit8(e, 0x09); emit8(e, 0xC5); // or r13d, eax
+}
+
+static void emit_load_value_imm(fgb_jit_emitter* e, uint8_t value) {
+    emit8(e, 0x41); emit8(e, 0x81); emit8(e, 0xCD); emit32(e, (uint32_t)value << 16); // or r13d, imm32
+}
+
+// Host location of WRAM and HRAM addresses whose mapping never changes, or -1
+static int32_t fixed_ram_offset(const fgb_jit_emitter* e, uint16_t addr) {
+    const fgb_cpu* cpu = e->jit->cpu;
+
+    if (!e->paged) {
+        return -1;
+    }
+
+    if (addr >= 0xC000 && (addr < 0xD000 || (addr < 0xE000 && cpu->model != FGB_MODEL_CGB))) {
+        return CPU_OFFSET(mmu.wram) + (addr - 0xC000); // Bank 1 is always mapped on the DMG
+    }
+
+    if (addr >= 0xFF80 && addr < 0xFFFF) {
+        return CPU_OFFSET(mmu.hram) + (addr - 0xFF80);
+    }
+
+    return -1;
+}
+
+// Reads the byte at r13w into r13d, after e->pending cycles of the instruction.
+// ROM and WRAM are read through the page tables, everything else goes through
+// fgb_cpu_finish_read, which syncs the peripheral behind the address first.
+static void emit_read(fgb_jit_emitter* e) {
+    e->pending += 3;
+    const uint32_t pending = e->pending;
+
+    emit8(e, 0x44); emit8(e, 0x89); emit8(e, 0xE8); // mov eax, r13d
+    emit8(e, 0xC1); emit8(e, 0xE8); emit8(e, 0x08); // shr eax, 8
+    emit8(e, 0x3D); emit32(e, 0x80); // cmp eax, 0x80
+    uint8_t* rom = emit_jcc8(e, 0x72); // jb
+    emit8(e, 0x8D); emit8(e, 0x88); emit32(e, (uint32_t)-0xC0); // lea ecx, [rax - 0xC0]
+    emit8(e, 0x83); emit8(e, 0xF9); emit8(e, 0x3E); // cmp ecx, 0x3E
+    uint8_t* slow = emit_jcc32(e, 0x73); // jae
+    patch_jcc8(e, rom);
+
+    emit8(e, 0x48); emit8(e, 0x8B); emit8(e, 0x84); emit8(e, 0xC3); emit32(e, (uint32_t)CPU_OFFSET(mmu.read_pages)); // mov rax, [rbx + rax*8 + read_pages]
+    emit8(e, 0x48); emit8(e, 0x85); emit8(e, 0xC0); // test rax, rax
+    uint8_t* unmapped = emit_jcc32(e, 0x74); // jz
+    emit8(e, 0x41); emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0xCD); // movzx ecx, r13b
+    emit8(e, 0x44); emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0x2C); emit8(e, 0x08); // movzx r13d, byte [rax + rcx]
+    e->pending += 1;
+    emit_flush(e);
+    uint8_t* done = emit_jcc32(e, 0xEB); // jmp
+
+    patch_rel32(slow, e->ptr);
+    patch_rel32(unmapped, e->ptr);
+    e->pending = pending;
+    emit_flush(e);
+    emit_store_pc(e);
+    emit8(e, 0x41); emit8(e, 0x0F); emit8(e, 0xB7); emit8(e, 0xF5); // movzx esi, r13w
+    emit_call(e, (const void*)fgb_cpu_finish_read);
+    emit8(e, 0x44); emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0xE8); // movzx r13d, al
+    emit_reload_budget(e);
+    e->called = true;
+
+    patch_rel32(done, e->ptr);
+}
+
+static void emit_read_imm(fgb_jit_emitter* e, uint16_t addr) {
+    const int32_t offset = fixed_ram_offset(e, addr);
+    if (offset < 0) {
+        emit_load_address_imm(e, addr);
+        emit_read(e);
+        return;
+    }
+
+    // Nothing but the CPU accesses this memory, so the peripherals can catch up later
+    e->pending += 4;
+    emit8(e, 0x44); emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 5, offset); // movzx r13d, byte [offset]
+}
+
+// Drops blocks translated from the address in r13w. The bitmap is clear for almost all of RAM.
+static void emit_check_ram_code(fgb_jit_emitter* e) {
+    emit8(e, 0x41); emit8(e, 0x0F); emit8(e, 0xB7); emit8(e, 0xC5); // movzx eax, r13w
+    emit8(e, 0x89); emit8(e, 0xC1); // mov ecx, eax
+    emit8(e, 0xC1); emit8(e, 0xE8); emit8(e, 0x03); // shr eax, 3
+    emit8(e, 0x83); emit8(e, 0xE1); emit8(e, 0x07); // and ecx, 7
+    emit8(e, 0x48); emit8(e, 0xBA); emit64(e, (uint64_t)(uintptr_t)e->jit->blocks.ram_code); // mov rdx, ram_code
+    emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0x04); emit8(e, 0x02); // movzx eax, byte [rdx + rax]
+    emit8(e, 0x0F); emit8(e, 0xA3); emit8(e, 0xC8); // bt eax, ecx
+    emit_stub(e, 0x72, STUB_NOTIFY, -1); // jc
+    e->called = true; // exit_block may be set
+}
+
+// Writes bits 16-23 of r13d to the address in r13w, after e->pending cycles of the instruction.
+// Only WRAM is written through the page tables, pages protected during OAM DMA and everything
+// else go through fgb_cpu_finish_write.
+static void emit_write(fgb_jit_emitter* e) {
+    // The page may only become protected on this M-cycle, so catch up first
+    e->pending += 3;
+    emit_flush(e);
+
+    emit8(e, 0x44); emit8(e, 0x89); emit8(e, 0xE8); // mov eax, r13d
+    emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0xC4); // movzx eax, ah
+    emit8(e, 0x3D); emit32(e, 0xC0); // cmp eax, 0xC0
+    uint8_t* below = emit_jcc32(e, 0x72); // jb
+    emit8(e, 0x3D); emit32(e, 0xE0); // cmp eax, 0xE0
+    uint8_t* above = emit_jcc32(e, 0x73); // jae
+
+    emit8(e, 0x48); emit8(e, 0x8B); emit8(e, 0x84); emit8(e, 0xC3); emit32(e, (uint32_t)CPU_OFFSET(mmu.write_pages)); // mov rax, [rbx + rax*8 + write_pages]
+    emit8(e, 0x48); emit8(e, 0x85); emit8(e, 0xC0); // test rax, rax
+    uint8_t* unmapped = emit_jcc32(e, 0x74); // jz
+    emit8(e, 0x41); emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0xCD); // movzx ecx, r13b
+    emit8(e, 0x44); emit8(e, 0x89); emit8(e, 0xEA); // mov edx, r13d
+    emit8(e, 0xC1); emit8(e, 0xEA); emit8(e, 0x10); // shr edx, 16
+    emit8(e, 0x88); emit8(e, 0x14); emit8(e, 0x08); // mov [rax + rcx], dl
+    emit_check_ram_code(e);
+    e->pending = 1;
+    emit_flush(e);
+    uint8_t* done = emit_jcc32(e, 0xEB); // jmp
+
+    patch_rel32(below, e->ptr);
+    patch_rel32(above, e->ptr);
+    patch_rel32(unmapped, e->ptr);
+    emit_store_pc(e);
+    emit8(e, 0x41); emit8(e, 0x0F); emit8(e, 0xB7); emit8(e, 0xF5); // movzx esi, r13w
+    emit8(e, 0x44); emit8(e, 0x89); emit8(e, 0xEA); // mov edx, r13d
+    emit8(e, 0xC1); emit8(e, 0xEA); emit8(e, 0x10); // shr edx, 16
+    emit_callback(e, (const void*)fgb_cpu_finish_write);
+
+    patch_rel32(done, e->ptr);
+}
+
+// Writes the 8-bit register to a fixed address
+static void emit_write_imm(fgb_jit_emitter* e, uint16_t addr, int32_t reg) {
+    const int32_t offset = fixed_ram_offset(e, addr);
+    if (offset < 0 || addr < 0xFF80) {
+        emit_load_address_imm(e, addr);
+        emit_load_value(e, reg);
+        emit_write(e);
+        return;
+    }
+
+    // HRAM, which is never the source of an OAM DMA
+    e->pending += 4;
+    emit_rbx_mem(e, 0x8A, 0, reg); // mov al, [reg]
+    emit_rbx_mem(e, 0x88, 0, offset); // mov [offset], al
+    emit_load_address_imm(e, addr);
+    emit_check_ram_code(e);
+}
+
+// Pushes a register pair, or a constant if pair is -1
+static void emit_push(fgb_jit_emitter* e, int32_t pair, uint16_t value) {
+    for (int i = 1; i >= 0; i--) {
+        emit8(e, 0x66); emit_rbx_mem(e, 0xFF, 1, CPU_OFFSET(regs.sp)); // dec word [sp]
+        emit_load_address(e, CPU_OFFSET(regs.sp));
+        if (pair < 0) {
+            emit_load_value_imm(e, (uint8_t)(value >> (i * 8)));
+        }
+        else {
+            emit_load_value(e, pair + i);
+        }
+        emit_write(e);
+    }
+}
+
+// Pops into a register pair
+static void emit_pop(fgb_jit_emitter* e, int32_t pair) {
+    e->popping_pc = pair == CPU_OFFSET(regs.pc);
+
+    for (int i = 0; i < 2; i++) {
+        emit_load_address(e, CPU_OFFSET(regs.sp));
+        emit8(e, 0x66); emit_rbx_mem(e, 0xFF, 0, CPU_OFFSET(regs.sp)); // inc word [sp]
+        emit_read(e);
+        emit8(e, 0x44); emit8(e, 0x89); emit8(e, 0xE8); // mov eax, r13d
+        emit_rbx_mem(e, 0x88, 0, pair + i); // mov [pair + i], al
+    }
+
+    e->popping_pc = false;
+}
+
+// edx = C flag
+static void emit_carry_add(fgb_jit_emitter* e) {
+    emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 1, CPU_OFFSET(lazy_flags.y)); // movzx ecx, byte [y]
+    emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 2, CPU_OFFSET(lazy_flags.carry)); // movzx edx, byte [carry]
+    emit8(e, 0x01); emit8(e, 0xD1); // add ecx, edx
+    emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 2, CPU_OFFSET(lazy_flags.x)); // movzx edx, byte [x]
+    emit8(e, 0x01); emit8(e, 0xD1); // add ecx, edx
+    emit8(e, 0x81); emit8(e, 0xF9); emit32(e, 0xFF); // cmp ecx, 0xFF
+    emit8(e, 0x0F); emit8(e, 0x97); emit8(e, 0xC2); // seta dl
+    emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0xD2); // movzx edx, dl
+}
+
+static void emit_carry_sub(fgb_jit_emitter* e) {
+    emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 1, CPU_OFFSET(lazy_flags.y)); // movzx ecx, byte [y]
+    emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 2, CPU_OFFSET(lazy_flags.carry)); // movzx edx, byte [carry]
+    emit8(e, 0x01); emit8(e, 0xD1); // add ecx, edx
+    emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 2, CPU_OFFSET(lazy_flags.x)); // movzx edx, byte [x]
+    emit8(e, 0x39); emit8(e, 0xD1); // cmp ecx, edx
+    emit8(e, 0x0F); emit8(e, 0x97); emit8(e, 0xC2); // seta dl
+    emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0xD2); // movzx edx, dl
+}
+
+static void emit_carry_none(fgb_jit_emitter* e) {
+    emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 2, CPU_OFFSET(regs.f)); // movzx edx, byte [f]
+    emit8(e, 0xC1); emit8(e, 0xEA); emit8(e, 0x04); // shr edx, 4
+    emit8(e, 0x83); emit8(e, 0xE2); emit8(e, 0x01); // and edx, 1
+}
+
+// Same as fgb_cpu_carry, specialized when the ALU operation in lazy_flags is known
+static void emit_carry(fgb_jit_emitter* e) {
+    switch (e->lazy_op) {
+    case LAZY_OP_NONE:
+        emit_carry_none(e);
+        return;
+    case LAZY_OP_ADD:
+        emit_carry_add(e);
+        return;
+    case LAZY_OP_SUB:
+        emit_carry_sub(e);
+        return;
+    case LAZY_OP_INC:
+    case LAZY_OP_DEC:
+        emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 2, CPU_OFFSET(lazy_flags.carry)); // movzx edx, byte [carry]
+        return;
+    case LAZY_OP_AND:
+    case LAZY_OP_OR:
+        emit8(e, 0x31); emit8(e, 0xD2); // xor edx, edx
+        return;
+    default:
+        break;
+    }
+
+    uint8_t* done[4];
+
+    emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 0, CPU_OFFSET(lazy_flags.op)); // movzx eax, byte [op]
+    emit8(e, 0x83); emit8(e, 0xF8); emit8(e, LAZY_OP_ADD); // cmp eax, LAZY_OP_ADD
+    uint8_t* not_add = emit_jcc8(e, 0x75); // jne
+    emit_carry_add(e);
+    done[0] = emit_jcc8(e, 0xEB); // jmp
+
+    patch_jcc8(e, not_add);
+    emit8(e, 0x83); emit8(e, 0xF8); emit8(e, LAZY_OP_SUB); // cmp eax, LAZY_OP_SUB
+    uint8_t* not_sub = emit_jcc8(e, 0x75); // jne
+    emit_carry_sub(e);
+    done[1] = emit_jcc8(e, 0xEB); // jmp
+
+    patch_jcc8(e, not_sub);
+    emit8(e, 0x83); emit8(e, 0xF8); emit8(e, LAZY_OP_DEC); // cmp eax, LAZY_OP_DEC
+    uint8_t* logic = emit_jcc8(e, 0x77); // ja
+    emit8(e, 0x85); emit8(e, 0xC0); // test eax, eax
+    uint8_t* none = emit_jcc8(e, 0x74); // jz
+    emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 2, CPU_OFFSET(lazy_flags.carry)); // movzx edx, byte [carry]
+    done[2] = emit_jcc8(e, 0xEB); // jmp
+
+    patch_jcc8(e, logic);
+    emit8(e, 0x31); emit8(e, 0xD2); // xor edx, edx
+    done[3] = emit_jcc8(e, 0xEB); // jmp
+
+    patch_jcc8(e, none);
+    emit_carry_none(e);
+
+    for (int i = 0; i < 4; i++) {
+        patch_jcc8(e, done[i]);
+    }
+}
+
+// edx = Z flag
+static void emit_zero(fgb_jit_emitter* e) {
+    switch (e->lazy_op) {
+    case LAZY_OP_NONE:
+        emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 2, CPU_OFFSET(regs.f)); // movzx edx, byte [f]
+        emit8(e, 0xC1); emit8(e, 0xEA); emit8(e, 0x07); // shr edx, 7
+        return;
+    case LAZY_OP_ADD:
+    case LAZY_OP_SUB: {
+        const uint8_t op = e->lazy_op == LAZY_OP_ADD ? 0x02 : 0x2A; // add / sub al, r/m8
+        emit_rbx_mem(e, 0x8A, 0, CPU_OFFSET(lazy_flags.x)); // mov al, [x]
+        emit_rbx_mem(e, op, 0, CPU_OFFSET(lazy_flags.y)); // op al, [y]
+        emit_rbx_mem(e, op, 0, CPU_OFFSET(lazy_flags.carry)); // op al, [carry]
+    } break;
+    case LAZY_OP_INC:
+    case LAZY_OP_DEC:
+    case LAZY_OP_AND:
+    case LAZY_OP_OR: {
+        const uint8_t result = e->lazy_op == LAZY_OP_INC ? 0xFF : e->lazy_op == LAZY_OP_DEC ? 0x01 : 0x00;
+        emit_rbx_mem(e, 0x80, 7, CPU_OFFSET(lazy_flags.x)); emit8(e, result); // cmp byte [x], imm8
+    } break;
+    default:
+        emit_call(e, (const void*)fgb_cpu_compute_flags);
+        emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0xD0); // movzx edx, al
+        emit8(e, 0xC1); emit8(e, 0xEA); emit8(e, 0x07); // shr edx, 7
+        return;
+    }
+
+    emit8(e, 0x0F); emit8(e, 0x94); emit8(e, 0xC2); // sete dl
+    emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0xD2); // movzx edx, dl
+}
+
+// Evaluates NZ, Z, NC or C (bits 3-4 of the opcode) and leaves the block at not_taken_pc if it is false
+static void emit_condition(fgb_jit_emitter* e, uint8_t opcode, uint16_t not_taken_pc) {
+    const int cc = (opcode >> 3) & 3;
+    if (cc < 2) {
+        emit_zero(e);
+    }
+    else {
+        emit_carry(e);
+    }
+
+    emit8(e, 0x85); emit8(e, 0xD2); // test edx, edx
+    emit_stub(e, (cc & 1) ? 0x74 : 0x75, STUB_BRANCH, not_taken_pc); // je / jne
+}
+
+// Continues at the jump target. Backward jumps are checked for idle loops like fgb_jr_ and fgb_jp_ do.
+static void emit_jump(fgb_jit_emitter* e, uint16_t target, uint16_t end, bool backward) {
+    if (backward) {
+        emit_flush(e);
+        emit8(e, 0x66); emit_rbx_mem(e, 0xC7, 0, CPU_OFFSET(regs.pc)); emit16(e, target); // mov word [pc], imm16
+        emit_rbx_mem(e, 0x80, 7, CPU_OFFSET(idle_loop.enabled)); emit8(e, 0); // cmp byte [idle_loop.enabled], 0
+        uint8_t* disabled = emit_jcc8(e, 0x74); // je
+        emit8(e, 0xBE); emit32(e, target); // mov esi, imm32
+        emit8(e, 0xBA); emit32(e, end); // mov edx, imm32
+        emit_call(e, (const void*)fgb_cpu_check_idle_loop);
+        emit_reload_budget(e); // Skipped iterations advance the clock
+        patch_jcc8(e, disabled);
+    }
+
+    emit_continue(e, target, e->pending);
+}
+
+// Sets lazy_flags to op with x = eax, y = ecx and, for ADC and SBC, carry = edx
+static void emit_set_lazy_flags(fgb_jit_emitter* e, enum fgb_cpu_lazy_op op, bool with_y, bool with_carry) {
+    emit8(e, 0x89); emit8(e, 0xC6); // mov esi, eax
+    emit8(e, 0xC1); emit8(e, 0xE6); emit8(e, 0x08); // shl esi, 8
+    emit8(e, 0x83); emit8(e, 0xCE); emit8(e, (uint8_t)op); // or esi, op
+
+    if (with_y) {
+        emit8(e, 0x89); emit8(e, 0xCF); // mov edi, ecx
+        emit8(e, 0xC1); emit8(e, 0xE7); emit8(e, 0x10); // shl edi, 16
+        emit8(e, 0x09); emit8(e, 0xFE); // or esi, edi
+    }
+
+    if (with_carry) {
+        emit8(e, 0x89); emit8(e, 0xD7); // mov edi, edx
+        emit8(e, 0xC1); emit8(e, 0xE7); emit8(e, 0x18); // shl edi, 24
+        emit8(e, 0x09); emit8(e, 0xFE); // or esi, edi
+    }
+
+    emit_rbx_mem(e, 0x89, 6, CPU_OFFSET(lazy_flags)); // mov [lazy_flags], esi
+    e->lazy_op = op;
+}
+
+// ADD, ADC, SUB, SBC, AND, XOR, OR or CP (bits 3-5 of the opcode) of A and r13d
+static void emit_alu(fgb_jit_emitter* e, int op) {
+    if (op == 1 || op == 3) {
+        emit_carry(e);
+    }
+
+    emit8(e, 0x44); emit8(e, 0x89); emit8(e, 0xE9); // mov ecx, r13d
+    emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 0, CPU_OFFSET(regs.a)); // movzx eax, byte [a]
+
+    switch (op) {
+    case 0: // ADD
+    case 1: // ADC
+        emit_set_lazy_flags(e, LAZY_OP_ADD, true, op == 1);
+        emit8(e, 0x00); emit8(e, 0xC8); // add al, cl
+        if (op == 1) {
+            emit8(e, 0x00); emit8(e, 0xD0); // add al, dl
+        }
+        break;
+    case 2: // SUB
+    case 3: // SBC
+    case 7: // CP
+        emit_set_lazy_flags(e, LAZY_OP_SUB, true, op == 3);
+        if (op == 7) {
+            return;
+        }
+        emit8(e, 0x28); emit8(e, 0xC8); // sub al, cl
+        if (op == 3) {
+            emit8(e, 0x28); emit8(e, 0xD0); // sub al, dl
+        }
+        break;
+    default: {
+        static const uint8_t logic_ops[3] = { 0x20, 0x30, 0x08 }; // and, xor, or
+        emit8(e, logic_ops[op - 4]); emit8(e, 0xC8); // op al, cl
+        emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0xC0); // movzx eax, al
+        emit_set_lazy_flags(e, op == 4 ? LAZY_OP_AND : LAZY_OP_OR, false, false);
+    } break;
+    }
+
+    emit_rbx_mem(e, 0x88, 0, CPU_OFFSET(regs.a)); // mov [a], al
+}
+
+// INC r / DEC r, C is kept in lazy_flags.carry
+static void emit_inc_dec(fgb_jit_emitter* e, int32_t reg, bool dec) {
+    emit_carry(e);
+    emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 0, reg); // movzx eax, byte [reg]
+    emit_set_lazy_flags(e, dec ? LAZY_OP_DEC : LAZY_OP_INC, false, true);
+    emit8(e, 0xFE); emit8(e, dec ? 0xC8 : 0xC0); // dec al / inc al
+    emit_rbx_mem(e, 0x88, 0, reg); // mov [reg], al
+}
+
+// BIT b, r: Z from the bit, N cleared, H set, C kept
+static void emit_bit(fgb_jit_emitter* e, int32_t reg, int bit) {
+    emit_carry(e);
+    emit8(e, 0xC1); emit8(e, 0xE2); emit8(e, 0x04); // shl edx, 4
+    emit8(e, 0x83); emit8(e, 0xCA); emit8(e, CPU_FLAG_H); // or edx, CPU_FLAG_H
+    emit_rbx_mem(e, 0xF6, 0, reg); emit8(e, (uint8_t)(1 << bit)); // test byte [reg], imm8
+    uint8_t* set = emit_jcc8(e, 0x75); // jnz
+    emit8(e, 0x83); emit8(e, 0xCA); emit8(e, CPU_FLAG_Z); // or edx, CPU_FLAG_Z
+    patch_jcc8(e, set);
+    emit_rbx_mem(e, 0x88, 2, CPU_OFFSET(regs.f)); // mov [f], dl
+    emit_rbx_mem(e, 0xC6, 0, CPU_OFFSET(lazy_flags.op)); emit8(e, LAZY_OP_NONE); // mov byte [op], LAZY_OP_NONE
+    e->lazy_op = LAZY_OP_NONE;
+}
+
+// Compiles the instruction at addr with the cycle timing of its interpreter handler.
+// Returns false if it has to call the handler instead. Instructions that end the
+// block leave it on every path.
+static bool emit_native(fgb_jit_emitter* e, uint16_t addr, const uint8_t* bytes) {
+    const uint8_t opcode = bytes[0];
+    const uint16_t imm16 = (uint16_t)(bytes[1] | bytes[2] << 8);
+    const uint16_t next = (uint16_t)(addr + fgb_jit_instruction_length(opcode));
+    const int32_t pair = pair_offsets[(opcode >> 4) & 3];
+    const int32_t dst = reg_offsets[(opcode >> 3) & 7];
+    const int32_t src = reg_offsets[opcode & 7];
+
+    e->pending += 4; // Opcode fetch
+
+    switch (opcode) {
+    case 0x00: // NOP
+        return true;
+
+    case 0x01: case 0x11: case 0x21: case 0x31: // LD rr, nn
+        e->pending += 8;
+        emit8(e, 0x66); emit_rbx_mem(e, 0xC7, 0, pair); emit16(e, imm16); // mov word [rr], imm16
+        return true;
+
+    case 0x02: case 0x12: // LD (BC), A / LD (DE), A
+        emit_load_address(e, pair);
+        emit_load_value(e, CPU_OFFSET(regs.a));
+        emit_write(e);
+        return true;
+
+    case 0x0A: case 0x1A: // LD A, (BC) / LD A, (DE)
+        emit_load_address(e, pair);
+        emit_read(e);
+        emit8(e, 0x44); emit8(e, 0x89); emit8(e, 0xE8); // mov eax, r13d
+        emit_rbx_mem(e, 0x88, 0, CPU_OFFSET(regs.a)); // mov [a], al
+        return true;
+
+    case 0x22: case 0x32: // LD (HL+), A / LD (HL-), A
+        emit_load_address(e, CPU_OFFSET(regs.hl));
+        emit_load_value(e, CPU_OFFSET(regs.a));
+        emit8(e, 0x66); emit_rbx_mem(e, 0xFF, opcode == 0x32, CPU_OFFSET(regs.hl)); // inc / dec word [hl]
+        emit_write(e);
+        return true;
+
+    case 0x2A: case 0x3A: // LD A, (HL+) / LD A, (HL-)
+        emit_load_address(e, CPU_OFFSET(regs.hl));
+        emit8(e, 0x66); emit_rbx_mem(e, 0xFF, opcode == 0x3A, CPU_OFFSET(regs.hl)); // inc / dec word [hl]
+        emit_read(e);
+        emit8(e, 0x44); emit8(e, 0x89); emit8(e, 0xE8); // mov eax, r13d
+        emit_rbx_mem(e, 0x88, 0, CPU_OFFSET(regs.a)); // mov [a], al
+        return true;
+
+    case 0x03: case 0x13: case 0x33: // INC rr, INC HL also changes flags (see fgb_inc_hl)
+    case 0x0B: case 0x1B: case 0x2B: case 0x3B: // DEC rr
+        e->pending += 4;
+        emit8(e, 0x66); emit_rbx_mem(e, 0xFF, (opcode & 0x08) != 0, pair); // inc / dec word [rr]
+        return true;
+
+    case 0x04: case 0x0C: case 0x14: case 0x1C: case 0x24: case 0x2C: case 0x3C: // INC r
+    case 0x05: case 0x0D: case 0x15: case 0x1D: case 0x25: case 0x2D: case 0x3D: // DEC r
+        emit_inc_dec(e, dst, opcode & 1);
+        return true;
+
+    case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x3E: // LD r, n
+        e->pending += 4;
+        emit_rbx_mem(e, 0xC6, 0, dst); emit8(e, bytes[1]); // mov byte [r], imm8
+        return true;
+
+    case 0x36: // LD (HL), n
+        e->pending += 4;
+        emit_load_address(e, CPU_OFFSET(regs.hl));
+        emit_load_value_imm(e, bytes[1]);
+        emit_write(e);
+        return true;
+
+    case 0x18: // JR e
+        e->pending += 8;
+        emit_jump(e, (uint16_t)(next + (int8_t)bytes[1]), next, (int8_t)bytes[1] < 0);
+        return true;
+
+    case 0x20: case 0x28: case 0x30: case 0x38: // JR cc, e
+        e->pending += 4;
+        emit_condition(e, opcode, next);
+        e->pending += 4;
+        emit_jump(e, (uint16_t)(next + (int8_t)bytes[1]), next, (int8_t)bytes[1] < 0);
+        return true;
+
+    case 0xC3: // JP nn
+        e->pending += 12;
+        emit_jump(e, imm16, next, imm16 < next);
+        return true;
+
+    case 0xC2: case 0xCA: case 0xD2: case 0xDA: // JP cc, nn
+        e->pending += 8;
+        emit_condition(e, opcode, next);
+        e->pending += 4;
+        emit_jump(e, imm16, next, imm16 < next);
+        return true;
+
+    case 0xCD: // CALL nn
+    case 0xC4: case 0xCC: case 0xD4: case 0xDC: // CALL cc, nn
+        e->pending += 8;
+        if (opcode != 0xCD) {
+            emit_condition(e, opcode, next);
+        }
+        e->pending += 4;
+        emit_push(e, -1, next);
+        emit_rbx_mem(e, 0xFF, 0, CPU_OFFSET(call_depth)); // inc dword [call_depth]
+        emit_continue(e, imm16, e->pending);
+        return true;
+
+    case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF: // RST
+        e->pending += 4;
+        emit_push(e, -1, next);
+        emit_rbx_mem(e, 0xFF, 0, CPU_OFFSET(call_depth)); // inc dword [call_depth]
+        emit_continue(e, opcode & 0x38, e->pending);
+        return true;
+
+    case 0xC9: // RET
+    case 0xC0: case 0xC8: case 0xD0: case 0xD8: { // RET cc
+        if (opcode != 0xC9) {
+            e->pending += 4;
+            emit_condition(e, opcode, next);
+        }
+        emit_pop(e, CPU_OFFSET(regs.pc));
+        e->pending += 4;
+        emit_rbx_mem(e, 0x83, 7, CPU_OFFSET(call_depth)); emit8(e, 0); // cmp dword [call_depth], 0
+        uint8_t* outermost = emit_jcc8(e, 0x74); // je
+        emit_rbx_mem(e, 0xFF, 1, CPU_OFFSET(call_depth)); // dec dword [call_depth]
+        patch_jcc8(e, outermost);
+        emit_exit(e, -1, e->pending);
+    } return true;
+
+    case 0xC1: case 0xD1: case 0xE1: // POP rr
+        emit_pop(e, pair);
+        return true;
+
+    case 0xC5: case 0xD5: case 0xE5: // PUSH rr
+        e->pending += 4;
+        emit_push(e, pair, 0);
+        return true;
+
+    case 0xE9: // JP HL
+        emit8(e, 0x0F); emit_rbx_mem(e, 0xB7, 0, CPU_OFFSET(regs.hl)); // movzx eax, word [hl]
+        emit8(e, 0x66); emit_rbx_mem(e, 0x89, 0, CPU_OFFSET(regs.pc)); // mov [pc], ax
+        emit_exit(e, -1, e->pending);
+        return true;
+
+    case 0xE0: // LDH (n), A
+        e->pending += 4;
+        emit_write_imm(e, 0xFF00 | bytes[1], CPU_OFFSET(regs.a));
+        return true;
+
+    case 0xEA: // LD (nn), A
+        e->pending += 8;
+        emit_write_imm(e, imm16, CPU_OFFSET(regs.a));
+        return true;
+
+    case 0xF0: // LDH A, (n)
+    case 0xFA: // LD A, (nn)
+        e->pending += opcode == 0xF0 ? 4 : 8;
+        emit_read_imm(e, opcode == 0xF0 ? 0xFF00 | bytes[1] : imm16);
+        emit8(e, 0x44); emit8(e, 0x89); emit8(e, 0xE8); // mov eax, r13d
+        emit_rbx_mem(e, 0x88, 0, CPU_OFFSET(regs.a)); // mov [a], al
+        return true;
+
+    case 0xE2: // LD (C), A
+        emit8(e, 0x44); emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 5, CPU_OFFSET(regs.c)); // movzx r13d, byte [c]
+        emit8(e, 0x41); emit8(e, 0x81); emit8(e, 0xCD); emit32(e, 0xFF00); // or r13d, 0xFF00
+        emit_load_value(e, CPU_OFFSET(regs.a));
+        emit_write(e);
+        return true;
+
+    case 0xF2: // LD A, (C)
+        emit8(e, 0x44); emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 5, CPU_OFFSET(regs.c)); // movzx r13d, byte [c]
+        emit8(e, 0x41); emit8(e, 0x81); emit8(e, 0xCD); emit32(e, 0xFF00); // or r13d, 0xFF00
+        emit_read(e);
+        emit8(e, 0x44); emit8(e, 0x89); emit8(e, 0xE8); // mov eax, r13d
+        emit_rbx_mem(e, 0x88, 0, CPU_OFFSET(regs.a)); // mov [a], al
+        return true;
+
+    case 0xF3: // DI
+        emit_rbx_mem(e, 0xC6, 0, CPU_OFFSET(ime)); emit8(e, 0); // mov byte [ime], 0
+        return true;
+
+    case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE: // ALU A, n
+        e->pending += 4;
+        emit_load_address_imm(e, bytes[1]);
+        emit_alu(e, (opcode >> 3) & 7);
+        return true;
+
+    case 0xCB: {
+        const int32_t reg = reg_offsets[bytes[1] & 7];
+        if (bytes[1] < 0x40 || bytes[1] >= 0x80 || reg < 0) {
+            break; // Only BIT b, r
+        }
+
+        e->pending += 4;
+        emit_bit(e, reg, (bytes[1] >> 3) & 7);
+    } return true;
+
+    default:
+        break;
+    }
+
+    if (opcode >= 0x40 && opcode < 0x80 && opcode != 0x76) {
+        if (dst < 0) { // LD (HL), r
+            emit_load_address(e, CPU_OFFSET(regs.hl));
+            emit_load_value(e, src);
+            emit_write(e);
+            return true;
+        }
+
+        if (src < 0) { // LD r, (HL)
+            emit_load_address(e, CPU_OFFSET(regs.hl));
+            emit_read(e);
+            emit8(e, 0x44); emit8(e, 0x89); emit8(e, 0xE8); // mov eax, r13d
+        }
+        else {
+            emit_rbx_mem(e, 0x8A, 0, src); // mov al, [src]
+        }
+
+        emit_rbx_mem(e, 0x88, 0, dst); // mov [dst], al
+        return true;
+    }
+
+    if (opcode >= 0x80 && opcode < 0xC0) { // ALU A, r
+        if (src < 0) {
+            emit_load_address(e, CPU_OFFSET(regs.hl));
+            emit_read(e);
+        }
+        else {
+            emit8(e, 0x44); emit8(e, 0x0F); emit_rbx_mem(e, 0xB6, 5, src); // movzx r13d, byte [src]
+        }
+
+        emit_alu(e, (opcode >> 3) & 7);
+        return true;
+    }
+
+    e->pending -= 4;
+    return false;
+}
+
+// Runs the instruction through its interpreter handler, which performs its own fetches and memory accesses
+static void emit_handler(fgb_jit_emitter* e, uint16_t addr, uint8_t opcode) {
+    e->pending += 4; // Opcode fetch
+    emit_flush(e);
+    emit8(e, 0x66); emit_rbx_mem(e, 0xC7, 0, CPU_OFFSET(regs.pc)); emit16(e, (uint16_t)(addr + 1)); // mov word [pc], imm16
+    emit8(e, 0x48); emit8(e, 0xBE); emit64(e, (uint64_t)(uintptr_t)fgb_instruction_get(opcode)); // mov rsi, imm64
+    emit_callback(e, (const void*)fgb_instruction_get_handler(opcode));
+    e->lazy_op = FGB_JIT_LAZY_UNKNOWN;
+}
+
+// Switches the pages holding [start, start + size) between writable and executable
+static bool fgb_jit_protect(const fgb_jit* jit, uint8_t* start, size_t size, int prot) {
+    const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    const uintptr_t begin = (uintptr_t)start & ~(page - 1);
+    uintptr_t end = ((uintptr_t)start + size + page - 1) & ~(page - 1);
+
+    if (end > (uintptr_t)jit->code + FGB_JIT_CODE_SIZE) {
+        end = (uintptr_t)jit->code + FGB_JIT_CODE_SIZE;
+    }
+
+    if (mprotect((void*)begin, end - begin, prot) != 0) {
+        log_error("Failed to change the protection of the JIT code buffer");
+        return false;
+    }
+
+    return true;
+}
+
+void* fgb_jit_translate(fgb_jit* jit, uint16_t pc, uint16_t region_end) {
+    fgb_cpu* cpu = jit->cpu;
+
+    uint8_t* start = jit->code + jit->code_used;
+    if (!fgb_jit_protect(jit, start, FGB_JIT_MAX_HOST_BLOCK, PROT_READ | PROT_WRITE)) {
+        return NULL;
+    }
+
+    fgb_jit_emitter e = {
+        .ptr = start,
+        .jit = jit,
+        .paged = cpu->mmu.paged && !cpu->mmu.use_ext_data,
+        .lazy_op = FGB_JIT_LAZY_UNKNOWN,
+    };
+
+    emit8(&e, 0x53); // push rbx
+    emit8(&e, 0x41); emit8(&e, 0x54); // push r12
+    emit8(&e, 0x41); emit8(&e, 0x55); // push r13
+    emit8(&e, 0x48); emit8(&e, 0x89); emit8(&e, 0xFB); // mov rbx, rdi
+    emit_reload_budget(&e);
+
+    // Single stepping leaves after the first instruction
+    emit8(&e, 0x48); emit8(&e, 0xB8); emit64(&e, (uint64_t)(uintptr_t)&jit->exit_block); // mov rax, &exit_block
+    emit8(&e, 0x80); emit8(&e, 0x38); emit8(&e, 0x00); // cmp byte [rax], 0
+    uint8_t* run = emit_jcc8(&e, 0x74); // je
+    emit8(&e, 0x45); emit8(&e, 0x31); emit8(&e, 0xE4); // xor r12d, r12d
+    patch_jcc8(&e, run);
+    assert(e.ptr - start == FGB_JIT_CHAIN_ENTRY);
+
+    uint32_t addr = pc;
+    for (int i = 0; i < FGB_JIT_MAX_BLOCK_LENGTH; i++) {
+        uint8_t bytes[3];
+        bytes[0] = cpu->mmu.read_u8(&cpu->mmu, (uint16_t)addr);
+        const uint16_t length = fgb_jit_instruction_length(bytes[0]);
+        const uint8_t* before = e.ptr;
+
+        // Operands past the end of the region (e.g. in the next ROM bank) are fetched by the handler
+        const bool split = addr + length > region_end;
+        for (uint16_t j = 1; j < length; j++) {
+            bytes[j] = split ? 0 : cpu->mmu.read_u8(&cpu->mmu, (uint16_t)(addr + j));
+        }
+
+        e.called = false;
+        e.next_pc = (uint16_t)(addr + length);
+        const bool native = !split && emit_native(&e, (uint16_t)addr, bytes);
+        if (!native) {
+            emit_handler(&e, (uint16_t)addr, bytes[0]);
+        }
+
+        fgb_code_table_mark(&jit->blocks, (uint16_t)addr, addr + length);
+        addr += length;
+
+        if (fgb_instruction_ends_block(bytes[0])) {
+            if (!native) {
+                emit_exit(&e, -1, e.pending);
+            }
+            break;
+        }
+
+        // Room for the stubs so far and one more instruction with all of its stubs
+        const int stubs = e.stub_count + FGB_JIT_MAX_INSTRUCTION_STUBS;
+        const bool full = stubs > FGB_JIT_MAX_STUBS || (size_t)(e.ptr - start) + FGB_JIT_MAX_HOST_INSTRUCTION
+            + (size_t)stubs * FGB_JIT_MAX_STUB_SIZE > FGB_JIT_MAX_HOST_BLOCK;
+        if (split || addr >= region_end || i == FGB_JIT_MAX_BLOCK_LENGTH - 1 || full) {
+            emit_continue(&e, (uint16_t)addr, e.pending);
+            break;
+        }
+
+        emit_boundary(&e, (int32_t)addr);
+        assert(e.ptr - before <= FGB_JIT_MAX_HOST_INSTRUCTION);
+    }
+
+    emit_stubs(&e);
+    assert(e.ptr - start <= FGB_JIT_MAX_HOST_BLOCK);
+
+    if (!fgb_jit_protect(jit, start, FGB_JIT_MAX_HOST_BLOCK, PROT_READ | PROT_EXEC)) {
+        return NULL;
+    }
+
+    jit->code_used += e.ptr - start;
+
+    return start;
+}
+
+#endif // FGB_JIT_X86_64
@@ -22,11 +22,42 @@
 
 
 static void fgb_mmu_reset(fgb_mmu* mmu);
-static void fgb_mmu_write_dmg(fgb_mmu* mmu, uint16_t addr, uint8_t value);
-static uint8_t fgb_mmu_read_dmg(const fgb_mmu* mmu, uint16_t addr);
-static void fgb_mmu_write_cgb(fgb_mmu* mmu, uint16_t addr, uint8_t value);
-static uint8_t fgb_mmu_read_cgb(const fgb_mmu* mmu, uint16_t addr);
+static void fgb_mmu_write(fgb_mmu* mmu, uint16_t addr, uint8_t value);
+static uint8_t fgb_mmu_read(const fgb_mmu* mmu, uint16_t addr);
 static uint16_t fgb_mmu_read_u16(const fgb_mmu* mmu, uint16_t addr);
+static void fgb_mmu_init_handlers(fgb_mmu* mmu);
+static void fgb_mmu_map_cart(fgb_mmu* mmu);
+static void fgb_mmu_map_wram(fgb_mmu* mmu);
+
+// Handlers for pages without a host pointer
+static uint8_t fgb_mmu_read_cart(const fgb_mmu* mmu, uint16_t addr);
+static void fgb_mmu_write_cart(fgb_mmu* mmu, uint16_t addr, uint8_t value);
+static void fgb_mmu_write_mbc(fgb_mmu* mmu, uint16_t addr, uint8_t value);
+static void fgb_mmu_write_wram(fgb_mmu* mmu, uint16_t addr, uint8_t value);
+static uint8_t fgb_mmu_read_vram(const fgb_mmu* mmu, uint16_t addr);
+static void fgb_mmu_write_vram(fgb_mmu* mmu, uint16_t addr, uint8_t value);
+static uint8_t fgb_mmu_read_oam(const fgb_mmu* mmu, uint16_t addr);
+static void fgb_mmu_write_oam(fgb_mmu* mmu, uint16_t addr, uint8_t value);
+static uint8_t fgb_mmu_read_high(const fgb_mmu* mmu, uint16_t addr);
+static void fgb_mmu_write_high(fgb_mmu* mmu, uint16_t addr, uint8_t value);
+
+// I/O register handlers
+static void fgb_mmu_init_io_registers(fgb_mmu* mmu);
+static void fgb_mmu_set_io_registers(fgb_mmu* mmu, uint16_t first, uint16_t last,
+    fgb_io_read_handler read, fgb_io_write_handler write, void* ctx, uint8_t sync, uint8_t reschedule);
+static uint8_t fgb_mmu_io_read_timer(const void* ctx, uint16_t addr);
+static void fgb_mmu_io_write_timer(void* ctx, uint16_t addr, uint8_t value);
+static uint8_t fgb_mmu_io_read_apu(const void* ctx, uint16_t addr);
+static void fgb_mmu_io_write_apu(void* ctx, uint16_t addr, uint8_t value);
+static uint8_t fgb_mmu_io_read_ppu(const void* ctx, uint16_t addr);
+static void fgb_mmu_io_write_ppu(void* ctx, uint16_t addr, uint8_t value);
+static uint8_t fgb_mmu_io_read_cpu(const void* ctx, uint16_t addr);
+static void fgb_mmu_io_write_cpu(void* ctx, uint16_t addr, uint8_t value);
+static uint8_t fgb_mmu_io_read_io(const void* ctx, uint16_t addr);
+static void fgb_mmu_io_write_io(void* ctx, uint16_t addr, uint8_t value);
+static void fgb_mmu_io_write_bootrom(void* ctx, uint16_t addr, uint8_t value);
+static uint8_t fgb_mmu_io_read_wbk(const void* ctx, uint16_t addr);
+static void fgb_mmu_io_write_wbk(void* ctx, uint16_t addr, uint8_t value);
 
 static const uint8_t dmg_bootrom[] = {
     0x31, 0xFE, 0xFF, 0x21, 0xFF, 0x9F, 0xAF, 0x32,
@@ -108,11 +139,16 @@ void fgb_mmu_init(fgb_mmu* mmu, fgb_cart* cart, fgb_cpu* cpu, const fgb_mmu_ops*
     mmu->cpu = cpu;
     mmu->model = cpu->model;
 
+    memset(mmu->read_pages, 0, sizeof(mmu->read_pages));
+    memset(mmu->write_pages, 0, sizeof(mmu->write_pages));
+    fgb_mmu_init_io_registers(mmu);
+
     if (ops) {
         mmu->reset = ops->reset;
         mmu->write_u8 = ops->write_u8;
         mmu->read_u8 = ops->read_u8;
         mmu->read_u16 = ops->read_u16;
+        mmu->paged = false;
 
         if (ops->data) {
             mmu->ext_data = ops->data;
@@ -120,10 +156,13 @@ void fgb_mmu_init(fgb_mmu* mmu, fgb_cart* cart, fgb_cpu* cpu, const fgb_mmu_ops*
             mmu->use_ext_data = true;
         }
     } else {
+        fgb_mmu_init_handlers(mmu);
+
         mmu->reset = fgb_mmu_reset;
-        mmu->write_u8 = mmu->model == FGB_MODEL_DMG ? fgb_mmu_write_dmg : fgb_mmu_write_cgb;
-        mmu->read_u8 = mmu->model == FGB_MODEL_DMG ? fgb_mmu_read_dmg : fgb_mmu_read_cgb;
+        mmu->write_u8 = fgb_mmu_write;
+        mmu->read_u8 = fgb_mmu_read;
         mmu->read_u16 = fgb_mmu_read_u16;
+        mmu->paged = true;
     }
 
     mmu->reset(mmu);
@@ -134,315 +173,293 @@ void fgb_mmu_reset(fgb_mmu* mmu) {
     memset(mmu->hram, 0, sizeof(mmu->hram));
     mmu->bootrom_mapped = true;
     mmu->wbk = 1;
+
+    fgb_mmu_remap(mmu);
 }
 
-static void fgb_mmu_write_dmg(fgb_mmu* mmu, uint16_t addr, uint8_t value) {
-    // Cart
-    if (addr < 0x8000) {
-        fgb_cart_write(mmu->cart, addr, value);
+void fgb_mmu_remap(fgb_mmu* mmu) {
+    if (!mmu->paged) {
         return;
     }
 
-    // VRAM (>= 0x8000)
-    if (addr < 0xA000) {
-        fgb_ppu_write_vram(mmu->ppu, addr - 0x8000, value);
-        return;
-    }
+    fgb_ppu_leave_fast_dma(mmu->ppu); // The DMA source may be one of the pages that move
+    fgb_mmu_map_cart(mmu);
+    fgb_mmu_map_wram(mmu);
+}
 
-    // External RAM Bank (>= 0xA000)
-    if (addr < 0xC000) {
-        fgb_cart_write(mmu->cart, addr, value);
-        return;
+void fgb_mmu_init_handlers(fgb_mmu* mmu) {
+    for (int page = 0x00; page < 0x80; page++) {
+        mmu->read_handlers[page] = fgb_mmu_read_cart;
+        mmu->write_handlers[page] = fgb_mmu_write_mbc;
     }
 
-    // WRAM (>= 0xC000)
-    if (addr < 0xE000) {
-        mmu->wram[addr - 0xC000] = value;
-        return;
+    for (int page = 0x80; page < 0xA0; page++) {
+        mmu->read_handlers[page] = fgb_mmu_read_vram;
+        mmu->write_handlers[page] = fgb_mmu_write_vram;
     }
 
-    // ECHO RAM (>= 0xE000)
-    if (addr < 0xFE00) {
-        // Maps directly to C000 - DDFF
-        mmu->wram[addr - 0xE000] = value;
-        return;
+    for (int page = 0xA0; page < 0xC0; page++) {
+        mmu->read_handlers[page] = fgb_mmu_read_cart;
+        mmu->write_handlers[page] = fgb_mmu_write_cart;
     }
 
-    // OAM (>= 0xFE00)
-    if (addr < 0xFEA0) {
-        fgb_ppu_write_oam(mmu->ppu, addr - 0xFE00, value);
-        return;
+    // C000 - FDFF is always backed by WRAM, the handler is only reached after fgb_mmu_protect
+    for (int page = 0xC0; page < 0xFE; page++) {
+        mmu->write_handlers[page] = fgb_mmu_write_wram;
     }
 
-    if (addr >= 0xFF04 && addr <= 0xFF07) {
-        fgb_timer_write(mmu->timer, addr, value);
-        return;
-    }
+    mmu->read_handlers[0xFE] = fgb_mmu_read_oam;
+    mmu->write_handlers[0xFE] = fgb_mmu_write_oam;
+    mmu->read_handlers[0xFF] = fgb_mmu_read_high;
+    mmu->write_handlers[0xFF] = fgb_mmu_write_high;
+}
 
-    if (addr >= 0xFF10 && addr < 0xFF40) {
-        fgb_apu_write(mmu->apu, addr, value);
-        return;
-    }
+void fgb_mmu_init_io_registers(fgb_mmu* mmu) {
+    const uint8_t timer = 1 << SCHED_EVENT_TIMER;
+    const uint8_t ppu = 1 << SCHED_EVENT_PPU;
+    const uint8_t apu = 1 << SCHED_EVENT_APU;
 
-    if (addr >= 0xFF40 && addr < 0xFF50) {
-        fgb_ppu_write(mmu->ppu, addr, value);
-        return;
-    }
+    // Joypad, serial and unused registers
+    fgb_mmu_set_io_registers(mmu, 0xFF00, 0xFF7F, fgb_mmu_io_read_io, fgb_mmu_io_write_io, mmu->io, 0, 0);
 
-    if (addr == 0xFF50) {
-        mmu->bootrom_mapped = false;
-        return;
-    }
+    fgb_mmu_set_io_registers(mmu, 0xFF04, 0xFF07, fgb_mmu_io_read_timer, fgb_mmu_io_write_timer, mmu->timer, timer, timer);
 
-    if (addr == 0xFFFF || addr == 0xFF0F) {
-        fgb_cpu_write(mmu->cpu, addr, value);
-        return;
-    }
+    // Interrupt flags need every interrupt source to be up to date
+    fgb_mmu_set_io_registers(mmu, 0xFF0F, 0xFF0F, fgb_mmu_io_read_cpu, fgb_mmu_io_write_cpu, mmu->cpu, timer | ppu, 0);
 
-    if (addr >= 0xFF00 && addr < 0xFF80) {
-        fgb_io_write(mmu->io, addr, value);
-        return;
-    }
+    fgb_mmu_set_io_registers(mmu, 0xFF10, 0xFF3F, fgb_mmu_io_read_apu, fgb_mmu_io_write_apu, mmu->apu, apu, apu);
 
-    // HRAM
-    if (addr >= 0xFF80 && addr < 0xFFFF) {
-        mmu->hram[addr - 0xFF80] = value;
-        return;
+    if (mmu->model == FGB_MODEL_DMG) {
+        fgb_mmu_set_io_registers(mmu, 0xFF40, 0xFF4F, fgb_mmu_io_read_ppu, fgb_mmu_io_write_ppu, mmu->ppu, ppu, ppu);
+    } else {
+        fgb_mmu_set_io_registers(mmu, 0xFF40, 0xFF4B, fgb_mmu_io_read_ppu, fgb_mmu_io_write_ppu, mmu->ppu, ppu, ppu);
+        fgb_mmu_set_io_registers(mmu, 0xFF4C, 0xFF4E, fgb_mmu_io_read_io, fgb_mmu_io_write_io, mmu->io, ppu, ppu);
+        fgb_mmu_set_io_registers(mmu, 0xFF4F, 0xFF4F, fgb_mmu_io_read_ppu, fgb_mmu_io_write_ppu, mmu->ppu, ppu, ppu);
+        fgb_mmu_set_io_registers(mmu, 0xFF70, 0xFF70, fgb_mmu_io_read_wbk, fgb_mmu_io_write_wbk, mmu, 0, 0);
     }
 
-    log_error("Unmapped memory write to 0x%04X", addr);
+    // Bootrom latch is write-only
+    mmu->io_registers[0xFF50 - 0xFF00].write = fgb_mmu_io_write_bootrom;
+    mmu->io_registers[0xFF50 - 0xFF00].ctx = mmu;
+    mmu->io_registers[0xFF50 - 0xFF00].sync = 0;
+    mmu->io_registers[0xFF50 - 0xFF00].reschedule = 0;
 }
 
-static uint8_t fgb_mmu_read_dmg(const fgb_mmu* mmu, uint16_t addr) {
-    // Bootrom
-    if (mmu->bootrom_mapped && addr < 0x100) {
-        return dmg_bootrom[addr];
+void fgb_mmu_set_io_registers(fgb_mmu* mmu, uint16_t first, uint16_t last,
+    fgb_io_read_handler read, fgb_io_write_handler write, void* ctx, uint8_t sync, uint8_t reschedule) {
+    for (uint16_t addr = first; addr <= last; addr++) {
+        fgb_io_register* reg = &mmu->io_registers[addr - 0xFF00];
+        reg->read = read;
+        reg->write = write;
+        reg->ctx = ctx;
+        reg->sync = sync;
+        reg->reschedule = reschedule;
     }
+}
 
-    // Cart
-    if (addr < 0x8000) {
-        return fgb_cart_read(mmu->cart, addr);
-    }
+void fgb_mmu_map_cart(fgb_mmu* mmu) {
+    for (uint16_t base = 0x0000; base < 0x8000; base += FGB_CART_ROM_BANK_SIZE) {
+        const uint8_t* bank = mmu->cart ? fgb_cart_map_rom(mmu->cart, base) : NULL;
 
-    // VRAM (>= 0x8000)
-    if (addr < 0xA000) {
-        return fgb_ppu_read_vram(mmu->ppu, addr - 0x8000);
+        for (int i = 0; i < FGB_CART_ROM_BANK_SIZE / FGB_MMU_PAGE_SIZE; i++) {
+            mmu->read_pages[(base >> 8) + i] = bank ? bank + i * FGB_MMU_PAGE_SIZE : NULL;
+        }
     }
 
-    // External RAM Bank (>= 0xA000)
-    if (addr < 0xC000) {
-        return fgb_cart_read(mmu->cart, addr);
+    if (mmu->bootrom_mapped) {
+        mmu->read_pages[0x00] = dmg_bootrom; // Exactly one page
     }
 
-    // WRAM (>= 0xC000)
-    if (addr < 0xE000) {
-        return mmu->wram[addr - 0xC000];
+    uint8_t* ram = mmu->cart ? fgb_cart_map_ram(mmu->cart) : NULL;
+    for (int i = 0; i < FGB_CART_RAM_BANK_SIZE / FGB_MMU_PAGE_SIZE; i++) {
+        mmu->read_pages[0xA0 + i] = ram ? ram + i * FGB_MMU_PAGE_SIZE : NULL;
+        mmu->write_pages[0xA0 + i] = ram ? ram + i * FGB_MMU_PAGE_SIZE : NULL;
     }
+}
 
-    // ECHO RAM (>= 0xE000)
-    if (addr < 0xFE00) {
-        // Maps directly to C000 - DDFF
-        return mmu->wram[addr - 0xE000];
-    }
+void fgb_mmu_map_wram(fgb_mmu* mmu) {
+    for (int page = 0xC0; page < 0xFE; page++) {
+        const int wram_page = page < 0xE0 ? page : page - 0x20; // E000 - FDFF echoes C000 - DDFF
 
-    // OAM (>= 0xFE00)
-    if (addr < 0xFEA0) {
-        return fgb_ppu_read_oam(mmu->ppu, addr - 0xFE00);
-    }
+        uint8_t* memory;
+        if (wram_page < 0xD0) {
+            memory = &mmu->wram[(wram_page - 0xC0) * FGB_MMU_PAGE_SIZE]; // Bank 0
+        } else {
+            memory = &mmu->wram[mmu->wbk * FGB_WRAM_BANK_SIZE + (wram_page - 0xD0) * FGB_MMU_PAGE_SIZE]; // Bank 1-7 (always 1 on DMG)
+        }
 
-    if (addr >= 0xFF04 && addr <= 0xFF07) {
-        return fgb_timer_read(mmu->timer, addr);
+        mmu->read_pages[page] = memory;
+        mmu->write_pages[page] = memory;
     }
+}
 
-    if (addr >= 0xFF10 && addr < 0xFF40) {
-        return fgb_apu_read(mmu->apu, addr);
+void fgb_mmu_write(fgb_mmu* mmu, uint16_t addr, uint8_t value) {
+    uint8_t* page = mmu->write_pages[addr >> 8];
+    if (page) {
+        page[addr & 0xFF] = value;
+        return;
     }
 
-    if (addr >= 0xFF40 && addr < 0xFF50) {
-        return fgb_ppu_read(mmu->ppu, addr);
-    }
+    mmu->write_handlers[addr >> 8](mmu, addr, value);
+}
 
-    if (addr == 0xFFFF || addr == 0xFF0F) {
-        return fgb_cpu_read(mmu->cpu, addr);
+uint8_t fgb_mmu_read(const fgb_mmu* mmu, uint16_t addr) {
+    const uint8_t* page = mmu->read_pages[addr >> 8];
+    if (page) {
+        return page[addr & 0xFF];
     }
 
-    if (addr >= 0xFF00 && addr < 0xFF80) {
-        return fgb_io_read(mmu->io, addr);
-    }
+    return mmu->read_handlers[addr >> 8](mmu, addr);
+}
 
-    // HRAM
-    if (addr >= 0xFF80 && addr < 0xFFFF) {
-        return mmu->hram[addr - 0xFF80];
-    }
+uint8_t fgb_mmu_read_cart(const fgb_mmu* mmu, uint16_t addr) {
+    return fgb_cart_read(mmu->cart, addr);
+}
 
-    log_error("Unmapped memory read from 0x%04X", addr);
-    return 0xFF; // Return a default value for unmapped reads
+void fgb_mmu_write_cart(fgb_mmu* mmu, uint16_t addr, uint8_t value) {
+    fgb_ppu_leave_fast_dma(mmu->ppu); // Cart RAM may be the DMA source, see fgb_mmu_protect
+    fgb_cart_write(mmu->cart, addr, value);
 }
 
-void fgb_mmu_write_cgb(fgb_mmu* mmu, uint16_t addr, uint8_t value) {
-    // Cart
-    if (addr < 0x8000) {
-        fgb_cart_write(mmu->cart, addr, value);
-        return;
-    }
+void fgb_mmu_write_mbc(fgb_mmu* mmu, uint16_t addr, uint8_t value) {
+    fgb_ppu_leave_fast_dma(mmu->ppu); // Before the bank under a DMA source is switched
+    fgb_cart_write(mmu->cart, addr, value);
+    fgb_mmu_map_cart(mmu); // Banks or RAM enable may have changed
+}
 
-    // VRAM (>= 0x8000)
-    if (addr < 0xA000) {
-        fgb_ppu_write_vram(mmu->ppu, addr - 0x8000, value);
-        return;
-    }
+void fgb_mmu_write_wram(fgb_mmu* mmu, uint16_t addr, uint8_t value) {
+    fgb_mmu_remap(mmu); // Ends the DMA that protected the page and maps it again
+    mmu->write_pages[addr >> 8][addr & 0xFF] = value;
+}
 
-    // External RAM Bank (>= 0xA000)
-    if (addr < 0xC000) {
-        fgb_cart_write(mmu->cart, addr, value);
-        return;
+void fgb_mmu_protect(fgb_mmu* mmu, const uint8_t* memory) {
+    for (int page = 0; page < FGB_MMU_PAGE_COUNT; page++) {
+        if (mmu->write_pages[page] == memory) {
+            mmu->write_pages[page] = NULL;
+        }
     }
+}
 
-    if (addr < 0xD000) {
-        // WRAM Bank 0
-        mmu->wram[addr - 0xC000] = value;
-        return;
-    }
+uint8_t fgb_mmu_read_vram(const fgb_mmu* mmu, uint16_t addr) {
+    // Access depends on the PPU mode, so VRAM is never mapped directly
+    return fgb_ppu_read_vram(mmu->ppu, addr - 0x8000);
+}
 
-    if (addr < 0xE000) {
-        // WRAM Bank 1-7
-        mmu->wram[addr + (mmu->wbk * FGB_WRAM_BANK_SIZE) - 0xC000] = value;
-        return;
-    }
+void fgb_mmu_write_vram(fgb_mmu* mmu, uint16_t addr, uint8_t value) {
+    fgb_ppu_write_vram(mmu->ppu, addr - 0x8000, value);
+}
 
-    // ECHO RAM (>= 0xE000)
-    if (addr < 0xFE00) {
-        // Maps directly to C000 - DDFF
-        mmu->wram[addr - 0xE000] = value;
-        return;
+uint8_t fgb_mmu_read_oam(const fgb_mmu* mmu, uint16_t addr) {
+    if (addr < 0xFEA0) {
+        return fgb_ppu_read_oam(mmu->ppu, addr - 0xFE00);
     }
 
-    // OAM (>= 0xFE00)
+    log_error("Unmapped memory read from 0x%04X", addr);
+    return 0xFF; // Return a default value for unmapped reads
+}
+
+void fgb_mmu_write_oam(fgb_mmu* mmu, uint16_t addr, uint8_t value) {
     if (addr < 0xFEA0) {
         fgb_ppu_write_oam(mmu->ppu, addr - 0xFE00, value);
         return;
     }
 
-    if (addr >= 0xFF04 && addr <= 0xFF07) {
-        fgb_timer_write(mmu->timer, addr, value);
-        return;
-    }
-
-    if (addr >= 0xFF10 && addr < 0xFF40) {
-        fgb_apu_write(mmu->apu, addr, value);
-        return;
-    }
+    log_error("Unmapped memory write to 0x%04X", addr);
+}
 
-    if (addr >= 0xFF40 && addr < 0xFF4C || addr == 0xFF4F) {
-        fgb_ppu_write(mmu->ppu, addr, value);
+void fgb_mmu_write_high(fgb_mmu* mmu, uint16_t addr, uint8_t value) {
+    if (addr < 0xFF80) {
+        const fgb_io_register* reg = &mmu->io_registers[addr - 0xFF00];
+        reg->write(reg->ctx, addr, value);
         return;
     }
 
-    if (addr == 0xFF50) {
-        mmu->bootrom_mapped = false;
+    if (addr == 0xFFFF) {
+        fgb_cpu_write(mmu->cpu, addr, value);
         return;
     }
 
-    if (addr == 0xFF70) {
-        mmu->wbk = value ? value & 0x07 : 1;
-        return;
-    }
+    // HRAM
+    mmu->hram[addr - 0xFF80] = value;
+}
 
-    if (addr == 0xFFFF || addr == 0xFF0F) {
-        fgb_cpu_write(mmu->cpu, addr, value);
-        return;
+uint8_t fgb_mmu_read_high(const fgb_mmu* mmu, uint16_t addr) {
+    if (addr < 0xFF80) {
+        const fgb_io_register* reg = &mmu->io_registers[addr - 0xFF00];
+        return reg->read(reg->ctx, addr);
     }
 
-    if (addr >= 0xFF00 && addr < 0xFF80) {
-        fgb_io_write(mmu->io, addr, value);
-        return;
+    if (addr == 0xFFFF) {
+        return fgb_cpu_read(mmu->cpu, addr);
     }
 
     // HRAM
-    if (addr >= 0xFF80 && addr < 0xFFFF) {
-        mmu->hram[addr - 0xFF80] = value;
-        return;
-    }
-
-    log_error("Unmapped memory write to 0x%04X", addr);
+    return mmu->hram[addr - 0xFF80];
 }
 
-uint8_t fgb_mmu_read_cgb(const fgb_mmu* mmu, uint16_t addr) {
-    // Bootrom
-    if (mmu->bootrom_mapped && addr < 0x100) {
-        return dmg_bootrom[addr];
-    }
-
-    // Cart
-    if (addr < 0x8000) {
-        return fgb_cart_read(mmu->cart, addr);
-    }
+uint8_t fgb_mmu_io_read_timer(const void* ctx, uint16_t addr) {
+    return fgb_timer_read(ctx, addr);
+}
 
-    // VRAM (>= 0x8000)
-    if (addr < 0xA000) {
-        return fgb_ppu_read_vram(mmu->ppu, addr - 0x8000);
-    }
+void fgb_mmu_io_write_timer(void* ctx, uint16_t addr, uint8_t value) {
+    fgb_timer_write(ctx, addr, value);
+}
 
-    // External RAM Bank (>= 0xA000)
-    if (addr < 0xC000) {
-        return fgb_cart_read(mmu->cart, addr);
-    }
+uint8_t fgb_mmu_io_read_apu(const void* ctx, uint16_t addr) {
+    return fgb_apu_read(ctx, addr);
+}
 
-    if (addr < 0xD000) {
-        // WRAM Bank 0
-        return mmu->wram[addr - 0xC000];
-    }
+void fgb_mmu_io_write_apu(void* ctx, uint16_t addr, uint8_t value) {
+    fgb_apu_write(ctx, addr, value);
+}
 
-    if (addr < 0xE000) {
-        // WRAM Bank 1-7
-        return mmu->wram[addr + (mmu->wbk * FGB_WRAM_BANK_SIZE) - 0xC000];
-    }
+uint8_t fgb_mmu_io_read_ppu(const void* ctx, uint16_t addr) {
+    return fgb_ppu_read(ctx, addr);
+}
 
-    // ECHO RAM (>= 0xE000)
-    if (addr < 0xFE00) {
-        // Maps directly to C000 - DDFF
-        return mmu->wram[addr - 0xE000];
-    }
+void fgb_mmu_io_write_ppu(void* ctx, uint16_t addr, uint8_t value) {
+    fgb_ppu_write(ctx, addr, value);
+}
 
-    // OAM (>= 0xFE00)
-    if (addr < 0xFEA0) {
-        return fgb_ppu_read_oam(mmu->ppu, addr - 0xFE00);
-    }
+uint8_t fgb_mmu_io_read_cpu(const void* ctx, uint16_t addr) {
+    return fgb_cpu_read(ctx, addr);
+}
 
-    if (addr >= 0xFF04 && addr <= 0xFF07) {
-        return fgb_timer_read(mmu->timer, addr);
-    }
+void fgb_mmu_io_write_cpu(void* ctx, uint16_t addr, uint8_t value) {
+    fgb_cpu_write(ctx, addr, value);
+}
 
-    if (addr >= 0xFF10 && addr < 0xFF40) {
-        return fgb_apu_read(mmu->apu, addr);
-    }
+uint8_t fgb_mmu_io_read_io(const void* ctx, uint16_t addr) {
+    return fgb_io_read(ctx, addr);
+}
 
-    if (addr >= 0xFF40 && addr < 0xFF4C || addr == 0xFF4F) {
-        return fgb_ppu_read(mmu->ppu, addr);
-    }
+void fgb_mmu_io_write_io(void* ctx, uint16_t addr, uint8_t value) {
+    fgb_io_write(ctx, addr, value);
+}
 
-    if (addr == 0xFF70) {
-        return mmu->wbk;
-    }
+void fgb_mmu_io_write_bootrom(void* ctx, uint16_t addr, uint8_t value) {
+    (void)addr;
+    (void)value;
 
-    if (addr == 0xFFFF || addr == 0xFF0F) {
-        return fgb_cpu_read(mmu->cpu, addr);
-    }
+    fgb_mmu* mmu = ctx;
+    mmu->bootrom_mapped = false;
+    fgb_mmu_remap(mmu);
+}
 
-    if (addr >= 0xFF00 && addr < 0xFF80) {
-        return fgb_io_read(mmu->io, addr);
-    }
+uint8_t fgb_mmu_io_read_wbk(const void* ctx, uint16_t addr) {
+    (void)addr;
+    return ((const fgb_mmu*)ctx)->wbk;
+}
 
-    // HRAM
-    if (addr >= 0xFF80 && addr < 0xFFFF) {
-        return mmu->hram[addr - 0xFF80];
-    }
+void fgb_mmu_io_write_wbk(void* ctx, uint16_t addr, uint8_t value) {
+    (void)addr;
 
-    log_error("Unmapped memory read from 0x%04X", addr);
-    return 0xFF; // Return a default value for unmapped reads
+    fgb_mmu* mmu = ctx;
+    mmu->wbk = value ? value & 0x07 : 1;
+    fgb_mmu_remap(mmu);
 }
 
-static uint16_t fgb_mmu_read_u16(const fgb_mmu* mmu, uint16_t addr) {
+uint16_t fgb_mmu_read_u16(const fgb_mmu* mmu, uint16_t addr) {
     const uint16_t lower = mmu->read_u8(mmu, addr);
     const uint16_t upper = mmu->read_u8(mmu, addr + 1);
     return upper << 8 | lower;
@@ -5,13 +5,16 @@
 #include <string.h>
 
 #include <ulog.h>
-#include <sort_r.h>
 
 #define OAM_SCAN_CYCLES             (80)  // T-cycles
 #define SCANLINE_CYCLES             (456) // T-cycles
 #define VBLANK_CYCLES               SCANLINE_CYCLES
 #define HBLANK_MAX_CYCLES           (SCANLINE_CYCLES - OAM_SCAN_CYCLES)
 
+// OAM DMA timeline, in T-cycles after the write to DMA
+#define PPU_DMA_BLOCK_TICK          (5) // First byte is copied and OAM becomes inaccessible
+#define PPU_DMA_DONE_TICK           (PPU_DMA_BLOCK_TICK + (PPU_DMA_BYTES - 1) * 4) // Last byte is copied
+
 #define TILE_MAP_BASE               (0x9800 - 0x8000)
 #define TILE_MAP_WIDTH              32
 #define TILE_MAP_HEIGHT             32
@@ -23,19 +26,39 @@
 #define TILE_DATA_BLOCK_OFFSET(BLOCK)    (TILE_DATA_BLOCK_BASE + (BLOCK) * TILE_BLOCK_SIZE)
 #define TILE_DATA_OFFSET(BLOCK, TILE)    (TILE_DATA_BLOCK_OFFSET(BLOCK) + (TILE) * TILE_SIZE_BYTES)
 
-#define TILE_PIXEL(LSB, MSB, X)    (((((MSB) >> (7 - (X))) & 1) << 1) | (((LSB) >> (7 - (X))) & 1))
-
 static void fgb_ppu_do_oam_scan(fgb_ppu* ppu);
+static void fgb_ppu_store_oam(fgb_ppu* ppu, uint16_t addr, uint8_t value);
+static void fgb_ppu_index_sprite_lines(fgb_ppu* ppu, int sprite, uint64_t set);
+static void fgb_ppu_sort_sprite_x(fgb_ppu* ppu, int sprite);
+static int fgb_ppu_sprite_x_key(const fgb_ppu* ppu, uint8_t offset);
+static void fgb_ppu_rebuild_sprite_index(fgb_ppu* ppu);
 static void fgb_ppu_pixel_fetcher_tick(fgb_ppu* ppu);
 static void fgb_ppu_lcd_push(fgb_ppu* ppu);
+static uint8_t fgb_ppu_mix_pixel(const fgb_ppu* ppu, const fgb_pixel_fifo* bg_wnd, const fgb_pixel_fifo* sprites);
+static uint8_t fgb_ppu_get_bg_shade(const fgb_ppu* ppu, int color);
+static void fgb_ppu_write_line(fgb_ppu* ppu, const uint8_t* values, const uint8_t* indices);
+static void fgb_ppu_blank_frame(fgb_ppu* ppu, int buffer);
+static uint16_t fgb_rgba_to_rgb565(uint32_t color);
+static uint32_t fgb_rgb565_to_rgba(uint16_t color);
+static int fgb_ppu_get_sprite_line(const fgb_ppu* ppu, const fgb_sprite* sprite);
+static const uint8_t* fgb_ppu_get_sprite_row(const fgb_ppu* ppu, const fgb_sprite* sprite);
+static const uint8_t* fgb_ppu_get_decoded_sprite_row(fgb_ppu* ppu, const fgb_sprite* sprite);
+static bool fgb_ppu_render_line(fgb_ppu* ppu);
+static uint8_t fgb_ppu_encode_sprite_pixel(int color, int palette, int bg_prio);
+static uint32_t fgb_ppu_line_cycles(const fgb_ppu* ppu, int window_x, int sprite_count, int* sprite_x);
+static void fgb_ppu_leave_fast_line(fgb_ppu* ppu);
 static void fgb_ppu_try_stat_irq(fgb_ppu* ppu);
-
-static void fgb_queue_push(fgb_queue* queue, fgb_pixel pixel);
-static fgb_pixel fgb_queue_pop(fgb_queue* queue);
-static fgb_pixel* fgb_queue_at(fgb_queue* queue, int index);
-static bool fgb_queue_full(const fgb_queue* queue);
-static bool fgb_queue_empty(const fgb_queue* queue);
-static void fgb_queue_clear(fgb_queue* queue);
+static bool fgb_ppu_stat_line(const fgb_ppu* ppu);
+static uint32_t fgb_ppu_idle_cycles(const fgb_ppu* ppu);
+static uint32_t fgb_ppu_dma_idle_cycles(const fgb_ppu* ppu);
+static void fgb_ppu_do_dma(fgb_ppu* ppu);
+
+static void fgb_fifo_shift(fgb_pixel_fifo* fifo);
+static int fgb_fifo_color(const fgb_pixel_fifo* fifo, int index);
+static uint8_t fgb_fifo_get_slot(const fgb_pixel_fifo* fifo, int index);
+static void fgb_fifo_set_slot(fgb_pixel_fifo* fifo, int index, uint8_t slot);
+static void fgb_fifo_clear(fgb_pixel_fifo* fifo);
+static uint8_t fgb_flip_byte(uint8_t value);
 
 fgb_ppu* fgb_ppu_create(void) {
     fgb_ppu* ppu = malloc(sizeof(fgb_ppu));
@@ -46,12 +69,6 @@ fgb_ppu* fgb_ppu_create(void) {
 
     memset(ppu, 0, sizeof(fgb_ppu));
 
-    if (mtx_init(&ppu->buffer_mutex, mtx_plain) != thrd_success) {
-        log_error("PPU: Failed to initialize buffer mutex");
-        free(ppu);
-        return NULL;
-    }
-
     ppu->bg_palette.colors[0] = 0xFFFFFFFF; // Color 0: White
     ppu->bg_palette.colors[1] = 0xFFB0B0B0; // Color 1: Light Gray
     ppu->bg_palette.colors[2] = 0xFF606060; // Color 2: Dark Gray
@@ -63,6 +80,16 @@ fgb_ppu* fgb_ppu_create(void) {
     ppu->obj_palette.colors[3] = 0xFF000000; // Color 3: Black
 
     ppu->model = FGB_MODEL_DMG;
+    ppu->simd = fgb_simd_get_kernels(fgb_simd_detect());
+
+    ppu->back_buffer = 0;
+    ppu->front_buffer = 1;
+    atomic_init(&ppu->ready_buffer, 2);
+
+    if (!fgb_ppu_set_frame_format(ppu, PPU_FRAME_FORMAT_RGBA8888)) {
+        free(ppu);
+        return NULL;
+    }
 
     return ppu;
 }
@@ -76,6 +103,7 @@ fgb_ppu* fgb_ppu_create_with_model(fgb_model model) {
 
 void fgb_ppu_destroy(fgb_ppu* ppu) {
     ppu->cpu = NULL;
+    free(ppu->framebuffers[0]);
     free(ppu);
 }
 
@@ -91,18 +119,23 @@ void fgb_ppu_reset(fgb_ppu* ppu) {
     memset(ppu->vram0, 0, sizeof(ppu->vram0));
     memset(ppu->vram1, 0, sizeof(ppu->vram1));
     memset(ppu->oam, 0, sizeof(ppu->oam));
-    memset(ppu->framebuffers, 0, sizeof(ppu->framebuffers));
+    memset(ppu->tile_cache_dirty, 0xFF, sizeof(ppu->tile_cache_dirty));
     memset(ppu->line_sprites, 0xFF, sizeof(ppu->line_sprites));
 
-    ppu->back_buffer = 0;
+    // The consumer may still be reading the front buffer, so only the buffers the PPU owns
+    // are blanked and a blank frame is handed over, as when the LCD is turned off
+    fgb_ppu_blank_frame(ppu, ppu->back_buffer);
+    fgb_ppu_swap_buffers(ppu);
+    fgb_ppu_blank_frame(ppu, ppu->back_buffer);
+
     ppu->mode_cycles = 0;
     ppu->frame_cycles = 0;
     ppu->scanline_cycles = 0;
     ppu->pixels_drawn = 0;
     ppu->sprite_count = 0;
 
-    fgb_queue_clear(&ppu->bg_wnd_fifo);
-    fgb_queue_clear(&ppu->sprite_fifo);
+    fgb_fifo_clear(&ppu->bg_wnd_fifo);
+    fgb_fifo_clear(&ppu->sprite_fifo);
 
     ppu->reached_window_x = false;
     ppu->reached_window_y = false;
@@ -117,11 +150,15 @@ void fgb_ppu_reset(fgb_ppu* ppu) {
     ppu->sprite_fetch_active = false;
     ppu->processed_pixels = 0;
     ppu->framebuffer_x = 0;
+    ppu->fast_line = false;
 
     ppu->oam_scan_done = false;
     ppu->reset = false;
     ppu->frames_rendered = 0;
+    ppu->skip_next_frame = false;
+    ppu->frame_skipped = false;
     ppu->lcd_control.value = 0x00;
+    fgb_ppu_rebuild_sprite_index(ppu);
     ppu->ly = 0;
     ppu->lyc = 0;
     ppu->stat.value = 0x00;
@@ -138,35 +175,150 @@ void fgb_ppu_reset(fgb_ppu* ppu) {
     ppu->dma_active = false;
     ppu->dma = 0xFF;
     ppu->dma_addr = 0;
+    ppu->dma_source = NULL;
     ppu->dma_bytes = 0;
     ppu->dma_cycles = 0;
     ppu->hblank_cycles = HBLANK_MAX_CYCLES;
 }
 
-const uint32_t* fgb_ppu_get_front_buffer(const fgb_ppu* ppu) {
-    return ppu->framebuffers[(ppu->back_buffer + PPU_FRAMEBUFFER_COUNT - 1) % PPU_FRAMEBUFFER_COUNT];
+const void* fgb_ppu_get_front_buffer(const fgb_ppu* ppu) {
+    // The PPU never writes to either candidate, so this is safe as long as it isn't running at the same time
+    const int ready = atomic_load_explicit(&ppu->ready_buffer, memory_order_acquire);
+    if (ready & PPU_FRAME_READY) {
+        return ppu->framebuffers[ready & ~PPU_FRAME_READY];
+    }
+
+    return ppu->framebuffers[ppu->front_buffer];
 }
 
-const uint32_t* fgb_ppu_get_back_buffer(const fgb_ppu* ppu) {
+const void* fgb_ppu_get_back_buffer(const fgb_ppu* ppu) {
     return ppu->framebuffers[ppu->back_buffer];
 }
 
-void fgb_ppu_lock_buffer(fgb_ppu* ppu) {
-    if (mtx_lock(&ppu->buffer_mutex) != thrd_success) {
-        log_error("PPU: Failed to lock buffer mutex");
+void fgb_ppu_swap_buffers(fgb_ppu *ppu) {
+    // Whatever the consumer didn't take in time is overwritten next
+    const int previous = atomic_exchange_explicit(&ppu->ready_buffer, ppu->back_buffer | PPU_FRAME_READY, memory_order_acq_rel);
+    ppu->back_buffer = previous & ~PPU_FRAME_READY;
+}
+
+const void* fgb_ppu_acquire_latest_frame(fgb_ppu* ppu) {
+    if (ppu->frame_acquired) {
+        log_warn("PPU: Frame acquired again before it was released");
+    }
+
+    // Trade the frame from last time for the newer one, if the PPU finished one since
+    if (atomic_load_explicit(&ppu->ready_buffer, memory_order_relaxed) & PPU_FRAME_READY) {
+        const int ready = atomic_exchange_explicit(&ppu->ready_buffer, ppu->front_buffer, memory_order_acq_rel);
+        ppu->front_buffer = ready & ~PPU_FRAME_READY;
     }
+
+    ppu->frame_acquired = true;
+    return ppu->framebuffers[ppu->front_buffer];
 }
 
-void fgb_ppu_unlock_buffer(fgb_ppu* ppu) {
-    if (mtx_unlock(&ppu->buffer_mutex) != thrd_success) {
-        log_error("PPU: Failed to unlock buffer mutex");
+void fgb_ppu_release_frame(fgb_ppu* ppu, const void* frame) {
+    if (frame != ppu->framebuffers[ppu->front_buffer]) {
+        log_warn("PPU: Released a frame that wasn't acquired");
     }
+
+    ppu->frame_acquired = false;
 }
 
-void fgb_ppu_swap_buffers(fgb_ppu *ppu) {
-    fgb_ppu_lock_buffer(ppu);
-    ppu->back_buffer = (ppu->back_buffer + 1) % PPU_FRAMEBUFFER_COUNT;
-    fgb_ppu_unlock_buffer(ppu);
+bool fgb_ppu_set_frame_format(fgb_ppu* ppu, enum fgb_frame_format format) {
+    size_t pitch;
+    switch (format) {
+    case PPU_FRAME_FORMAT_RGBA8888:
+        pitch = SCREEN_WIDTH * sizeof(uint32_t);
+        break;
+    case PPU_FRAME_FORMAT_RGB565:
+        pitch = SCREEN_WIDTH * sizeof(uint16_t);
+        break;
+    case PPU_FRAME_FORMAT_INDEX8:
+        pitch = SCREEN_WIDTH;
+        break;
+    case PPU_FRAME_FORMAT_INDEX2:
+        pitch = SCREEN_WIDTH / 4;
+        break;
+    default:
+        log_error("PPU: Unknown frame format %d", format);
+        return false;
+    }
+
+    if (ppu->frame_acquired) {
+        log_error("PPU: Can't change the frame format while a frame is acquired");
+        return false;
+    }
+
+    uint8_t* memory = malloc(pitch * SCREEN_HEIGHT * PPU_FRAMEBUFFER_COUNT);
+    if (!memory) {
+        log_error("PPU: Failed to allocate framebuffers");
+        return false;
+    }
+
+    free(ppu->framebuffers[0]);
+    for (int i = 0; i < PPU_FRAMEBUFFER_COUNT; i++) {
+        ppu->framebuffers[i] = &memory[i * pitch * SCREEN_HEIGHT];
+    }
+
+    ppu->frame_format = format;
+    ppu->frame_pitch = pitch;
+    memset(memory, 0, pitch * SCREEN_HEIGHT * PPU_FRAMEBUFFER_COUNT);
+
+    return true;
+}
+
+size_t fgb_ppu_get_frame_pitch(const fgb_ppu* ppu) {
+    return ppu->frame_pitch;
+}
+
+void fgb_ppu_get_frame_palette(const fgb_ppu* ppu, uint32_t* colors) {
+    memset(colors, 0, PPU_FRAME_PALETTE_SIZE * sizeof(uint32_t));
+
+    for (int i = 0; i < 4; i++) {
+        colors[PPU_FRAME_INDEX_BG + i] = ppu->bg_palette.colors[i];
+        colors[PPU_FRAME_INDEX_OBJ + i] = ppu->obj_palette.colors[i];
+    }
+
+    colors[PPU_FRAME_INDEX_WINDOW] = ppu->debug.window_color;
+}
+
+void fgb_ppu_convert_frame(const fgb_ppu* ppu, const void* frame, uint32_t* colors) {
+    uint32_t palette[PPU_FRAME_PALETTE_SIZE];
+    fgb_ppu_get_frame_palette(ppu, palette);
+
+    switch (ppu->frame_format) {
+    case PPU_FRAME_FORMAT_RGBA8888:
+        memcpy(colors, frame, SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t));
+        break;
+
+    case PPU_FRAME_FORMAT_RGB565: {
+        const uint16_t* pixels = frame;
+        for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+            colors[i] = fgb_rgb565_to_rgba(pixels[i]);
+        }
+    } break;
+
+    case PPU_FRAME_FORMAT_INDEX8:
+        ppu->simd->map_colors(frame, palette, colors, SCREEN_WIDTH * SCREEN_HEIGHT);
+        break;
+
+    case PPU_FRAME_FORMAT_INDEX2: {
+        const uint8_t* packed = frame;
+        uint8_t indices[SCREEN_WIDTH];
+
+        for (int y = 0; y < SCREEN_HEIGHT; y++) {
+            for (int x = 0; x < SCREEN_WIDTH; x++) {
+                indices[x] = (packed[y * ppu->frame_pitch + x / 4] >> (6 - 2 * (x % 4))) & 0x3;
+            }
+
+            ppu->simd->map_colors(indices, palette, &colors[y * SCREEN_WIDTH], SCREEN_WIDTH);
+        }
+    } break;
+    }
+}
+
+void fgb_ppu_set_frame_skip(fgb_ppu* ppu, bool skip) {
+    ppu->skip_next_frame = skip;
 }
 
 void fgb_ppu_set_color_mode(fgb_ppu *ppu, enum fgb_color_mode mode) {
@@ -231,17 +383,43 @@ const fgb_tile* fgb_ppu_get_tile_data(const fgb_ppu* ppu, int tile_id, bool is_s
     return (fgb_tile*)&ppu->vram0[TILE_DATA_OFFSET(tile_block, tile_id % 128)];
 }
 
+int fgb_ppu_get_tile_index(const fgb_ppu* ppu, int tile_id, bool is_sprite) {
+    if (is_sprite || ppu->lcd_control.bg_wnd_tiles == 1) {
+        return tile_id; // Blocks 0 and 1
+    }
+
+    return tile_id > 127 ? tile_id : 2 * TILES_PER_BLOCK + tile_id; // Blocks 2 and 1
+}
+
+const uint8_t* fgb_ppu_get_tile_row(fgb_ppu* ppu, int bank, int tile_index, int y, bool flip) {
+    fgb_decoded_tile* tile = &ppu->tile_cache[bank][tile_index];
+
+    // Rows are decoded again the first time they are used after a VRAM write
+    if (ppu->tile_cache_dirty[bank][tile_index] & (1 << y)) {
+        const uint8_t* data = &(bank ? ppu->vram1 : ppu->vram0)[tile_index * TILE_SIZE_BYTES + y * 2];
+        ppu->simd->decode_row(data[0], data[1], tile->rows[y], tile->flipped_rows[y]);
+
+        ppu->tile_cache_dirty[bank][tile_index] &= ~(1 << y);
+    }
+
+    return flip ? tile->flipped_rows[y] : tile->rows[y];
+}
+
 uint32_t fgb_ppu_get_bg_color(const fgb_ppu* ppu, fgb_pixel pixel) {
     // Debug override
     if (ppu->debug.window_color >> 24 && pixel.is_wnd) {
         return ppu->debug.window_color;
     }
 
+    return ppu->bg_palette.colors[fgb_ppu_get_bg_shade(ppu, pixel.color)];
+}
+
+uint8_t fgb_ppu_get_bg_shade(const fgb_ppu* ppu, int color) {
     if (!ppu->lcd_control.bg_wnd_enable) {
-        return ppu->bg_palette.colors[0]; // Background disabled, always color 0
+        return 0; // Background disabled, always color 0
     }
 
-    return ppu->bg_palette.colors[(ppu->bgp.value >> (pixel.color * 2)) & 0x3];
+    return (ppu->bgp.value >> (color * 2)) & 0x3;
 }
 
 uint32_t fgb_ppu_get_obj_color(const fgb_ppu* ppu, uint8_t pixel_index, int palette) {
@@ -264,11 +442,10 @@ bool fgb_ppu_tick(fgb_ppu* ppu) {
             ppu->frame_cycles = 0;
             ppu->reset = true;
 
-            fgb_ppu_lock_buffer(ppu);
-            memset(ppu->framebuffers, 0xFF, sizeof(ppu->framebuffers));
-            fgb_ppu_unlock_buffer(ppu);
-
+            // Show a blank screen, the consumer may still be reading the front buffer
+            fgb_ppu_blank_frame(ppu, ppu->back_buffer);
             fgb_ppu_swap_buffers(ppu);
+            fgb_ppu_blank_frame(ppu, ppu->back_buffer);
         }
 
         return false;
@@ -281,8 +458,10 @@ bool fgb_ppu_tick(fgb_ppu* ppu) {
         ppu->processed_pixels = 0;
         ppu->fetch_x = 0;
         ppu->is_first_fetch = true;
-        fgb_queue_clear(&ppu->bg_wnd_fifo);
-        fgb_queue_clear(&ppu->sprite_fifo);
+        fgb_fifo_clear(&ppu->bg_wnd_fifo);
+        fgb_fifo_clear(&ppu->sprite_fifo);
+        ppu->fast_line = false;
+        ppu->frame_skipped = ppu->skip_next_frame;
         ppu->reset = false;
 
         return false;
@@ -293,30 +472,7 @@ bool fgb_ppu_tick(fgb_ppu* ppu) {
     ppu->dma_cycles++;
     ppu->scanline_cycles++;
 
-    if (ppu->dma_active && ppu->dma_cycles > 4) {
-        ppu->oam_blocked = true;
-
-        const int bytes_to_transfer = min(ppu->dma_cycles / 4, PPU_DMA_BYTES - ppu->dma_bytes);
-        ppu->dma_cycles -= bytes_to_transfer * 4;
-
-        const fgb_mmu* mmu = &ppu->cpu->mmu;
-
-        for (int i = 0; i < bytes_to_transfer; i++) {
-            const uint16_t src = ppu->dma_addr + ppu->dma_bytes + i;
-            const uint16_t dst = (ppu->dma_bytes + i) % PPU_OAM_SIZE;
-            ppu->oam[dst] = mmu->read_u8(mmu, src);
-        }
-
-        ppu->dma_bytes += bytes_to_transfer;
-
-        if (ppu->dma_bytes >= PPU_DMA_BYTES) {
-            ppu->dma_active = false; // DMA transfer complete
-        }
-    }
-
-    if (!ppu->dma_active && ppu->oam_blocked && ppu->dma_cycles > 4) {
-        ppu->oam_blocked = false;
-    }
+    fgb_ppu_do_dma(ppu);
 
     switch (ppu->stat.mode) {
     case PPU_MODE_OAM_SCAN:
@@ -331,12 +487,24 @@ bool fgb_ppu_tick(fgb_ppu* ppu) {
             if (ppu->ly == ppu->window_pos.y) {
                 ppu->reached_window_y = true;
             }
+
+            ppu->fast_line = fgb_ppu_render_line(ppu);
         }
         break;
 
     case PPU_MODE_DRAW:
-        fgb_ppu_pixel_fetcher_tick(ppu); // Fetch pixels into the FIFOs
-        fgb_ppu_lcd_push(ppu); // Try to push pixels to the framebuffer
+        if (ppu->fast_line) {
+            // Already drawn, only wait as long as the FIFO would have taken
+            if (ppu->mode_cycles >= ppu->fast_line_cycles) {
+                ppu->fast_line = false;
+                ppu->framebuffer_x = SCREEN_WIDTH;
+                ppu->reached_window_x = ppu->fast_line_window;
+                ppu->sprite_fifo = ppu->fast_line_sprites;
+            }
+        } else {
+            fgb_ppu_pixel_fetcher_tick(ppu); // Fetch pixels into the FIFOs
+            fgb_ppu_lcd_push(ppu); // Try to push pixels to the framebuffer
+        }
 
         if (ppu->framebuffer_x >= SCREEN_WIDTH) {
             // Reset Fetcher and FIFO state for the next line
@@ -346,7 +514,7 @@ bool fgb_ppu_tick(fgb_ppu* ppu) {
             ppu->processed_pixels = 0;
             ppu->bg_wnd_fetch_step = FETCH_STEP_TILE_0;
             ppu->sprite_fetch_active = false;
-            fgb_queue_clear(&ppu->bg_wnd_fifo);
+            fgb_fifo_clear(&ppu->bg_wnd_fifo);
 
             // Increment window line counter every time a scanline
             // has any window pixels drawn
@@ -381,7 +549,9 @@ bool fgb_ppu_tick(fgb_ppu* ppu) {
             if (ppu->ly == 144) {
                 ppu->stat.mode = PPU_MODE_VBLANK;
                 fgb_cpu_request_interrupt(ppu->cpu, IRQ_VBLANK);
-                fgb_ppu_swap_buffers(ppu);
+                if (!ppu->frame_skipped) {
+                    fgb_ppu_swap_buffers(ppu);
+                }
 
                 ppu->reached_window_x = false;
                 ppu->reached_window_y = false;
@@ -403,6 +573,7 @@ bool fgb_ppu_tick(fgb_ppu* ppu) {
                 ppu->stat.mode = PPU_MODE_OAM_SCAN;
                 ppu->frame_cycles = 0; // Reset frame cycles
                 ppu->frames_rendered++;
+                ppu->frame_skipped = ppu->skip_next_frame;
 
                 return true;
             }
@@ -419,10 +590,199 @@ bool fgb_ppu_tick(fgb_ppu* ppu) {
     return false;
 }
 
+void fgb_ppu_advance(fgb_ppu* ppu, uint32_t cycles) {
+    while (cycles > 0) {
+        const uint32_t idle = fgb_ppu_idle_cycles(ppu);
+        if (idle == FGB_SCHEDULER_NO_EVENT) {
+            return; // LCD is off, nothing will happen until it's turned back on
+        }
+
+        if (idle == 0) {
+            fgb_ppu_tick(ppu);
+            cycles--;
+            continue;
+        }
+
+        const uint32_t skip = min(idle, cycles);
+        ppu->mode_cycles += skip;
+        ppu->frame_cycles += skip;
+        ppu->dma_cycles += (int)skip;
+        ppu->scanline_cycles += skip;
+        cycles -= skip;
+    }
+}
+
+uint32_t fgb_ppu_next_event(const fgb_ppu* ppu) {
+    const uint32_t idle = fgb_ppu_idle_cycles(ppu);
+    if (idle == FGB_SCHEDULER_NO_EVENT) {
+        return FGB_SCHEDULER_NO_EVENT;
+    }
+
+    // Mode 3 can't end before every remaining pixel of the line has been pushed,
+    // and interrupts are only requested on mode transitions
+    if (idle == 0 && ppu->stat.mode == PPU_MODE_DRAW && !ppu->dma_active && !ppu->oam_blocked
+        && !ppu->reset && fgb_ppu_stat_line(ppu) == ppu->last_stat) {
+        return SCREEN_WIDTH - ppu->framebuffer_x;
+    }
+
+    return idle + 1;
+}
+
+// Returns how many of the upcoming ticks would do nothing but count cycles.
+// The tick that completes a mode is never included.
+uint32_t fgb_ppu_idle_cycles(const fgb_ppu* ppu) {
+    if (!ppu->lcd_control.lcd_ppu_enable) {
+        return ppu->reset ? FGB_SCHEDULER_NO_EVENT : 0;
+    }
+
+    if (ppu->reset || fgb_ppu_stat_line(ppu) != ppu->last_stat) {
+        return 0;
+    }
+
+    const uint32_t dma_idle = fgb_ppu_dma_idle_cycles(ppu);
+    if (dma_idle == 0) {
+        return 0;
+    }
+
+    uint32_t mode_end;
+    switch (ppu->stat.mode) {
+    case PPU_MODE_OAM_SCAN:
+        if (!ppu->oam_scan_done) {
+            return 0;
+        }
+        mode_end = OAM_SCAN_CYCLES;
+        break;
+    case PPU_MODE_DRAW:
+        if (!ppu->fast_line) {
+            return 0;
+        }
+        mode_end = ppu->fast_line_cycles;
+        break;
+    case PPU_MODE_HBLANK:
+        mode_end = ppu->hblank_cycles;
+        break;
+    case PPU_MODE_VBLANK:
+        mode_end = VBLANK_CYCLES;
+        break;
+    default:
+        return 0;
+    }
+
+    const uint32_t idle = mode_end > ppu->mode_cycles + 1 ? mode_end - ppu->mode_cycles - 1 : 0;
+    return min(idle, dma_idle);
+}
+
+// Same as fgb_ppu_idle_cycles, but only for the DMA. A DMA from host memory only
+// has to be looked at when OAM gets blocked and when the transfer completes.
+uint32_t fgb_ppu_dma_idle_cycles(const fgb_ppu* ppu) {
+    if (ppu->dma_active && ppu->dma_source) {
+        const int next = ppu->dma_cycles < PPU_DMA_BLOCK_TICK ? PPU_DMA_BLOCK_TICK : PPU_DMA_DONE_TICK;
+        return next > ppu->dma_cycles + 1 ? (uint32_t)(next - ppu->dma_cycles - 1) : 0;
+    }
+
+    if (ppu->dma_active || ppu->oam_blocked) {
+        return 0;
+    }
+
+    return FGB_SCHEDULER_NO_EVENT;
+}
+
+void fgb_ppu_do_dma(fgb_ppu* ppu) {
+    if (ppu->dma_active && ppu->dma_source) {
+        if (ppu->dma_cycles >= PPU_DMA_BLOCK_TICK) {
+            ppu->oam_blocked = true;
+        }
+
+        if (ppu->dma_cycles >= PPU_DMA_DONE_TICK) {
+            // OAM has been blocked the whole time and the source couldn't change without
+            // going through fgb_ppu_leave_fast_dma, so nobody can tell that the bytes arrive all at once
+            memcpy(ppu->oam, ppu->dma_source, PPU_DMA_BYTES);
+            fgb_ppu_rebuild_sprite_index(ppu);
+            ppu->dma_bytes = PPU_DMA_BYTES;
+            ppu->dma_cycles -= PPU_DMA_DONE_TICK - 1; // Where a byte by byte transfer would be after its last byte
+            ppu->dma_active = false;
+            ppu->dma_source = NULL;
+            fgb_mmu_remap(&ppu->cpu->mmu); // Writes to the source go straight to memory again
+        }
+    }
+    else if (ppu->dma_active && ppu->dma_cycles > 4) {
+        ppu->oam_blocked = true;
+
+        // The source has side effects or depends on the PPU mode (VRAM, OAM, I/O), so read it a byte at a time
+        const int bytes_to_transfer = min(ppu->dma_cycles / 4, PPU_DMA_BYTES - ppu->dma_bytes);
+        ppu->dma_cycles -= bytes_to_transfer * 4;
+
+        const fgb_mmu* mmu = &ppu->cpu->mmu;
+
+        for (int i = 0; i < bytes_to_transfer; i++) {
+            const uint16_t src = ppu->dma_addr + ppu->dma_bytes + i;
+            const uint16_t dst = (ppu->dma_bytes + i) % PPU_OAM_SIZE;
+            fgb_ppu_store_oam(ppu, dst, mmu->read_u8(mmu, src));
+        }
+
+        ppu->dma_bytes += bytes_to_transfer;
+
+        if (ppu->dma_bytes >= PPU_DMA_BYTES) {
+            ppu->dma_active = false; // DMA transfer complete
+        }
+    }
+
+    if (!ppu->dma_active && ppu->oam_blocked && ppu->dma_cycles > 4) {
+        ppu->oam_blocked = false;
+    }
+}
+
+// Called before the memory a DMA copies from in one go can change: a CPU write to it, a bank switch or
+// a remap. The bytes a byte by byte transfer would have read by now are copied from the old memory,
+// which hasn't changed yet, and the rest is read through the MMU a byte at a time.
+void fgb_ppu_leave_fast_dma(fgb_ppu* ppu) {
+    if (!ppu->dma_active || !ppu->dma_source) {
+        return;
+    }
+
+    fgb_cpu_sync(ppu->cpu);
+    if (!ppu->dma_active) {
+        return; // Completed during the sync
+    }
+
+    // The first byte is copied on tick PPU_DMA_BLOCK_TICK and every 4 ticks after that
+    const int due = ppu->dma_cycles >= PPU_DMA_BLOCK_TICK ? min((ppu->dma_cycles - 1) / 4, PPU_DMA_BYTES) : 0;
+    for (int i = 0; i < due; i++) {
+        fgb_ppu_store_oam(ppu, i, ppu->dma_source[i]);
+    }
+
+    ppu->dma_bytes = due;
+    ppu->dma_cycles -= due * 4;
+    ppu->dma_source = NULL;
+
+    // Nothing has run since the last sync, this only moves the PPU's next event to the next tick
+    fgb_cpu_sync(ppu->cpu);
+    fgb_mmu_remap(&ppu->cpu->mmu);
+}
+
 void fgb_ppu_write(fgb_ppu* ppu, uint16_t addr, uint8_t value) {
+    switch (addr) {
+    case 0xFF40:
+    case 0xFF42:
+    case 0xFF43:
+    case 0xFF46:
+    case 0xFF47:
+    case 0xFF48:
+    case 0xFF49:
+    case 0xFF4B:
+        // The rest of the line has to be drawn with the new value
+        fgb_ppu_leave_fast_line(ppu);
+        break;
+    default:
+        break;
+    }
+
     switch (addr) {
     case 0xFF40:
         ppu->lcd_control.value = value;
+        if ((ppu->lcd_control.obj_size ? PPU_SPRITE_H16 : PPU_SPRITE_H) != ppu->sprite_lines_height) {
+            fgb_ppu_rebuild_sprite_index(ppu);
+        }
         break;
 
     case 0xFF41:
@@ -445,12 +805,18 @@ void fgb_ppu_write(fgb_ppu* ppu, uint16_t addr, uint8_t value) {
         break;
 
     case 0xFF46:
+        fgb_ppu_leave_fast_dma(ppu); // A restarted transfer keeps the bytes the old one copied
         ppu->dma = value;
         ppu->oam_blocked = ppu->dma_active; // OAM is blocked if a DMA is already active
         ppu->dma_active = true;
         ppu->dma_addr = (uint16_t)value << 8;
+        ppu->dma_source = ppu->cpu->mmu.paged ? ppu->cpu->mmu.read_pages[value] : NULL;
         ppu->dma_cycles = 0;
         ppu->dma_bytes = 0;
+
+        if (ppu->dma_source) {
+            fgb_mmu_protect(&ppu->cpu->mmu, ppu->dma_source); // Writes to the source end up in fgb_ppu_leave_fast_dma
+        }
         break;
 
     case 0xFF47:
@@ -537,11 +903,14 @@ void fgb_ppu_write_vram(fgb_ppu* ppu, uint16_t addr, uint8_t value) {
        return;
     }
 
-    if (ppu->model == FGB_MODEL_CGB && ppu->vbk == 1) {
-        ppu->vram1[addr] = value;
-    } else {
-        ppu->vram0[addr] = value;
+    const int bank = ppu->model == FGB_MODEL_CGB && ppu->vbk == 1;
+    uint8_t* vram = bank ? ppu->vram1 : ppu->vram0;
+
+    if (addr < TILE_COUNT * TILE_SIZE_BYTES && vram[addr] != value) {
+        ppu->tile_cache_dirty[bank][addr / TILE_SIZE_BYTES] |= 1 << ((addr % TILE_SIZE_BYTES) / 2);
     }
+
+    vram[addr] = value;
 }
 
 uint8_t fgb_ppu_read_vram(const fgb_ppu* ppu, uint16_t addr) {
@@ -565,7 +934,7 @@ void fgb_ppu_write_oam(fgb_ppu* ppu, uint16_t addr, uint8_t value) {
         return;
     }
 
-    ppu->oam[addr] = value;
+    fgb_ppu_store_oam(ppu, addr, value);
 }
 
 uint8_t fgb_ppu_read_oam(const fgb_ppu* ppu, uint16_t addr) {
@@ -580,51 +949,143 @@ uint8_t fgb_ppu_read_oam(const fgb_ppu* ppu, uint16_t addr) {
     return ppu->oam[addr];
 }
 
-static int fgb_ppu_compare_sprites(const void* a, const void* b, void* ctx) {
-    const fgb_ppu* ppu = ctx;
+void fgb_ppu_do_oam_scan(fgb_ppu* ppu) {
+    if (ppu->oam_scan_done) {
+        return;
+    }
 
-    const int idx_a = (int)(*(const uint8_t*)a);
-    const int idx_b = (int)(*(const uint8_t*)b);
-    const fgb_sprite* sprite_a = (const fgb_sprite*)&ppu->oam[idx_a];
-    const fgb_sprite* sprite_b = (const fgb_sprite*)&ppu->oam[idx_b];
+    if (ppu->dma_active) {
+        return; // Wait for DMA to finish
+    }
 
-    if (sprite_a->x == sprite_b->x) {
-        return idx_a - idx_b; // Lower OAM index has priority
+    ppu->sprite_count = 0;
+
+    if (ppu->ly >= SCREEN_HEIGHT) {
+        ppu->oam_scan_done = true;
+        return;
+    }
+
+    // The first 10 sprites in OAM order that cover the line are selected...
+    uint64_t remaining = ppu->sprite_lines[ppu->ly];
+    uint64_t selected = 0;
+    for (int i = 0; i < PPU_SCANLINE_SPRITES && remaining; i++) {
+        const uint64_t lowest = remaining & (~remaining + 1);
+        selected |= lowest;
+        remaining ^= lowest;
+    }
+
+    // ...and then drawn in X order (and OAM index for ties)
+    for (int i = 0; i < PPU_OAM_SPRITES && selected; i++) {
+        const uint8_t offset = ppu->sprite_x_order[i];
+        const uint64_t bit = 1ull << (offset / PPU_SPRITE_SIZE_BYTES);
+        if (selected & bit) {
+            ppu->sprite_buffer[ppu->sprite_count++] = offset;
+            selected ^= bit;
+        }
     }
 
-    return (int)sprite_a->x - (int)sprite_b->x; // Lower X coordinate has priority
+    ppu->oam_scan_done = true;
 }
 
-void fgb_ppu_do_oam_scan(fgb_ppu* ppu) {
-    if (ppu->oam_scan_done) {
+// Writes a byte of OAM and keeps the sprite index in sync with it
+void fgb_ppu_store_oam(fgb_ppu* ppu, uint16_t addr, uint8_t value) {
+    const int sprite = addr / PPU_SPRITE_SIZE_BYTES;
+    const uint8_t old_value = ppu->oam[addr];
+    if (old_value == value) {
         return;
     }
 
-    if (ppu->dma_active) {
-        return; // Wait for DMA to finish
+    switch (addr % PPU_SPRITE_SIZE_BYTES) {
+    case 0: // Y
+        fgb_ppu_index_sprite_lines(ppu, sprite, 0);
+        ppu->oam[addr] = value;
+        fgb_ppu_index_sprite_lines(ppu, sprite, 1ull << sprite);
+        break;
+
+    case 1: // X
+        ppu->oam[addr] = value;
+        fgb_ppu_sort_sprite_x(ppu, sprite);
+        break;
+
+    default:
+        ppu->oam[addr] = value;
+        break;
     }
+}
 
-    ppu->sprite_count = 0;
+// Sets the sprite's bit on the scanlines it covers to set, which is either 0 or the bit itself
+void fgb_ppu_index_sprite_lines(fgb_ppu* ppu, int sprite, uint64_t set) {
+    const int top = ppu->oam[sprite * PPU_SPRITE_SIZE_BYTES] - 16;
+    const int first = max(top, 0);
+    const int last = min(top + ppu->sprite_lines_height, SCREEN_HEIGHT);
+    const uint64_t bit = 1ull << sprite;
 
-    const int sprite_height = ppu->lcd_control.obj_size ? PPU_SPRITE_H16 : PPU_SPRITE_H;
+    for (int line = first; line < last; line++) {
+        ppu->sprite_lines[line] = (ppu->sprite_lines[line] & ~bit) | set;
+    }
+}
 
-    for (int i = 0; i < PPU_OAM_SPRITES; i++) {
-        const fgb_sprite* sprite = (const fgb_sprite*)&ppu->oam[i * PPU_SPRITE_SIZE_BYTES];
-        if (ppu->ly < sprite->y - 16 || ppu->ly >= sprite->y - 16 + sprite_height) {
-            continue; // Sprite is not on this scanline
+// Moves a sprite whose X changed to its new place in sprite_x_order
+void fgb_ppu_sort_sprite_x(fgb_ppu* ppu, int sprite) {
+    const uint8_t offset = (uint8_t)(sprite * PPU_SPRITE_SIZE_BYTES);
+    const int key = fgb_ppu_sprite_x_key(ppu, offset);
+
+    int pos = 0;
+    while (ppu->sprite_x_order[pos] != offset) {
+        pos++;
+    }
+
+    while (pos > 0) {
+        const uint8_t prev = ppu->sprite_x_order[pos - 1];
+        if (fgb_ppu_sprite_x_key(ppu, prev) < key) {
+            break;
         }
 
-        ppu->sprite_buffer[ppu->sprite_count++] = i * PPU_SPRITE_SIZE_BYTES;
-        
-        if (ppu->sprite_count >= PPU_SCANLINE_SPRITES) {
+        ppu->sprite_x_order[pos] = prev;
+        pos--;
+    }
+
+    while (pos < PPU_OAM_SPRITES - 1) {
+        const uint8_t next = ppu->sprite_x_order[pos + 1];
+        if (fgb_ppu_sprite_x_key(ppu, next) > key) {
             break;
         }
+
+        ppu->sprite_x_order[pos] = next;
+        pos++;
     }
 
-    // Sort sprites by X coordinate (and OAM index for ties)
-    sort_r(ppu->sprite_buffer, ppu->sprite_count, sizeof(uint8_t), fgb_ppu_compare_sprites, ppu);
+    ppu->sprite_x_order[pos] = offset;
+}
 
-    ppu->oam_scan_done = true;
+int fgb_ppu_sprite_x_key(const fgb_ppu* ppu, uint8_t offset) {
+    return (ppu->oam[offset + 1] << 8) | offset;
+}
+
+// Builds the sprite index from scratch, after OAM was replaced or the sprite size changed
+void fgb_ppu_rebuild_sprite_index(fgb_ppu* ppu) {
+    memset(ppu->sprite_lines, 0, sizeof(ppu->sprite_lines));
+    ppu->sprite_lines_height = ppu->lcd_control.obj_size ? PPU_SPRITE_H16 : PPU_SPRITE_H;
+
+    for (int i = 0; i < PPU_OAM_SPRITES; i++) {
+        fgb_ppu_index_sprite_lines(ppu, i, 1ull << i);
+
+        // Insertion sort, OAM is mostly in order already
+        const uint8_t offset = (uint8_t)(i * PPU_SPRITE_SIZE_BYTES);
+        const int key = fgb_ppu_sprite_x_key(ppu, offset);
+        int pos = i;
+        while (pos > 0) {
+            const uint8_t prev = ppu->sprite_x_order[pos - 1];
+            if (fgb_ppu_sprite_x_key(ppu, prev) < key) {
+                break;
+            }
+
+            ppu->sprite_x_order[pos] = prev;
+            pos--;
+        }
+
+        ppu->sprite_x_order[pos] = offset;
+    }
 }
 
 void fgb_ppu_pixel_fetcher_tick(fgb_ppu* ppu) {
@@ -646,85 +1107,36 @@ void fgb_ppu_pixel_fetcher_tick(fgb_ppu* ppu) {
         case FETCH_STEP_TILE_0:
         case FETCH_STEP_TILE_1:
             break;
-        case FETCH_STEP_DATA_LOW_0: {
-            // Handle 8x8 and 8x16 sprites. For 8x16 the tile id's LSB is ignored
-            // and the sprite may span two tiles vertically
-            const int tile_id_base = ppu->current_sprite->tile & (ppu->lcd_control.obj_size ? 0xFE : 0xFF);
-            const int sprite_height = ppu->lcd_control.obj_size ? PPU_SPRITE_H16 : PPU_SPRITE_H;
-            int line = (ppu->ly + 16) - ppu->current_sprite->y; // line within sprite
-
-            if (ppu->current_sprite->y_flip) {
-                line = sprite_height - 1 - line;
-            }
-            line = max(line, 0);
-
-            const int tile_index = tile_id_base + (line >= 8 ? 1 : 0);
-            const int tile_row = 2 * (line % 8);
-            const fgb_tile* tile = fgb_ppu_get_tile_data(ppu, tile_index, true);
-            ppu->sprite_tile_lo = tile->data[tile_row];
-        } break;
+        case FETCH_STEP_DATA_LOW_0:
+            ppu->sprite_tile_lo = fgb_ppu_get_sprite_row(ppu, ppu->current_sprite)[0];
+            break;
         case FETCH_STEP_DATA_LOW_1:
             break;
-        case FETCH_STEP_DATA_HIGH_0: {
-            const int tile_id_base = ppu->current_sprite->tile & (ppu->lcd_control.obj_size ? 0xFE : 0xFF);
-            const int sprite_height = ppu->lcd_control.obj_size ? 16 : 8;
-            int line = (ppu->ly + 16) - ppu->current_sprite->y; // line within sprite 0..height-1
-
-            if (ppu->current_sprite->y_flip) {
-                line = sprite_height - 1 - line;
-            }
-            line = max(line, 0);
-
-            const int tile_index = tile_id_base + (line >= 8 ? 1 : 0);
-            const int tile_row = 2 * (line % 8);
-            const fgb_tile* tile = fgb_ppu_get_tile_data(ppu, tile_index, true);
-            ppu->sprite_tile_hi = tile->data[tile_row + 1];
-        } break;
+        case FETCH_STEP_DATA_HIGH_0:
+            ppu->sprite_tile_hi = fgb_ppu_get_sprite_row(ppu, ppu->current_sprite)[1];
+            break;
         case FETCH_STEP_DATA_HIGH_1:
             break;
         case FETCH_STEP_PUSH_0: {
-            // Push the 8 sprite pixels into the sprite FIFO aligned to the
-            // current framebuffer_x. Each sprite pixel's screen X is
-            // (sprite.x - 8) + sx. We compute its position relative to the
-            // FIFO front (framebuffer_x) and either overwrite a transparent
-            // slot or push blank pixels until the target index is reached.
-            for (int sx = 0; sx < PPU_SPRITE_W; sx++) {
-                const int bit = ppu->current_sprite->x_flip ? (PPU_SPRITE_W - sx - 1) : sx;
-                const uint8_t color = TILE_PIXEL(ppu->sprite_tile_lo, ppu->sprite_tile_hi, bit);
-
-                // Absolute screen X for this sprite pixel
-                const int screen_x = ppu->current_sprite->x - 8 + sx;
-                // Index relative to framebuffer_x
-                const int rel = screen_x - ppu->framebuffer_x;
-
-                if (rel < 0) {
-                    continue; // pixel already past
-                } else if (rel >= PPU_PIXEL_FIFO_SIZE) {
-                    break; // too far to fit in FIFO 
-                }
-
-                const fgb_pixel pixel = {
-                    .color = color,
-                    .palette = ppu->current_sprite->palette,
-                    .sprite_prio = 0,
-                    .bg_prio = ppu->current_sprite->priority,
-                    .is_wnd = false,
-                };
-
-                // If the FIFO already contains an entry at `rel`, only
-                // overwrite it if it's transparent (color == 0). Otherwise
-                // push blanks until we reach `rel` and then push the pixel.
-                if (rel < ppu->sprite_fifo.count) {
-                    fgb_pixel* existing = fgb_queue_at(&ppu->sprite_fifo, rel);
-                    if (existing && existing->color == 0) {
-                        *existing = pixel;
-                    }
-                } else {
-                    while (ppu->sprite_fifo.count < rel) {
-                        fgb_queue_push(&ppu->sprite_fifo, (fgb_pixel){ 0, 0, 0, 0, false });
-                    }
-                    fgb_queue_push(&ppu->sprite_fifo, pixel);
-                }
+            // Overlay the sprite's row onto the sprite FIFO, aligned to the current framebuffer_x.
+            // Pixels left of framebuffer_x are already drawn and shifted out, and the sprite only
+            // gets fetched once it starts at most 8 pixels ahead, so the row always fits.
+            const uint8_t lo = ppu->current_sprite->x_flip ? fgb_flip_byte(ppu->sprite_tile_lo) : ppu->sprite_tile_lo;
+            const uint8_t hi = ppu->current_sprite->x_flip ? fgb_flip_byte(ppu->sprite_tile_hi) : ppu->sprite_tile_hi;
+            const int past = ppu->framebuffer_x + 8 - ppu->current_sprite->x; // Pixels already drawn
+
+            if (past < PPU_SPRITE_W) {
+                fgb_pixel_fifo* fifo = &ppu->sprite_fifo;
+                const uint8_t sprite_lo = (uint8_t)(lo << past);
+                const uint8_t sprite_hi = (uint8_t)(hi << past);
+
+                // Only the transparent pixels of sprites fetched earlier get replaced
+                const uint8_t mask = (uint8_t)((sprite_lo | sprite_hi) & ~(fifo->lo | fifo->hi));
+                fifo->lo |= sprite_lo & mask;
+                fifo->hi |= sprite_hi & mask;
+                fifo->palette = (fifo->palette & ~mask) | (ppu->current_sprite->palette ? mask : 0);
+                fifo->bg_prio = (fifo->bg_prio & ~mask) | (ppu->current_sprite->priority ? mask : 0);
+                fifo->count = max(fifo->count, PPU_SPRITE_W - past);
             }
 
             ppu->sprite_fetch_active = false;
@@ -762,16 +1174,16 @@ void fgb_ppu_pixel_fetcher_tick(fgb_ppu* ppu) {
             }
             break;
         case FETCH_STEP_PUSH_0: {
-            if (!fgb_queue_empty(&ppu->bg_wnd_fifo)) {
+            if (ppu->bg_wnd_fifo.count > 0) {
                 ppu->bg_wnd_fetch_step = FETCH_STEP_PUSH_1; // Wait until there is space in the FIFO
                 break;
             }
 
-            for (int x = 0; x < 8; x++) {
-                const uint8_t pixel_index = TILE_PIXEL(ppu->bg_wnd_tile_lo, ppu->bg_wnd_tile_hi, x);
-                const fgb_pixel pixel = { pixel_index, 0, 0, 0, ppu->is_window_tile };
-                fgb_queue_push(&ppu->bg_wnd_fifo, pixel);
-            }
+            // The whole tile row is loaded into the empty FIFO at once
+            ppu->bg_wnd_fifo.lo = ppu->bg_wnd_tile_lo;
+            ppu->bg_wnd_fifo.hi = ppu->bg_wnd_tile_hi;
+            ppu->bg_wnd_fifo.is_wnd = ppu->is_window_tile ? 0xFF : 0x00;
+            ppu->bg_wnd_fifo.count = PPU_PIXEL_FIFO_SIZE;
 
             ppu->fetch_x++;
         } break;
@@ -784,37 +1196,29 @@ void fgb_ppu_pixel_fetcher_tick(fgb_ppu* ppu) {
 
 void fgb_ppu_lcd_push(fgb_ppu* ppu) {
     // No pixels are pushed to the LCD if the BG/Wnd FIFO is empty or if a sprite fetch is active
-    if (fgb_queue_empty(&ppu->bg_wnd_fifo) || ppu->sprite_fetch_active) {
+    if (ppu->bg_wnd_fifo.count == 0 || ppu->sprite_fetch_active) {
         return;
     }
 
     if (ppu->processed_pixels++ < (ppu->scroll.x % 8)) {
         // Skip pixels until we reach the scroll offset
-        fgb_queue_pop(&ppu->bg_wnd_fifo);
+        fgb_fifo_shift(&ppu->bg_wnd_fifo);
         return;
     }
 
-    uint32_t* framebuffer = ppu->framebuffers[ppu->back_buffer];
-    const fgb_pixel bg_pixel = fgb_queue_pop(&ppu->bg_wnd_fifo);
-    const fgb_pixel sprite_pixel = fgb_queue_empty(&ppu->sprite_fifo)
-        ? (fgb_pixel){ 0, 0, 0, 0 }
-        : fgb_queue_pop(&ppu->sprite_fifo);
-    
-    uint32_t color = 0;
-    if (sprite_pixel.color == 0) {
-        // No sprite pixel, draw background pixel
-        color = fgb_ppu_get_bg_color(ppu, bg_pixel);
-    } else if (sprite_pixel.bg_prio == 1 && bg_pixel.color != 0) {
-        // Sprite is behind background and background pixel is not color 0
-        color = fgb_ppu_get_bg_color(ppu, bg_pixel);
-    } else {
-        // Draw sprite pixel
-        color = fgb_ppu_get_obj_color(ppu, sprite_pixel.color, sprite_pixel.palette);
+    if (!ppu->frame_skipped) {
+        ppu->line_indices[ppu->framebuffer_x] = fgb_ppu_mix_pixel(ppu, &ppu->bg_wnd_fifo, &ppu->sprite_fifo);
     }
-
-    framebuffer[ppu->ly * SCREEN_WIDTH + ppu->framebuffer_x] = color;
     ppu->framebuffer_x++;
 
+    if (ppu->framebuffer_x == SCREEN_WIDTH && !ppu->frame_skipped) {
+        static const uint8_t same_index[PPU_FRAME_PALETTE_SIZE] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+        fgb_ppu_write_line(ppu, ppu->line_indices, same_index);
+    }
+
+    fgb_fifo_shift(&ppu->bg_wnd_fifo);
+    fgb_fifo_shift(&ppu->sprite_fifo);
+
     if (ppu->reached_window_x) {
         return;
     }
@@ -825,15 +1229,340 @@ void fgb_ppu_lcd_push(fgb_ppu* ppu) {
         //ppu->window_line_counter = 0;
         ppu->bg_wnd_fetch_step = FETCH_STEP_TILE_0;
         ppu->fetch_x = 0;
-        fgb_queue_clear(&ppu->bg_wnd_fifo);
+        fgb_fifo_clear(&ppu->bg_wnd_fifo);
     }
 }
 
-void fgb_ppu_try_stat_irq(fgb_ppu* ppu) {
-    const bool stat = (ppu->ly == ppu->lyc && ppu->stat.lyc_int) ||
+// Mixes the pixels at the front of both FIFOs, returns the frame palette index
+uint8_t fgb_ppu_mix_pixel(const fgb_ppu* ppu, const fgb_pixel_fifo* bg_wnd, const fgb_pixel_fifo* sprites) {
+    const int bg_color = fgb_fifo_color(bg_wnd, 0);
+    const int sprite_color = fgb_fifo_color(sprites, 0);
+
+    // No sprite pixel, or the sprite is behind background and background pixel is not color 0
+    if (sprite_color == 0 || ((sprites->bg_prio & 0x80) && bg_color != 0)) {
+        if (ppu->debug.window_color >> 24 && (bg_wnd->is_wnd & 0x80)) {
+            return PPU_FRAME_INDEX_WINDOW; // Debug override
+        }
+
+        return PPU_FRAME_INDEX_BG + fgb_ppu_get_bg_shade(ppu, bg_color);
+    }
+
+    // Draw sprite pixel
+    const int palette = (sprites->palette & 0x80) ? 1 : 0;
+    return PPU_FRAME_INDEX_OBJ + ((ppu->obp[palette].value >> (sprite_color * 2)) & 0x3);
+}
+
+// Stores the current line in the back buffer. values are looked up in indices to get their frame palette index.
+void fgb_ppu_write_line(fgb_ppu* ppu, const uint8_t* values, const uint8_t* indices) {
+    uint8_t* line = &ppu->framebuffers[ppu->back_buffer][ppu->ly * ppu->frame_pitch];
+    uint32_t palette[PPU_FRAME_PALETTE_SIZE];
+
+    switch (ppu->frame_format) {
+    case PPU_FRAME_FORMAT_RGBA8888: {
+        uint32_t colors[PPU_FRAME_PALETTE_SIZE];
+        fgb_ppu_get_frame_palette(ppu, palette);
+        for (int i = 0; i < PPU_FRAME_PALETTE_SIZE; i++) {
+            colors[i] = palette[indices[i]];
+        }
+
+        ppu->simd->map_colors(values, colors, (uint32_t*)line, SCREEN_WIDTH);
+    } break;
+
+    case PPU_FRAME_FORMAT_RGB565: {
+        uint16_t colors[PPU_FRAME_PALETTE_SIZE];
+        fgb_ppu_get_frame_palette(ppu, palette);
+        for (int i = 0; i < PPU_FRAME_PALETTE_SIZE; i++) {
+            colors[i] = fgb_rgba_to_rgb565(palette[indices[i]]);
+        }
+
+        uint16_t* pixels = (uint16_t*)line;
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            pixels[x] = colors[values[x]];
+        }
+    } break;
+
+    case PPU_FRAME_FORMAT_INDEX8:
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            line[x] = indices[values[x]];
+        }
+        break;
+
+    case PPU_FRAME_FORMAT_INDEX2:
+        for (int x = 0; x < SCREEN_WIDTH; x += 4) {
+            line[x / 4] = (uint8_t)(((indices[values[x]] & 0x3) << 6) | ((indices[values[x + 1]] & 0x3) << 4)
+                | ((indices[values[x + 2]] & 0x3) << 2) | (indices[values[x + 3]] & 0x3));
+        }
+        break;
+    }
+}
+
+// Fills a framebuffer with what the LCD shows while it is off
+void fgb_ppu_blank_frame(fgb_ppu* ppu, int buffer) {
+    // White for the color formats, the lightest shade for the index formats
+    const bool is_color = ppu->frame_format == PPU_FRAME_FORMAT_RGBA8888 || ppu->frame_format == PPU_FRAME_FORMAT_RGB565;
+    memset(ppu->framebuffers[buffer], is_color ? 0xFF : PPU_FRAME_INDEX_BG, ppu->frame_pitch * SCREEN_HEIGHT);
+}
+
+uint16_t fgb_rgba_to_rgb565(uint32_t color) {
+    const uint32_t r = color & 0xFF;
+    const uint32_t g = (color >> 8) & 0xFF;
+    const uint32_t b = (color >> 16) & 0xFF;
+    return (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+uint32_t fgb_rgb565_to_rgba(uint16_t color) {
+    const uint32_t r = (color >> 11) & 0x1F;
+    const uint32_t g = (color >> 5) & 0x3F;
+    const uint32_t b = color & 0x1F;
+
+    // Repeat the top bits in the bits that got lost so white stays white
+    return 0xFF000000 | (((b << 3) | (b >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((r << 3) | (r >> 2));
+}
+
+// Returns the row of the sprite's tiles that is on the current line.
+// For 8x16 sprites the tile id's LSB is ignored and rows 8-15 are in the second tile.
+int fgb_ppu_get_sprite_line(const fgb_ppu* ppu, const fgb_sprite* sprite) {
+    const int sprite_height = ppu->lcd_control.obj_size ? PPU_SPRITE_H16 : PPU_SPRITE_H;
+    int line = (ppu->ly + 16) - sprite->y; // line within sprite
+
+    if (sprite->y_flip) {
+        line = sprite_height - 1 - line;
+    }
+
+    return max(line, 0);
+}
+
+// Returns the low and high byte of the sprite's row on the current line
+const uint8_t* fgb_ppu_get_sprite_row(const fgb_ppu* ppu, const fgb_sprite* sprite) {
+    const int line = fgb_ppu_get_sprite_line(ppu, sprite);
+    const int tile_index = (sprite->tile & (ppu->lcd_control.obj_size ? 0xFE : 0xFF)) + (line >= 8 ? 1 : 0);
+    const fgb_tile* tile = fgb_ppu_get_tile_data(ppu, tile_index, true);
+    return &tile->data[2 * (line % 8)];
+}
+
+// Same as fgb_ppu_get_sprite_row, but decoded and already flipped
+const uint8_t* fgb_ppu_get_decoded_sprite_row(fgb_ppu* ppu, const fgb_sprite* sprite) {
+    const int line = fgb_ppu_get_sprite_line(ppu, sprite);
+    const int tile_index = (sprite->tile & (ppu->lcd_control.obj_size ? 0xFE : 0xFF)) + (line >= 8 ? 1 : 0);
+    return fgb_ppu_get_tile_row(ppu, 0, tile_index, line % 8, sprite->x_flip);
+}
+
+// Draws the whole line at the start of mode 3 instead of a pixel per tick through the FIFOs, and works out
+// how long the FIFOs would have taken for it. The result is the same as long as nothing the FIFOs read
+// changes before the line ends, which only a register write can do (VRAM and OAM are blocked).
+// Those go through fgb_ppu_leave_fast_line first. Returns false if the line has to be drawn by the FIFOs.
+bool fgb_ppu_render_line(fgb_ppu* ppu) {
+    if (ppu->dma_active) {
+        return false; // OAM changes underneath the sprite fetches
+    }
+
+    // The window starts after the pixel at WX - 7 is drawn, and is still counted if that is the last pixel of the line
+    const bool window = ppu->lcd_control.wnd_enable && ppu->reached_window_y && (int)ppu->window_pos.x - 7 <= SCREEN_WIDTH;
+    const int window_x = window ? max((int)ppu->window_pos.x - 7, 1) : SCREEN_WIDTH;
+
+    const int sprite_count = ppu->lcd_control.obj_enable ? ppu->sprite_count : 0;
+    int sprite_x[PPU_SCANLINE_SPRITES];
+    ppu->fast_line_cycles = fgb_ppu_line_cycles(ppu, window ? window_x : SCREEN_WIDTH + 1, sprite_count, sprite_x);
+    ppu->fast_line_window = window;
+
+    // Only the timing is needed in a skipped frame. The sprite pixels left over at the end of
+    // the last line show up in the first line of the next frame though, so that line is still drawn.
+    if (ppu->frame_skipped && ppu->ly != SCREEN_HEIGHT - 1) {
+        fgb_fifo_clear(&ppu->fast_line_sprites);
+        return true;
+    }
+
+    uint8_t colors[SCREEN_WIDTH];
+
+    // A tile row at a time, the first and last ones may be cut off
+    const int bg_y = (ppu->ly + ppu->scroll.y) & 0xFF;
+    const int bg_map = TILE_MAP_OFFSET(ppu->lcd_control.bg_tile_map) + TILE_MAP_WIDTH * (bg_y / 8);
+    for (int x = 0; x < window_x;) {
+        const int map_x = (ppu->scroll.x + x) & 0xFF;
+        const int tile_index = fgb_ppu_get_tile_index(ppu, ppu->vram0[bg_map + map_x / 8], false);
+        const int count = min(TILE_WIDTH - map_x % 8, window_x - x);
+        memcpy(&colors[x], &fgb_ppu_get_tile_row(ppu, 0, tile_index, bg_y % 8, false)[map_x % 8], count);
+        x += count;
+    }
+
+    const int wnd_y = ppu->window_line_counter;
+    const int wnd_map = TILE_MAP_OFFSET(ppu->lcd_control.wnd_tile_map) + TILE_MAP_WIDTH * (wnd_y / 8);
+    for (int x = window_x; x < SCREEN_WIDTH; x += TILE_WIDTH) {
+        const int tile_index = fgb_ppu_get_tile_index(ppu, ppu->vram0[wnd_map + (x - window_x) / 8], false);
+        const int count = min(TILE_WIDTH, SCREEN_WIDTH - x);
+        memcpy(&colors[x], fgb_ppu_get_tile_row(ppu, 0, tile_index, wnd_y % 8, false), count);
+    }
+
+    // Sprite pixels by screen X as palette slots (see simd.h). The FIFO may hold pixels
+    // from the end of the previous line, and a sprite can end up to 7 pixels past the right edge.
+    uint8_t sprites[SCREEN_WIDTH + PPU_PIXEL_FIFO_SIZE];
+    memset(sprites, 0, sizeof(sprites));
+
+    int sprite_end = ppu->sprite_fifo.count;
+    for (int i = 0; i < ppu->sprite_fifo.count; i++) {
+        sprites[i] = fgb_fifo_get_slot(&ppu->sprite_fifo, i);
+    }
+
+    for (int i = 0; i < sprite_count && sprite_x[i] >= 0; i++) {
+        const fgb_sprite* sprite = (const fgb_sprite*)&ppu->oam[ppu->sprite_buffer[i]];
+        const uint8_t* row = fgb_ppu_get_decoded_sprite_row(ppu, sprite);
+
+        for (int sx = 0; sx < PPU_SPRITE_W; sx++) {
+            const int screen_x = sprite->x - 8 + sx;
+            if (screen_x < sprite_x[i]) {
+                continue; // Already drawn by the time the sprite was fetched
+            }
+
+            // Earlier sprites win unless they are transparent there
+            if (sprites[screen_x] == 0) {
+                sprites[screen_x] = fgb_ppu_encode_sprite_pixel(row[sx], sprite->palette, sprite->priority);
+            }
+
+            sprite_end = max(sprite_end, screen_x + 1);
+        }
+    }
+
+    // Same as fgb_ppu_mix_pixel for the whole line
+    uint8_t slots[SCREEN_WIDTH];
+    ppu->simd->compose(colors, sprites, slots, SCREEN_WIDTH);
+
+    if (ppu->debug.window_color >> 24) {
+        for (int x = window_x; x < SCREEN_WIDTH; x++) {
+            if (slots[x] < FGB_SIMD_SLOT_OBP0) {
+                slots[x] = FGB_SIMD_SLOT_WINDOW;
+            }
+        }
+    }
+
+    uint8_t indices[FGB_SIMD_SLOT_COUNT] = { 0 };
+    for (int i = 0; i < 4; i++) {
+        indices[FGB_SIMD_SLOT_BG + i] = PPU_FRAME_INDEX_BG + fgb_ppu_get_bg_shade(ppu, i);
+        indices[FGB_SIMD_SLOT_OBP0 + i] = PPU_FRAME_INDEX_OBJ + ((ppu->obp[0].value >> (i * 2)) & 0x3);
+        indices[FGB_SIMD_SLOT_OBP1 + i] = PPU_FRAME_INDEX_OBJ + ((ppu->obp[1].value >> (i * 2)) & 0x3);
+    }
+    indices[FGB_SIMD_SLOT_WINDOW] = PPU_FRAME_INDEX_WINDOW;
+
+    fgb_ppu_write_line(ppu, slots, indices);
+
+    fgb_fifo_clear(&ppu->fast_line_sprites);
+    for (int x = SCREEN_WIDTH; x < sprite_end; x++) {
+        fgb_fifo_set_slot(&ppu->fast_line_sprites, x - SCREEN_WIDTH, sprites[x]);
+    }
+    ppu->fast_line_sprites.count = max(sprite_end - SCREEN_WIDTH, 0);
+
+    return true;
+}
+
+// Converts a sprite pixel to its palette slot for the line kernels, 0 if it is transparent
+uint8_t fgb_ppu_encode_sprite_pixel(int color, int palette, int bg_prio) {
+    if (color == 0) {
+        return 0;
+    }
+
+    const uint8_t slot = (uint8_t)((palette ? FGB_SIMD_SLOT_OBP1 : FGB_SIMD_SLOT_OBP0) + color);
+    return slot | (bg_prio ? FGB_SIMD_SPRITE_BEHIND_BG : 0);
+}
+
+// Returns the length of mode 3 for the current line, and the framebuffer X at which each sprite gets fetched
+// (-1 if the line ends first). window_x is where the window starts, past the end of the line if it doesn't.
+uint32_t fgb_ppu_line_cycles(const fgb_ppu* ppu, int window_x, int sprite_count, int* sprite_x) {
+    const int discard = ppu->scroll.x % 8;
+
+    for (int i = 0; i < sprite_count; i++) {
+        sprite_x[i] = -1;
+    }
+
+    if (sprite_count == 0) {
+        // The first fetch is done twice (12 cycles), then a pixel is pushed or discarded every cycle.
+        // Restarting the fetcher for the window costs 6 more.
+        return 12 + discard + SCREEN_WIDTH + (window_x < SCREEN_WIDTH ? 6 : 0);
+    }
+
+    // How long a sprite stalls the line depends on where the BG fetcher and FIFO are at, so step
+    // through the line like fgb_ppu_pixel_fetcher_tick and fgb_ppu_lcd_push do, without the pixels
+    uint32_t cycles = 0;
+    int x = 0;
+    int fifo = 0;
+    int processed = 0;
+    int step = FETCH_STEP_TILE_0;
+    int sprite_step = FETCH_STEP_TILE_0;
+    int sprite = 0;
+    bool first_fetch = true;
+    bool sprite_active = false;
+
+    while (x < SCREEN_WIDTH) {
+        cycles++;
+
+        if (!sprite_active && sprite < sprite_count && ((const fgb_sprite*)&ppu->oam[ppu->sprite_buffer[sprite]])->x <= x + 8) {
+            sprite_x[sprite++] = x;
+            sprite_active = true;
+            sprite_step = FETCH_STEP_TILE_0;
+            step = FETCH_STEP_TILE_0;
+        }
+
+        if (sprite_active && sprite_step++ == FETCH_STEP_PUSH_0) {
+            sprite_active = false;
+        }
+
+        if (sprite_active) {
+            continue;
+        }
+
+        switch (step++) {
+        case FETCH_STEP_DATA_HIGH_1:
+            if (first_fetch) {
+                step = FETCH_STEP_TILE_0;
+                first_fetch = false;
+            }
+            break;
+        case FETCH_STEP_PUSH_0:
+            if (fifo == 0) {
+                fifo = 8;
+            }
+            break;
+        case FETCH_STEP_PUSH_1:
+            step = FETCH_STEP_TILE_0;
+            break;
+        default:
+            break;
+        }
+
+        if (fifo > 0) {
+            fifo--;
+            if (processed++ >= discard && ++x == window_x) {
+                step = FETCH_STEP_TILE_0;
+                fifo = 0;
+            }
+        }
+    }
+
+    return cycles;
+}
+
+// Draws the current line with the FIFOs from here on. They are run from the start of the line up to
+// the current cycle first, which draws the same pixels again but leaves them where they would have been.
+void fgb_ppu_leave_fast_line(fgb_ppu* ppu) {
+    if (!ppu->fast_line) {
+        return;
+    }
+
+    ppu->fast_line = false;
+
+    for (uint32_t i = 0; i < ppu->mode_cycles; i++) {
+        fgb_ppu_pixel_fetcher_tick(ppu);
+        fgb_ppu_lcd_push(ppu);
+    }
+}
+
+bool fgb_ppu_stat_line(const fgb_ppu* ppu) {
+    return (ppu->ly == ppu->lyc && ppu->stat.lyc_int) ||
         (ppu->stat.mode == PPU_MODE_HBLANK && ppu->stat.hblank_int) ||
         (ppu->stat.mode == PPU_MODE_OAM_SCAN && ppu->stat.oam_int) ||
         (ppu->stat.mode == PPU_MODE_VBLANK && (ppu->stat.vblank_int || ppu->stat.oam_int));
+}
+
+void fgb_ppu_try_stat_irq(fgb_ppu* ppu) {
+    const bool stat = fgb_ppu_stat_line(ppu);
 
     if (!ppu->last_stat && stat) {
         fgb_cpu_request_interrupt(ppu->cpu, IRQ_LCD);
@@ -842,50 +1571,49 @@ void fgb_ppu_try_stat_irq(fgb_ppu* ppu) {
     ppu->last_stat = stat;
 }
 
-void fgb_queue_push(fgb_queue* queue, fgb_pixel pixel) {
-    if (fgb_queue_full(queue)) {
-        log_warn("PPU Pixel Queue Overflow");
+// Drops the pixel at the front
+void fgb_fifo_shift(fgb_pixel_fifo* fifo) {
+    if (fifo->count == 0) {
         return;
     }
 
-    queue->pixels[queue->push_index] = pixel;
-    queue->push_index = (queue->push_index + 1) % PPU_PIXEL_FIFO_SIZE;
-    queue->count++;
+    fifo->lo <<= 1;
+    fifo->hi <<= 1;
+    fifo->palette <<= 1;
+    fifo->bg_prio <<= 1;
+    fifo->is_wnd <<= 1;
+    fifo->count--;
 }
 
-fgb_pixel fgb_queue_pop(fgb_queue* queue) {
-    if (fgb_queue_empty(queue)) {
-        log_warn("PPU Pixel Queue Underflow");
-        return (fgb_pixel) { 0, 0, 0, 0 };
-    }
-
-    const fgb_pixel pixel = queue->pixels[queue->pop_index];
-    queue->pop_index = (queue->pop_index + 1) % PPU_PIXEL_FIFO_SIZE;
-    queue->count--;
-
-    return pixel;
+int fgb_fifo_color(const fgb_pixel_fifo* fifo, int index) {
+    const int bit = 7 - index;
+    return (((fifo->hi >> bit) & 1) << 1) | ((fifo->lo >> bit) & 1);
 }
 
-fgb_pixel* fgb_queue_at(fgb_queue* queue, int index) {
-    if (index < 0 || index >= PPU_PIXEL_FIFO_SIZE) {
-        log_warn("PPU Pixel Queue Index Out of Bounds");
-        return NULL;
-    }
-
-    const int real_index = (queue->pop_index + index) % PPU_PIXEL_FIFO_SIZE;
-    return &queue->pixels[real_index];
+// Returns a sprite pixel as its palette slot, see fgb_ppu_encode_sprite_pixel
+uint8_t fgb_fifo_get_slot(const fgb_pixel_fifo* fifo, int index) {
+    const int bit = 7 - index;
+    return fgb_ppu_encode_sprite_pixel(fgb_fifo_color(fifo, index), (fifo->palette >> bit) & 1, (fifo->bg_prio >> bit) & 1);
 }
 
-bool fgb_queue_full(const fgb_queue* queue) {
-    return queue->count >= PPU_PIXEL_FIFO_SIZE;
+// Writes a sprite pixel given as a palette slot, leaving count as is
+void fgb_fifo_set_slot(fgb_pixel_fifo* fifo, int index, uint8_t slot) {
+    const uint8_t bit = (uint8_t)(0x80 >> index);
+    const int color = slot & 0x03;
+
+    fifo->lo = (fifo->lo & ~bit) | ((color & 1) ? bit : 0);
+    fifo->hi = (fifo->hi & ~bit) | ((color & 2) ? bit : 0);
+    fifo->palette = (fifo->palette & ~bit) | (color && (slot & 0x0F) >= FGB_SIMD_SLOT_OBP1 ? bit : 0);
+    fifo->bg_prio = (fifo->bg_prio & ~bit) | (color && (slot & FGB_SIMD_SPRITE_BEHIND_BG) ? bit : 0);
 }
 
-bool fgb_queue_empty(const fgb_queue* queue) {
-    return queue->count == 0;
+void fgb_fifo_clear(fgb_pixel_fifo* fifo) {
+    memset(fifo, 0, sizeof(fgb_pixel_fifo));
 }
 
-void fgb_queue_clear(fgb_queue* queue) {
-    queue->push_index = 0;
-    queue->pop_index = 0;
-    queue->count = 0;
+// Mirrors a tile row horizontally
+uint8_t fgb_flip_byte(uint8_t value) {
+    value = (uint8_t)(((value & 0xF0) >> 4) | ((value & 0x0F) << 4));
+    value = (uint8_t)(((value & 0xCC) >> 2) | ((value & 0x33) << 2));
+    return (uint8_t)(((value & 0xAA) >> 1) | ((value & 0x55) << 1));
 }
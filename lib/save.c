@@ -0,0 +1,304 @@
+#include "save.h"
+#include "cart.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <ulog.h>
+
+
+#define FGB_SAVE_PAGE_BIT(BITMAP, PAGE) ((BITMAP)[(PAGE) >> 3] & (1 << ((PAGE) & 7)))
+#define FGB_SAVE_RTC_STATE_SIZE_32  44 // Older variant of the RTC state with a 32 bit timestamp
+#define FGB_SAVE_BACKUP_SUFFIX      ".bak"
+
+static FILE* fgb_save_open(fgb_save* save, const char* path);
+static bool fgb_save_backup(const char* path);
+static bool fgb_save_compare(fgb_save* save, size_t offset, const uint8_t* data, size_t size);
+static int fgb_save_flusher(void* arg);
+static size_t fgb_save_page_count(const fgb_save* save);
+static bool fgb_save_any_dirty(const fgb_save* save);
+
+
+fgb_save* fgb_save_create(fgb_cart* cart, const char* path) {
+    if (!fgb_cart_has_battery(cart)) {
+        return NULL;
+    }
+
+    const size_t ram_size = fgb_cart_get_battery_buffered_ram(cart) ? fgb_cart_get_ram_size(cart) : 0;
+    const size_t size = ram_size + (cart->has_rtc ? FGB_CART_RTC_STATE_SIZE : 0);
+    if (size > FGB_SAVE_MAX_PAGES * FGB_SAVE_PAGE_SIZE) {
+        log_error("Cart RAM is too large to be saved (%zu bytes)", size);
+        return NULL;
+    }
+
+    fgb_save* save = malloc(sizeof(fgb_save));
+    if (!save) {
+        log_error("Failed to allocate save");
+        return NULL;
+    }
+
+    memset(save, 0, sizeof(fgb_save));
+    save->cart = cart;
+    save->size = size;
+    save->ram_size = ram_size;
+
+    save->shadow = malloc(size);
+    save->staging = malloc(size);
+    if (!save->shadow || !save->staging) {
+        log_error("Failed to allocate save buffers");
+        free(save->shadow);
+        free(save->staging);
+        free(save);
+        return NULL;
+    }
+
+    save->file = fgb_save_open(save, path);
+    if (!save->file) {
+        free(save->shadow);
+        free(save->staging);
+        free(save);
+        return NULL;
+    }
+
+    memcpy(save->shadow, save->staging, size); // What's in the file now
+    save->running = true;
+
+    if (mtx_init(&save->lock, mtx_plain) != thrd_success || cnd_init(&save->wake) != thrd_success) {
+        log_error("Failed to initialize save synchronization");
+        (void)fclose(save->file);
+        free(save->shadow);
+        free(save->staging);
+        free(save);
+        return NULL;
+    }
+
+    if (thrd_create(&save->flusher, fgb_save_flusher, save) != thrd_success) {
+        log_error("Failed to start save flusher thread");
+        cnd_destroy(&save->wake);
+        mtx_destroy(&save->lock);
+        (void)fclose(save->file);
+        free(save->shadow);
+        free(save->staging);
+        free(save);
+        return NULL;
+    }
+
+    cart->save = save;
+    return save;
+}
+
+void fgb_save_destroy(fgb_save* save) {
+    if (!save) {
+        return;
+    }
+
+    // The game may still be in the middle of writing, but this is the last chance to keep it
+    fgb_save_capture(save);
+
+    mtx_lock(&save->lock);
+    save->running = false;
+    cnd_signal(&save->wake);
+    mtx_unlock(&save->lock);
+
+    (void)thrd_join(save->flusher, NULL);
+
+    log_info("Save: %llu captures, %llu pages written",
+        (unsigned long long)save->captures, (unsigned long long)save->pages_written);
+
+    save->cart->save = NULL;
+
+    cnd_destroy(&save->wake);
+    mtx_destroy(&save->lock);
+    (void)fclose(save->file);
+    free(save->shadow);
+    free(save->staging);
+    free(save);
+}
+
+void fgb_save_capture(fgb_save* save) {
+    uint8_t rtc[FGB_CART_RTC_STATE_SIZE];
+    if (save->cart->has_rtc) {
+        fgb_cart_save_rtc(save->cart, rtc);
+    }
+
+    mtx_lock(&save->lock);
+
+    bool changed = fgb_save_compare(save, 0, fgb_cart_get_battery_buffered_ram(save->cart), save->ram_size);
+    if (save->cart->has_rtc) {
+        changed |= fgb_save_compare(save, save->ram_size, rtc, FGB_CART_RTC_STATE_SIZE);
+    }
+
+    if (changed) {
+        save->captures++;
+        cnd_signal(&save->wake);
+    }
+
+    mtx_unlock(&save->lock);
+}
+
+// Copies data into the shadow at offset and marks the pages that changed. Returns true if any did.
+bool fgb_save_compare(fgb_save* save, size_t offset, const uint8_t* data, size_t size) {
+    bool changed = false;
+
+    for (size_t start = 0; start < size;) {
+        const size_t page = (offset + start) / FGB_SAVE_PAGE_SIZE;
+        const size_t length = min((page + 1) * FGB_SAVE_PAGE_SIZE - (offset + start), size - start);
+
+        if (memcmp(&save->shadow[offset + start], &data[start], length) != 0) {
+            memcpy(&save->shadow[offset + start], &data[start], length);
+            save->dirty[page >> 3] |= 1 << (page & 7);
+            changed = true;
+        }
+
+        start += length;
+    }
+
+    return changed;
+}
+
+// Opens the save file and loads it into the cart, leaving its contents in staging.
+// Files without the RTC state or with the 44 byte RTC state are extended. A file that doesn't fit
+// the cart at all is moved to <path>.bak and a new one is started, it is never overwritten.
+FILE* fgb_save_open(fgb_save* save, const char* path) {
+    FILE* file = fopen(path, "r+b");
+    if (file) {
+        (void)fseek(file, 0, SEEK_END);
+        const long file_size = ftell(file);
+        (void)fseek(file, 0, SEEK_SET);
+
+        const bool short_rtc = save->cart->has_rtc && file_size == (long)(save->ram_size + FGB_SAVE_RTC_STATE_SIZE_32);
+        if ((file_size == (long)save->size || file_size == (long)save->ram_size || short_rtc)
+            && fread(save->staging, 1, (size_t)file_size, file) == (size_t)file_size) {
+            if (save->ram_size > 0) {
+                fgb_cart_load_battery_buffered_ram(save->cart, save->staging, save->ram_size);
+            }
+
+            if (short_rtc) {
+                // Same layout with a 32 bit timestamp, rewritten with a 64 bit one on the first capture
+                memset(&save->staging[save->ram_size + FGB_SAVE_RTC_STATE_SIZE_32], 0,
+                    FGB_CART_RTC_STATE_SIZE - FGB_SAVE_RTC_STATE_SIZE_32);
+                fgb_cart_load_rtc(save->cart, &save->staging[save->ram_size]);
+            } else if (file_size == (long)save->size && save->cart->has_rtc) {
+                fgb_cart_load_rtc(save->cart, &save->staging[save->ram_size]);
+            } else if (save->cart->has_rtc) {
+                // Written with the first capture
+                memset(&save->staging[save->ram_size], 0, FGB_CART_RTC_STATE_SIZE);
+            }
+
+            return file;
+        }
+
+        (void)fclose(file);
+
+        if (!fgb_save_backup(path)) {
+            log_error("Save file %s does not match the cart (%ld bytes, expected %zu) and could not be backed up, not saving",
+                path, file_size, save->size);
+            return NULL;
+        }
+
+        log_warn("Save file %s does not match the cart (%ld bytes, expected %zu), moved it to %s%s",
+            path, file_size, save->size, path, FGB_SAVE_BACKUP_SUFFIX);
+    }
+
+    file = fopen(path, "w+b");
+    if (!file) {
+        log_error("Could not open save file %s", path);
+        return NULL;
+    }
+
+    memset(save->staging, 0, save->size);
+    memset(save->dirty, 0xFF, sizeof(save->dirty));
+    return file;
+}
+
+// Renames path to path.bak, unless there already is a backup
+bool fgb_save_backup(const char* path) {
+    const size_t length = strlen(path);
+    char* backup = malloc(length + sizeof(FGB_SAVE_BACKUP_SUFFIX));
+    if (!backup) {
+        log_error("Failed to allocate backup path");
+        return false;
+    }
+
+    memcpy(backup, path, length);
+    memcpy(backup + length, FGB_SAVE_BACKUP_SUFFIX, sizeof(FGB_SAVE_BACKUP_SUFFIX));
+
+    FILE* existing = fopen(backup, "rb");
+    if (existing) {
+        log_error("Backup %s already exists", backup);
+        (void)fclose(existing);
+        free(backup);
+        return false;
+    }
+
+    const bool renamed = rename(path, backup) == 0;
+    free(backup);
+    return renamed;
+}
+
+int fgb_save_flusher(void* arg) {
+    fgb_save* save = arg;
+
+    mtx_lock(&save->lock);
+
+    while (true) {
+        while (save->running && !fgb_save_any_dirty(save)) {
+            cnd_wait(&save->wake, &save->lock);
+        }
+
+        if (!fgb_save_any_dirty(save)) {
+            break; // Stopped and nothing left to write
+        }
+
+        // Take the dirty pages so the emulation thread can keep capturing while the file is written
+        uint8_t dirty[sizeof(save->dirty)];
+        memcpy(dirty, save->dirty, sizeof(dirty));
+        memset(save->dirty, 0, sizeof(save->dirty));
+        memcpy(save->staging, save->shadow, save->size);
+
+        mtx_unlock(&save->lock);
+
+        size_t page = 0;
+        while (page < fgb_save_page_count(save)) {
+            if (!FGB_SAVE_PAGE_BIT(dirty, page)) {
+                page++;
+                continue;
+            }
+
+            // Write runs of consecutive dirty pages at once
+            const size_t first = page;
+            while (page < fgb_save_page_count(save) && FGB_SAVE_PAGE_BIT(dirty, page)) {
+                page++;
+            }
+
+            const size_t offset = first * FGB_SAVE_PAGE_SIZE;
+            const size_t length = min(page * FGB_SAVE_PAGE_SIZE, save->size) - offset;
+            if (fseek(save->file, (long)offset, SEEK_SET) != 0 || fwrite(&save->staging[offset], 1, length, save->file) != length) {
+                log_error("Failed to write save file");
+            }
+
+            save->pages_written += page - first;
+        }
+
+        (void)fflush(save->file);
+
+        mtx_lock(&save->lock);
+    }
+
+    mtx_unlock(&save->lock);
+    return 0;
+}
+
+size_t fgb_save_page_count(const fgb_save* save) {
+    return (save->size + FGB_SAVE_PAGE_SIZE - 1) / FGB_SAVE_PAGE_SIZE;
+}
+
+bool fgb_save_any_dirty(const fgb_save* save) {
+    for (size_t i = 0; i < sizeof(save->dirty); i++) {
+        if (save->dirty[i]) {
+            return true;
+        }
+    }
+
+    return false;
+}
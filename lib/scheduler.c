@@ -0,0 +1,25 @@
+#include "scheduler.h"
+
+
+void fgb_scheduler_reset(fgb_scheduler* sched, uint64_t now) {
+    for (int i = 0; i < SCHED_EVENT_COUNT; i++) {
+        sched->deadline[i] = now;
+        sched->synced[i] = now;
+    }
+
+    sched->next = now;
+}
+
+void fgb_scheduler_set(fgb_scheduler* sched, enum fgb_sched_event event, uint64_t deadline) {
+    sched->deadline[event] = deadline;
+
+    // With only a handful of components a linear scan beats any heap
+    uint64_t next = sched->deadline[0];
+    for (int i = 1; i < SCHED_EVENT_COUNT; i++) {
+        if (sched->deadline[i] < next) {
+            next = sched->deadline[i];
+        }
+    }
+
+    sched->next = next;
+}
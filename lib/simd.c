@@ -0,0 +1,286 @@
+#include "simd.h"
+
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FGB_SIMD_X86
+#include <immintrin.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define FGB_SIMD_TARGET(ISA)
+#else
+// Only these functions are compiled for the extension, the rest of the library still runs anywhere
+#define FGB_SIMD_TARGET(ISA) __attribute__((target(ISA)))
+#endif
+#endif
+
+
+static uint8_t fgb_simd_compose_pixel(uint8_t bg, uint8_t sprite);
+
+static void fgb_simd_decode_row_scalar(uint8_t lsb, uint8_t msb, uint8_t* pixels, uint8_t* flipped);
+static void fgb_simd_compose_scalar(const uint8_t* bg, const uint8_t* sprites, uint8_t* slots, int count);
+static void fgb_simd_map_colors_scalar(const uint8_t* slots, const uint32_t* table, uint32_t* colors, int count);
+
+#ifdef FGB_SIMD_X86
+static void fgb_simd_decode_row_ssse3(uint8_t lsb, uint8_t msb, uint8_t* pixels, uint8_t* flipped);
+static void fgb_simd_compose_ssse3(const uint8_t* bg, const uint8_t* sprites, uint8_t* slots, int count);
+static void fgb_simd_map_colors_ssse3(const uint8_t* slots, const uint32_t* table, uint32_t* colors, int count);
+static void fgb_simd_split_table(const uint32_t* table, uint8_t planes[4][FGB_SIMD_SLOT_COUNT]);
+static void fgb_simd_compose_avx2(const uint8_t* bg, const uint8_t* sprites, uint8_t* slots, int count);
+static void fgb_simd_map_colors_avx2(const uint8_t* slots, const uint32_t* table, uint32_t* colors, int count);
+#endif
+
+
+static const fgb_simd_kernels fgb_simd_scalar = {
+    .level = FGB_SIMD_SCALAR,
+    .name = "scalar",
+    .decode_row = fgb_simd_decode_row_scalar,
+    .compose = fgb_simd_compose_scalar,
+    .map_colors = fgb_simd_map_colors_scalar,
+};
+
+#ifdef FGB_SIMD_X86
+static const fgb_simd_kernels fgb_simd_ssse3 = {
+    .level = FGB_SIMD_SSSE3,
+    .name = "SSSE3",
+    .decode_row = fgb_simd_decode_row_ssse3,
+    .compose = fgb_simd_compose_ssse3,
+    .map_colors = fgb_simd_map_colors_ssse3,
+};
+
+static const fgb_simd_kernels fgb_simd_avx2 = {
+    .level = FGB_SIMD_AVX2,
+    .name = "AVX2",
+    .decode_row = fgb_simd_decode_row_ssse3, // A row is only 8 pixels
+    .compose = fgb_simd_compose_avx2,
+    .map_colors = fgb_simd_map_colors_avx2,
+};
+#endif
+
+
+enum fgb_simd_level fgb_simd_detect(void) {
+#if defined(FGB_SIMD_X86) && defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    const int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    const bool ssse3 = info[2] & (1 << 9);
+    // AVX needs OSXSAVE and the OS saving the YMM registers too
+    const bool avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+
+    if (avx && max_leaf >= 7) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) {
+            return FGB_SIMD_AVX2;
+        }
+    }
+
+    if (ssse3) {
+        return FGB_SIMD_SSSE3;
+    }
+#elif defined(FGB_SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return FGB_SIMD_AVX2;
+    }
+
+    if (__builtin_cpu_supports("ssse3")) {
+        return FGB_SIMD_SSSE3;
+    }
+#endif
+
+    return FGB_SIMD_SCALAR;
+}
+
+const fgb_simd_kernels* fgb_simd_get_kernels(enum fgb_simd_level level) {
+#ifdef FGB_SIMD_X86
+    if (level >= FGB_SIMD_AVX2) {
+        return &fgb_simd_avx2;
+    }
+
+    if (level >= FGB_SIMD_SSSE3) {
+        return &fgb_simd_ssse3;
+    }
+#else
+    (void)level;
+#endif
+
+    return &fgb_simd_scalar;
+}
+
+// The sprite pixel wins unless it is transparent or behind a BG color other than 0
+uint8_t fgb_simd_compose_pixel(uint8_t bg, uint8_t sprite) {
+    if ((sprite & 0x0F) == 0 || ((sprite & FGB_SIMD_SPRITE_BEHIND_BG) && bg != 0)) {
+        return bg;
+    }
+
+    return sprite & 0x0F;
+}
+
+void fgb_simd_decode_row_scalar(uint8_t lsb, uint8_t msb, uint8_t* pixels, uint8_t* flipped) {
+    for (int x = 0; x < 8; x++) {
+        const uint8_t color = (((msb >> (7 - x)) & 1) << 1) | ((lsb >> (7 - x)) & 1);
+        pixels[x] = color;
+        flipped[7 - x] = color;
+    }
+}
+
+void fgb_simd_compose_scalar(const uint8_t* bg, const uint8_t* sprites, uint8_t* slots, int count) {
+    for (int i = 0; i < count; i++) {
+        slots[i] = fgb_simd_compose_pixel(bg[i], sprites[i]);
+    }
+}
+
+void fgb_simd_map_colors_scalar(const uint8_t* slots, const uint32_t* table, uint32_t* colors, int count) {
+    for (int i = 0; i < count; i++) {
+        colors[i] = table[slots[i]];
+    }
+}
+
+#ifdef FGB_SIMD_X86
+
+FGB_SIMD_TARGET("ssse3")
+void fgb_simd_decode_row_ssse3(uint8_t lsb, uint8_t msb, uint8_t* pixels, uint8_t* flipped) {
+    // Bit of each pixel, the second half mirrored
+    const __m128i bits = _mm_setr_epi8(
+        (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+        0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80);
+
+    const __m128i lo = _mm_cmpeq_epi8(_mm_and_si128(_mm_set1_epi8((char)lsb), bits), bits);
+    const __m128i hi = _mm_cmpeq_epi8(_mm_and_si128(_mm_set1_epi8((char)msb), bits), bits);
+    const __m128i colors = _mm_or_si128(_mm_and_si128(lo, _mm_set1_epi8(1)), _mm_and_si128(hi, _mm_set1_epi8(2)));
+
+    _mm_storel_epi64((__m128i*)pixels, colors);
+    _mm_storel_epi64((__m128i*)flipped, _mm_srli_si128(colors, 8));
+}
+
+FGB_SIMD_TARGET("ssse3")
+void fgb_simd_compose_ssse3(const uint8_t* bg, const uint8_t* sprites, uint8_t* slots, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i slot_mask = _mm_set1_epi8(0x0F);
+    const __m128i behind_bg = _mm_set1_epi8(FGB_SIMD_SPRITE_BEHIND_BG);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i b = _mm_loadu_si128((const __m128i*)&bg[i]);
+        const __m128i s = _mm_loadu_si128((const __m128i*)&sprites[i]);
+        const __m128i slot = _mm_and_si128(s, slot_mask);
+
+        const __m128i transparent = _mm_cmpeq_epi8(slot, zero);
+        const __m128i behind = _mm_cmpeq_epi8(_mm_and_si128(s, behind_bg), behind_bg);
+        const __m128i hidden = _mm_andnot_si128(_mm_cmpeq_epi8(b, zero), behind);
+        const __m128i use_bg = _mm_or_si128(transparent, hidden);
+
+        _mm_storeu_si128((__m128i*)&slots[i], _mm_or_si128(_mm_and_si128(use_bg, b), _mm_andnot_si128(use_bg, slot)));
+    }
+
+    fgb_simd_compose_scalar(&bg[i], &sprites[i], &slots[i], count - i);
+}
+
+// Splits the color table into 4 tables of single bytes, which can be looked up with a byte shuffle
+void fgb_simd_split_table(const uint32_t* table, uint8_t planes[4][FGB_SIMD_SLOT_COUNT]) {
+    for (int slot = 0; slot < FGB_SIMD_SLOT_COUNT; slot++) {
+        for (int plane = 0; plane < 4; plane++) {
+            planes[plane][slot] = (uint8_t)(table[slot] >> (plane * 8));
+        }
+    }
+}
+
+FGB_SIMD_TARGET("ssse3")
+void fgb_simd_map_colors_ssse3(const uint8_t* slots, const uint32_t* table, uint32_t* colors, int count) {
+    uint8_t planes[4][FGB_SIMD_SLOT_COUNT];
+    fgb_simd_split_table(table, planes);
+
+    const __m128i plane0 = _mm_loadu_si128((const __m128i*)planes[0]);
+    const __m128i plane1 = _mm_loadu_si128((const __m128i*)planes[1]);
+    const __m128i plane2 = _mm_loadu_si128((const __m128i*)planes[2]);
+    const __m128i plane3 = _mm_loadu_si128((const __m128i*)planes[3]);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i s = _mm_loadu_si128((const __m128i*)&slots[i]);
+        const __m128i b0 = _mm_shuffle_epi8(plane0, s);
+        const __m128i b1 = _mm_shuffle_epi8(plane1, s);
+        const __m128i b2 = _mm_shuffle_epi8(plane2, s);
+        const __m128i b3 = _mm_shuffle_epi8(plane3, s);
+
+        // Interleave the bytes back into colors
+        const __m128i lo01 = _mm_unpacklo_epi8(b0, b1);
+        const __m128i hi01 = _mm_unpackhi_epi8(b0, b1);
+        const __m128i lo23 = _mm_unpacklo_epi8(b2, b3);
+        const __m128i hi23 = _mm_unpackhi_epi8(b2, b3);
+
+        _mm_storeu_si128((__m128i*)&colors[i + 0], _mm_unpacklo_epi16(lo01, lo23));
+        _mm_storeu_si128((__m128i*)&colors[i + 4], _mm_unpackhi_epi16(lo01, lo23));
+        _mm_storeu_si128((__m128i*)&colors[i + 8], _mm_unpacklo_epi16(hi01, hi23));
+        _mm_storeu_si128((__m128i*)&colors[i + 12], _mm_unpackhi_epi16(hi01, hi23));
+    }
+
+    fgb_simd_map_colors_scalar(&slots[i], table, &colors[i], count - i);
+}
+
+FGB_SIMD_TARGET("avx2")
+void fgb_simd_compose_avx2(const uint8_t* bg, const uint8_t* sprites, uint8_t* slots, int count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i slot_mask = _mm256_set1_epi8(0x0F);
+    const __m256i behind_bg = _mm256_set1_epi8(FGB_SIMD_SPRITE_BEHIND_BG);
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        const __m256i b = _mm256_loadu_si256((const __m256i*)&bg[i]);
+        const __m256i s = _mm256_loadu_si256((const __m256i*)&sprites[i]);
+        const __m256i slot = _mm256_and_si256(s, slot_mask);
+
+        const __m256i transparent = _mm256_cmpeq_epi8(slot, zero);
+        const __m256i behind = _mm256_cmpeq_epi8(_mm256_and_si256(s, behind_bg), behind_bg);
+        const __m256i hidden = _mm256_andnot_si256(_mm256_cmpeq_epi8(b, zero), behind);
+        const __m256i use_bg = _mm256_or_si256(transparent, hidden);
+
+        _mm256_storeu_si256((__m256i*)&slots[i], _mm256_blendv_epi8(slot, b, use_bg));
+    }
+
+    fgb_simd_compose_ssse3(&bg[i], &sprites[i], &slots[i], count - i);
+}
+
+FGB_SIMD_TARGET("avx2")
+void fgb_simd_map_colors_avx2(const uint8_t* slots, const uint32_t* table, uint32_t* colors, int count) {
+    uint8_t planes[4][FGB_SIMD_SLOT_COUNT];
+    fgb_simd_split_table(table, planes);
+
+    // The shuffle works within each 128 bit lane, so both lanes get the whole table
+    const __m256i plane0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)planes[0]));
+    const __m256i plane1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)planes[1]));
+    const __m256i plane2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)planes[2]));
+    const __m256i plane3 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)planes[3]));
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        const __m256i s = _mm256_loadu_si256((const __m256i*)&slots[i]);
+        const __m256i b0 = _mm256_shuffle_epi8(plane0, s);
+        const __m256i b1 = _mm256_shuffle_epi8(plane1, s);
+        const __m256i b2 = _mm256_shuffle_epi8(plane2, s);
+        const __m256i b3 = _mm256_shuffle_epi8(plane3, s);
+
+        const __m256i lo01 = _mm256_unpacklo_epi8(b0, b1);
+        const __m256i hi01 = _mm256_unpackhi_epi8(b0, b1);
+        const __m256i lo23 = _mm256_unpacklo_epi8(b2, b3);
+        const __m256i hi23 = _mm256_unpackhi_epi8(b2, b3);
+
+        // Each of these has 4 colors from the first 16 pixels and 4 from the second
+        const __m256i c0 = _mm256_unpacklo_epi16(lo01, lo23); // 0-3, 16-19
+        const __m256i c1 = _mm256_unpackhi_epi16(lo01, lo23); // 4-7, 20-23
+        const __m256i c2 = _mm256_unpacklo_epi16(hi01, hi23); // 8-11, 24-27
+        const __m256i c3 = _mm256_unpackhi_epi16(hi01, hi23); // 12-15, 28-31
+
+        _mm256_storeu_si256((__m256i*)&colors[i + 0], _mm256_permute2x128_si256(c0, c1, 0x20));
+        _mm256_storeu_si256((__m256i*)&colors[i + 8], _mm256_permute2x128_si256(c2, c3, 0x20));
+        _mm256_storeu_si256((__m256i*)&colors[i + 16], _mm256_permute2x128_si256(c0, c1, 0x31));
+        _mm256_storeu_si256((__m256i*)&colors[i + 24], _mm256_permute2x128_si256(c2, c3, 0x31));
+    }
+
+    fgb_simd_map_colors_ssse3(&slots[i], table, &colors[i], count - i);
+}
+
+#endif
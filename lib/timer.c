@@ -21,6 +21,7 @@ static const uint16_t div_bit_table[] = {
 };
 
 static void fgb_timer_increment(fgb_timer* timer);
+static uint32_t fgb_timer_cycles_until_overflow(const fgb_timer* timer);
 
 void fgb_timer_init(fgb_timer* timer, fgb_cpu* cpu) {
     memset(timer, 0, sizeof(fgb_timer));
@@ -52,6 +53,53 @@ void fgb_timer_tick(fgb_timer* timer) {
     }
 }
 
+void fgb_timer_advance(fgb_timer* timer, uint32_t cycles) {
+    while (cycles > 0) {
+        // The few cycles around an overflow are ticked one by one
+        if (timer->overflow) {
+            fgb_timer_tick(timer);
+            cycles--;
+            continue;
+        }
+
+        uint32_t bulk = cycles;
+        if (timer->enable) {
+            const uint32_t until_overflow = fgb_timer_cycles_until_overflow(timer);
+            if (until_overflow <= bulk) {
+                bulk = until_overflow - 1;
+            }
+        }
+
+        if (bulk == 0) {
+            fgb_timer_tick(timer);
+            cycles--;
+            continue;
+        }
+
+        if (timer->enable) {
+            // Every time the bits below and including the watched bit wrap around, a falling edge occurs
+            const uint32_t period = (uint32_t)div_bit_table[timer->clk_sel] << 1;
+            const uint32_t edges = ((timer->divider & (period - 1)) + bulk) / period;
+            timer->counter = (uint8_t)(timer->counter + edges);
+        }
+
+        timer->divider = (uint16_t)(timer->divider + bulk);
+        cycles -= bulk;
+    }
+}
+
+uint32_t fgb_timer_next_event(const fgb_timer* timer) {
+    if (timer->overflow) {
+        return 1;
+    }
+
+    if (!timer->enable) {
+        return FGB_SCHEDULER_NO_EVENT;
+    }
+
+    return fgb_timer_cycles_until_overflow(timer);
+}
+
 void fgb_timer_reset(fgb_timer* timer) {
     timer->divider = 0xAB00;
     timer->counter = 0;
@@ -119,6 +167,29 @@ void fgb_timer_write(fgb_timer* timer, uint16_t addr, uint8_t value) {
     }
 }
 
+uint32_t fgb_timer_stable_cycles(const fgb_timer* timer, uint16_t addr) {
+    switch (addr) {
+    case TIMER_DIV_ADDRESS:
+        return 0xFF - (timer->divider & 0xFF);
+
+    case TIMER_TIMA_ADDRESS: {
+        if (timer->overflow) {
+            return 0;
+        }
+
+        if (!timer->enable) {
+            return FGB_SCHEDULER_NO_EVENT;
+        }
+
+        const uint32_t period = (uint32_t)div_bit_table[timer->clk_sel] << 1;
+        return period - (timer->divider & (period - 1)) - 1;
+    }
+
+    default:
+        return FGB_SCHEDULER_NO_EVENT; // TMA and TAC only change when written
+    }
+}
+
 uint8_t fgb_timer_read(const fgb_timer* timer, uint16_t addr) {
     switch (addr) {
     case TIMER_DIV_ADDRESS:
@@ -139,6 +210,13 @@ uint8_t fgb_timer_read(const fgb_timer* timer, uint16_t addr) {
     }
 }
 
+uint32_t fgb_timer_cycles_until_overflow(const fgb_timer* timer) {
+    const uint32_t period = (uint32_t)div_bit_table[timer->clk_sel] << 1;
+    const uint32_t first_edge = period - (timer->divider & (period - 1));
+
+    return first_edge + (0xFF - timer->counter) * period;
+}
+
 void fgb_timer_increment(fgb_timer* timer) {
     timer->counter++;
 
@@ -0,0 +1,155 @@
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <ulog.h>
+
+
+#define FGB_TRACE_WRITER_IDLE_NS    1000000 // 1 ms between polls of an empty buffer
+
+static int fgb_trace_writer(void* arg);
+static size_t fgb_trace_drain(fgb_trace* trace);
+
+
+fgb_trace* fgb_trace_create(const char* path, size_t capacity) {
+    fgb_trace* trace = malloc(sizeof(fgb_trace));
+    if (!trace) {
+        log_error("Failed to allocate trace");
+        return NULL;
+    }
+
+    memset(trace, 0, sizeof(fgb_trace));
+
+    trace->capacity = 1;
+    while (trace->capacity < capacity) {
+        trace->capacity <<= 1;
+    }
+
+    trace->records = malloc(trace->capacity * sizeof(fgb_trace_record));
+    if (!trace->records) {
+        log_error("Failed to allocate trace buffer");
+        free(trace);
+        return NULL;
+    }
+
+    trace->file = fopen(path, "wb");
+    if (!trace->file) {
+        log_error("Failed to open trace file %s", path);
+        free(trace->records);
+        free(trace);
+        return NULL;
+    }
+
+    fgb_trace_header header = {
+        .version = FGB_TRACE_VERSION,
+        .record_size = sizeof(fgb_trace_record),
+    };
+    memcpy(header.magic, FGB_TRACE_MAGIC, sizeof(header.magic));
+    (void)fwrite(&header, sizeof(header), 1, trace->file);
+
+    atomic_init(&trace->head, 0);
+    atomic_init(&trace->tail, 0);
+    atomic_init(&trace->running, true);
+
+    if (thrd_create(&trace->writer, fgb_trace_writer, trace) != thrd_success) {
+        log_error("Failed to start trace writer thread");
+        (void)fclose(trace->file);
+        free(trace->records);
+        free(trace);
+        return NULL;
+    }
+
+    return trace;
+}
+
+void fgb_trace_destroy(fgb_trace* trace) {
+    if (!trace) {
+        return;
+    }
+
+    atomic_store_explicit(&trace->running, false, memory_order_release);
+    (void)thrd_join(trace->writer, NULL);
+
+    log_info("Trace: %llu records written, %llu stalls",
+        (unsigned long long)trace->records_written, (unsigned long long)trace->stalls);
+
+    (void)fclose(trace->file);
+    free(trace->records);
+    free(trace);
+}
+
+void fgb_trace_push(fgb_trace* trace, const fgb_trace_record* record) {
+    const size_t head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+
+    if (head - atomic_load_explicit(&trace->tail, memory_order_acquire) == trace->capacity) {
+        trace->stalls++;
+        do {
+            thrd_yield();
+        } while (head - atomic_load_explicit(&trace->tail, memory_order_acquire) == trace->capacity);
+    }
+
+    trace->records[head & (trace->capacity - 1)] = *record;
+    atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+}
+
+bool fgb_trace_read_header(FILE* file, fgb_trace_header* header) {
+    if (fread(header, sizeof(*header), 1, file) != 1) {
+        log_error("Failed to read trace header");
+        return false;
+    }
+
+    if (memcmp(header->magic, FGB_TRACE_MAGIC, sizeof(header->magic)) != 0) {
+        log_error("Not an fgb trace file");
+        return false;
+    }
+
+    if (header->version != FGB_TRACE_VERSION || header->record_size != sizeof(fgb_trace_record)) {
+        log_error("Unsupported trace version %u (record size %u)", header->version, header->record_size);
+        return false;
+    }
+
+    return true;
+}
+
+int fgb_trace_writer(void* arg) {
+    fgb_trace* trace = arg;
+
+    while (atomic_load_explicit(&trace->running, memory_order_acquire)) {
+        if (fgb_trace_drain(trace) == 0) {
+            const struct timespec idle = { .tv_sec = 0, .tv_nsec = FGB_TRACE_WRITER_IDLE_NS };
+            (void)thrd_sleep(&idle, NULL);
+        }
+    }
+
+    // The CPU has stopped pushing, write whatever is left
+    while (fgb_trace_drain(trace) != 0) {
+    }
+
+    (void)fflush(trace->file);
+    return 0;
+}
+
+size_t fgb_trace_drain(fgb_trace* trace) {
+    const size_t tail = atomic_load_explicit(&trace->tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&trace->head, memory_order_acquire);
+    if (head == tail) {
+        return 0;
+    }
+
+    // Only write up to the end of the buffer, the rest wraps around to the next call
+    const size_t start = tail & (trace->capacity - 1);
+    size_t count = head - tail;
+    if (count > trace->capacity - start) {
+        count = trace->capacity - start;
+    }
+
+    if (fwrite(&trace->records[start], sizeof(fgb_trace_record), count, trace->file) != count) {
+        log_error("Failed to write trace records");
+    }
+
+    trace->records_written += count;
+    atomic_store_explicit(&trace->tail, tail + count, memory_order_release);
+
+    return count;
+}
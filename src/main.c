@@ -18,13 +18,7 @@
 
 #include "audio.h"
 #include <fgb/cart.h>
-
-size_t file_size(FILE* f) {
-    fseek(f, 0, SEEK_END);
-    const size_t size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    return size;
-}
+#include <fgb/save.h>
 
 #define DISASM_LINES 20
 #define WINDOW_SCALE 4
@@ -41,18 +35,19 @@ struct app {
     double emu_framerate;
     double emu_update_time;
     bool reset_keep_breakpoints;
+    bool auto_frameskip; // Off by default, skipped frames would show stale pictures while debugging
 
     float main_scale;
     GLFWwindow* window;
 
-    FILE* trace_file;
+    fgb_trace* trace;
 
     uint16_t disasm_addr;
     char disasm_buffer[DISASM_LINES][64];
     char* disasm_buffer_ptrs[DISASM_LINES];
     uint16_t disasm_addrs[DISASM_LINES];
 
-    uint32_t framebuffer_textures[PPU_FRAMEBUFFER_COUNT];
+    uint32_t framebuffer_textures[2]; // Latest frame and the frame in progress
     uint32_t sprite_textures[PPU_OAM_SPRITES];
 };
 
@@ -64,6 +59,7 @@ struct app g_app = {
     .render_framerate = 0.0,
     .emu_framerate = 0.0,
     .reset_keep_breakpoints = true,
+    .auto_frameskip = false,
     .main_scale = 1.0f,
     .window = NULL,
     .disasm_addr = 0x0100,
@@ -74,7 +70,6 @@ struct app g_app = {
 static bool emu_start(void);
 static bool emu_stop(void);
 static void emu_configure(void);
-static void emu_try_save_ram(void);
 
 static char* last_of(char* str, char c) {
     for (size_t i = strlen(str) - 1; i > 0; i--) {
@@ -156,64 +151,29 @@ static void on_step(fgb_cpu* cpu) {
     (void)fflush(stderr);
 }
 
-static void log_cpu_trace(fgb_cpu* cpu, uint16_t addr, uint32_t depth, const char* disasm) {
-    (void)cpu;
-    (void)fprintf(g_app.trace_file, "0x%04X:%*s%s\n", addr, 2 * (depth + 1), "", disasm);
-}
-
 static fgb_emu* emu_init(const char* rom_path) {
     if (!endswith(rom_path, ".gb")) {
         log_error("Unsupported ROM format: %s (only .gb supported)", rom_path);
         exit(1);
     }
 
-    FILE* f;
-    errno_t err = fopen_s(&f, rom_path, "rb");
-    if (err) {
-        printf("Failed to open file %s\n", rom_path);
+    fgb_emu* emu = fgb_emu_create_from_file(rom_path, FGB_MODEL_DMG, APU_SAMPLE_RATE, fgb_audio_push_samples, fgb_audio_get_driver());
+    if (!emu) {
+        printf("Failed to load ROM %s\n", rom_path);
         exit(1);
     }
 
-    const size_t size = file_size(f);
-    uint8_t* data = malloc(size);
-    if (!data) {
-        printf("Failed to allocate memory for ROM\n");
-        fclose(f);
-        exit(1);
-    }
-
-    fread(data, 1, size, f);
-    fclose(f);
-
-    fgb_emu* emu = fgb_emu_create(data, size, APU_SAMPLE_RATE, fgb_audio_push_samples, fgb_audio_get_driver());
-    free(data);
-
     g_app.rom_path = _strdup(rom_path);
 
-    // Try to load battery-backed RAM
-    char* save_path = save_path_from_rom(g_app.rom_path);
-    err = fopen_s(&f, save_path, "rb");
-    free(save_path);
-
-    if (err) {
-        // File does not exist, that's fine
-        return emu;
-    }
-
-    const size_t save_size = file_size(f);
-    uint8_t* save_data = malloc(save_size);
-    if (!save_data) {
-        printf("Failed to allocate memory for save data\n");
-        fclose(f);
-        return emu; // Not really a fatal error so just continue
+    // Loads battery-backed RAM and RTC and keeps the save file up to date from then on
+    if (fgb_cart_has_battery(emu->cart)) {
+        char* save_path = save_path_from_rom(g_app.rom_path);
+        if (!fgb_save_create(emu->cart, save_path)) {
+            log_warn("Battery RAM will not be saved");
+        }
+        free(save_path);
     }
 
-    fread(save_data, 1, save_size, f);
-    fclose(f);
-
-    fgb_cart_load_battery_buffered_ram(emu->cart, save_data, save_size);
-    free(save_data);
-
     return emu;
 }
 
@@ -393,28 +353,22 @@ static void render_cpu_options(void) {
     igBegin("CPU", NULL, ImGuiWindowFlags_None);
 
     if (igButton("Reset", (ImVec2) { 0, 0 })) {
-        uint16_t bps[FGB_CPU_MAX_BREAKPOINTS];
-        memcpy(bps, g_app.emu->cpu->breakpoints, sizeof(bps));
+        if (!g_app.reset_keep_breakpoints) {
+            fgb_cpu_clear_all_bps(g_app.emu->cpu);
+        }
 
         fgb_emu_reset(g_app.emu);
-
-        if (g_app.reset_keep_breakpoints) {
-            memcpy(g_app.emu->cpu->breakpoints, bps, sizeof(bps));
-        }
     }
 
     igSameLine(0.0f, -1.0f);
     if (igButton("Reset Paused", (ImVec2) { 0, 0 })) {
-        uint16_t bps[FGB_CPU_MAX_BREAKPOINTS];
-        memcpy(bps, g_app.emu->cpu->breakpoints, sizeof(bps));
+        if (!g_app.reset_keep_breakpoints) {
+            fgb_cpu_clear_all_bps(g_app.emu->cpu);
+        }
 
         fgb_emu_reset(g_app.emu);
 
-        if (g_app.reset_keep_breakpoints) {
-            memcpy(g_app.emu->cpu->breakpoints, bps, sizeof(bps));
-        }
-
-        g_app.emu->cpu->debugging = true;
+        fgb_cpu_set_debugging(g_app.emu->cpu, true);
         set_disasm_addr(g_app.emu->cpu->regs.pc);
     }
 
@@ -441,6 +395,11 @@ static void render_cpu_options(void) {
         log_info("Screen display %s", g_app.display_screen ? "enabled" : "disabled");
     }
 
+    if (igCheckbox("Auto Frameskip", &g_app.auto_frameskip)) {
+        fgb_emu_set_frameskip(g_app.emu, g_app.auto_frameskip ? FGB_FRAMESKIP_AUTO : 0);
+        log_info("Auto frameskip %s", g_app.auto_frameskip ? "enabled" : "disabled");
+    }
+
     if (igButton("Reset CPU", (ImVec2) { 0, 0 })) {
         fgb_cpu_reset(g_app.emu->cpu);
         log_info("CPU reset");
@@ -465,13 +424,13 @@ static void render_cpu_options(void) {
     igBeginDisabled(!g_app.emu->cpu->debugging);
 
     if (igButton("Step Over", (ImVec2) { 0, 0 })) {
-        g_app.emu->cpu->do_step = true;
+        fgb_cpu_request_step(g_app.emu->cpu);
     }
 
     igSameLine(0.0f, -1.0f);
     
     if (igButton("Continue", (ImVec2) { 0, 0 })) {
-        g_app.emu->cpu->debugging = false;
+        fgb_cpu_set_debugging(g_app.emu->cpu, false);
     }
 
     igEndDisabled();
@@ -479,7 +438,7 @@ static void render_cpu_options(void) {
     igSameLine(0.0f, -1.0f);
 
     if (igButton("Pause", (ImVec2) { 0, 0 })) {
-        g_app.emu->cpu->debugging = true;
+        fgb_cpu_set_debugging(g_app.emu->cpu, true);
         log_info("Execution stopped at 0x%04X", g_app.emu->cpu->regs.pc);
         set_disasm_addr(g_app.emu->cpu->regs.pc);
     }
@@ -533,7 +492,8 @@ static void render_cpu_options(void) {
 
     if (igBeginTable("cpu_table", 2, ImGuiTableFlags_SizingStretchProp | ImGuiTableFlags_BordersInnerV, (ImVec2) { 0, 0 }, 0.0f)) {
         // Intentional copy to allow editing without risk of Race Conditions
-        const fgb_cpu_regs before_regs = cpu->regs;
+        fgb_cpu_regs before_regs = cpu->regs;
+        before_regs.f = fgb_cpu_get_f(cpu); // F may still be pending
         fgb_cpu_regs regs = before_regs;
 
         // Left column: registers
@@ -557,7 +517,7 @@ static void render_cpu_options(void) {
             igInputScalar("##F", ImGuiDataType_U8, &regs.f, NULL, NULL, "%02X", ImGuiInputTextFlags_CharsHexadecimal);
 
             igTableSetColumnIndex(3);
-            igText("AF: %04X", cpu->regs.af);
+            igText("AF: %04X", before_regs.af);
 
             // Row: B / C   | inputs | BC
             igTableNextRow(0, 0);
@@ -624,6 +584,7 @@ static void render_cpu_options(void) {
         if (memcmp(&before_regs, &regs, sizeof(fgb_cpu_regs)) != 0) {
             // Registers were modified, apply changes
             cpu->regs = regs;
+            fgb_cpu_set_f(cpu, regs.f);
         }
 
         // Right column: flags + misc
@@ -853,13 +814,11 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
             fgb_cpu_dump_state(emu->cpu);
         }
         if (key == GLFW_KEY_N) {
-            if (emu->cpu->debugging) {
-                emu->cpu->do_step = true;
-            }
+            fgb_cpu_request_step(emu->cpu);
         }
         if (key == GLFW_KEY_C) {
             if (emu->cpu->debugging) {
-                emu->cpu->debugging = false;
+                fgb_cpu_set_debugging(emu->cpu, false);
                 log_info("Continuing execution");
             }
         }
@@ -980,9 +939,10 @@ bool emu_stop(void) {
 
 void emu_configure(void) {
     set_disasm_addr(0x100);
+    fgb_cpu_set_core(g_app.emu->cpu, CPU_CORE_DEBUG); // The frontend can pause and step at any time
     fgb_cpu_set_bp_callback(g_app.emu->cpu, on_breakpoint);
     fgb_cpu_set_step_callback(g_app.emu->cpu, on_step);
-    fgb_cpu_set_trace_callback(g_app.emu->cpu, log_cpu_trace);
+    fgb_cpu_set_trace(g_app.emu->cpu, g_app.trace);
 
     ulog_set_quiet(false);
     ulog_set_level(LOG_DEBUG);
@@ -990,23 +950,7 @@ void emu_configure(void) {
     g_app.emu->cpu->trace_count = 0;
 
     fgb_ppu_set_color_mode(g_app.emu->ppu, PPU_COLOR_MODE_TINTED);
-}
-
-void emu_try_save_ram(void) {
-    const uint8_t* ram = fgb_cart_get_battery_buffered_ram(g_app.emu->cart);
-    if (ram) {
-        char* save_path = save_path_from_rom(g_app.rom_path);
-        FILE* file = fopen(save_path, "wb");
-        if (!file) {
-            log_error("Could not open save file for writing: %s", save_path);
-            return;
-        }
-
-        free(save_path);
-
-        fwrite(ram, 1, fgb_cart_get_ram_size(g_app.emu->cart), file);
-        fclose(file);
-    }
+    fgb_emu_set_frameskip(g_app.emu, g_app.auto_frameskip ? FGB_FRAMESKIP_AUTO : 0);
 }
 
 int main(int argc, char** argv) {
@@ -1031,9 +975,10 @@ int main(int argc, char** argv) {
 
     imgui_init();
 
-    g_app.trace_file = fopen("cpu_trace.log", "w");
-    if (!g_app.trace_file) {
-        printf("Could not open trace log file. Exiting\n");
+    // Binary instruction trace, decoded offline with fgbtrace
+    g_app.trace = fgb_trace_create("cpu_trace.bin", FGB_TRACE_DEFAULT_CAPACITY);
+    if (!g_app.trace) {
+        printf("Could not open trace file. Exiting\n");
         return 1;
     }
 
@@ -1093,7 +1038,7 @@ int main(int argc, char** argv) {
 
         while (accumulator >= emu_frametime) {
             accumulator -= emu_frametime;
-            fgb_cpu_run_frame(g_app.emu->cpu);
+            fgb_emu_run_frame(g_app.emu);
         }
 
         if (current_time - last_title_update >= 1.0) {
@@ -1197,13 +1142,12 @@ int main(int argc, char** argv) {
 
     g_app.running = false;
 
-    emu_try_save_ram();
-    fgb_emu_destroy(g_app.emu);
+    fgb_emu_destroy(g_app.emu); // Also writes the remaining battery RAM
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
 
-    fclose(g_app.trace_file);
+    fgb_trace_destroy(g_app.trace);
     free(g_app.rom_path);
 
     igDestroyContext(NULL);
@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include <GL/glew.h>
@@ -40,6 +41,9 @@ static const int QUAD_INDICES[] = {
 
 static uint32_t* s_texture_data = NULL;
 static uint32_t* s_oam_texture_data = NULL;
+static uint32_t s_frame_rgba[SCREEN_WIDTH * SCREEN_HEIGHT];
+
+static const void* fgb_frame_to_rgba(const fgb_ppu* ppu, const void* frame);
 
 
 uint32_t fgb_create_screen_texture(void) {
@@ -57,22 +61,30 @@ uint32_t fgb_create_screen_texture(void) {
     return texture_id;
 }
 
+// Frames in other formats are converted here before they are uploaded
+const void* fgb_frame_to_rgba(const fgb_ppu* ppu, const void* frame) {
+    if (ppu->frame_format == PPU_FRAME_FORMAT_RGBA8888) {
+        return frame;
+    }
+
+    fgb_ppu_convert_frame(ppu, frame, s_frame_rgba);
+    return s_frame_rgba;
+}
+
 void fgb_upload_screen_texture(uint32_t texture_id, fgb_ppu* ppu) {
     gl_call(glBindTexture(GL_TEXTURE_2D, texture_id));
 
-    fgb_ppu_lock_buffer(ppu);
-    const uint32_t* framebuffer = fgb_ppu_get_front_buffer(ppu);
-    gl_call(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, framebuffer));
-    fgb_ppu_unlock_buffer(ppu);
+    const void* framebuffer = fgb_ppu_acquire_latest_frame(ppu);
+    gl_call(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, fgb_frame_to_rgba(ppu, framebuffer)));
+    fgb_ppu_release_frame(ppu, framebuffer);
 }
 
 void fgb_upload_back_buffer_texture(uint32_t texture_id, fgb_ppu* ppu) {
     gl_call(glBindTexture(GL_TEXTURE_2D, texture_id));
 
-    fgb_ppu_lock_buffer(ppu);
-    const uint32_t* framebuffer = fgb_ppu_get_back_buffer(ppu);
-    gl_call(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, framebuffer));
-    fgb_ppu_unlock_buffer(ppu);
+    // Debug view of the frame in progress, only meaningful on the emulation thread
+    const void* framebuffer = fgb_ppu_get_back_buffer(ppu);
+    gl_call(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, fgb_frame_to_rgba(ppu, framebuffer)));
 }
 
 uint32_t fgb_create_tile_block_texture(int tiles_per_row) {
@@ -95,9 +107,7 @@ uint32_t fgb_create_tile_block_texture(int tiles_per_row) {
     return texture_id;
 }
 
-void fgb_upload_tile_block_texture(uint32_t texture_id, int tiles_per_row, const fgb_ppu* ppu, int tile_block, const fgb_palette* pal) {
-    const fgb_tile* tiles = (const fgb_tile*)(&ppu->vram0[TILE_BLOCK_VRAM_OFFSET(tile_block)]);
-
+void fgb_upload_tile_block_texture(uint32_t texture_id, int tiles_per_row, fgb_ppu* ppu, int tile_block, const fgb_palette* pal) {
     if (!s_texture_data) {
         s_texture_data = malloc(TILE_BLOCK_SIZE_RGBA);
         if (!s_texture_data) {
@@ -107,25 +117,24 @@ void fgb_upload_tile_block_texture(uint32_t texture_id, int tiles_per_row, const
     }
 
     uint32_t* texture_data = s_texture_data;
-    
-    for (int i = 0; i < TILES_PER_BLOCK; i++) {
-        const fgb_tile* tile = tiles + i;
 
-        for (int y = 0; y < TILE_HEIGHT; y++) {
-            for (int x = 0; x < TILE_WIDTH; x++) {
-                const uint8_t pixel_index = fgb_tile_get_pixel(tile, x, y);
+    const int width = tiles_per_row * TILE_WIDTH;
+    const int height = (TILES_PER_BLOCK / tiles_per_row) * TILE_HEIGHT;
+
+    uint32_t table[FGB_SIMD_SLOT_COUNT] = { 0 };
+    memcpy(&table[FGB_SIMD_SLOT_BG], pal->colors, sizeof(pal->colors));
 
-                const int tex_x = (i % tiles_per_row) * TILE_WIDTH + x;
-                const int tex_y = (i / tiles_per_row) * TILE_HEIGHT + y;
-                const int tex_index = (tex_y * (tiles_per_row * TILE_WIDTH)) + tex_x;
+    // Gather a row of the texture from the decoded tiles, then map it to colors in one go
+    uint8_t row[TILES_PER_BLOCK * TILE_WIDTH];
 
-                texture_data[tex_index] = pal->colors[pixel_index];
-            }
+    for (int tex_y = 0; tex_y < height; tex_y++) {
+        for (int i = 0; i < tiles_per_row; i++) {
+            const int tile_index = tile_block * TILES_PER_BLOCK + (tex_y / TILE_HEIGHT) * tiles_per_row + i;
+            memcpy(&row[i * TILE_WIDTH], fgb_ppu_get_tile_row(ppu, 0, tile_index, tex_y % TILE_HEIGHT, false), TILE_WIDTH);
         }
-    }
 
-    const int width = tiles_per_row * TILE_WIDTH;
-    const int height = (TILES_PER_BLOCK / tiles_per_row) * TILE_HEIGHT;
+        ppu->simd->map_colors(row, table, &texture_data[tex_y * width], width);
+    }
 
     gl_call(glBindTexture(GL_TEXTURE_2D, texture_id));
     gl_call(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, texture_data));
@@ -152,7 +161,7 @@ void fgb_create_oam_textures(uint32_t* textures, int count) {
     }
 }
 
-void fgb_upload_oam_textures(const uint32_t* textures, int count, const fgb_ppu* ppu) {
+void fgb_upload_oam_textures(const uint32_t* textures, int count, fgb_ppu* ppu) {
     const size_t texture_width = PPU_SPRITE_W + 2;
     const size_t texture_height = PPU_SPRITE_H16 + 2;
 
@@ -172,13 +181,14 @@ void fgb_upload_oam_textures(const uint32_t* textures, int count, const fgb_ppu*
         const int sprite_x = 1;
         const int sprite_y = 1 + PPU_SPRITE_H;
 
-        const fgb_tile* tile = fgb_ppu_get_tile_data(ppu, sprite->tile, true);
+        const int tile_index = fgb_ppu_get_tile_index(ppu, sprite->tile, true);
 
         for (int y = 0; y < PPU_SPRITE_H; y++) {
+            const int real_y = sprite->y_flip ? (PPU_SPRITE_H - 1 - y) : y;
+            const uint8_t* row = fgb_ppu_get_tile_row(ppu, 0, tile_index, real_y, sprite->x_flip);
+
             for (int x = 0; x < PPU_SPRITE_W; x++) {
-                const int real_x = sprite->x_flip ? (PPU_SPRITE_W - 1 - x) : x;
-                const int real_y = sprite->y_flip ? (PPU_SPRITE_H - 1 - y) : y;
-                const uint8_t pixel_index = fgb_tile_get_pixel(tile, real_x, real_y);
+                const uint8_t pixel_index = row[x];
                 const int tex_x = sprite_x + x;
                 const int tex_y = sprite_y + y;
                 const int tex_index = (tex_y * texture_width) + tex_x;
@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <string.h>
 
 #include <tester.h>
@@ -7,6 +8,7 @@
 
 static fgb_cpu* cpu;
 static int mem_access_count;
+static enum fgb_cpu_backend backend = CPU_BACKEND_INTERPRETER;
 static struct mem_access mem_accesses[16];
 
 static void mock_cpu_init(size_t tester_ins_mem_size, uint8_t* tester_ins_mem);
@@ -39,12 +41,21 @@ static void mock_cpu_init(size_t tester_ins_mem_size, uint8_t* tester_ins_mem) {
     fgb_apu* apu = fgb_apu_create(48000, NULL, NULL);
     cpu = fgb_cpu_create_with(NULL, ppu, apu, &ops);
     cpu->force_disable_interrupts = true;
+    cpu->test_mode = true; // Peripherals are not attached to the tester memory
     mem_access_count = 0;
+
+    if (!fgb_cpu_set_backend(cpu, backend)) {
+        fprintf(stderr, "CPU backend is not supported, using the interpreter\n");
+    }
+}
+
+void mock_cpu_set_backend(enum fgb_cpu_backend value) {
+    backend = value;
 }
 
 void mock_cpu_set_state(struct state* state) {
     cpu->regs.a = state->reg8.A;
-    cpu->regs.f = state->reg8.F;
+    fgb_cpu_set_f(cpu, state->reg8.F);
     cpu->regs.b = state->reg8.B;
     cpu->regs.c = state->reg8.C;
     cpu->regs.d = state->reg8.D;
@@ -58,11 +69,14 @@ void mock_cpu_set_state(struct state* state) {
     cpu->ime = state->interrupts_master_enabled;
 
     mem_access_count = state->num_mem_accesses;
+
+    // The tester replaces instruction memory behind the CPU's back
+    fgb_cpu_flush_blocks(cpu);
 }
 
 void mock_cpu_get_state(struct state* state) {
     state->reg8.A = cpu->regs.a;
-    state->reg8.F = cpu->regs.f;
+    state->reg8.F = fgb_cpu_get_f(cpu);
     state->reg8.B = cpu->regs.b;
     state->reg8.C = cpu->regs.c;
     state->reg8.D = cpu->regs.d;
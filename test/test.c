@@ -3,8 +3,10 @@
 #include <string.h>
 
 #include <tester.h>
+#include <fgb/cpu.h>
 
 extern struct tester_operations mock_cpu_ops;
+extern void mock_cpu_set_backend(enum fgb_cpu_backend backend);
 
 static struct tester_flags flags = {
     .keep_going_on_mismatch = 0,
@@ -21,6 +23,8 @@ static void print_usage(char* progname) {
     printf(" -c     Disable testing of CB prefixed instructions.\n");
     printf(" -p     Print instruction undergoing tests.\n");
     printf(" -v     Print every inputstate that is tested.\n");
+    printf(" -b     Run instructions through the block cache.\n");
+    printf(" -j     Run instructions through the JIT backend.\n");
     printf(" -h     Show this help.\n");
 }
 
@@ -43,6 +47,12 @@ static int parse_args(int argc, char** argv) {
         if (strchr(argv[i] + 1, 'v')) {
             flags.print_verbose_inputs = 1;
         }
+        if (strchr(argv[i] + 1, 'b')) {
+            mock_cpu_set_backend(CPU_BACKEND_CACHED);
+        }
+        if (strchr(argv[i] + 1, 'j')) {
+            mock_cpu_set_backend(CPU_BACKEND_JIT);
+        }
         if (argv[i][1] == 'h') {
             print_usage(argv[0]);
             return 1;
@@ -0,0 +1,101 @@
+// Unit tests for the parts of libfgb that the instruction tester doesn't reach
+//
+// Usage: fgbunit [test name]...
+
+#include "unit.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <ulog.h>
+
+#define UNIT_MAX_REPORTED_FAILURES 10 // Per test, the rest are only counted
+
+typedef struct unit_test {
+    const char* name;
+    void (*run)(void);
+} unit_test;
+
+static const unit_test tests[] = {
+    { "trace", unit_test_trace },
+    { "rtc", unit_test_rtc },
+    { "simd", unit_test_simd },
+    { "frames", unit_test_frames },
+    { "formats", unit_test_formats },
+    { "frameskip", unit_test_frameskip },
+    { "apu", unit_test_apu },
+};
+
+static const uint8_t nintendo_logo[] = {
+    0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83, 0x00, 0x0C, 0x00, 0x0D,
+    0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E, 0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99,
+    0xBB, 0xBB, 0x67, 0x63, 0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E,
+};
+
+static int test_failures;
+
+void unit_fail(const char* file, int line, const char* fmt, ...) {
+    if (test_failures++ >= UNIT_MAX_REPORTED_FAILURES) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    printf("  %s:%d: ", file, line);
+    vprintf(fmt, args);
+    printf("\n");
+    va_end(args);
+}
+
+void unit_make_rom(uint8_t* rom, size_t size, uint8_t cart_type, uint8_t rom_size, uint8_t ram_size) {
+    memset(rom, 0, size);
+    memcpy(&rom[0x104], nintendo_logo, sizeof(nintendo_logo));
+    memcpy(&rom[0x134], "FGBUNIT", 7);
+    rom[0x147] = cart_type;
+    rom[0x148] = rom_size;
+    rom[0x149] = ram_size;
+
+    uint8_t checksum = 0;
+    for (int addr = 0x134; addr <= 0x14C; addr++) {
+        checksum = (uint8_t)(checksum - rom[addr] - 1);
+    }
+    rom[0x14D] = checksum;
+}
+
+static bool should_run(const char* name, int argc, char** argv) {
+    if (argc < 2) {
+        return true;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], name) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int main(int argc, char** argv) {
+    ulog_set_quiet(true);
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        if (!should_run(tests[i].name, argc, argv)) {
+            continue;
+        }
+
+        test_failures = 0;
+        tests[i].run();
+
+        printf("%-12s %s", tests[i].name, test_failures ? "FAILED" : "OK");
+        if (test_failures) {
+            printf(" (%d failures)", test_failures);
+            failed++;
+        }
+        printf("\n");
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,31 @@
+#ifndef FGB_UNIT_H
+#define FGB_UNIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef FGB_UNIT_DATA_DIR
+#define FGB_UNIT_DATA_DIR "data" // Set by CMake, this only works from the repository root
+#endif
+
+#define UNIT_DATA(name) FGB_UNIT_DATA_DIR "/" name
+
+// Fails the running test but keeps it going, so one run reports every mismatch
+#define UNIT_EXPECT(cond, ...) \
+    do { if (!(cond)) { unit_fail(__FILE__, __LINE__, __VA_ARGS__); } } while (0)
+
+void unit_fail(const char* file, int line, const char* fmt, ...);
+
+// Fills rom with a header that passes the cart checks, the rest is zero
+void unit_make_rom(uint8_t* rom, size_t size, uint8_t cart_type, uint8_t rom_size, uint8_t ram_size);
+
+void unit_test_trace(void);
+void unit_test_rtc(void);
+void unit_test_simd(void);
+void unit_test_frames(void);
+void unit_test_formats(void);
+void unit_test_frameskip(void);
+void unit_test_apu(void);
+
+#endif // FGB_UNIT_H
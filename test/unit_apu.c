@@ -0,0 +1,172 @@
+#include "unit.h"
+
+#include <string.h>
+
+#include <fgb/apu.h>
+#include <fgb/cpu.h>
+
+#define UNIT_APU_SAMPLE_RATE    48000
+#define UNIT_APU_PHASES         64
+#define UNIT_APU_PHASE_CYCLES   20000 // A few frame sequencer steps per phase
+#define UNIT_APU_MAX_SAMPLES    (UNIT_APU_PHASES * UNIT_APU_PHASE_CYCLES / 80)
+
+typedef struct unit_apu_output {
+    float samples[UNIT_APU_MAX_SAMPLES * 2];
+    size_t count;
+} unit_apu_output;
+
+static uint64_t rng_state = 0xD1B54A32D192ED03ull;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void collect_samples(const float* samples, size_t frame_count, void* userdata) {
+    unit_apu_output* output = userdata;
+
+    if (output->count + frame_count > UNIT_APU_MAX_SAMPLES) {
+        frame_count = UNIT_APU_MAX_SAMPLES - output->count;
+    }
+
+    memcpy(&output->samples[output->count * 2], samples, frame_count * 2 * sizeof(float));
+    output->count += frame_count;
+}
+
+// The APU as it used to run, one T-cycle at a time
+static void reference_tick(fgb_apu* apu, unit_apu_output* output) {
+    if (!apu->nr52.apu_en) {
+        return;
+    }
+
+    if (apu->cycle_counter++ >= FGB_CPU_CLOCK_SPEED / 512) {
+        fgb_audio_channel_1_fs_tick(&apu->channel1, apu->sequencer_step);
+        fgb_audio_channel_2_fs_tick(&apu->channel2, apu->sequencer_step);
+        fgb_audio_channel_3_fs_tick(&apu->channel3, apu->sequencer_step);
+        fgb_audio_channel_4_fs_tick(&apu->channel4, apu->sequencer_step);
+
+        apu->cycle_counter = 0;
+        apu->sequencer_step = (apu->sequencer_step + 1) % 8;
+    }
+
+    fgb_audio_channel_1_tick(&apu->channel1);
+    fgb_audio_channel_2_tick(&apu->channel2);
+    fgb_audio_channel_3_tick(&apu->channel3);
+    fgb_audio_channel_4_tick(&apu->channel4);
+
+    apu->accumulator += apu->sample_rate;
+    if (apu->accumulator < FGB_CPU_CLOCK_SPEED) {
+        return;
+    }
+    apu->accumulator -= FGB_CPU_CLOCK_SPEED;
+
+    const int8_t samples[4] = { apu->channel1.sample, apu->channel2.sample, apu->channel3.sample, apu->channel4.sample };
+    float left = 0.0f;
+    float right = 0.0f;
+
+    for (int ch = 0; ch < 4; ch++) {
+        if (apu->nr51.value & (0x10 << ch)) {
+            left += ((float)samples[ch] * (float)apu->nr50.vol_l) / (15.0f * 7.0f);
+        }
+        if (apu->nr51.value & (0x01 << ch)) {
+            right += ((float)samples[ch] * (float)apu->nr50.vol_r) / (15.0f * 7.0f);
+        }
+    }
+
+    if (left > 1.0f) left = 1.0f;
+    if (left < -1.0f) left = -1.0f;
+    if (right > 1.0f) right = 1.0f;
+    if (right < -1.0f) right = -1.0f;
+
+    const float frame[2] = { left, right };
+    collect_samples(frame, 1, output);
+}
+
+// Sound registers a game would touch between phases, with the channels retriggered now and then
+static void write_registers(fgb_apu* apu, uint64_t random) {
+    fgb_apu_write(apu, 0xFF10, (uint8_t)(random & 0x7F)); // Sweep
+    fgb_apu_write(apu, 0xFF11, (uint8_t)(random >> 8)); // Duty and length
+    fgb_apu_write(apu, 0xFF12, (uint8_t)(random >> 16) | 0x08); // Envelope
+    fgb_apu_write(apu, 0xFF13, (uint8_t)(random >> 24)); // Period
+    fgb_apu_write(apu, 0xFF14, (uint8_t)((random >> 32) & 0xC7));
+
+    fgb_apu_write(apu, 0xFF16, (uint8_t)(random >> 40));
+    fgb_apu_write(apu, 0xFF17, (uint8_t)(random >> 48) | 0x08);
+    fgb_apu_write(apu, 0xFF18, (uint8_t)(random >> 56));
+    fgb_apu_write(apu, 0xFF19, (uint8_t)((random >> 4) & 0xC7));
+
+    fgb_apu_write(apu, 0xFF1A, 0x80);
+    fgb_apu_write(apu, 0xFF1C, (uint8_t)(random >> 20) & 0x60);
+    fgb_apu_write(apu, 0xFF1D, (uint8_t)(random >> 28));
+    fgb_apu_write(apu, 0xFF30 + (random >> 36) % 16, (uint8_t)(random >> 44));
+    fgb_apu_write(apu, 0xFF1E, (uint8_t)((random >> 52) & 0xC7));
+
+    fgb_apu_write(apu, 0xFF22, (uint8_t)(random >> 12));
+    fgb_apu_write(apu, 0xFF25, (uint8_t)(random >> 60) | 0x0F);
+}
+
+// fgb_apu_advance skips from one frame sequencer step or sample to the next,
+// it has to produce exactly the samples of stepping every T-cycle
+void unit_test_apu(void) {
+    static unit_apu_output stepped;
+    static unit_apu_output advanced;
+    memset(&stepped, 0, sizeof(stepped));
+    memset(&advanced, 0, sizeof(advanced));
+
+    fgb_apu* reference = fgb_apu_create(UNIT_APU_SAMPLE_RATE, NULL, NULL);
+    fgb_apu* apu = fgb_apu_create(UNIT_APU_SAMPLE_RATE, collect_samples, &advanced);
+    UNIT_EXPECT(reference && apu, "could not create the APUs");
+    if (!reference || !apu) {
+        if (reference) fgb_apu_destroy(reference);
+        if (apu) fgb_apu_destroy(apu);
+        return;
+    }
+
+    fgb_apu_reset(reference);
+    fgb_apu_reset(apu);
+
+    for (int phase = 0; phase < UNIT_APU_PHASES; phase++) {
+        const uint64_t random = next_random();
+        write_registers(reference, random);
+        write_registers(apu, random);
+
+        for (uint32_t i = 0; i < UNIT_APU_PHASE_CYCLES; i++) {
+            reference_tick(reference, &stepped);
+        }
+
+        // Chunks from single cycles up to several frame sequencer steps
+        uint32_t left = UNIT_APU_PHASE_CYCLES;
+        while (left > 0) {
+            uint32_t chunk = 1 + (uint32_t)(next_random() % (phase % 2 ? 50 : 20000));
+            if (chunk > left) {
+                chunk = left;
+            }
+
+            fgb_apu_advance(apu, chunk);
+            left -= chunk;
+        }
+
+        UNIT_EXPECT(apu->cycle_counter == reference->cycle_counter && apu->sequencer_step == reference->sequencer_step,
+            "phase %d: frame sequencer at %u step %u, expected %u step %u", phase,
+            apu->cycle_counter, apu->sequencer_step, reference->cycle_counter, reference->sequencer_step);
+    }
+
+    UNIT_EXPECT(stepped.count > 0, "no samples were produced");
+    // Samples reach the callback in whole chunks, the last partial one is still buffered
+    const size_t expected = stepped.count - stepped.count % apu->sample_chunk;
+    UNIT_EXPECT(advanced.count == expected, "%zu samples, expected %zu", advanced.count, expected);
+
+    const size_t count = advanced.count < stepped.count ? advanced.count : stepped.count;
+    for (size_t i = 0; i < count * 2; i++) {
+        if (advanced.samples[i] != stepped.samples[i]) {
+            UNIT_EXPECT(false, "sample %zu (%s) is %f, expected %f", i / 2, i % 2 ? "right" : "left",
+                advanced.samples[i], stepped.samples[i]);
+            break;
+        }
+    }
+
+    fgb_apu_destroy(reference);
+    fgb_apu_destroy(apu);
+}
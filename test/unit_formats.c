@@ -0,0 +1,118 @@
+#include "unit.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <fgb/emu.h>
+
+#define UNIT_FORMATS_ROM        UNIT_DATA("pokemonred.gb") // Sprites, window and palette fades within the intro
+#define UNIT_FORMATS_FRAMES     900
+#define UNIT_FORMATS_PIXELS     (SCREEN_WIDTH * SCREEN_HEIGHT)
+
+typedef struct unit_format_run {
+    enum fgb_frame_format format;
+    bool obj_colors; // Gives sprites their own colors, INDEX2 only keeps the shade and can't tell them apart
+    fgb_emu* emu;
+    fgb_emu* reference; // Same settings, RGBA8888
+} unit_format_run;
+
+static const char* const format_names[] = { "RGBA8888", "RGB565", "INDEX8", "INDEX2" };
+
+static fgb_emu* create_emu(enum fgb_frame_format format, bool obj_colors) {
+    fgb_emu* emu = fgb_emu_create_from_file(UNIT_FORMATS_ROM, FGB_MODEL_DMG, 48000, NULL, NULL);
+    if (!emu) {
+        return NULL;
+    }
+
+    if (!fgb_ppu_set_frame_format(emu->ppu, format)) {
+        fgb_emu_destroy(emu);
+        return NULL;
+    }
+
+    if (obj_colors) {
+        emu->ppu->obj_palette.colors[0] = 0xFFE0F0FF;
+        emu->ppu->obj_palette.colors[1] = 0xFF3060C0;
+        emu->ppu->obj_palette.colors[2] = 0xFF104080;
+        emu->ppu->obj_palette.colors[3] = 0xFF001020;
+    }
+
+    return emu;
+}
+
+// RGB565 keeps 5 bits of red and blue and 6 of green
+static bool close_to(uint32_t actual, uint32_t expected) {
+    static const int tolerance[4] = { 7, 3, 7, 0 };
+
+    for (int channel = 0; channel < 4; channel++) {
+        const int a = (int)((actual >> (channel * 8)) & 0xFF);
+        const int e = (int)((expected >> (channel * 8)) & 0xFF);
+        if (abs(a - e) > tolerance[channel]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void compare_frame(const unit_format_run* run, int frame, const uint32_t* actual, const uint32_t* expected) {
+    for (int i = 0; i < UNIT_FORMATS_PIXELS; i++) {
+        const bool same = run->format == PPU_FRAME_FORMAT_RGB565 ? close_to(actual[i], expected[i]) : actual[i] == expected[i];
+        if (!same) {
+            UNIT_EXPECT(false, "%s frame %d differs at %d,%d: %08X, expected %08X", format_names[run->format], frame,
+                i % SCREEN_WIDTH, i / SCREEN_WIDTH, actual[i], expected[i]);
+            return;
+        }
+    }
+}
+
+// Draws the same frames in every format and checks that they convert to what RGBA8888 draws
+void unit_test_formats(void) {
+    unit_format_run runs[] = {
+        { .format = PPU_FRAME_FORMAT_RGB565, .obj_colors = true },
+        { .format = PPU_FRAME_FORMAT_INDEX8, .obj_colors = true },
+        { .format = PPU_FRAME_FORMAT_INDEX2, .obj_colors = false },
+    };
+    const int run_count = sizeof(runs) / sizeof(runs[0]);
+
+    static uint32_t actual[UNIT_FORMATS_PIXELS];
+    static uint32_t expected[UNIT_FORMATS_PIXELS];
+
+    bool created = true;
+    for (int i = 0; i < run_count; i++) {
+        runs[i].emu = create_emu(runs[i].format, runs[i].obj_colors);
+        runs[i].reference = create_emu(PPU_FRAME_FORMAT_RGBA8888, runs[i].obj_colors);
+        created = created && runs[i].emu && runs[i].reference;
+    }
+
+    UNIT_EXPECT(created, "could not load %s", UNIT_FORMATS_ROM);
+
+    int sprite_frames = 0;
+    for (int frame = 0; created && frame < UNIT_FORMATS_FRAMES; frame++) {
+        for (int i = 0; i < run_count; i++) {
+            fgb_emu_run_frame(runs[i].emu);
+            fgb_emu_run_frame(runs[i].reference);
+
+            fgb_ppu_convert_frame(runs[i].emu->ppu, fgb_ppu_get_front_buffer(runs[i].emu->ppu), actual);
+            fgb_ppu_convert_frame(runs[i].reference->ppu, fgb_ppu_get_front_buffer(runs[i].reference->ppu), expected);
+            compare_frame(&runs[i], frame, actual, expected);
+
+            // Make sure sprites were actually on screen at some point
+            if (runs[i].format == PPU_FRAME_FORMAT_INDEX8) {
+                const uint8_t* indices = fgb_ppu_get_front_buffer(runs[i].emu->ppu);
+                for (int p = 0; p < UNIT_FORMATS_PIXELS; p++) {
+                    if (indices[p] >= PPU_FRAME_INDEX_OBJ && indices[p] < PPU_FRAME_INDEX_OBJ + 4) {
+                        sprite_frames++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    UNIT_EXPECT(!created || sprite_frames > 0, "no sprite was drawn in %d frames", UNIT_FORMATS_FRAMES);
+
+    for (int i = 0; i < run_count; i++) {
+        fgb_emu_destroy(runs[i].emu);
+        fgb_emu_destroy(runs[i].reference);
+    }
+}
@@ -0,0 +1,93 @@
+#include "unit.h"
+
+#include <stdatomic.h>
+#include <threads.h>
+
+#include <fgb/ppu.h>
+
+#define UNIT_FRAMES_COUNT   20000
+#define UNIT_FRAMES_PIXELS  (SCREEN_WIDTH * SCREEN_HEIGHT)
+
+typedef struct unit_frames_producer {
+    fgb_ppu* ppu;
+    atomic_bool done;
+} unit_frames_producer;
+
+// Stands in for the PPU: every pixel of frame n is n, so a frame the producer is still writing shows up as mixed values
+static int produce_frames(void* arg) {
+    unit_frames_producer* producer = arg;
+
+    for (uint32_t n = 1; n <= UNIT_FRAMES_COUNT; n++) {
+        uint32_t* pixels = (uint32_t*)fgb_ppu_get_back_buffer(producer->ppu);
+        for (int i = 0; i < UNIT_FRAMES_PIXELS; i++) {
+            pixels[i] = n;
+        }
+
+        fgb_ppu_swap_buffers(producer->ppu);
+    }
+
+    atomic_store(&producer->done, true);
+    return 0;
+}
+
+// Returns the pixel value the whole frame has, or UINT32_MAX if it is torn
+static uint32_t frame_number(const uint32_t* pixels) {
+    for (int i = 1; i < UNIT_FRAMES_PIXELS; i++) {
+        if (pixels[i] != pixels[0]) {
+            return UINT32_MAX;
+        }
+    }
+
+    return pixels[0];
+}
+
+// Swaps frames on one thread while another acquires and releases them
+void unit_test_frames(void) {
+    unit_frames_producer producer = { .ppu = fgb_ppu_create() };
+    UNIT_EXPECT(producer.ppu != NULL, "could not create a PPU");
+    if (!producer.ppu) {
+        return;
+    }
+
+    atomic_init(&producer.done, false);
+
+    thrd_t thread;
+    if (thrd_create(&thread, produce_frames, &producer) != thrd_success) {
+        UNIT_EXPECT(false, "could not start the producer thread");
+        fgb_ppu_destroy(producer.ppu);
+        return;
+    }
+
+    uint32_t last = 0;
+    int frames_seen = 0;
+    while (last != UNIT_FRAMES_COUNT) {
+        const bool done = atomic_load(&producer.done);
+
+        const uint32_t* pixels = fgb_ppu_acquire_latest_frame(producer.ppu);
+        const uint32_t first = frame_number(pixels);
+        const uint32_t again = frame_number(pixels); // Still the same while it is held
+        fgb_ppu_release_frame(producer.ppu, pixels);
+
+        UNIT_EXPECT(first != UINT32_MAX && again == first, "torn frame after frame %u", last);
+        UNIT_EXPECT(first >= last, "frame %u acquired after frame %u", first, last);
+        if (first == UINT32_MAX || first < last) {
+            break;
+        }
+
+        if (first != last) {
+            frames_seen++;
+        }
+        last = first;
+
+        // Once the producer is done, the newest frame has to be the last one
+        if (done) {
+            UNIT_EXPECT(last == UNIT_FRAMES_COUNT, "frame %u acquired after the last swap", last);
+            break;
+        }
+    }
+
+    (void)thrd_join(thread, NULL);
+    UNIT_EXPECT(frames_seen > 0, "no frame was acquired");
+
+    fgb_ppu_destroy(producer.ppu);
+}
@@ -0,0 +1,110 @@
+#include "unit.h"
+
+#include <string.h>
+
+#include <fgb/emu.h>
+
+#define UNIT_FRAMESKIP_ROM      UNIT_DATA("pokemonred.gb") // Turns the LCD off and on between scenes
+#define UNIT_FRAMESKIP_FRAMES   1500
+#define UNIT_FRAMESKIP_PIXELS   (SCREEN_WIDTH * SCREEN_HEIGHT)
+#define UNIT_FRAMESKIP_PATTERN  (FGB_FRAMESKIP_MAX + 2) // Frames covering a whole skip cycle
+
+static const int frameskips[] = { 1, 3, FGB_FRAMESKIP_MAX };
+
+// Presses START now and then once the intro is over, so input and the menus it opens are covered too
+static void press_buttons(fgb_emu* emu, int frame) {
+    fgb_emu_set_button(emu, BUTTON_START, frame >= 600 && frame % 120 < 5);
+}
+
+static bool same_state(const fgb_emu* emu, const fgb_emu* reference) {
+    const fgb_cpu* cpu = emu->cpu;
+    const fgb_cpu* ref = reference->cpu;
+
+    return cpu->total_cycles == ref->total_cycles
+        && cpu->regs.pc == ref->regs.pc
+        && cpu->regs.sp == ref->regs.sp
+        && cpu->regs.a == ref->regs.a
+        && fgb_cpu_get_f(cpu) == fgb_cpu_get_f(ref)
+        && cpu->regs.bc == ref->regs.bc
+        && cpu->regs.de == ref->regs.de
+        && cpu->regs.hl == ref->regs.hl
+        && cpu->ime == ref->ime
+        && cpu->mode == ref->mode
+        && cpu->interrupt.enable == ref->interrupt.enable
+        && cpu->interrupt.flags == ref->interrupt.flags
+        && emu->ppu->ly == reference->ppu->ly
+        && emu->ppu->stat.value == reference->ppu->stat.value;
+}
+
+// Skipped frames only leave out the drawing, so the CPU has to see exactly the same machine
+static void run_frameskip(int frameskip) {
+    fgb_emu* emu = fgb_emu_create_from_file(UNIT_FRAMESKIP_ROM, FGB_MODEL_DMG, 48000, NULL, NULL);
+    fgb_emu* reference = fgb_emu_create_from_file(UNIT_FRAMESKIP_ROM, FGB_MODEL_DMG, 48000, NULL, NULL);
+    UNIT_EXPECT(emu && reference, "could not load %s", UNIT_FRAMESKIP_ROM);
+    if (!emu || !reference) {
+        fgb_emu_destroy(emu);
+        fgb_emu_destroy(reference);
+        return;
+    }
+
+    fgb_emu_set_frameskip(emu, frameskip);
+
+    int drawn = 0;
+    bool pattern[UNIT_FRAMESKIP_PATTERN] = { false };
+    for (int frame = 0; frame < UNIT_FRAMESKIP_FRAMES; frame++) {
+        press_buttons(emu, frame);
+        press_buttons(reference, frame);
+        fgb_emu_run_frame(emu);
+        fgb_emu_run_frame(reference);
+
+        if (!same_state(emu, reference)) {
+            UNIT_EXPECT(false, "frameskip %d: frame %d ends at %llu cycles, PC %04X, IF %02X, LY %d, STAT %02X, expected %llu, %04X, %02X, %d, %02X",
+                frameskip, frame, (unsigned long long)emu->cpu->total_cycles, emu->cpu->regs.pc, emu->cpu->interrupt.flags,
+                emu->ppu->ly, emu->ppu->stat.value, (unsigned long long)reference->cpu->total_cycles, reference->cpu->regs.pc,
+                reference->cpu->interrupt.flags, reference->ppu->ly, reference->ppu->stat.value);
+            break;
+        }
+
+        // A frame that was drawn has to be the one drawn without skipping
+        const bool published = atomic_load(&emu->ppu->ready_buffer) & PPU_FRAME_READY;
+        const void* pixels = fgb_ppu_acquire_latest_frame(emu->ppu);
+        const void* expected = fgb_ppu_acquire_latest_frame(reference->ppu);
+        if (published) {
+            UNIT_EXPECT(memcmp(pixels, expected, UNIT_FRAMESKIP_PIXELS * sizeof(uint32_t)) == 0,
+                "frameskip %d: frame %d was drawn differently", frameskip, frame);
+            drawn++;
+        }
+        if (frame < UNIT_FRAMESKIP_PATTERN) {
+            pattern[frame] = published;
+        }
+        fgb_ppu_release_frame(emu->ppu, pixels);
+        fgb_ppu_release_frame(reference->ppu, expected);
+    }
+
+    UNIT_EXPECT(drawn > 0 && drawn < UNIT_FRAMESKIP_FRAMES, "frameskip %d: drew %d of %d frames",
+        frameskip, drawn, UNIT_FRAMESKIP_FRAMES);
+
+    // A reset emulator skips the same frames as a new one, even when reset halfway through a skip
+    fgb_emu_run_frame(emu);
+    fgb_emu_reset(emu);
+    for (int frame = 0; frame < UNIT_FRAMESKIP_PATTERN; frame++) {
+        fgb_emu_set_button(emu, BUTTON_START, false);
+        fgb_emu_run_frame(emu);
+
+        const bool published = atomic_load(&emu->ppu->ready_buffer) & PPU_FRAME_READY;
+        fgb_ppu_release_frame(emu->ppu, fgb_ppu_acquire_latest_frame(emu->ppu));
+        if (published != pattern[frame]) {
+            UNIT_EXPECT(false, "frameskip %d: frame %d after a reset was %s", frameskip, frame, published ? "drawn" : "skipped");
+            break;
+        }
+    }
+
+    fgb_emu_destroy(emu);
+    fgb_emu_destroy(reference);
+}
+
+void unit_test_frameskip(void) {
+    for (size_t i = 0; i < sizeof(frameskips) / sizeof(frameskips[0]); i++) {
+        run_frameskip(frameskips[i]);
+    }
+}
@@ -0,0 +1,276 @@
+#include "unit.h"
+
+#include <string.h>
+
+#include <fgb/cart.h>
+#include <fgb/cpu.h>
+
+#define UNIT_RTC_TRIALS         400
+#define UNIT_RTC_LONG_TRIALS    4 // Long enough for the day counter to overflow
+#define UNIT_RTC_TICK_SECONDS   1000 // Most seconds fgb_cart_tick can take at once
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// The clock as it used to run, one second at a time
+static void reference_second(uint8_t* regs) {
+    if (regs[RTC_DH] & 0x40) {
+        return; // Halted
+    }
+
+    regs[RTC_S] = (regs[RTC_S] + 1) & 0x3F;
+    if (regs[RTC_S] != 60) {
+        return;
+    }
+    regs[RTC_S] = 0;
+
+    regs[RTC_M] = (regs[RTC_M] + 1) & 0x3F;
+    if (regs[RTC_M] != 60) {
+        return;
+    }
+    regs[RTC_M] = 0;
+
+    regs[RTC_H] = (regs[RTC_H] + 1) & 0x1F;
+    if (regs[RTC_H] != 24) {
+        return;
+    }
+    regs[RTC_H] = 0;
+
+    uint16_t days = (uint16_t)(((regs[RTC_DH] & 0x01) << 8) | regs[RTC_DL]);
+    if (++days == 512) {
+        days = 0;
+        regs[RTC_DH] |= 0x80;
+    }
+
+    regs[RTC_DL] = (uint8_t)(days & 0xFF);
+    regs[RTC_DH] = (uint8_t)((regs[RTC_DH] & 0xFE) | (days >> 8));
+}
+
+static fgb_cart* create_rtc_cart(void) {
+    static uint8_t rom[0x8000];
+    unit_make_rom(rom, sizeof(rom), 0x10, 0x00, 0x02); // MBC3+TIMER+RAM+BATTERY, 32 KiB ROM, 8 KiB RAM
+
+    fgb_cart* cart = fgb_cart_load(rom, sizeof(rom));
+    if (cart) {
+        fgb_cart_write(cart, 0x0000, 0x0A); // Enable RAM and RTC
+    }
+
+    return cart;
+}
+
+static void write_regs(fgb_cart* cart, const uint8_t* regs) {
+    for (int i = 0; i < RTC_REG_COUNT; i++) {
+        fgb_cart_write(cart, 0x4000, RTC_REG_START + i);
+        fgb_cart_write(cart, 0xA000, regs[i]);
+    }
+}
+
+static void read_regs(fgb_cart* cart, uint8_t* regs) {
+    for (int i = 0; i < RTC_REG_COUNT; i++) {
+        fgb_cart_write(cart, 0x4000, RTC_REG_START + i);
+        regs[i] = fgb_cart_read(cart, 0xA000);
+    }
+}
+
+static void latch_regs(fgb_cart* cart, uint8_t* regs) {
+    fgb_cart_write(cart, 0x6000, 0x00);
+    fgb_cart_write(cart, 0x6000, 0x01);
+    read_regs(cart, regs);
+}
+
+static void run_seconds(fgb_cart* cart, uint64_t seconds) {
+    while (seconds > 0) {
+        const uint64_t chunk = seconds < UNIT_RTC_TICK_SECONDS ? seconds : UNIT_RTC_TICK_SECONDS;
+        fgb_cart_tick(cart, (uint32_t)(chunk * FGB_CPU_CLOCK_SPEED));
+        seconds -= chunk;
+    }
+}
+
+// Random register values, including the out of range ones a game can write
+static void random_regs(uint8_t* regs, bool in_range) {
+    regs[RTC_S] = (uint8_t)(next_random() & 0x3F);
+    regs[RTC_M] = (uint8_t)(next_random() & 0x3F);
+    regs[RTC_H] = (uint8_t)(next_random() & 0x1F);
+    regs[RTC_DL] = (uint8_t)next_random();
+    regs[RTC_DH] = (uint8_t)(next_random() & 0x81); // Not halted
+
+    if (in_range) {
+        regs[RTC_S] %= 60;
+        regs[RTC_M] %= 60;
+        regs[RTC_H] %= 24;
+    }
+}
+
+// Compares the lazily computed clock against one that is incremented every second
+static void test_against_reference(void) {
+    for (int trial = 0; trial < UNIT_RTC_TRIALS + UNIT_RTC_LONG_TRIALS; trial++) {
+        fgb_cart* cart = create_rtc_cart();
+        UNIT_EXPECT(cart != NULL, "could not create an MBC3 cart");
+        if (!cart) {
+            return;
+        }
+
+        uint8_t expected[RTC_REG_COUNT];
+        random_regs(expected, trial % 3 == 0);
+        write_regs(cart, expected);
+
+        uint64_t seconds;
+        if (trial >= UNIT_RTC_TRIALS) {
+            seconds = 44236800 + next_random() % 1000000; // 512 days and a bit
+        } else if (trial % 2) {
+            seconds = next_random() % 5000;
+        } else {
+            seconds = next_random() % 400000;
+        }
+
+        // Half a second twice, the remainder has to carry over between updates
+        fgb_cart_tick(cart, FGB_CPU_CLOCK_SPEED / 2);
+        uint8_t actual[RTC_REG_COUNT];
+        latch_regs(cart, actual);
+        fgb_cart_tick(cart, FGB_CPU_CLOCK_SPEED / 2);
+        run_seconds(cart, seconds);
+        latch_regs(cart, actual);
+
+        for (uint64_t i = 0; i <= seconds; i++) {
+            reference_second(expected);
+        }
+
+        UNIT_EXPECT(memcmp(expected, actual, sizeof(actual)) == 0,
+            "trial %d, %llu s: %02X:%02X:%02X %02X%02X, expected %02X:%02X:%02X %02X%02X",
+            trial, (unsigned long long)seconds + 1,
+            actual[RTC_H], actual[RTC_M], actual[RTC_S], actual[RTC_DH], actual[RTC_DL],
+            expected[RTC_H], expected[RTC_M], expected[RTC_S], expected[RTC_DH], expected[RTC_DL]);
+
+        fgb_cart_destroy(cart);
+    }
+}
+
+static void test_day_carry(void) {
+    fgb_cart* cart = create_rtc_cart();
+    if (!cart) {
+        return;
+    }
+
+    const uint8_t last_second[RTC_REG_COUNT] = { 59, 59, 23, 0xFF, 0x01 }; // Day 511
+    write_regs(cart, last_second);
+    run_seconds(cart, 1);
+
+    uint8_t actual[RTC_REG_COUNT];
+    latch_regs(cart, actual);
+    UNIT_EXPECT(actual[RTC_S] == 0 && actual[RTC_M] == 0 && actual[RTC_H] == 0 && actual[RTC_DL] == 0,
+        "day 511 didn't wrap to day 0");
+    UNIT_EXPECT(actual[RTC_DH] == 0x80, "DH is %02X after the day counter overflowed, expected 80", actual[RTC_DH]);
+
+    fgb_cart_destroy(cart);
+}
+
+static void test_halt(void) {
+    fgb_cart* cart = create_rtc_cart();
+    if (!cart) {
+        return;
+    }
+
+    const uint8_t halted[RTC_REG_COUNT] = { 10, 20, 5, 0x42, 0x40 };
+    write_regs(cart, halted);
+    run_seconds(cart, 100000);
+
+    uint8_t actual[RTC_REG_COUNT];
+    latch_regs(cart, actual);
+    UNIT_EXPECT(memcmp(halted, actual, sizeof(actual)) == 0, "halted clock moved");
+
+    // Cycles spent halted don't count once it runs again
+    fgb_cart_write(cart, 0x4000, RTC_REG_START + RTC_DH);
+    fgb_cart_write(cart, 0xA000, 0x00);
+    run_seconds(cart, 1);
+    latch_regs(cart, actual);
+    UNIT_EXPECT(actual[RTC_S] == 11 && actual[RTC_M] == 20, "clock at %02X:%02X after resuming, expected 20:11",
+        actual[RTC_M], actual[RTC_S]);
+
+    fgb_cart_destroy(cart);
+}
+
+static uint64_t read_timestamp(const uint8_t* state) {
+    uint64_t timestamp = 0;
+    for (int i = 0; i < 8; i++) {
+        timestamp |= (uint64_t)state[RTC_REG_COUNT * 8 + i] << (i * 8);
+    }
+
+    return timestamp;
+}
+
+static void write_timestamp(uint8_t* state, uint64_t timestamp) {
+    for (int i = 0; i < 8; i++) {
+        state[RTC_REG_COUNT * 8 + i] = (uint8_t)(timestamp >> (i * 8));
+    }
+}
+
+// The 48 byte state: registers, latched registers (4 bytes each) and a 64 bit timestamp
+static void test_save_load(void) {
+    fgb_cart* source = create_rtc_cart();
+    fgb_cart* dest = create_rtc_cart();
+    if (!source || !dest) {
+        fgb_cart_destroy(source);
+        fgb_cart_destroy(dest);
+        return;
+    }
+
+    const uint8_t halted[RTC_REG_COUNT] = { 33, 44, 12, 0x99, 0xC1 };
+    uint8_t latched[RTC_REG_COUNT];
+    write_regs(source, halted);
+    latch_regs(source, latched);
+
+    uint8_t state[FGB_CART_RTC_STATE_SIZE];
+    fgb_cart_save_rtc(source, state);
+    for (int i = 0; i < RTC_REG_COUNT; i++) {
+        UNIT_EXPECT(state[i * 4] == halted[i] && state[(RTC_REG_COUNT + i) * 4] == latched[i],
+            "register %d is not where the save layout puts it", i);
+    }
+
+    // A halted clock doesn't catch up on the time the emulator was closed
+    write_timestamp(state, read_timestamp(state) - 3600);
+    fgb_cart_load_rtc(dest, state);
+
+    uint8_t actual[RTC_REG_COUNT];
+    read_regs(dest, actual);
+    UNIT_EXPECT(memcmp(latched, actual, sizeof(actual)) == 0, "latched registers differ after loading");
+    latch_regs(dest, actual);
+    UNIT_EXPECT(memcmp(halted, actual, sizeof(actual)) == 0, "halted registers differ after loading");
+
+    // A running one does, the second may change between saving and loading
+    const uint8_t running[RTC_REG_COUNT] = { 59, 59, 23, 0x10, 0x00 };
+    write_regs(source, running);
+    fgb_cart_save_rtc(source, state);
+    write_timestamp(state, read_timestamp(state) - 3600);
+    fgb_cart_load_rtc(dest, state);
+    latch_regs(dest, actual);
+
+    uint8_t expected[RTC_REG_COUNT];
+    memcpy(expected, running, sizeof(expected));
+    for (int i = 0; i < 3600; i++) {
+        reference_second(expected);
+    }
+
+    bool matched = false;
+    for (int late = 0; late < 3 && !matched; late++) {
+        matched = memcmp(expected, actual, sizeof(actual)) == 0;
+        reference_second(expected);
+    }
+    UNIT_EXPECT(matched, "clock at day %02X%02X %02X:%02X:%02X after an hour away",
+        actual[RTC_DH], actual[RTC_DL], actual[RTC_H], actual[RTC_M], actual[RTC_S]);
+
+    fgb_cart_destroy(source);
+    fgb_cart_destroy(dest);
+}
+
+void unit_test_rtc(void) {
+    test_against_reference();
+    test_day_carry();
+    test_halt();
+    test_save_load();
+}
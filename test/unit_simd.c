@@ -0,0 +1,119 @@
+#include "unit.h"
+
+#include <string.h>
+
+#include <fgb/simd.h>
+
+#define UNIT_SIMD_MAX_COUNT     160 // Line width, longer than a few AVX2 blocks
+#define UNIT_SIMD_MAX_OFFSET    4 // Unaligned starts
+#define UNIT_SIMD_ROUNDS        16 // Random inputs per count
+#define UNIT_SIMD_GUARD         0xA5 // Written past the end, must survive every kernel
+
+static uint32_t rng_state = 0x2545F491u;
+
+static uint32_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void test_decode_row(const fgb_simd_kernels* scalar, const fgb_simd_kernels* kernels) {
+    for (int lsb = 0; lsb < 256; lsb++) {
+        for (int msb = 0; msb < 256; msb++) {
+            uint8_t expected[8], expected_flipped[8];
+            uint8_t actual[8], actual_flipped[8];
+            scalar->decode_row((uint8_t)lsb, (uint8_t)msb, expected, expected_flipped);
+            kernels->decode_row((uint8_t)lsb, (uint8_t)msb, actual, actual_flipped);
+
+            UNIT_EXPECT(memcmp(expected, actual, sizeof(actual)) == 0 &&
+                memcmp(expected_flipped, actual_flipped, sizeof(actual_flipped)) == 0,
+                "%s decode_row differs for %02X %02X", kernels->name, lsb, msb);
+        }
+    }
+}
+
+// Every BG color against every sprite slot with and without the priority bit, then random pixels
+static void fill_compose_input(uint8_t* bg, uint8_t* sprites, int count, int round) {
+    for (int i = 0; i < count; i++) {
+        if (round == 0) {
+            const int combo = i % 128;
+            bg[i] = (uint8_t)(combo & 3);
+            sprites[i] = (uint8_t)(combo >> 2);
+        } else {
+            const uint32_t r = next_random();
+            bg[i] = (uint8_t)(r & 3);
+            sprites[i] = (uint8_t)((r >> 2) & (0x0F | FGB_SIMD_SPRITE_BEHIND_BG));
+        }
+    }
+}
+
+static void test_compose(const fgb_simd_kernels* scalar, const fgb_simd_kernels* kernels) {
+    uint8_t bg[UNIT_SIMD_MAX_OFFSET + UNIT_SIMD_MAX_COUNT];
+    uint8_t sprites[UNIT_SIMD_MAX_OFFSET + UNIT_SIMD_MAX_COUNT];
+    uint8_t expected[UNIT_SIMD_MAX_OFFSET + UNIT_SIMD_MAX_COUNT + 1];
+    uint8_t actual[UNIT_SIMD_MAX_OFFSET + UNIT_SIMD_MAX_COUNT + 1];
+
+    for (int count = 0; count <= UNIT_SIMD_MAX_COUNT; count++) {
+        for (int round = 0; round < UNIT_SIMD_ROUNDS; round++) {
+            const int offset = round % UNIT_SIMD_MAX_OFFSET;
+            fill_compose_input(&bg[offset], &sprites[offset], count, round);
+
+            memset(expected, UNIT_SIMD_GUARD, sizeof(expected));
+            memset(actual, UNIT_SIMD_GUARD, sizeof(actual));
+            scalar->compose(&bg[offset], &sprites[offset], &expected[offset], count);
+            kernels->compose(&bg[offset], &sprites[offset], &actual[offset], count);
+
+            UNIT_EXPECT(memcmp(expected, actual, sizeof(actual)) == 0,
+                "%s compose differs for %d pixels at offset %d", kernels->name, count, offset);
+        }
+    }
+}
+
+static void test_map_colors(const fgb_simd_kernels* scalar, const fgb_simd_kernels* kernels) {
+    uint8_t slots[UNIT_SIMD_MAX_OFFSET + UNIT_SIMD_MAX_COUNT];
+    uint32_t expected[UNIT_SIMD_MAX_OFFSET + UNIT_SIMD_MAX_COUNT + 1];
+    uint32_t actual[UNIT_SIMD_MAX_OFFSET + UNIT_SIMD_MAX_COUNT + 1];
+    uint32_t table[FGB_SIMD_SLOT_COUNT];
+
+    for (int count = 0; count <= UNIT_SIMD_MAX_COUNT; count++) {
+        for (int round = 0; round < UNIT_SIMD_ROUNDS; round++) {
+            const int offset = round % UNIT_SIMD_MAX_OFFSET;
+
+            // Every byte of every color differs, so a pixel that lands in the wrong place or
+            // a byte from the wrong plane shows up, including across the AVX2 lanes
+            for (int slot = 0; slot < FGB_SIMD_SLOT_COUNT; slot++) {
+                table[slot] = next_random();
+            }
+
+            for (int i = 0; i < count; i++) {
+                slots[offset + i] = round == 0 ? (uint8_t)(i % FGB_SIMD_SLOT_COUNT) : (uint8_t)(next_random() % FGB_SIMD_SLOT_COUNT);
+            }
+
+            memset(expected, UNIT_SIMD_GUARD, sizeof(expected));
+            memset(actual, UNIT_SIMD_GUARD, sizeof(actual));
+            scalar->map_colors(&slots[offset], table, &expected[offset], count);
+            kernels->map_colors(&slots[offset], table, &actual[offset], count);
+
+            UNIT_EXPECT(memcmp(expected, actual, sizeof(actual)) == 0,
+                "%s map_colors differs for %d pixels at offset %d", kernels->name, count, offset);
+        }
+    }
+}
+
+// Checks the vector kernels of every level the host supports against the scalar ones
+void unit_test_simd(void) {
+    const fgb_simd_kernels* scalar = fgb_simd_get_kernels(FGB_SIMD_SCALAR);
+    const enum fgb_simd_level best = fgb_simd_detect();
+
+    UNIT_EXPECT(scalar->level == FGB_SIMD_SCALAR, "scalar kernels report level %d", scalar->level);
+
+    for (int level = FGB_SIMD_SCALAR; level <= (int)best; level++) {
+        const fgb_simd_kernels* kernels = fgb_simd_get_kernels((enum fgb_simd_level)level);
+        UNIT_EXPECT(kernels->level == (enum fgb_simd_level)level, "level %d returned %s kernels", level, kernels->name);
+
+        test_decode_row(scalar, kernels);
+        test_compose(scalar, kernels);
+        test_map_colors(scalar, kernels);
+    }
+}
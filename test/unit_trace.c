@@ -0,0 +1,71 @@
+#include "unit.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <fgb/trace.h>
+
+#define UNIT_TRACE_PATH     "fgbunit_trace.bin"
+#define UNIT_TRACE_CAPACITY 8 // Small enough that the ring wraps and the CPU side stalls
+#define UNIT_TRACE_RECORDS  100000
+
+static void make_record(uint32_t i, fgb_trace_record* record) {
+    memset(record, 0, sizeof(*record));
+    record->cycle = (uint64_t)i * 4 + 0x100000000ull;
+    record->pc = (uint16_t)(i * 3);
+    record->bank = (uint16_t)(i % 128);
+    record->af = (uint16_t)(i ^ 0xA5A5);
+    record->bc = (uint16_t)(i >> 1);
+    record->de = (uint16_t)(i >> 2);
+    record->hl = (uint16_t)(i * 7);
+    record->sp = (uint16_t)(0xFFFE - i);
+    record->opcode = (uint8_t)i;
+    record->operands[0] = (uint8_t)(i >> 8);
+    record->operands[1] = (uint8_t)(i >> 16);
+    record->depth = (uint8_t)(i % 255);
+}
+
+// Pushes records through the ring buffer and writer thread and reads them back from the file
+void unit_test_trace(void) {
+    fgb_trace* trace = fgb_trace_create(UNIT_TRACE_PATH, UNIT_TRACE_CAPACITY);
+    UNIT_EXPECT(trace != NULL, "could not create %s", UNIT_TRACE_PATH);
+    if (!trace) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < UNIT_TRACE_RECORDS; i++) {
+        fgb_trace_record record;
+        make_record(i, &record);
+        fgb_trace_push(trace, &record);
+    }
+
+    fgb_trace_destroy(trace);
+
+    FILE* file = fopen(UNIT_TRACE_PATH, "rb");
+    UNIT_EXPECT(file != NULL, "could not open %s", UNIT_TRACE_PATH);
+    if (!file) {
+        return;
+    }
+
+    fgb_trace_header header;
+    UNIT_EXPECT(fgb_trace_read_header(file, &header), "header was rejected");
+
+    for (uint32_t i = 0; i < UNIT_TRACE_RECORDS; i++) {
+        fgb_trace_record expected, actual;
+        make_record(i, &expected);
+
+        if (fread(&actual, sizeof(actual), 1, file) != 1) {
+            UNIT_EXPECT(false, "trace ends after %u of %u records", i, UNIT_TRACE_RECORDS);
+            break;
+        }
+
+        UNIT_EXPECT(memcmp(&expected, &actual, sizeof(actual)) == 0, "record %u differs (pc %04X, expected %04X)",
+            i, actual.pc, expected.pc);
+    }
+
+    uint8_t extra;
+    UNIT_EXPECT(fread(&extra, 1, 1, file) == 0, "trace has data past the last record");
+
+    (void)fclose(file);
+    (void)remove(UNIT_TRACE_PATH);
+}
@@ -0,0 +1,108 @@
+// Disassembles a binary CPU trace (see fgb/trace.h) into a text log
+//
+// Usage: fgbtrace <trace.bin> [output.log]
+
+#include <fgb/instruction.h>
+#include <fgb/trace.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FGBTRACE_BATCH 4096 // Records read at a time
+
+static const char* const cb_ops[] = { "RLC", "RRC", "RL", "RR", "SLA", "SRA", "SWAP", "SRL" };
+static const char* const cb_regs[] = { "B", "C", "D", "E", "H", "L", "(HL)", "A" };
+
+static void disassemble(const fgb_trace_record* record, char* dest, size_t dest_size) {
+    const fgb_instruction* ins = fgb_instruction_get(record->opcode);
+
+    if (record->opcode == 0xCB) {
+        const uint8_t op = record->operands[0];
+        if (op < 0x40) {
+            (void)snprintf(dest, dest_size, "%s %s", cb_ops[op >> 3], cb_regs[op & 7]);
+        }
+        else {
+            static const char* const bit_ops[] = { "BIT", "RES", "SET" };
+            (void)snprintf(dest, dest_size, "%s %d,%s", bit_ops[(op >> 6) - 1], (op >> 3) & 7, cb_regs[op & 7]);
+        }
+
+        return;
+    }
+
+    switch (ins->operand_size) {
+    case 0:
+        (void)snprintf(dest, dest_size, "%s", ins->fmt_0(ins));
+        break;
+    case 1:
+        (void)snprintf(dest, dest_size, "%s", ins->fmt_1(ins, record->operands[0]));
+        break;
+    case 2:
+        (void)snprintf(dest, dest_size, "%s", ins->fmt_2(ins, (uint16_t)(record->operands[0] | record->operands[1] << 8)));
+        break;
+    default:
+        (void)snprintf(dest, dest_size, "UNKNOWN");
+        break;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s <trace.bin> [output.log]\n", argv[0]);
+        return 1;
+    }
+
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) {
+        printf("Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    FILE* out = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (!out) {
+        printf("Could not open %s\n", argv[2]);
+        (void)fclose(in);
+        return 1;
+    }
+
+    fgb_trace_header header;
+    if (!fgb_trace_read_header(in, &header)) {
+        printf("%s is not a valid trace file\n", argv[1]);
+        (void)fclose(in);
+        if (out != stdout) {
+            (void)fclose(out);
+        }
+        return 1;
+    }
+
+    fgb_trace_record* records = malloc(FGBTRACE_BATCH * sizeof(fgb_trace_record));
+    if (!records) {
+        printf("Could not allocate record buffer\n");
+        (void)fclose(in);
+        if (out != stdout) {
+            (void)fclose(out);
+        }
+        return 1;
+    }
+
+    char disasm[64];
+    size_t count;
+    while ((count = fread(records, sizeof(fgb_trace_record), FGBTRACE_BATCH, in)) != 0) {
+        for (size_t i = 0; i < count; i++) {
+            const fgb_trace_record* record = &records[i];
+            disassemble(record, disasm, sizeof(disasm));
+
+            (void)fprintf(out, "%12llu %02X:%04X:%*s%-*s AF=%04X BC=%04X DE=%04X HL=%04X SP=%04X\n",
+                (unsigned long long)record->cycle, record->bank, record->pc,
+                2 * (record->depth + 1), "", 24, disasm,
+                record->af, record->bc, record->de, record->hl, record->sp);
+        }
+    }
+
+    free(records);
+    (void)fclose(in);
+    if (out != stdout) {
+        (void)fclose(out);
+    }
+
+    return 0;
+}